@@ -32,10 +32,15 @@
 
 #include "config_task.h"
 #include "definitions.h"
+#include "driver/spi/drv_spi_trace.h"
 #include "http_task.h"
 #include "imager_task.h"
 #include "mu_strbuf.h"
 #include "nv_data.h"
+#include "ping_task.h"
+#include "probe_task.h"
+#include "survey_task.h"
+#include "udp_task.h"
 #include "winc_task.h"
 #include "yb_log.h"
 #include "yb_rtc.h"
@@ -59,6 +64,24 @@
   "Host: example.com\r\n"                                                      \
   "User-Agent: Mozilla/5.0 (Windows NT 10.0; Win64; x64; rv:95.0)\r\n"         \
   "Accept: */*;q=0.8\r\n"                                                      \
+  "Connection: close\r\n"                                                      \
+  "\r\n"
+
+#define DOWNLOAD_MSG_SIZE 192
+#define DOWNLOAD_MSG_FORMAT                                                    \
+  "GET %s HTTP/1.1\r\n"                                                        \
+  "Host: %s\r\n"                                                               \
+  "Connection: close\r\n"                                                      \
+  "\r\n"
+
+// Headers only: the body is streamed from the SD card by http_task.
+#define UPLOAD_MSG_SIZE 256
+#define UPLOAD_MSG_FORMAT                                                      \
+  "POST %s HTTP/1.1\r\n"                                                       \
+  "Host: %s\r\n"                                                               \
+  "Content-Type: application/octet-stream\r\n"                                 \
+  "Content-Length: %lu\r\n"                                                    \
+  "Connection: close\r\n"                                                      \
   "\r\n"
 
 #define TASK_STATES(M)                                                         \
@@ -95,6 +118,12 @@ static uint8_t s_response_buf[TCP_BUFFER_SIZE];
 static mu_strbuf_t s_request_msg;
 static mu_strbuf_t s_response_msg;
 
+static char s_download_buf[DOWNLOAD_MSG_SIZE];
+static mu_strbuf_t s_download_msg;
+
+static char s_upload_buf[UPLOAD_MSG_SIZE];
+static mu_strbuf_t s_upload_msg;
+
 #define EXPAND_NAME(_name) #_name,
 static const char *s_app_state_names[] = {TASK_STATES(EXPAND_NAME)};
 
@@ -123,16 +152,26 @@ void app_step(void *arg);
  */
 static void print_banner(void);
 
+#if DRV_SPI_TRACE_ENABLE
+/**
+ * @brief Print this wake's SPI trace, one "spitrace" line per mark or
+ * transfer, for tools/spi_trace.py.
+ */
+static void app_dump_spi_trace(void);
+#endif
+
 // *****************************************************************************
 // Public code
 
 void APP_Initialize(void) {
+  DRV_SPI_TraceInitialize();
   s_app_ctx.state = APP_STATE_INIT;
   s_app_ctx.timeout_is_active = false;
   if (app_is_cold_boot()) {
     nv_data_clear(); // forget everything you knew...
     yb_rtc_init();
   }
+  winc_task_boot();
   mu_strbuf_init_from_cstr(&s_request_msg, TCP_SEND_MESSAGE);
   mu_strbuf_init_rw(&s_response_msg, s_response_buf, TCP_BUFFER_SIZE);
   s_app_ctx.reboot_at = yb_rtc_now();
@@ -217,8 +256,9 @@ void APP_Tasks(void) {
 
   case APP_STATE_START_IMAGER_TASK: {
     const char *image_file = config_task_get_winc_image_filename();
+    const char *image_region = config_task_get_winc_image_region();
     YB_LOG_INFO("Reflashing WINC from %s", image_file);
-    imager_task_init(image_file);
+    imager_task_init(image_file, image_region);
     app_set_state(APP_STATE_AWAIT_IMAGER_TASK);
   } break;
 
@@ -254,7 +294,7 @@ void APP_Tasks(void) {
   } break;
 
   case APP_STATE_START_WINC_TASK: {
-    winc_task_connect(config_task_get_wifi_ssid(), config_task_get_wifi_pass());
+    winc_task_connect();
     app_set_state(APP_STATE_AWAIT_WINC_TASK);
   } break;
 
@@ -283,12 +323,19 @@ void APP_Tasks(void) {
                 nv_data()->app_nv_data.reboot_count);
     YB_LOG_INFO("Preparing to hibernate");
     http_task_shutdown();
+    probe_task_shutdown();
+    ping_task_shutdown();
+    udp_task_shutdown();
+    survey_task_shutdown();
     winc_task_shutdown();
     imager_task_shutdown();
     config_task_shutdown();
     SYS_FS_Unmount(SD_MOUNT_NAME);
+#if DRV_SPI_TRACE_ENABLE
+    app_dump_spi_trace();
+#endif
     yb_rtc_tics_t wake_at = nv_data()->app_nv_data.wake_at;
-    wake_at = yb_rtc_offset(wake_at, config_task_get_wake_interval_ms());
+    wake_at = yb_rtc_next_period(wake_at, config_task_get_wake_interval_ms());
     // record the time at which we next want to wake...
     nv_data()->app_nv_data.wake_at = wake_at;
     yb_rtc_hibernate_until(wake_at);
@@ -316,6 +363,71 @@ mu_strbuf_t *app_request_msg() { return &s_request_msg; }
 
 mu_strbuf_t *app_response_msg() { return &s_response_msg; }
 
+mu_strbuf_t *app_download_msg(const char *path) {
+  snprintf(s_download_buf,
+           sizeof(s_download_buf),
+           DOWNLOAD_MSG_FORMAT,
+           path,
+           APP_HOST_NAME);
+  return mu_strbuf_init_from_cstr(&s_download_msg, s_download_buf);
+}
+
+mu_strbuf_t *app_upload_msg(const char *path, uint32_t length) {
+  snprintf(s_upload_buf,
+           sizeof(s_upload_buf),
+           UPLOAD_MSG_FORMAT,
+           path,
+           APP_HOST_NAME,
+           length);
+  return mu_strbuf_init_from_cstr(&s_upload_msg, s_upload_buf);
+}
+
+size_t app_build_report(uint8_t *buf, size_t size) {
+  uint32_t fields[] = {nv_data()->app_nv_data.reboot_count,
+                       nv_data()->app_nv_data.success_count,
+                       (uint32_t)app_uptime_ms()};
+  size_t n = 0;
+
+  for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+    if (n + 4 > size) {
+      break;
+    }
+    buf[n++] = (uint8_t)(fields[i] >> 24);
+    buf[n++] = (uint8_t)(fields[i] >> 16);
+    buf[n++] = (uint8_t)(fields[i] >> 8);
+    buf[n++] = (uint8_t)(fields[i]);
+  }
+  n += winc_task_encode_causes(&buf[n], size - n);
+  n += ping_task_encode(&buf[n], size - n);
+  n += http_task_encode_timing(&buf[n], size - n);
+  if (config_task_get_survey_every() > 0) {
+    n += survey_task_encode(&buf[n], size - n);
+  }
+  return n;
+}
+
+void app_report_delivered(bool via_udp) {
+  app_nv_data_t *nv = &nv_data()->app_nv_data;
+  yb_rtc_ms_t ms = app_uptime_ms();
+
+  if (via_udp) {
+    nv->udp_report_ms = ms;
+    // only the UDP report carries the survey records
+    survey_task_encoded_delivered();
+  } else {
+    nv->http_report_ms = ms;
+  }
+  YB_LOG_INFO("Report delivered via %s at %d ms",
+              via_udp ? "UDP" : "HTTP",
+              (int)ms);
+  if (nv->udp_report_ms > 0 && nv->http_report_ms > 0) {
+    YB_LOG_INFO("Last report: HTTP %d ms, UDP %d ms, UDP saves %d ms",
+                (int)nv->http_report_ms,
+                (int)nv->udp_report_ms,
+                (int)(nv->http_report_ms - nv->udp_report_ms));
+  }
+}
+
 // *****************************************************************************
 // Local (private, static) code
 
@@ -324,6 +436,7 @@ static void app_set_state(app_state_t new_state) {
     YB_LOG_INFO(
         "%s => %s", app_state_name(s_app_ctx.state), app_state_name(new_state));
     s_app_ctx.state = new_state;
+    DRV_SPI_TraceMark(app_state_name(new_state));
   }
 }
 
@@ -339,3 +452,28 @@ static void print_banner(void) {
          nv_data()->app_nv_data.reboot_count);
   printf("\n##############################");
 }
+
+#if DRV_SPI_TRACE_ENABLE
+static void app_dump_spi_trace(void) {
+  DRV_SPI_TRACE_RECORD record;
+  DRV_SPI_TRACE_MARK mark;
+  uint32_t overwritten;
+  size_t count = DRV_SPI_TraceCount(&overwritten);
+
+  printf("\nspitrace hz %lu records %u overwritten %lu",
+         (uint32_t)CPU_CLOCK_FREQUENCY,
+         count,
+         overwritten);
+  for (size_t i = 0; DRV_SPI_TraceMarkGet(i, &mark); i++) {
+    printf("\nspitrace m %lu %s", mark.cycle, mark.name);
+  }
+  for (size_t i = 0; DRV_SPI_TraceGet(i, &record); i++) {
+    printf("\nspitrace t %d %d %d %lu %lu",
+           record.source,
+           record.dir,
+           record.length,
+           record.startCycle,
+           record.endCycle);
+  }
+}
+#endif
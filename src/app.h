@@ -34,6 +34,7 @@
 #include "mu_strbuf.h"
 #include "yb_rtc.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // =============================================================================
@@ -48,18 +49,47 @@ extern "C" {
 
 #define APP_HOST_NAME "example.com"
 #define APP_HOST_IP_ADDR NULL // use APP_HOST_NAME
-// #define APP_HOST_USE_TLS true
-// #define APP_HOST_PORT 443
-#define APP_HOST_USE_TLS false
-#define APP_HOST_PORT 80
+#define APP_HOST_USE_TLS true
+#define APP_HOST_PORT 443
+// #define APP_HOST_USE_TLS false
+// #define APP_HOST_PORT 80
+
+// Set to true to skip X.509 verification, e.g. when testing against a local
+// TLS server whose self-signed CA has not been loaded into the WINC.
+#define APP_HOST_TLS_BYPASS_X509 false
+
+// How long a resolved APP_HOST_NAME address is trusted before the next DNS
+// lookup.  Set to 0 to perform a DNS lookup on every wake.
+#define APP_HOST_DNS_TTL_MS ((yb_rtc_ms_t)3600000.0)
+
+// Time allowed for probing the probe_endpoint list from config.txt.
+#define APP_PROBE_BUDGET_MS ((yb_rtc_ms_t)5000.0)
+
+// Time allowed for the ping burst configured by ping_count and ping_host.
+#define APP_PING_BUDGET_MS ((yb_rtc_ms_t)5000.0)
+
+// Time allowed for each direction of the bench_host throughput benchmark.
+#define APP_BENCH_BUDGET_MS ((yb_rtc_ms_t)10000.0)
+
+// Time allowed for the site survey configured by survey_every, including
+// reading back the results.
+#define APP_SURVEY_BUDGET_MS ((yb_rtc_ms_t)3000.0)
+
+// UDP report path (udp_host in config.txt): the report is sent up to this many
+// times, waiting APP_UDP_ACK_TIMEOUT_MS for the first ack and doubling the wait
+// on each retry.  If no ack arrives the report falls back to HTTP.
+#define APP_UDP_MAX_ATTEMPTS 3
+#define APP_UDP_ACK_TIMEOUT_MS ((yb_rtc_ms_t)250.0)
 
 /**
  * @brief Data that is preserved across reboots.
  */
 typedef struct {
-  uint32_t reboot_count;  // # of times system rebooted
-  uint32_t success_count; // # of times app completed HTTP exchange
-  yb_rtc_tics_t wake_at;  // RTC time at which app woke up
+  uint32_t reboot_count;      // # of times system rebooted
+  uint32_t success_count;     // # of times app completed HTTP exchange
+  yb_rtc_tics_t wake_at;      // RTC time at which app woke up
+  yb_rtc_ms_t http_report_ms; // uptime when the last HTTP report completed
+  yb_rtc_ms_t udp_report_ms;  // uptime when the last UDP report was acked
 } app_nv_data_t;
 
 // *****************************************************************************
@@ -96,6 +126,36 @@ mu_strbuf_t *app_request_msg();
  */
 mu_strbuf_t *app_response_msg();
 
+/**
+ * @brief Return a reference to a buffer holding a GET request for path on
+ * APP_HOST_NAME.
+ */
+mu_strbuf_t *app_download_msg(const char *path);
+
+/**
+ * @brief Return a reference to a buffer holding the headers of a POST of
+ * length bytes to path on APP_HOST_NAME.
+ */
+mu_strbuf_t *app_upload_msg(const char *path, uint32_t length);
+
+/**
+ * @brief Write the compact report sent over the UDP path into buf and return
+ * its length: reboot_count, success_count and uptime in ms, each as a 32 bit
+ * big-endian value, then the connection failure counts by cause (see
+ * winc_task_encode_causes()), the round trip statistics of this wake's ping
+ * burst (see ping_task_encode()) and the phase timing of the most recent
+ * HTTP request (see http_task_encode_timing()).  If the site survey is enabled,
+ * the survey records that have changed since they were last delivered follow
+ * (see survey_task_encode()).
+ */
+size_t app_build_report(uint8_t *buf, size_t size);
+
+/**
+ * @brief Record that the report was delivered, over UDP if via_udp is true or
+ * else over HTTP, and log how the wake time compares with the other path.
+ */
+void app_report_delivered(bool via_udp);
+
 // *****************************************************************************
 // EOF
 
@@ -48,6 +48,7 @@
 
 #include <string.h>
 #include "drv_sdspi_plib_interface.h"
+#include "driver/spi/drv_spi_trace.h"
 
 // *****************************************************************************
 /* Timer Event Handler
@@ -91,6 +92,8 @@ void _DRV_SDSPI_SPIPlibCallbackHandler( uintptr_t context )
     dObj->spiTransferStatus = DRV_SDSPI_SPI_TRANSFER_STATUS_COMPLETE;
 
     SYS_PORT_PinSet(dObj->chipSelectPin);
+
+    DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE_SDSPI);
 }
 
 // *****************************************************************************
@@ -117,6 +120,8 @@ bool _DRV_SDSPI_SPIWrite(
 
     dObj->spiTransferStatus = DRV_SDSPI_SPI_TRANSFER_STATUS_IN_PROGRESS;
 
+    DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE_SDSPI, DRV_SPI_TRACE_DIR_WRITE, nBytes);
+
     if (dObj->spiPlib->write (pWriteBuffer, nBytes) == false)
     {
         SYS_PORT_PinSet(dObj->chipSelectPin);
@@ -153,6 +158,8 @@ bool _DRV_SDSPI_SPIRead(
 
     dObj->spiTransferStatus = DRV_SDSPI_SPI_TRANSFER_STATUS_IN_PROGRESS;
 
+    DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE_SDSPI, DRV_SPI_TRACE_DIR_READ, nBytes);
+
     if (dObj->spiPlib->read (pReadBuffer, nBytes) == false)
     {
         SYS_PORT_PinSet(dObj->chipSelectPin);
@@ -177,6 +184,8 @@ bool _DRV_SDSPI_SPIWriteWithChipSelectDisabled(
 
     dObj->spiTransferStatus = DRV_SDSPI_SPI_TRANSFER_STATUS_IN_PROGRESS;
 
+    DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE_SDSPI, DRV_SPI_TRACE_DIR_WRITE, nBytes);
+
     if (dObj->spiPlib->write (pWriteBuffer, nBytes) == true)
     {
         isSuccess = true;
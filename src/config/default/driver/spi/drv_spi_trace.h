@@ -0,0 +1,177 @@
+/*******************************************************************************
+  SPI Transfer Trace Header File
+
+
+  File Name:
+    drv_spi_trace.h
+
+  Summary:
+    [rdp] Records SPI transfers into a RAM ring for bus profiling.
+
+  Description:
+    Each transfer is recorded with its source, direction, length and start and
+    end times from the Cortex-M cycle counter.  Named marks record phases of
+    the application, so that a host tool can lay the transfers out on a
+    timeline and total the bus time of each phase.
+
+    Tracing is disabled unless DRV_SPI_TRACE_ENABLE is defined non-zero, e.g.
+    in the project's preprocessor macros.  When disabled, the calls below
+    compile to nothing and no RAM is used.
+*******************************************************************************/
+
+//DOM-IGNORE-BEGIN
+/*******************************************************************************
+* MIT License
+*
+* Copyright (c) 2022 Klatu Networks
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+//DOM-IGNORE-END
+
+#ifndef DRV_SPI_TRACE_H
+#define DRV_SPI_TRACE_H
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: File includes
+// *****************************************************************************
+// *****************************************************************************
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus  // Provide C++ Compatibility
+
+    extern "C" {
+
+#endif
+// DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Configuration
+// *****************************************************************************
+// *****************************************************************************
+
+#ifndef DRV_SPI_TRACE_ENABLE
+#define DRV_SPI_TRACE_ENABLE        0
+#endif
+
+/* Number of transfers held; once full, the oldest are overwritten. */
+#ifndef DRV_SPI_TRACE_DEPTH
+#define DRV_SPI_TRACE_DEPTH         512
+#endif
+
+/* Number of phase marks held; once full, further marks are dropped. */
+#ifndef DRV_SPI_TRACE_MARK_DEPTH
+#define DRV_SPI_TRACE_MARK_DEPTH    64
+#endif
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Data Types
+// *****************************************************************************
+// *****************************************************************************
+
+/* Where a transfer was recorded.  SPI transfers are the bus actually moving
+   data; WINC transfers are whole WDRV_WINC_SPISend/Receive calls, including
+   queueing behind earlier transfers and waiting for completion. */
+typedef enum
+{
+    DRV_SPI_TRACE_SOURCE_SPI = 0,
+    DRV_SPI_TRACE_SOURCE_WINC,
+    DRV_SPI_TRACE_SOURCE_SDSPI,
+    DRV_SPI_TRACE_SOURCE_COUNT
+} DRV_SPI_TRACE_SOURCE;
+
+typedef enum
+{
+    DRV_SPI_TRACE_DIR_WRITE = 1,
+    DRV_SPI_TRACE_DIR_READ = 2,
+    DRV_SPI_TRACE_DIR_WRITE_READ = 3
+} DRV_SPI_TRACE_DIR;
+
+typedef struct
+{
+    uint32_t    startCycle;
+    uint32_t    endCycle;
+    uint16_t    length;     /* bytes, saturated at 65535 */
+    uint8_t     source;     /* DRV_SPI_TRACE_SOURCE */
+    uint8_t     dir;        /* DRV_SPI_TRACE_DIR */
+} DRV_SPI_TRACE_RECORD;
+
+typedef struct
+{
+    uint32_t    cycle;
+    const char  *name;      /* must be a string constant */
+} DRV_SPI_TRACE_MARK;
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Interface Routines
+// *****************************************************************************
+// *****************************************************************************
+
+#if DRV_SPI_TRACE_ENABLE
+
+/* Starts the cycle counter and empties the trace. */
+void DRV_SPI_TraceInitialize(void);
+
+/* Notes the start of a transfer by source.  Each source has at most one
+   transfer in progress.  May be called from interrupt context. */
+void DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE source, DRV_SPI_TRACE_DIR dir,
+                        size_t length);
+
+/* Records the transfer begun by source.  May be called from interrupt
+   context. */
+void DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE source);
+
+/* Records the start of a phase of the application. */
+void DRV_SPI_TraceMark(const char *name);
+
+/* Returns the number of transfers held, and of those overwritten. */
+size_t DRV_SPI_TraceCount(uint32_t *overwritten);
+
+/* Copies out the index'th oldest transfer held. */
+bool DRV_SPI_TraceGet(size_t index, DRV_SPI_TRACE_RECORD *record);
+
+/* Returns the number of marks held. */
+size_t DRV_SPI_TraceMarkCount(void);
+
+/* Copies out the index'th mark. */
+bool DRV_SPI_TraceMarkGet(size_t index, DRV_SPI_TRACE_MARK *mark);
+
+#else
+
+#define DRV_SPI_TraceInitialize()               ((void)0)
+#define DRV_SPI_TraceBegin(source, dir, length) ((void)0)
+#define DRV_SPI_TraceEnd(source)                ((void)0)
+#define DRV_SPI_TraceMark(name)                 ((void)0)
+
+#endif
+
+// DOM-IGNORE-BEGIN
+#ifdef __cplusplus
+}
+#endif
+// DOM-IGNORE-END
+
+#endif // #ifndef DRV_SPI_TRACE_H
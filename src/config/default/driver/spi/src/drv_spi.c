@@ -48,6 +48,7 @@
 #include <string.h>
 #include "configuration.h"
 #include "driver/spi/drv_spi.h"
+#include "driver/spi/drv_spi_trace.h"
 #include "system/debug/sys_debug.h"
 
 // *****************************************************************************
@@ -474,6 +475,27 @@ static void _DRV_SPI_StartDMATransfer(DRV_SPI_TRANSFER_OBJ* transferObj)
     }
 }
 
+#if DRV_SPI_TRACE_ENABLE
+/* [rdp] Note the start of a transfer. */
+static void _DRV_SPI_TraceTransferBegin(DRV_SPI_TRANSFER_OBJ* transferObj)
+{
+    DRV_SPI_TRACE_DIR dir = DRV_SPI_TRACE_DIR_WRITE_READ;
+
+    if (transferObj->rxSize == 0)
+    {
+        dir = DRV_SPI_TRACE_DIR_WRITE;
+    }
+    else if (transferObj->txSize == 0)
+    {
+        dir = DRV_SPI_TRACE_DIR_READ;
+    }
+    DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE_SPI, dir,
+        (transferObj->rxSize > transferObj->txSize) ? transferObj->rxSize : transferObj->txSize);
+}
+#else
+#define _DRV_SPI_TraceTransferBegin(transferObj) ((void)0)
+#endif
+
 static void _DRV_SPI_UpdateTransferSetupAndAssertCS(
     DRV_SPI_TRANSFER_OBJ* transferObj
 )
@@ -481,6 +503,9 @@ static void _DRV_SPI_UpdateTransferSetupAndAssertCS(
     DRV_SPI_OBJ* dObj;
     DRV_SPI_CLIENT_OBJ* clientObj;
 
+    /* [rdp] Every transfer starts here, with or without DMA. */
+    _DRV_SPI_TraceTransferBegin(transferObj);
+
     /* Get the client object that owns this buffer */
     clientObj = &((DRV_SPI_CLIENT_OBJ *)gDrvSPIObj[((transferObj->clientHandle & DRV_SPI_INSTANCE_MASK) >> 8)].clientObjPool)
     [transferObj->clientHandle & DRV_SPI_INDEX_MASK];
@@ -545,6 +570,8 @@ static void _DRV_SPI_PlibCallbackHandler(uintptr_t contextHandle)
         }
     }
 
+    DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE_SPI);
+
     /* Check if the client that submitted the request is active? */
     if (clientObj->clientHandle == transferObj->clientHandle)
     {
@@ -737,6 +764,8 @@ void _DRV_SPI_RX_DMA_CallbackHandler(
             }
         }
 
+        DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE_SPI);
+
         /* Check if the client that submitted the request is active? */
         if (clientObj->clientHandle == transferObj->clientHandle)
         {
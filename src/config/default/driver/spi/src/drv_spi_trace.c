@@ -0,0 +1,170 @@
+/*******************************************************************************
+  SPI Transfer Trace Implementation.
+
+
+  File Name:
+    drv_spi_trace.c
+
+  Summary:
+    [rdp] Records SPI transfers into a RAM ring for bus profiling.
+
+  Description:
+    See drv_spi_trace.h.  Times are read from the DWT cycle counter, which
+    counts CPU_CLOCK_FREQUENCY cycles per second and wraps every 35 seconds at
+    120 MHz; differences of nearby readings are exact.
+*******************************************************************************/
+
+//DOM-IGNORE-BEGIN
+/*******************************************************************************
+* MIT License
+*
+* Copyright (c) 2022 Klatu Networks
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+//DOM-IGNORE-END
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Included Files
+// *****************************************************************************
+// *****************************************************************************
+
+#include "driver/spi/drv_spi_trace.h"
+
+#if DRV_SPI_TRACE_ENABLE
+
+#include "definitions.h"
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: Global Data
+// *****************************************************************************
+// *****************************************************************************
+
+static DRV_SPI_TRACE_RECORD traceRing[DRV_SPI_TRACE_DEPTH];
+static size_t traceNext;
+static size_t traceCount;
+static uint32_t traceOverwritten;
+
+static DRV_SPI_TRACE_MARK traceMarks[DRV_SPI_TRACE_MARK_DEPTH];
+static size_t traceMarkCount;
+
+/* The transfer in progress for each source, completed by DRV_SPI_TraceEnd. */
+static volatile DRV_SPI_TRACE_RECORD traceBegun[DRV_SPI_TRACE_SOURCE_COUNT];
+
+// *****************************************************************************
+// *****************************************************************************
+// Section: SPI Trace Interface Implementation
+// *****************************************************************************
+// *****************************************************************************
+
+void DRV_SPI_TraceInitialize(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    traceNext = 0;
+    traceCount = 0;
+    traceOverwritten = 0;
+    traceMarkCount = 0;
+}
+
+void DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE source, DRV_SPI_TRACE_DIR dir,
+                        size_t length)
+{
+    volatile DRV_SPI_TRACE_RECORD *begun = &traceBegun[source];
+
+    begun->length = (length > UINT16_MAX) ? UINT16_MAX : (uint16_t)length;
+    begun->source = (uint8_t)source;
+    begun->dir = (uint8_t)dir;
+    begun->startCycle = DWT->CYCCNT;
+}
+
+void DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE source)
+{
+    uint32_t endCycle = DWT->CYCCNT;
+    DRV_SPI_TRACE_RECORD *record;
+    bool interruptState;
+
+    /* The SPI source ends in the DMA interrupt, the others in task context. */
+    interruptState = SYS_INT_Disable();
+    record = &traceRing[traceNext];
+    traceNext = (traceNext + 1) % DRV_SPI_TRACE_DEPTH;
+    if (traceCount < DRV_SPI_TRACE_DEPTH)
+    {
+        traceCount++;
+    }
+    else
+    {
+        traceOverwritten++;
+    }
+    *record = traceBegun[source];
+    record->endCycle = endCycle;
+    SYS_INT_Restore(interruptState);
+}
+
+void DRV_SPI_TraceMark(const char *name)
+{
+    if (traceMarkCount < DRV_SPI_TRACE_MARK_DEPTH)
+    {
+        traceMarks[traceMarkCount].cycle = DWT->CYCCNT;
+        traceMarks[traceMarkCount].name = name;
+        traceMarkCount++;
+    }
+}
+
+size_t DRV_SPI_TraceCount(uint32_t *overwritten)
+{
+    if (NULL != overwritten)
+    {
+        *overwritten = traceOverwritten;
+    }
+    return traceCount;
+}
+
+bool DRV_SPI_TraceGet(size_t index, DRV_SPI_TRACE_RECORD *record)
+{
+    if ((index >= traceCount) || (NULL == record))
+    {
+        return false;
+    }
+    /* The oldest record follows the newest once the ring has wrapped. */
+    index += (traceCount < DRV_SPI_TRACE_DEPTH) ? 0 : traceNext;
+    *record = traceRing[index % DRV_SPI_TRACE_DEPTH];
+    return true;
+}
+
+size_t DRV_SPI_TraceMarkCount(void)
+{
+    return traceMarkCount;
+}
+
+bool DRV_SPI_TraceMarkGet(size_t index, DRV_SPI_TRACE_MARK *mark)
+{
+    if ((index >= traceMarkCount) || (NULL == mark))
+    {
+        return false;
+    }
+    *mark = traceMarks[index];
+    return true;
+}
+
+#endif // DRV_SPI_TRACE_ENABLE
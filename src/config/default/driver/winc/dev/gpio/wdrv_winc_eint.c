@@ -94,4 +94,40 @@ void WDRV_WINC_INTDeinitialize(void)
 #endif
 }
 
+/****************************************************************************
+ * Function:        WDRV_WINC_INTMask
+ * Summary: [rdp] Stops the WINC interrupt reaching the CPU.  An edge that
+ *          arrives meanwhile is held pending, not lost.
+ *****************************************************************************/
+void WDRV_WINC_INTMask(void)
+{
+#ifdef WDRV_WINC_EIC_SOURCE
+    EIC_InterruptDisable(WDRV_WINC_EIC_SOURCE);
+#elif defined WDRV_WINC_GPIO_SOURCE
+    GPIO_PinInterruptDisable(WDRV_WINC_GPIO_SOURCE);
+#elif defined WDRV_WINC_PIO_SOURCE
+    PIO_PinInterruptDisable(WDRV_WINC_PIO_SOURCE);
+#else
+    SYS_INT_SourceDisable(WDRV_INT_SOURCE);
+#endif
+}
+
+/****************************************************************************
+ * Function:        WDRV_WINC_INTUnmask
+ * Summary: [rdp] Lets the WINC interrupt reach the CPU again, including an
+ *          edge held pending while it was masked.
+ *****************************************************************************/
+void WDRV_WINC_INTUnmask(void)
+{
+#ifdef WDRV_WINC_EIC_SOURCE
+    EIC_InterruptEnable(WDRV_WINC_EIC_SOURCE);
+#elif defined WDRV_WINC_GPIO_SOURCE
+    GPIO_PinInterruptEnable(WDRV_WINC_GPIO_SOURCE);
+#elif defined WDRV_WINC_PIO_SOURCE
+    PIO_PinInterruptEnable(WDRV_WINC_PIO_SOURCE);
+#else
+    SYS_INT_SourceEnable(WDRV_INT_SOURCE);
+#endif
+}
+
 //DOM-IGNORE-END
@@ -39,6 +39,8 @@
 #include "definitions.h"
 #include "osal/osal.h"
 #include "wdrv_winc_common.h"
+#include "wdrv_winc_spi.h"
+#include "driver/spi/drv_spi_trace.h"
 
 #if defined(USE_CACHE_MAINTENANCE)
 /* Cache Management to be enabled in core & system components of MHC Project Graph*/
@@ -60,9 +62,30 @@
 #define SPI_DMA_DCACHE_CLEAN(addr, size) do { } while (0)
 #endif /* (DRV_SPI_DMA != 0) */
 
+// [rdp] Transfers are queued to DRV_SPI back to back, up to the depth of its
+// queue, and completions are counted off one semaphore.  Short sends (register
+// commands) are copied to a staging slot and allowed to complete behind the
+// caller; anything that reads from the WINC, or hands back a caller's buffer,
+// first waits for every earlier transfer.  DRV_SPI runs its queue in order, so
+// the WINC sees exactly the byte stream the blocking version produced.
+#define WDRV_WINC_SPI_DEPTH     DRV_SPI_QUEUE_SIZE_IDX0
+#define WDRV_WINC_SPI_POST_MAX  16
+
 static DRV_HANDLE spiHandle = DRV_HANDLE_INVALID;
-static OSAL_SEM_HANDLE_TYPE txSyncSem;
-static OSAL_SEM_HANDLE_TYPE rxSyncSem;
+static OSAL_SEM_HANDLE_TYPE doneSem;
+static volatile uint32_t pending;
+static volatile bool transferError;
+static uint8_t postSlot;
+static uint8_t __attribute__((aligned(4)))
+    postBuf[WDRV_WINC_SPI_DEPTH][WDRV_WINC_SPI_POST_MAX];
+
+// [rdp] Queue times of the transfers in flight, oldest at queueHead, so that
+// the completion handler can account for the time the bus was busy.
+static uint32_t queuedAt[WDRV_WINC_SPI_DEPTH];
+static uint8_t queueHead;
+static uint8_t queueTail;
+static uint32_t lastDoneAt;
+static WDRV_WINC_SPI_STATS spiStats;
 
 #if defined(__PIC32MZ__) && defined(USE_CACHE_MAINTENANCE)
 /****************************************************************************
@@ -83,44 +106,109 @@ static void _DataCacheClean(unsigned char *address, uint32_t size)
 }
 #endif /* defined(__PIC32MZ__) && defined(USE_CACHE_MAINTENANCE)*/
 
-static DRV_SPI_TRANSFER_HANDLE transferTxHandle;
-static DRV_SPI_TRANSFER_HANDLE transferRxHandle;
+/****************************************************************************
+ * Function:        _SPI_Wait
+ * Summary: [rdp] Waits for the oldest transfer in flight to complete.
+ *****************************************************************************/
+static void _SPI_Wait(void)
+{
+    uint32_t start = SYS_TIME_CounterGet();
 
-static bool _SPI_Tx(unsigned char *buf, uint32_t size)
+    while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&doneSem, OSAL_WAIT_FOREVER))
+    {
+    }
+
+    pending--;
+    spiStats.waitTicks += SYS_TIME_CounterGet() - start;
+}
+
+/****************************************************************************
+ * Function:        _SPI_Drain
+ * Summary: [rdp] Waits for every transfer in flight, and reports whether
+ * all of them succeeded.
+ *****************************************************************************/
+static bool _SPI_Drain(void)
 {
-    SPI_DMA_DCACHE_CLEAN(buf, size);
-    DRV_SPI_WriteTransferAdd(spiHandle, buf, size, &transferTxHandle);
+    bool ret;
 
-    if(transferTxHandle == DRV_SPI_TRANSFER_HANDLE_INVALID)
+    while (pending > 0)
     {
-        // Error handling here
-        return false;
+        _SPI_Wait();
+    }
+
+    ret = !transferError;
+    transferError = false;
+
+    return ret;
+}
+
+/****************************************************************************
+ * Function:        _SPI_Reserve
+ * Summary: [rdp] Makes room in the pipeline for one more transfer.
+ *****************************************************************************/
+static void _SPI_Reserve(void)
+{
+    if (pending >= WDRV_WINC_SPI_DEPTH)
+    {
+        spiStats.pipelineFull++;
+        _SPI_Wait();
     }
 
-    while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&txSyncSem, OSAL_WAIT_FOREVER))
+    queuedAt[queueTail] = SYS_TIME_CounterGet();
+}
+
+/****************************************************************************
+ * Function:        _SPI_Queued
+ * Summary: [rdp] Accounts for a transfer that DRV_SPI has accepted.
+ *****************************************************************************/
+static bool _SPI_Queued(DRV_SPI_TRANSFER_HANDLE handle)
+{
+    if (DRV_SPI_TRANSFER_HANDLE_INVALID == handle)
     {
+        spiStats.errors++;
+        return false;
+    }
+
+    queueTail = (queueTail + 1) % WDRV_WINC_SPI_DEPTH;
+    pending++;
+    spiStats.transfers++;
+
+    return true;
+}
 
+static bool _SPI_Tx(unsigned char *buf, uint32_t size)
+{
+    DRV_SPI_TRANSFER_HANDLE handle;
+
+    _SPI_Reserve();
+    SPI_DMA_DCACHE_CLEAN(buf, size);
+    DRV_SPI_WriteTransferAdd(spiHandle, buf, size, &handle);
+
+    if (false == _SPI_Queued(handle))
+    {
+        return false;
     }
 
+    spiStats.txBytes += size;
+
     return true;
 }
 
 static bool _SPI_Rx(unsigned char *const buf, uint32_t size)
 {
     static uint8_t dummy = 0;
+    DRV_SPI_TRANSFER_HANDLE handle;
 
+    _SPI_Reserve();
     SPI_DMA_DCACHE_CLEAN(buf, size);
+    DRV_SPI_WriteReadTransferAdd(spiHandle, &dummy, 1, buf, size, &handle);
 
-    DRV_SPI_WriteReadTransferAdd(spiHandle, &dummy, 1, buf, size, &transferRxHandle);
-
-    if(transferRxHandle == DRV_SPI_TRANSFER_HANDLE_INVALID)
+    if (false == _SPI_Queued(handle))
     {
-        // Error handling here
         return false;
     }
-    while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&rxSyncSem, OSAL_WAIT_FOREVER))
-    {
-    }
+
+    spiStats.rxBytes += size;
 
     return true;
 }
@@ -128,27 +216,34 @@ static bool _SPI_Rx(unsigned char *const buf, uint32_t size)
 static void _WDRV_WINC_SPITransferEventHandler(DRV_SPI_TRANSFER_EVENT event,
         DRV_SPI_TRANSFER_HANDLE handle, uintptr_t context)
 {
-    // The context handle was set to an application specific
-    // object. It is now retrievable easily in the event handler.
-   // MY_APP_OBJ myAppObj = (MY_APP_OBJ *) context;
+    uint32_t now;
+    uint32_t start;
 
     switch(event)
     {
         case DRV_SPI_TRANSFER_EVENT_COMPLETE:
-            // This means the data was transferred.
-            if (transferTxHandle == handle)
+        case DRV_SPI_TRANSFER_EVENT_ERROR:
+            // [rdp] The bus was busy from when this transfer was queued, or
+            // from when the one ahead of it finished, whichever was later.
+            now = SYS_TIME_CounterGet();
+            start = queuedAt[queueHead];
+
+            if ((int32_t)(lastDoneAt - start) > 0)
             {
-                OSAL_SEM_PostISR(&txSyncSem);
+                start = lastDoneAt;
             }
-            else if (transferRxHandle == handle)
+
+            spiStats.busyTicks += now - start;
+            lastDoneAt = now;
+            queueHead = (queueHead + 1) % WDRV_WINC_SPI_DEPTH;
+
+            if (DRV_SPI_TRANSFER_EVENT_ERROR == event)
             {
-                OSAL_SEM_PostISR(&rxSyncSem);
+                transferError = true;
+                spiStats.errors++;
             }
 
-            break;
-
-        case DRV_SPI_TRANSFER_EVENT_ERROR:
-            // Error handling here.
+            OSAL_SEM_PostISR(&doneSem);
             break;
 
         default:
@@ -167,6 +262,31 @@ bool WDRV_WINC_SPISend(unsigned char *const buf, uint32_t size)
 
     pData = buf;
 
+    // [rdp] The whole call: the bus itself is traced by drv_spi.
+    DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE_WINC, DRV_SPI_TRACE_DIR_WRITE, size);
+
+    // [rdp] A short send is copied and left to complete behind the caller.
+    if ((size > 0) && (size <= WDRV_WINC_SPI_POST_MAX))
+    {
+        // Reserve first: the slot's previous transfer is then done.
+        _SPI_Reserve();
+        pData = postBuf[postSlot];
+        postSlot = (postSlot + 1) % WDRV_WINC_SPI_DEPTH;
+        memcpy(pData, buf, size);
+
+        if (false == _SPI_Tx(pData, size))
+        {
+            ret = false;
+        }
+        else
+        {
+            spiStats.posted++;
+        }
+
+        DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE_WINC);
+        return ret;
+    }
+
 #ifdef DRV_SPI_DMA_MODE
     while ((true == ret) && (size > SPI_DMA_MAX_TX_SIZE))
     {
@@ -181,6 +301,13 @@ bool WDRV_WINC_SPISend(unsigned char *const buf, uint32_t size)
         ret = _SPI_Tx(pData, size);
     }
 
+    // [rdp] The caller may reuse buf as soon as this returns.
+    if (false == _SPI_Drain())
+    {
+        ret = false;
+    }
+
+    DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE_WINC);
     return ret;
 }
 
@@ -195,6 +322,8 @@ bool WDRV_WINC_SPIReceive(unsigned char *const buf, uint32_t size)
 
     pData = buf;
 
+    DRV_SPI_TraceBegin(DRV_SPI_TRACE_SOURCE_WINC, DRV_SPI_TRACE_DIR_READ, size);
+
 #ifdef DRV_SPI_DMA_MODE
     while ((true == ret) && (size > SPI_DMA_MAX_RX_SIZE))
     {
@@ -209,24 +338,62 @@ bool WDRV_WINC_SPIReceive(unsigned char *const buf, uint32_t size)
         ret = _SPI_Rx(pData, size);
     }
 
+    // [rdp] Also collects any posted sends queued ahead of this read.
+    if (false == _SPI_Drain())
+    {
+        ret = false;
+    }
+
+    DRV_SPI_TraceEnd(DRV_SPI_TRACE_SOURCE_WINC);
     return ret;
 }
 
+/****************************************************************************
+ * Function:        WDRV_WINC_SPIFlush
+ * Summary: [rdp] Waits for any posted sends to reach the module.
+ *****************************************************************************/
+bool WDRV_WINC_SPIFlush(void)
+{
+    return _SPI_Drain();
+}
+
+/****************************************************************************
+ * Function:        WDRV_WINC_SPIStatsGet
+ * Summary: [rdp] Returns the SPI bus counters.
+ *****************************************************************************/
+void WDRV_WINC_SPIStatsGet(WDRV_WINC_SPI_STATS *const pStats)
+{
+    if (NULL != pStats)
+    {
+        *pStats = spiStats;
+    }
+}
+
+/****************************************************************************
+ * Function:        WDRV_WINC_SPIStatsReset
+ * Summary: [rdp] Clears the SPI bus counters.
+ *****************************************************************************/
+void WDRV_WINC_SPIStatsReset(void)
+{
+    memset(&spiStats, 0, sizeof(spiStats));
+}
+
 /****************************************************************************
  * Function:        WDRV_WINC_SPIInitialize
  * Summary: Initializes the SPI object for the WiFi driver.
  *****************************************************************************/
 void WDRV_WINC_SPIInitialize(void)
 {
-    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&txSyncSem, OSAL_SEM_TYPE_COUNTING, 10, 0))
+    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&doneSem, OSAL_SEM_TYPE_COUNTING, 10, 0))
     {
         return;
     }
 
-    if (OSAL_RESULT_TRUE != OSAL_SEM_Create(&rxSyncSem, OSAL_SEM_TYPE_COUNTING, 10, 0))
-    {
-        return;
-    }
+    pending = 0;
+    transferError = false;
+    queueHead = 0;
+    queueTail = 0;
+    lastDoneAt = SYS_TIME_CounterGet();
 
     if (DRV_HANDLE_INVALID == spiHandle)
     {
@@ -247,11 +414,10 @@ void WDRV_WINC_SPIInitialize(void)
  *****************************************************************************/
 void WDRV_WINC_SPIDeinitialize(void)
 {
-    OSAL_SEM_Post(&txSyncSem);
-    OSAL_SEM_Delete(&txSyncSem);
+    _SPI_Drain();
 
-    OSAL_SEM_Post(&rxSyncSem);
-    OSAL_SEM_Delete(&rxSyncSem);
+    OSAL_SEM_Post(&doneSem);
+    OSAL_SEM_Delete(&doneSem);
 
     DRV_SPI_Close(spiHandle);
 
@@ -41,6 +41,7 @@
 #include "nmasic.h"
 #include "m2m_periph.h"
 #include "osal/osal.h"
+#include "definitions.h"
 
 #define NMI_AHB_DATA_MEM_BASE  0x30000
 #define NMI_AHB_SHARE_MEM_BASE 0xd0000
@@ -52,8 +53,30 @@
 #define WIFI_HOST_RCV_CTRL_4    (0x150400)
 #define WIFI_HOST_RCV_CTRL_5    (0x1088)
 
+// [rdp] A HIF message's header and control buffer are written to the WINC in
+// one block when together they fit in this many bytes.
+#define HIF_TX_COALESCE_SZ      128
+
+// [rdp] On receive, this many bytes from the start of the message (header
+// included) are read along with the header and kept for hif_receive().
+#define HIF_RX_PREFETCH_SZ      64
+
+// [rdp] hif_handle_isr() handles queued messages back to back, but yields
+// after this many, or once this many microseconds have passed, so that a burst
+// cannot starve the other tasks.  It is called again for the rest.
+#define HIF_ISR_MAX_EVENTS      8
+#define HIF_ISR_BUDGET_US       2000
+
 static OSAL_SEM_HANDLE_TYPE hifSemaphore;
 
+static uint8_t gau8HifTxStage[HIF_TX_COALESCE_SZ];
+static uint8_t gau8HifRxPrefetch[HIF_RX_PREFETCH_SZ];
+static uint16_t gu16HifRxPrefetchLen;
+static tstrHifStats gstrHifStats;
+static volatile uint8_t gu8HifIrqStamped;
+static volatile uint32_t gu32HifIrqAt;
+static uint8_t gu8HifRxPending;
+
 typedef struct {
     uint8_t u8ChipMode;
     uint8_t u8ChipSleep;
@@ -78,6 +101,8 @@ static int8_t hif_set_rx_done(void)
     int8_t ret = M2M_SUCCESS;
 
     gstrHifCxt.u8HifRXDone = 0;
+    /* [rdp] The WINC may now reuse the buffer. */
+    gu16HifRxPrefetchLen = 0;
     ret = nm_read_reg_with_ret(WIFI_HOST_RCV_CTRL_0,&reg);
     if(ret != M2M_SUCCESS)goto ERR1;
     /* Set RX Done */
@@ -268,11 +293,14 @@ int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16C
 {
     int8_t     ret = M2M_ERR_SEND;
     tstrHifHdr strHif;
+    uint32_t   u32Frames;
 
     while (OSAL_RESULT_FALSE == OSAL_SEM_Pend(&hifSemaphore, OSAL_WAIT_FOREVER))
     {
     }
 
+    u32Frames = nm_bus_frame_count();
+
     strHif.u8Opcode     = u8Opcode&(~NBIT7);
     strHif.u8Gid        = u8Gid;
     strHif.u16Length    = M2M_HIF_HDR_OFFSET;
@@ -292,16 +320,18 @@ int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16C
             volatile uint32_t reg, dma_addr = 0;
             volatile uint16_t cnt = 0;
 
-            reg = 0UL;
-            reg |= (uint32_t)u8Gid;
-            reg |= ((uint32_t)u8Opcode<<8);
-            reg |= ((uint32_t)strHif.u16Length<<16);
-            ret = nm_write_reg(NMI_STATE_REG,reg);
-            if(M2M_SUCCESS != ret) goto ERR1;
-
-            reg = 0UL;
-            reg |= NBIT1;
-            ret = nm_write_reg(WIFI_HOST_RCV_CTRL_2, reg);
+            tstrNmRegOp astrOps[2];
+
+            /* [rdp] Post the message details and request a buffer. */
+            astrOps[0].u32Addr = NMI_STATE_REG;
+            astrOps[0].u32Val = (uint32_t)u8Gid |
+                                ((uint32_t)u8Opcode<<8) |
+                                ((uint32_t)strHif.u16Length<<16);
+            astrOps[0].pu32RetVal = NULL;
+            astrOps[1].u32Addr = WIFI_HOST_RCV_CTRL_2;
+            astrOps[1].u32Val = NBIT1;
+            astrOps[1].pu32RetVal = NULL;
+            ret = nm_reg_batch(astrOps, 2);
             if(M2M_SUCCESS != ret) goto ERR1;
 
             dma_addr = 0;
@@ -338,9 +368,24 @@ int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16C
                 volatile uint32_t u32CurrAddr;
                 u32CurrAddr = dma_addr;
                 strHif.u16Length=NM_BSP_B_L_16(strHif.u16Length);
-                ret = nm_write_block(u32CurrAddr, (uint8_t*)&strHif, M2M_HIF_HDR_OFFSET);
-                if(M2M_SUCCESS != ret) goto ERR1;
-                u32CurrAddr += M2M_HIF_HDR_OFFSET;
+                if((pu8CtrlBuf != NULL) &&
+                   (M2M_HIF_HDR_OFFSET + u16CtrlBufSize <= HIF_TX_COALESCE_SZ))
+                {
+                    /* [rdp] Header and control buffer in one block write. */
+                    memset(gau8HifTxStage, 0, M2M_HIF_HDR_OFFSET);
+                    memcpy(gau8HifTxStage, &strHif, sizeof(tstrHifHdr));
+                    memcpy(&gau8HifTxStage[M2M_HIF_HDR_OFFSET], pu8CtrlBuf, u16CtrlBufSize);
+                    ret = nm_write_block(u32CurrAddr, gau8HifTxStage, M2M_HIF_HDR_OFFSET + u16CtrlBufSize);
+                    if(M2M_SUCCESS != ret) goto ERR1;
+                    u32CurrAddr += M2M_HIF_HDR_OFFSET + u16CtrlBufSize;
+                    pu8CtrlBuf = NULL;
+                }
+                else
+                {
+                    ret = nm_write_block(u32CurrAddr, (uint8_t*)&strHif, M2M_HIF_HDR_OFFSET);
+                    if(M2M_SUCCESS != ret) goto ERR1;
+                    u32CurrAddr += M2M_HIF_HDR_OFFSET;
+                }
                 if(pu8CtrlBuf != NULL)
                 {
                     ret = nm_write_block(u32CurrAddr, pu8CtrlBuf, u16CtrlBufSize);
@@ -383,6 +428,8 @@ int8_t hif_send(uint8_t u8Gid,uint8_t u8Opcode,uint8_t *pu8CtrlBuf,uint16_t u16C
     }
     /*actual sleep ret = M2M_SUCCESS*/
     ret = hif_chip_sleep();
+    gstrHifStats.u32TxMsgs++;
+    gstrHifStats.u32TxFrames += nm_bus_frame_count() - u32Frames;
     OSAL_SEM_Post(&hifSemaphore);
     return ret;
 ERR1:
@@ -398,10 +445,12 @@ ERR2:
 *   @brief  Host interface interrupt service routine
 *   @author M. Abdelmawla
 *   @date   15 July 2012
-*   @return 1 in case of interrupt received else 0 will be returned
+*   @param [out] pu8Handled
+*               [rdp] Set to 1 if a message was handled, 0 if none was queued
+*   @return ZERO in case of success and a negative value otherwise
 *   @version    1.0
 */
-static int8_t hif_isr(void)
+static int8_t hif_isr(uint8_t *pu8Handled)
 {
     int8_t ret = M2M_SUCCESS;
     uint32_t reg;
@@ -411,6 +460,8 @@ static int8_t hif_isr(void)
     {
     }
 
+    *pu8Handled = 0;
+    gu16HifRxPrefetchLen = 0;
     ret = nm_read_reg_with_ret(WIFI_HOST_RCV_CTRL_0, &reg);
     if(M2M_SUCCESS == ret)
     {
@@ -418,32 +469,47 @@ static int8_t hif_isr(void)
         {
             uint16_t size;
 
+            uint32_t address = 0;
+            tstrNmRegOp astrOps[2];
+
             /*Clearing RX interrupt*/
             reg &= ~NBIT0;
-            ret = nm_write_reg(WIFI_HOST_RCV_CTRL_0,reg);
-            if(ret != M2M_SUCCESS)goto ERR1;
+            *pu8Handled = 1;
             gstrHifCxt.u8HifRXDone = 1;
+            gstrHifStats.u32RxMsgs++;
             size = (uint16_t)((reg >> 2) & 0xfff);
+            /* [rdp] Clear the interrupt and fetch the buffer address together. */
+            astrOps[0].u32Addr = WIFI_HOST_RCV_CTRL_0;
+            astrOps[0].u32Val = reg;
+            astrOps[0].pu32RetVal = NULL;
+            astrOps[1].u32Addr = WIFI_HOST_RCV_CTRL_1;
+            astrOps[1].u32Val = 0;
+            astrOps[1].pu32RetVal = &address;
+            ret = nm_reg_batch(astrOps, (size > 0) ? 2 : 1);
+            if(ret != M2M_SUCCESS)goto ERR1;
             if (size > 0) {
-                uint32_t address = 0;
+                uint16_t u16Prefetch;
                 /**
                 start bus transfer
                 **/
-                ret = nm_read_reg_with_ret(WIFI_HOST_RCV_CTRL_1, &address);
-                if(M2M_SUCCESS != ret)
-                {
-                    M2M_ERR("(hif) WIFI_HOST_RCV_CTRL_1 bus fail\r\n");
-                    goto ERR1;
-                }
                 gstrHifCxt.u32RxAddr = address;
                 gstrHifCxt.u32RxSize = size;
-                ret = nm_read_block(address, (uint8_t*)&strHif, sizeof(tstrHifHdr));
-                strHif.u16Length = NM_BSP_B_L_16(strHif.u16Length);
+                /* [rdp] Read the start of the message along with its header. */
+                u16Prefetch = size;
+                if (u16Prefetch > HIF_RX_PREFETCH_SZ)
+                    u16Prefetch = HIF_RX_PREFETCH_SZ;
+                if (u16Prefetch < sizeof(tstrHifHdr))
+                    u16Prefetch = sizeof(tstrHifHdr);
+                gu16HifRxPrefetchLen = 0;
+                ret = nm_read_block(address, gau8HifRxPrefetch, u16Prefetch);
                 if(M2M_SUCCESS != ret)
                 {
                     M2M_ERR("(hif) address bus fail\r\n");
                     goto ERR1;
                 }
+                gu16HifRxPrefetchLen = u16Prefetch;
+                memcpy(&strHif, gau8HifRxPrefetch, sizeof(tstrHifHdr));
+                strHif.u16Length = NM_BSP_B_L_16(strHif.u16Length);
                 if(strHif.u16Length != size)
                 {
                     if((size - strHif.u16Length) > 4)
@@ -523,7 +589,9 @@ static int8_t hif_isr(void)
         }
         else
         {
-            M2M_ERR("(hif) False interrupt %lx\r\n",reg);
+            /* [rdp] The queue is empty: expected once a burst has been drained,
+             * as the interrupt line may have latched an edge meanwhile. */
+            M2M_DBG("(hif) No message queued %lx\r\n",reg);
             goto ERR1;
         }
     }
@@ -547,15 +615,96 @@ ERR1:
 int8_t hif_handle_isr(void)
 {
     int8_t ret = M2M_SUCCESS;
+    uint32_t u32Frames = nm_bus_frame_count();
+    uint32_t u32TxFrames = gstrHifStats.u32TxFrames;
+    uint32_t u32Start = SYS_TIME_CounterGet();
+    uint32_t u32Budget = (uint32_t)(((uint64_t)SYS_TIME_FrequencyGet() * HIF_ISR_BUDGET_US) / 1000000);
+    uint8_t u8Events = 0;
+    uint8_t u8Handled;
+
+    /* [rdp] Latency from the interrupt to the start of its handling. */
+    if (gu8HifIrqStamped)
+    {
+        uint32_t u32Latency = u32Start - gu32HifIrqAt;
+
+        gu8HifIrqStamped = 0;
+        gstrHifStats.u32Irqs++;
+        gstrHifStats.u32LatencyTicks += u32Latency;
+        if (u32Latency > gstrHifStats.u32MaxLatencyTicks)
+            gstrHifStats.u32MaxLatencyTicks = u32Latency;
+    }
 
-    ret = hif_isr();
-    if (M2M_SUCCESS != ret)
+    /* [rdp] Drain the queue: each message is followed by another read of the
+     * control register, which finds the next one without a new interrupt. */
+    gu8HifRxPending = 0;
+    gstrHifStats.u32Passes++;
+    for (;;)
     {
-        M2M_ERR("(hif) Fail to handle interrupt %d try again..\r\n",ret);
+        ret = hif_isr(&u8Handled);
+        if (M2M_SUCCESS != ret)
+        {
+            M2M_ERR("(hif) Fail to handle interrupt %d try again..\r\n",ret);
+            break;
+        }
+        if (!u8Handled)
+            break;
+        u8Events++;
+        if ((u8Events >= HIF_ISR_MAX_EVENTS) ||
+            ((SYS_TIME_CounterGet() - u32Start) >= u32Budget))
+        {
+            /* More may be queued: the caller comes back after a yield. */
+            gu8HifRxPending = 1;
+            gstrHifStats.u32Yields++;
+            break;
+        }
     }
+    if (u8Events == 0)
+        gstrHifStats.u32EmptyPasses++;
+    if (u8Events > gstrHifStats.u8MaxPassEvents)
+        gstrHifStats.u8MaxPassEvents = u8Events;
+
+    /* [rdp] Frames spent receiving, less any sends made by the callbacks. */
+    gstrHifStats.u32RxFrames += (nm_bus_frame_count() - u32Frames) -
+                                (gstrHifStats.u32TxFrames - u32TxFrames);
 
     return ret;
 }
+
+/*
+*   @fn     hif_irq_stamp
+*   @brief  [rdp] Note the time of the first interrupt not yet handled.
+*           Called from interrupt context.
+*/
+void hif_irq_stamp(void)
+{
+    if (!gu8HifIrqStamped)
+    {
+        gu32HifIrqAt = SYS_TIME_CounterGet();
+        gu8HifIrqStamped = 1;
+    }
+}
+
+/*
+*   @fn     hif_rx_pending
+*   @brief  [rdp] Return 1 if the last hif_handle_isr() yielded before the
+*           queue was empty.
+*/
+uint8_t hif_rx_pending(void)
+{
+    return gu8HifRxPending;
+}
+
+/*
+*   @fn     hif_get_stats
+*   @brief  [rdp] Copy out the HIF message and SPI frame counts.
+*/
+void hif_get_stats(tstrHifStats *pstrStats)
+{
+    if (pstrStats != NULL)
+    {
+        *pstrStats = gstrHifStats;
+    }
+}
 /*
 *   @fn     hif_receive
 *   @brief  Host interface interrupt service routine
@@ -601,8 +750,17 @@ int8_t hif_receive(uint32_t u32Addr, uint8_t *pu8Buf, uint16_t u16Sz, uint8_t is
     }
 
     /* Receive the payload */
-    ret = nm_read_block(u32Addr, pu8Buf, u16Sz);
-    if(ret != M2M_SUCCESS)goto ERR1;
+    if((u32Addr + u16Sz) <= (gstrHifCxt.u32RxAddr + gu16HifRxPrefetchLen))
+    {
+        /* [rdp] Already read along with the header. */
+        memcpy(pu8Buf, &gau8HifRxPrefetch[u32Addr - gstrHifCxt.u32RxAddr], u16Sz);
+        gstrHifStats.u32RxPrefetchHits++;
+    }
+    else
+    {
+        ret = nm_read_block(u32Addr, pu8Buf, u16Sz);
+        if(ret != M2M_SUCCESS)goto ERR1;
+    }
 
     /* check if this is the last packet */
     if((((gstrHifCxt.u32RxAddr + gstrHifCxt.u32RxSize) - (u32Addr + u16Sz)) <= 0) || isDone)
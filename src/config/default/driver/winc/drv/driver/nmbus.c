@@ -269,4 +269,27 @@ int8_t nm_write_block(uint32_t u32Addr, uint8_t *puBuf, uint32_t u32Sz)
     return s8Ret;
 }
 
+/*
+*   @fn     nm_reg_batch
+*   @brief  [rdp] Perform a sequence of register reads and writes back to back
+*   @param [in, out] pstrOps
+*               Accesses to perform, in order
+*   @param [in] u8Count
+*               Number of entries in pstrOps
+*   @return M2M_SUCCESS in case of success and M2M_ERR_BUS_FAIL in case of failure
+*/
+int8_t nm_reg_batch(tstrNmRegOp *pstrOps, uint8_t u8Count)
+{
+    return nm_spi_reg_batch(pstrOps, u8Count);
+}
+
+/*
+*   @fn     nm_bus_frame_count
+*   @brief  [rdp] Return the number of command frames sent on the bus
+*/
+uint32_t nm_bus_frame_count(void)
+{
+    return nm_spi_frame_count();
+}
+
 //DOM-IGNORE-END
@@ -43,6 +43,10 @@
 
 #include "nmspi.h"
 
+// [rdp] Set by nm_drv_set_resume() when the WINC was left running in power
+// save while the host hibernated: the next init wakes it instead of resetting.
+static uint8_t gu8Resume = 0;
+
 /**
 *   @fn     nm_get_firmware_info(tstrM2mRev* M2mRev)
 *   @brief  Get Firmware version info
@@ -258,12 +262,40 @@ ERR1:
     return ret;
 }
 
+void nm_drv_set_resume(uint8_t u8Resume)
+{
+    gu8Resume = u8Resume;
+}
+
+uint8_t nm_drv_resumed(void)
+{
+    return gu8Resume;
+}
+
 int8_t nm_drv_init_hold(void)
 {
     int8_t ret = M2M_SUCCESS;
 
     nm_spi_lock_init();
 
+    if (gu8Resume) {
+        // [rdp] The firmware is still running, with SPI CRC turned off by the
+        // previous nm_spi_init().  The first nm_spi_init() falls back to CRC
+        // off (the chip id may not read while the chip dozes), chip_wake()
+        // then holds it awake and the second nm_spi_init() checks the chip id.
+        nm_spi_init();
+        ret = chip_wake();
+        if (M2M_SUCCESS == ret) {
+            ret = nm_spi_init();
+        }
+        if (M2M_SUCCESS == ret) {
+            M2M_INFO("Resumed chip ID %lx\r\n", nmi_get_chipid());
+            return ret;
+        }
+        M2M_ERR("[nmi start]: fail resume, resetting\r\n");
+        gu8Resume = 0;
+    }
+
     ret = nm_bus_iface_init(NULL);
     if (M2M_SUCCESS != ret) {
         M2M_ERR("[nmi start]: fail init bus\r\n");
@@ -314,14 +346,17 @@ int8_t nm_drv_init_start(void * arg)
         }
     }
 
-    ret = wait_for_bootrom(u8Mode);
-    if (M2M_SUCCESS != ret) {
-        goto ERR2;
-    }
+    // [rdp] A resumed chip has long since booted: do not restart it.
+    if (!gu8Resume) {
+        ret = wait_for_bootrom(u8Mode);
+        if (M2M_SUCCESS != ret) {
+            goto ERR2;
+        }
 
-    ret = wait_for_firmware_start(u8Mode);
-    if (M2M_SUCCESS != ret) {
-        goto ERR2;
+        ret = wait_for_firmware_start(u8Mode);
+        if (M2M_SUCCESS != ret) {
+            goto ERR2;
+        }
     }
 
     if((M2M_WIFI_MODE_ATE_HIGH == u8Mode)||(M2M_WIFI_MODE_ATE_LOW == u8Mode)) {
@@ -39,6 +39,7 @@
 #include "nm_common.h"
 
 #include "nmspi.h"
+#include "nmcrc.h"
 #include "nmasic.h"
 #include "wdrv_winc_common.h"
 #include "wdrv_winc_spi.h"
@@ -92,8 +93,24 @@
 
 static uint8_t gu8Crc_off = 0;
 
+// [rdp] Set by nm_spi_set_crc(): keep CRC7 and CRC16 on after nm_spi_init().
+static uint8_t gu8Crc_wanted = 0;
+
 static OSAL_MUTEX_HANDLE_TYPE s_spiLock;
 
+// [rdp] The shortest reply the WINC can give to a command is read in one
+// transfer: command echo, state, and for reads the data header, data and CRC.
+// Any bytes the WINC delays past that are then read as before, one at a time.
+// spi_rx() hands out the prefetched bytes first.
+#define SPI_RX_WIN_SZ           (2 + 1 + 4 + 2)
+
+static uint8_t gau8RxWin[SPI_RX_WIN_SZ];
+static uint8_t gu8RxWinLen;
+static uint8_t gu8RxWinPos;
+
+// [rdp] # of command frames sent to the WINC.
+static uint32_t gu32SpiFrames;
+
 static inline int8_t spi_read(uint8_t *b, uint16_t sz)
 {
     if (true == WDRV_WINC_SPIReceive((unsigned char *const) b, sz))
@@ -110,57 +127,31 @@ static inline int8_t spi_write(uint8_t *b, uint16_t sz)
     return N_FAIL;
 }
 
-/********************************************
+static int8_t spi_prefetch(uint8_t sz)
+{
+    gu8RxWinPos = 0;
+    gu8RxWinLen = 0;
 
-    Crc7
+    if (N_OK != spi_read(gau8RxWin, sz))
+        return N_FAIL;
 
-********************************************/
+    gu8RxWinLen = sz;
 
-static const uint8_t crc7_syndrome_table[256] = {
-    0x00, 0x09, 0x12, 0x1b, 0x24, 0x2d, 0x36, 0x3f,
-    0x48, 0x41, 0x5a, 0x53, 0x6c, 0x65, 0x7e, 0x77,
-    0x19, 0x10, 0x0b, 0x02, 0x3d, 0x34, 0x2f, 0x26,
-    0x51, 0x58, 0x43, 0x4a, 0x75, 0x7c, 0x67, 0x6e,
-    0x32, 0x3b, 0x20, 0x29, 0x16, 0x1f, 0x04, 0x0d,
-    0x7a, 0x73, 0x68, 0x61, 0x5e, 0x57, 0x4c, 0x45,
-    0x2b, 0x22, 0x39, 0x30, 0x0f, 0x06, 0x1d, 0x14,
-    0x63, 0x6a, 0x71, 0x78, 0x47, 0x4e, 0x55, 0x5c,
-    0x64, 0x6d, 0x76, 0x7f, 0x40, 0x49, 0x52, 0x5b,
-    0x2c, 0x25, 0x3e, 0x37, 0x08, 0x01, 0x1a, 0x13,
-    0x7d, 0x74, 0x6f, 0x66, 0x59, 0x50, 0x4b, 0x42,
-    0x35, 0x3c, 0x27, 0x2e, 0x11, 0x18, 0x03, 0x0a,
-    0x56, 0x5f, 0x44, 0x4d, 0x72, 0x7b, 0x60, 0x69,
-    0x1e, 0x17, 0x0c, 0x05, 0x3a, 0x33, 0x28, 0x21,
-    0x4f, 0x46, 0x5d, 0x54, 0x6b, 0x62, 0x79, 0x70,
-    0x07, 0x0e, 0x15, 0x1c, 0x23, 0x2a, 0x31, 0x38,
-    0x41, 0x48, 0x53, 0x5a, 0x65, 0x6c, 0x77, 0x7e,
-    0x09, 0x00, 0x1b, 0x12, 0x2d, 0x24, 0x3f, 0x36,
-    0x58, 0x51, 0x4a, 0x43, 0x7c, 0x75, 0x6e, 0x67,
-    0x10, 0x19, 0x02, 0x0b, 0x34, 0x3d, 0x26, 0x2f,
-    0x73, 0x7a, 0x61, 0x68, 0x57, 0x5e, 0x45, 0x4c,
-    0x3b, 0x32, 0x29, 0x20, 0x1f, 0x16, 0x0d, 0x04,
-    0x6a, 0x63, 0x78, 0x71, 0x4e, 0x47, 0x5c, 0x55,
-    0x22, 0x2b, 0x30, 0x39, 0x06, 0x0f, 0x14, 0x1d,
-    0x25, 0x2c, 0x37, 0x3e, 0x01, 0x08, 0x13, 0x1a,
-    0x6d, 0x64, 0x7f, 0x76, 0x49, 0x40, 0x5b, 0x52,
-    0x3c, 0x35, 0x2e, 0x27, 0x18, 0x11, 0x0a, 0x03,
-    0x74, 0x7d, 0x66, 0x6f, 0x50, 0x59, 0x42, 0x4b,
-    0x17, 0x1e, 0x05, 0x0c, 0x33, 0x3a, 0x21, 0x28,
-    0x5f, 0x56, 0x4d, 0x44, 0x7b, 0x72, 0x69, 0x60,
-    0x0e, 0x07, 0x1c, 0x15, 0x2a, 0x23, 0x38, 0x31,
-    0x46, 0x4f, 0x54, 0x5d, 0x62, 0x6b, 0x70, 0x79
-};
-
-static uint8_t crc7_byte(uint8_t crc, uint8_t data)
-{
-    return crc7_syndrome_table[(crc << 1) ^ data];
+    return N_OK;
 }
 
-static uint8_t crc7(uint8_t crc, const uint8_t *buffer, uint32_t len)
+static int8_t spi_rx(uint8_t *b, uint16_t sz)
 {
-    while (len--)
-        crc = crc7_byte(crc, *buffer++);
-    return crc;
+    while ((sz > 0) && (gu8RxWinPos < gu8RxWinLen))
+    {
+        *b++ = gau8RxWin[gu8RxWinPos++];
+        sz--;
+    }
+
+    if (sz == 0)
+        return N_OK;
+
+    return spi_read(b, sz);
 }
 
 /********************************************
@@ -262,9 +253,14 @@ static int8_t spi_cmd(uint8_t cmd, uint32_t adr, uint32_t u32data, uint32_t sz,
             return N_FAIL;
     }
 
+    /* [rdp] A new command: nothing prefetched belongs to it. */
+    gu8RxWinLen = 0;
+    gu8RxWinPos = 0;
+    gu32SpiFrames++;
+
     if (!gu8Crc_off)
     {
-        bc[len-1] = (crc7(0x7f, (const uint8_t *)&bc[0], len-1)) << 1;
+        bc[len-1] = (nm_crc7(0x7f, (const uint8_t *)&bc[0], len-1)) << 1;
     }
     else
     {
@@ -297,7 +293,7 @@ static int8_t spi_cmd_rsp(uint8_t cmd)
 #endif
         )
     {
-        if (N_OK != spi_read(&rsp, 1))
+        if (N_OK != spi_rx(&rsp, 1))
             return N_FAIL;
     }
 
@@ -305,7 +301,7 @@ static int8_t spi_cmd_rsp(uint8_t cmd)
     s8RetryCnt = SPI_RESP_RETRY_COUNT;
     do
     {
-        if (N_OK != spi_read(&rsp, 1))
+        if (N_OK != spi_rx(&rsp, 1))
         {
             M2M_ERR("[spi_cmd_rsp]: Failed cmd response read, bus error...\r\n");
             return N_FAIL;
@@ -325,7 +321,7 @@ static int8_t spi_cmd_rsp(uint8_t cmd)
     s8RetryCnt = SPI_RESP_RETRY_COUNT;
     do
     {
-        if (N_OK != spi_read(&rsp, 1))
+        if (N_OK != spi_rx(&rsp, 1))
         {
             M2M_ERR("[spi_cmd_rsp]: Failed cmd response read, bus error...\r\n");
             return N_FAIL;
@@ -379,7 +375,7 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
         retry = SPI_RESP_RETRY_COUNT;
         do
         {
-            if (N_OK != spi_read(&rsp, 1))
+            if (N_OK != spi_rx(&rsp, 1))
             {
                 M2M_ERR("[spi_data_read]: Failed data response read, bus error...\r\n");
                 result = N_FAIL;
@@ -403,7 +399,7 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
         /**
             Read bytes
         **/
-        if (N_OK != spi_read(&b[ix], nbytes))
+        if (N_OK != spi_rx(&b[ix], nbytes))
         {
             M2M_ERR("[spi_data_read]: Failed data block read, bus error...\r\n");
             result = N_FAIL;
@@ -416,12 +412,25 @@ static int8_t spi_data_read(uint8_t *b, uint16_t sz,uint8_t clockless)
             **/
             if (!gu8Crc_off)
             {
-                if (N_OK != spi_read(crc, 2))
+                uint16_t u16Crc;
+
+                if (N_OK != spi_rx(crc, 2))
                 {
                     M2M_ERR("[spi_data_read]: Failed data block CRC read, bus error...\r\n");
                     result = N_FAIL;
                     break;
                 }
+
+                /* [rdp] Check it rather than discard it. */
+                u16Crc = nm_crc16(0xffff, &b[ix], nbytes);
+                if ((crc[0] != (uint8_t)(u16Crc >> 8)) || (crc[1] != (uint8_t)u16Crc))
+                {
+                    nm_crc_record(0);
+                    M2M_ERR("[spi_data_read]: Data block CRC mismatch\r\n");
+                    result = N_FAIL;
+                    break;
+                }
+                nm_crc_record(1);
             }
         }
         ix += nbytes;
@@ -492,6 +501,11 @@ static int8_t spi_data_write(uint8_t *b, uint16_t sz)
         **/
         if (!gu8Crc_off)
         {
+            /* [rdp] A real CRC16, for a WINC that checks it. */
+            uint16_t u16Crc = nm_crc16(0xffff, &b[ix], nbytes);
+
+            crc[0] = (uint8_t)(u16Crc >> 8);
+            crc[1] = (uint8_t)u16Crc;
             if (N_OK != spi_write(crc, 2))
             {
                 M2M_ERR("[spi_data_write]: Failed data block CRC write, bus error...\r\n");
@@ -539,6 +553,12 @@ static int8_t spi_write_reg(uint32_t u32Addr, uint32_t u32Val)
         return N_OK;
     }
 
+    if (spi_prefetch(2) != N_OK)
+    {
+        M2M_ERR("[spi_write_reg]: Failed bus error...\r\n");
+        return N_FAIL;
+    }
+
     if (spi_cmd_rsp(cmd) != N_OK)
     {
         M2M_ERR("[spi_write_reg]: Failed cmd response, write reg (%08" PRIx32 ")...\r\n", u32Addr);
@@ -562,6 +582,12 @@ static int8_t spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
         return N_FAIL;
     }
 
+    if (spi_prefetch(2) != N_OK)
+    {
+        M2M_ERR("[spi_write_block]: Failed bus error...\r\n");
+        return N_FAIL;
+    }
+
     if (spi_cmd_rsp(CMD_DMA_EXT_WRITE) != N_OK)
     {
         M2M_ERR("[spi_write_block]: Failed cmd response, write block (%08" PRIx32 ")...\r\n", u32Addr);
@@ -592,6 +618,9 @@ static int8_t spi_write_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
 
     if((rsp[len-1] != 0) || (rsp[len-2] != 0xC3))
     {
+        /* [rdp] With CRC on, a rejected block counts as a failed check. */
+        if (!gu8Crc_off)
+            nm_crc_record(0);
         M2M_ERR("[spi_write_block]: Failed data response read, %x %x %x\r\n", rsp[0], rsp[1], rsp[2]);
         return N_FAIL;
     }
@@ -620,6 +649,13 @@ static int8_t spi_read_reg(uint32_t u32Addr, uint32_t* pu32RetVal)
         return N_FAIL;
     }
 
+    /* Echo, state, data header, data and, unless off, CRC. */
+    if (spi_prefetch(((clockless || gu8Crc_off) ? 7 : 9)) != N_OK)
+    {
+        M2M_ERR("[spi_read_reg]: Failed bus error...\r\n");
+        return N_FAIL;
+    }
+
     if (spi_cmd_rsp(cmd) != N_OK)
     {
         M2M_ERR("[spi_read_reg]: Failed cmd response, read reg (%08" PRIx32 ")...\r\n", u32Addr);
@@ -652,6 +688,12 @@ static int8_t spi_read_block(uint32_t u32Addr, uint8_t *puBuf, uint16_t u16Sz)
         return N_FAIL;
     }
 
+    if (spi_prefetch(3) != N_OK)
+    {
+        M2M_ERR("[spi_read_block]: Failed bus error...\r\n");
+        return N_FAIL;
+    }
+
     if (spi_cmd_rsp(CMD_DMA_EXT_READ) != N_OK)
     {
         M2M_ERR("[spi_read_block]: Failed cmd response, read block (%08" PRIx32 ")...\r\n", u32Addr);
@@ -730,6 +772,7 @@ int8_t nm_spi_init(void)
         configure protocol
     **/
     gu8Crc_off = 0;
+    nm_crc_init();
 
     if (nm_spi_read_reg_with_ret(NMI_SPI_PROTOCOL_CONFIG, &reg) != M2M_SUCCESS)
     {
@@ -746,9 +789,13 @@ int8_t nm_spi_init(void)
             return M2M_ERR_BUS_FAIL;
         }
     }
-    if(gu8Crc_off == 0)
+    if ((gu8Crc_off == 0) || gu8Crc_wanted)
     {
-        reg &= ~0xc;    /* disable CRC checking */
+        /* [rdp] Leave CRC checking on if asked to, else disable it. */
+        if (gu8Crc_wanted)
+            reg |= 0xc;
+        else
+            reg &= ~0xc;
         reg &= ~0x70;
         reg |= (0x5 << 4);
 
@@ -759,7 +806,7 @@ int8_t nm_spi_init(void)
             return M2M_ERR_BUS_FAIL;
         }
 
-        gu8Crc_off = 1;
+        gu8Crc_off = gu8Crc_wanted ? 0 : 1;
     }
 
     /**
@@ -777,6 +824,40 @@ int8_t nm_spi_init(void)
     return M2M_SUCCESS;
 }
 
+/*
+*   @fn     nm_spi_set_crc
+*   @brief  [rdp] Turn CRC7 and CRC16 checking on or off.  The choice also
+*           holds across later calls to nm_spi_init().
+*   @param [in] u8Enable
+*               Non-zero to check CRCs
+*   @return M2M_SUCCESS in case of success and M2M_ERR_BUS_FAIL in case of failure
+*/
+int8_t nm_spi_set_crc(uint8_t u8Enable)
+{
+    uint32_t reg;
+
+    gu8Crc_wanted = u8Enable ? 1 : 0;
+
+    if (gu8Crc_off == (gu8Crc_wanted ? 0 : 1))
+        return M2M_SUCCESS;
+
+    if (nm_spi_read_reg_with_ret(NMI_SPI_PROTOCOL_CONFIG, &reg) != M2M_SUCCESS)
+        return M2M_ERR_BUS_FAIL;
+
+    if (gu8Crc_wanted)
+        reg |= 0xc;
+    else
+        reg &= ~0xc;
+
+    /* The write itself goes out in the old mode. */
+    if (nm_spi_write_reg(NMI_SPI_PROTOCOL_CONFIG, reg) != M2M_SUCCESS)
+        return M2M_ERR_BUS_FAIL;
+
+    gu8Crc_off = gu8Crc_wanted ? 0 : 1;
+
+    return M2M_SUCCESS;
+}
+
 /*
 *   @fn     nm_spi_deinit
 *   @brief  DeInitialize the SPI
@@ -885,6 +966,58 @@ int8_t nm_spi_write_reg(uint32_t u32Addr, uint32_t u32Val)
     return M2M_ERR_BUS_FAIL;
 }
 
+/*
+*   @fn     nm_spi_reg_batch
+*   @brief  [rdp] Perform a sequence of register reads and writes under one
+*           bus lock.  A failed access resets the SPI and the sequence resumes
+*           from it, sharing one retry budget.
+*   @param [in, out] pstrOps
+*               Accesses to perform, in order
+*   @param [in] u8Count
+*               Number of entries in pstrOps
+*   @return M2M_SUCCESS in case of success and M2M_ERR_BUS_FAIL in case of failure
+*/
+int8_t nm_spi_reg_batch(tstrNmRegOp *pstrOps, uint8_t u8Count)
+{
+    uint8_t retry = SPI_RETRY_COUNT;
+    uint8_t i = 0;
+    int8_t s8Ret;
+
+    if (OSAL_RESULT_TRUE != OSAL_MUTEX_Lock(&s_spiLock, OSAL_WAIT_FOREVER))
+        return M2M_ERR_BUS_FAIL;
+
+    while ((i < u8Count) && (retry > 0))
+    {
+        if (pstrOps[i].pu32RetVal != NULL)
+            s8Ret = spi_read_reg(pstrOps[i].u32Addr, pstrOps[i].pu32RetVal);
+        else
+            s8Ret = spi_write_reg(pstrOps[i].u32Addr, pstrOps[i].u32Val);
+
+        if (s8Ret == N_OK)
+        {
+            i++;
+            continue;
+        }
+
+        retry--;
+        M2M_ERR("Reset and retry %d %" PRIx32 "\r\n", retry, pstrOps[i].u32Addr);
+        spi_reset();
+    }
+
+    OSAL_MUTEX_Unlock(&s_spiLock);
+
+    return (i == u8Count) ? M2M_SUCCESS : M2M_ERR_BUS_FAIL;
+}
+
+/*
+*   @fn     nm_spi_frame_count
+*   @brief  [rdp] Return the number of command frames sent to the WINC
+*/
+uint32_t nm_spi_frame_count(void)
+{
+    return gu32SpiFrames;
+}
+
 /*
 *   @fn     nm_spi_read_block
 *   @brief  Read block of data
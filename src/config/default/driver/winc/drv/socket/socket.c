@@ -42,6 +42,7 @@ INCLUDES
 #include "m2m_hif.h"
 #include "m2m_types.h"
 #include "m2m_socket_host_if.h"
+#include "definitions.h"
 
 /*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*
 MACROS
@@ -104,6 +105,22 @@ typedef struct {
     uint8_t             u8ErrCode;
 } tstrSocket;
 
+/*!
+*  @brief  [rdp] Receive ring attached to a TCP socket by recv_ring_attach().
+*          Unread data occupies u16Count bytes from u16Head, wrapping at
+*          u16Size.  recv() is posted into the free space after it.
+*/
+typedef struct {
+    uint8_t             *pu8Buf;
+    uint16_t            u16Size;
+    uint16_t            u16Head;
+    uint16_t            u16Count;
+    uint8_t             bStalled;
+    uint32_t            u32Timeoutmsec;
+    uint32_t            u32StallStart;
+    tstrSocketRingStats strStats;
+} tstrSocketRing;
+
 /*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*
 GLOBALS
 *=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*=*/
@@ -118,9 +135,73 @@ volatile tpfAppSocketCb         gpfAppSocketCb;
 volatile tpfAppResolveCb        gpfAppResolveCb;
 volatile uint8_t                gbSocketInit = 0;
 
+static tstrSocketRing           gastrSocketRings[MAX_SOCKET];
+
 static tpfPingCb                gfpPingCb = NULL;
 static uint32_t                 gu32PingId = 0;
 
+/*
+*   @fn         Socket_RingAttached
+*   @brief      [rdp] Return true if data of this message type is received
+*               into the socket's ring.
+*/
+static uint8_t Socket_RingAttached(SOCKET sock, uint8_t u8SocketMsg)
+{
+    return (u8SocketMsg == SOCKET_MSG_RECV) && (gastrSocketRings[sock].pu8Buf != NULL);
+}
+
+/*
+*   @fn         Socket_RingPost
+*   @brief      [rdp] Post a recv() into the contiguous free space after the
+*               unread data in the socket's ring.  If there is none, mark the
+*               ring stalled; recv_ring_consume() posts again once space is
+*               freed.
+*/
+static void Socket_RingPost(SOCKET sock)
+{
+    tstrSocketRing  *pstrRing = &gastrSocketRings[sock];
+    uint32_t        u32Tail;
+    uint16_t        u16Free;
+
+    if((pstrRing->pu8Buf == NULL) || gastrSockets[sock].bIsRecvPending)
+        return;
+
+    if(pstrRing->u16Count == 0)
+    {
+        /* Empty: start again at the beginning for the largest recv(). */
+        pstrRing->u16Head = 0;
+    }
+    u32Tail = (uint32_t)pstrRing->u16Head + pstrRing->u16Count;
+    if(u32Tail >= pstrRing->u16Size)
+    {
+        u32Tail -= pstrRing->u16Size;
+        u16Free = pstrRing->u16Head - (uint16_t)u32Tail;
+    }
+    else
+    {
+        u16Free = pstrRing->u16Size - (uint16_t)u32Tail;
+    }
+
+    if(u16Free == 0)
+    {
+        if(!pstrRing->bStalled)
+        {
+            pstrRing->bStalled = 1;
+            pstrRing->u32StallStart = SYS_TIME_CounterGet();
+            pstrRing->strStats.u32Stalls++;
+        }
+        return;
+    }
+    if(pstrRing->bStalled)
+    {
+        pstrRing->bStalled = 0;
+        pstrRing->strStats.u32StallMs +=
+            SYS_TIME_CountToMS(SYS_TIME_CounterGet() - pstrRing->u32StallStart);
+    }
+    if(recv(sock, &pstrRing->pu8Buf[u32Tail], u16Free, pstrRing->u32Timeoutmsec) == SOCK_ERR_NO_ERROR)
+        pstrRing->strStats.u32Posts++;
+}
+
 /*********************************************************************
 Function
         Socket_ReadSocketData
@@ -169,8 +250,23 @@ static void Socket_ReadSocketData(SOCKET sock, tstrSocketRecvMsg *pstrRecv,uint8
             gastrSockets[sock].u16UserBufferSize = 0;
             gastrSockets[sock].pu8UserBuffer = NULL;
 
+            /* [rdp] The data landed in the ring: commit it, let the
+             * application look at it in place, then post into what is left. */
+            if(Socket_RingAttached(sock, u8SocketMsg))
+            {
+                tstrSocketRing *pstrRing = &gastrSocketRings[sock];
+
+                pstrRing->u16Count += u16Read;
+                pstrRing->strStats.u32Bytes += u16Read;
+                if(pstrRing->u16Count > pstrRing->strStats.u16MaxFill)
+                    pstrRing->strStats.u16MaxFill = pstrRing->u16Count;
+            }
+
             if(gpfAppSocketCb)
                 gpfAppSocketCb(sock, u8SocketMsg, pstrRecv);
+
+            if(Socket_RingAttached(sock, u8SocketMsg))
+                Socket_RingPost(sock);
         }
         else
         {
@@ -443,6 +539,7 @@ void socketInit(void)
     if(gbSocketInit == 0)
     {
         memset((uint8_t*)gastrSockets, 0, MAX_SOCKET * sizeof(tstrSocket));
+        memset(gastrSocketRings, 0, sizeof(gastrSocketRings));
         hif_register_cb(M2M_REQ_GROUP_IP, m2m_ip_cb);
         gbSocketInit    = 1;
         gu16SessionID   = 0;
@@ -470,6 +567,7 @@ Date
 void socketDeinit(void)
 {
     memset((uint8_t*)gastrSockets, 0, MAX_SOCKET * sizeof(tstrSocket));
+    memset(gastrSocketRings, 0, sizeof(gastrSocketRings));
     hif_register_cb(M2M_REQ_GROUP_IP, NULL);
     gpfAppSocketCb  = NULL;
     gpfAppResolveCb = NULL;
@@ -572,6 +670,7 @@ SOCKET socket(uint16_t u16Domain, uint8_t u8Type, uint8_t u8Config)
         if(sock >= 0)
         {
             memset((uint8_t*)pstrSock, 0, sizeof(tstrSocket));
+            memset(&gastrSocketRings[sock], 0, sizeof(tstrSocketRing));
             pstrSock->bIsUsed = 1;
 
             /* The session ID is used to distinguish different socket connections
@@ -970,6 +1069,116 @@ int16_t recv(SOCKET sock, void *pvRecvBuf, uint16_t u16BufLen, uint32_t u32Timeo
     return s16Ret;
 }
 /*********************************************************************
+Function
+        recv_ring_attach
+
+Description
+        [rdp] Receive into a ring rather than one buffer per recv().
+
+Return
+        SOCK_ERR_NO_ERROR, or SOCK_ERR_INVALID_ARG.
+*********************************************************************/
+int16_t recv_ring_attach(SOCKET sock, uint8_t *pu8Buf, uint16_t u16Size, uint16_t u16Fill, uint32_t u32Timeoutmsec)
+{
+    tstrSocketRing *pstrRing;
+
+    if((sock < 0) || (sock >= TCP_SOCK_MAX) || (pu8Buf == NULL) || (u16Size == 0) || (u16Fill > u16Size)
+        || (gastrSockets[sock].bIsUsed != 1) || gastrSockets[sock].bIsRecvPending)
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    pstrRing = &gastrSocketRings[sock];
+    memset(pstrRing, 0, sizeof(tstrSocketRing));
+    pstrRing->pu8Buf            = pu8Buf;
+    pstrRing->u16Size           = u16Size;
+    pstrRing->u16Count          = u16Fill;
+    pstrRing->u32Timeoutmsec    = u32Timeoutmsec;
+    pstrRing->strStats.u16MaxFill = u16Fill;
+    Socket_RingPost(sock);
+    return SOCK_ERR_NO_ERROR;
+}
+/*********************************************************************
+Function
+        recv_ring_peek
+
+Description
+        [rdp] Return the length of the unread data that is contiguous in
+        the ring, and where it starts.
+
+Return
+        Number of bytes at *ppu8Data, 0 if none.
+*********************************************************************/
+uint16_t recv_ring_peek(SOCKET sock, uint8_t **ppu8Data)
+{
+    tstrSocketRing  *pstrRing;
+    uint16_t        u16Len;
+
+    if((sock < 0) || (sock >= MAX_SOCKET) || (ppu8Data == NULL) || (gastrSocketRings[sock].pu8Buf == NULL))
+        return 0;
+
+    pstrRing = &gastrSocketRings[sock];
+    u16Len = pstrRing->u16Size - pstrRing->u16Head;
+    if(u16Len > pstrRing->u16Count)
+        u16Len = pstrRing->u16Count;
+    *ppu8Data = &pstrRing->pu8Buf[pstrRing->u16Head];
+    return u16Len;
+}
+/*********************************************************************
+Function
+        recv_ring_consume
+
+Description
+        [rdp] Release u16Len bytes from the front of the ring and post a
+        recv() into the freed space if none is outstanding.  A length of
+        zero just re-posts, e.g. after SOCK_ERR_TIMEOUT.
+
+Return
+        SOCK_ERR_NO_ERROR, or SOCK_ERR_INVALID_ARG.
+*********************************************************************/
+int16_t recv_ring_consume(SOCKET sock, uint16_t u16Len)
+{
+    tstrSocketRing  *pstrRing;
+    uint32_t        u32Head;
+
+    if((sock < 0) || (sock >= MAX_SOCKET) || (gastrSocketRings[sock].pu8Buf == NULL)
+        || (u16Len > gastrSocketRings[sock].u16Count))
+    {
+        return SOCK_ERR_INVALID_ARG;
+    }
+    pstrRing = &gastrSocketRings[sock];
+    u32Head = (uint32_t)pstrRing->u16Head + u16Len;
+    if(u32Head >= pstrRing->u16Size)
+        u32Head -= pstrRing->u16Size;
+    pstrRing->u16Head   = (uint16_t)u32Head;
+    pstrRing->u16Count -= u16Len;
+    Socket_RingPost(sock);
+    return SOCK_ERR_NO_ERROR;
+}
+/*********************************************************************
+Function
+        recv_ring_get_stats
+
+Description
+        [rdp] Copy the ring's counters.  A stall still in progress is
+        included in u32StallMs.
+
+Return
+        SOCK_ERR_NO_ERROR, or SOCK_ERR_INVALID_ARG.
+*********************************************************************/
+int8_t recv_ring_get_stats(SOCKET sock, tstrSocketRingStats *pstrStats)
+{
+    tstrSocketRing *pstrRing;
+
+    if((sock < 0) || (sock >= MAX_SOCKET) || (pstrStats == NULL) || (gastrSocketRings[sock].pu8Buf == NULL))
+        return SOCK_ERR_INVALID_ARG;
+
+    pstrRing = &gastrSocketRings[sock];
+    *pstrStats = pstrRing->strStats;
+    if(pstrRing->bStalled)
+        pstrStats->u32StallMs += SYS_TIME_CountToMS(SYS_TIME_CounterGet() - pstrRing->u32StallStart);
+    return SOCK_ERR_NO_ERROR;
+}
+/*********************************************************************
 Function
         close
 
@@ -1010,6 +1219,7 @@ int8_t shutdown(SOCKET sock)
             s8Ret = SOCK_ERR_INVALID;
         }
         memset((uint8_t*)&gastrSockets[sock], 0, sizeof(tstrSocket));
+        memset(&gastrSocketRings[sock], 0, sizeof(tstrSocketRing));
     }
     return s8Ret;
 }
@@ -65,6 +65,10 @@ SPI Flash DMA
 #define SPI_FLASH_MSB_CTL       (SPI_FLASH_BASE + 0x20)
 #define SPI_FLASH_TX_CTL        (SPI_FLASH_BASE + 0x24)
 
+/* [rdp] Called between busy polls; see spi_flash_set_busy_hook(). */
+static tpfSpiFlashBusyHook gpfBusyHook = NULL;
+#define SPI_FLASH_BUSY()        do { if(gpfBusyHook) gpfBusyHook(); } while(0)
+
 /*********************************************/
 /* STATIC FUNCTIONS                          */
 /*********************************************/
@@ -140,6 +144,7 @@ static int8_t spi_flash_load_to_cortus_mem(uint32_t u32MemAdr, uint32_t u32Flash
     {
         ret += nm_read_reg_with_ret(SPI_FLASH_TR_DONE, (uint32_t *)&val);
         if(M2M_SUCCESS != ret) break;
+        if(val != 1) SPI_FLASH_BUSY();  /* [rdp] */
     }
     while(val != 1);
 
@@ -331,6 +336,7 @@ static int8_t spi_flash_pp(uint32_t u32Offset, uint8_t *pu8Buf, uint16_t u16Sz)
     {
         if(ret != M2M_SUCCESS) goto ERR;
         ret += spi_flash_read_status_reg(&tmp);
+        if(tmp & 0x01) SPI_FLASH_BUSY();    /* [rdp] */
     }while(tmp & 0x01);
     ret += spi_flash_write_disable();
 ERR:
@@ -567,6 +573,7 @@ int8_t spi_flash_erase(uint32_t u32Offset, uint32_t u32Sz)
         {
             if(ret != M2M_SUCCESS) goto ERR;
             ret += spi_flash_read_status_reg(&tmp);
+            if(tmp & 0x01) SPI_FLASH_BUSY();    /* [rdp] */
         }while(tmp & 0x01);
 
     }
@@ -575,6 +582,12 @@ ERR:
     return ret;
 }
 
+/* [rdp] */
+void spi_flash_set_busy_hook(tpfSpiFlashBusyHook pfHook)
+{
+    gpfBusyHook = pfHook;
+}
+
 /**
 *   @fn         spi_flash_get_size
 *   @brief      Get size of SPI Flash
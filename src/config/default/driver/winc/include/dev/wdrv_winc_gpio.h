@@ -87,6 +87,52 @@ void WDRV_WINC_INTInitialize(void);
  */
 void WDRV_WINC_INTDeinitialize(void);
 
+//*******************************************************************************
+/*
+  Function:
+    void WDRV_WINC_INTMask(void)
+
+  Summary:
+    [rdp] Masks the WINC interrupt.
+
+  Description:
+    This function stops the WINC interrupt reaching the CPU.  An edge that
+    arrives while it is masked is held pending.
+
+  Precondition:
+    WDRV_WINC_INTInitialize must have been called.
+
+  Returns:
+    None.
+
+  Remarks:
+    May be called from the interrupt handler.
+ */
+void WDRV_WINC_INTMask(void);
+
+//*******************************************************************************
+/*
+  Function:
+    void WDRV_WINC_INTUnmask(void)
+
+  Summary:
+    [rdp] Unmasks the WINC interrupt.
+
+  Description:
+    This function lets the WINC interrupt reach the CPU again.  An edge held
+    pending while it was masked is then taken.
+
+  Precondition:
+    WDRV_WINC_INTInitialize must have been called.
+
+  Returns:
+    None.
+
+  Remarks:
+    None.
+ */
+void WDRV_WINC_INTUnmask(void);
+
 //*******************************************************************************
 /*
   Function:
@@ -40,6 +40,33 @@
 #ifndef _WDRV_WINC_SPI_H
 #define _WDRV_WINC_SPI_H
 
+#include <stdint.h>
+#include <stdbool.h>
+
+//*******************************************************************************
+/*  [rdp] SPI Bus Counters
+
+  Summary:
+    Counts of the traffic between the host and the module.
+
+  Description:
+    Times are in SYS_TIME counter ticks (see SYS_TIME_FrequencyGet).  busyTicks
+    is time with a transfer on the bus; waitTicks is time the caller spent
+    blocked on one.  Their difference is bus time the host overlapped with
+    other work.
+*/
+typedef struct
+{
+    uint32_t transfers;     // # of DRV_SPI transfers queued
+    uint32_t txBytes;       // # of bytes sent to the module
+    uint32_t rxBytes;       // # of bytes received from the module
+    uint32_t posted;        // # of short sends returned before completion
+    uint32_t pipelineFull;  // # of times a transfer waited for queue space
+    uint32_t errors;        // # of transfers refused or failed by DRV_SPI
+    uint32_t busyTicks;     // time the bus was busy
+    uint32_t waitTicks;     // time spent waiting for completions
+} WDRV_WINC_SPI_STATS;
+
 //*******************************************************************************
 /*
   Function:
@@ -94,6 +121,60 @@ bool WDRV_WINC_SPISend(unsigned char *const buf, uint32_t size);
  */
 bool WDRV_WINC_SPIReceive(unsigned char *const buf, uint32_t size);
 
+//*******************************************************************************
+/*
+  Function:
+    bool WDRV_WINC_SPIFlush(void)
+
+  Summary:
+    [rdp] Waits for any posted sends to reach the module.
+
+  Description:
+    Sends of a few bytes are copied and complete behind the caller.  Every
+    receive waits for them; call this where nothing is read after a send, e.g.
+    before powering down the host.
+
+  Precondition:
+    WDRV_WINC_SPIInitialize must have been called.
+
+  Returns:
+    true  - All transfers completed
+    false - A transfer failed
+
+  Remarks:
+    None.
+ */
+bool WDRV_WINC_SPIFlush(void);
+
+//*******************************************************************************
+/*
+  Function:
+    void WDRV_WINC_SPIStatsGet(WDRV_WINC_SPI_STATS *const pStats)
+
+  Summary:
+    [rdp] Returns the SPI bus counters.
+
+  Parameters:
+    pStats - receives a copy of the counters
+
+  Returns:
+    None.
+ */
+void WDRV_WINC_SPIStatsGet(WDRV_WINC_SPI_STATS *const pStats);
+
+//*******************************************************************************
+/*
+  Function:
+    void WDRV_WINC_SPIStatsReset(void)
+
+  Summary:
+    [rdp] Clears the SPI bus counters.
+
+  Returns:
+    None.
+ */
+void WDRV_WINC_SPIStatsReset(void);
+
 //*******************************************************************************
 /*
   Function:
@@ -64,6 +64,30 @@ typedef struct
     uint16_t  u16Length;    /*!< Payload length */
 }tstrHifHdr;
 
+/**
+*   @struct     tstrHifStats
+*   @brief      [rdp] Counts of HIF messages and of the SPI command frames they
+*               took, including chip wake and sleep.
+*/
+typedef struct
+{
+    uint32_t  u32TxMsgs;            /*!< # of messages sent */
+    uint32_t  u32TxFrames;          /*!< # of frames spent sending them */
+    uint32_t  u32RxMsgs;            /*!< # of messages received */
+    uint32_t  u32RxFrames;          /*!< # of frames spent receiving */
+    uint32_t  u32RxPrefetchHits;    /*!< # of hif_receive() calls served
+                                         from the data read with the header */
+    uint32_t  u32Irqs;              /*!< # of interrupts handled */
+    uint32_t  u32Passes;            /*!< # of calls to hif_handle_isr() */
+    uint32_t  u32EmptyPasses;       /*!< # of calls that found no message */
+    uint32_t  u32Yields;            /*!< # of calls that stopped at the
+                                         per-call limit */
+    uint32_t  u32LatencyTicks;      /*!< total SYS_TIME ticks from interrupt
+                                         to handling */
+    uint32_t  u32MaxLatencyTicks;   /*!< longest of those */
+    uint8_t   u8MaxPassEvents;      /*!< most messages handled in one call */
+}tstrHifStats;
+
 #ifdef __cplusplus
      extern "C" {
 #endif
@@ -211,11 +235,38 @@ uint8_t hif_get_sleep_mode(void);
 *   @fn     hif_handle_isr(void)
 *   @brief
             Handle interrupt received from NMC1500 firmware.
+            [rdp] Handles every queued message up to a per-call limit; see
+            hif_rx_pending().
 *   @return
             The function SHALL return 0 for success and a negative value otherwise.
 */
 int8_t hif_handle_isr(void);
 
+/**
+*   @fn     hif_get_stats(tstrHifStats *pstrStats)
+*   @brief
+            [rdp] Copy out the HIF message and SPI frame counts.
+*/
+void hif_get_stats(tstrHifStats *pstrStats);
+
+/**
+*   @fn     hif_irq_stamp(void)
+*   @brief
+            [rdp] Record the arrival of an interrupt, for the latency counts.
+            Called from the interrupt handler.
+*/
+void hif_irq_stamp(void);
+
+/**
+*   @fn     hif_rx_pending(void)
+*   @brief
+            [rdp] Return 1 if the last call to hif_handle_isr() stopped at its
+            limit with messages possibly still queued.  The caller should call
+            it again, after letting other tasks run, before re-enabling the
+            interrupt.
+*/
+uint8_t hif_rx_pending(void);
+
 #ifdef __cplusplus
 }
 #endif
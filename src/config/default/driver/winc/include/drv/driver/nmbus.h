@@ -44,6 +44,17 @@
 #ifdef __cplusplus
 extern "C"{
 #endif
+
+/**
+*   @struct tstrNmRegOp
+*   @brief  [rdp] One register access in a batch passed to nm_reg_batch()
+*/
+typedef struct
+{
+    uint32_t    u32Addr;        /*!< Register address */
+    uint32_t    u32Val;         /*!< Value to write, if pu32RetVal is NULL */
+    uint32_t    *pu32RetVal;    /*!< Where to store the value read, or NULL to write */
+} tstrNmRegOp;
 /**
 *   @fn     nm_bus_iface_init
 *   @brief  Initialize bus interface
@@ -131,6 +142,26 @@ int8_t nm_read_block(uint32_t u32Addr, uint8_t *puBuf, uint32_t u32Sz);
 */
 int8_t nm_write_block(uint32_t u32Addr, uint8_t *puBuf, uint32_t u32Sz);
 
+/**
+*   @fn     nm_reg_batch
+*   @brief  [rdp] Perform a sequence of register reads and writes back to back,
+*           under one bus lock and one retry budget
+*   @param [in, out] pstrOps
+*               Accesses to perform, in order
+*   @param [in] u8Count
+*               Number of entries in pstrOps
+*   @return ZERO in case of success and M2M_ERR_BUS_FAIL in case of failure
+*/
+int8_t nm_reg_batch(tstrNmRegOp *pstrOps, uint8_t u8Count);
+
+/**
+*   @fn     nm_bus_frame_count
+*   @brief  [rdp] Return the number of command frames sent on the bus since
+*           power up.  Differences of this count measure the cost of an
+*           operation.
+*/
+uint32_t nm_bus_frame_count(void);
+
 
 
 
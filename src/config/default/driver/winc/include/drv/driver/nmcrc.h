@@ -0,0 +1,104 @@
+/*******************************************************************************
+  This module contains the CRC7 and CRC16 checksums of the WINC1500 SPI
+  protocol.
+
+  File Name:
+    nmcrc.h
+
+  Summary:
+    [rdp] CRC7 and CRC16 checksums of the WINC1500 SPI protocol.
+
+  Description:
+    CRC7 protects command frames and CRC16 protects data packets.
+ *******************************************************************************/
+
+//DOM-IGNORE-BEGIN
+/*******************************************************************************
+* MIT License
+*
+* Copyright (c) 2022 Klatu Networks
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*******************************************************************************/
+
+#ifndef _NMCRC_H_
+#define _NMCRC_H_
+
+#include "nm_common.h"
+
+#ifdef __cplusplus
+     extern "C" {
+#endif
+
+/**
+*   @struct tstrNmCrcStats
+*   @brief  CRC engine choice and counters.  Bench times are in SYS_TIME
+*           counter ticks.
+*/
+typedef struct
+{
+    uint8_t     u8Tested;           /*!< nm_crc_init() has run */
+    uint8_t     u8HwAgrees;         /*!< DMAC CRC engine matches the tables */
+    uint8_t     u8HwUsed;           /*!< ...and is used for long buffers */
+    uint32_t    u32SwBenchTicks;    /*!< Tables, 256 bytes */
+    uint32_t    u32HwBenchTicks;    /*!< DMAC CRC engine, 256 bytes */
+    uint32_t    u32SwBytes;         /*!< # of bytes checksummed by the tables */
+    uint32_t    u32HwBytes;         /*!< # of bytes checksummed by the DMAC */
+    uint32_t    u32Checked;         /*!< # of data packets whose CRC16 was checked */
+    uint32_t    u32Errors;          /*!< # of those that failed the check */
+} tstrNmCrcStats;
+
+/**
+*   @fn     nm_crc_init
+*   @brief  Choose between the DMAC CRC engine and the tables.  Only the first
+*           call does anything.
+*/
+void nm_crc_init(void);
+
+/**
+*   @fn     nm_crc7
+*   @brief  Continue a CRC7 over len bytes of buffer.  Start from 0x7f.
+*/
+uint8_t nm_crc7(uint8_t crc, const uint8_t *buffer, uint32_t len);
+
+/**
+*   @fn     nm_crc16
+*   @brief  Continue a CRC16 over len bytes of buffer.  Start from 0xffff.
+*/
+uint16_t nm_crc16(uint16_t crc, const uint8_t *buffer, uint32_t len);
+
+/**
+*   @fn     nm_crc_record
+*   @brief  Count a data packet whose CRC16 was checked
+*   @param [in] u8Ok
+*               Non-zero if the CRC16 matched
+*/
+void nm_crc_record(uint8_t u8Ok);
+
+/**
+*   @fn     nm_crc_get_stats
+*   @brief  Copy out the CRC counters
+*/
+void nm_crc_get_stats(tstrNmCrcStats *pstrStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _NMCRC_H_ */
@@ -138,6 +138,23 @@ int8_t nm_drv_init_hold(void);
 */
 int8_t nm_drv_init_start(void * arg);
 
+/*
+*	@fn		nm_drv_set_resume
+*	@brief	[rdp] Request that the next nm_drv_init_hold() wake a WINC that was
+*			left running (e.g. associated in power save) instead of resetting it.
+*			If the WINC does not respond, it is reset as usual.
+*	@param [in]	u8Resume
+*				Non-zero to resume, zero to reset.
+*/
+void nm_drv_set_resume(uint8_t u8Resume);
+
+/*
+*	@fn		nm_drv_resumed
+*	@brief	[rdp] Return non-zero if the WINC was resumed rather than reset.
+*			Valid once nm_drv_init_hold() has returned.
+*/
+uint8_t nm_drv_resumed(void);
+
 /**
 *   @fn     nm_drv_deinit
 *   @brief  Deinitialize NMC1000 driver
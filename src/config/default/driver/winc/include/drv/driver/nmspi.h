@@ -40,6 +40,7 @@
 #define _NMSPI_H_
 
 #include "nm_common.h"
+#include "nmbus.h"
 
 #ifdef __cplusplus
      extern "C" {
@@ -104,6 +105,34 @@ int8_t nm_spi_read_reg_with_ret(uint32_t u32Addr, uint32_t* pu32RetVal);
 */
 int8_t nm_spi_write_reg(uint32_t u32Addr, uint32_t u32Val);
 
+/**
+*   @fn     nm_spi_reg_batch
+*   @brief  [rdp] Perform a sequence of register reads and writes under one
+*           bus lock
+*   @param [in, out] pstrOps
+*               Accesses to perform, in order
+*   @param [in] u8Count
+*               Number of entries in pstrOps
+*   @return M2M_SUCCESS in case of success and M2M_ERR_BUS_FAIL in case of failure
+*/
+int8_t nm_spi_reg_batch(tstrNmRegOp *pstrOps, uint8_t u8Count);
+
+/**
+*   @fn     nm_spi_set_crc
+*   @brief  [rdp] Turn CRC7 and CRC16 checking on or off.  The choice also
+*           holds across later calls to nm_spi_init().
+*   @param [in] u8Enable
+*               Non-zero to check CRCs
+*   @return M2M_SUCCESS in case of success and M2M_ERR_BUS_FAIL in case of failure
+*/
+int8_t nm_spi_set_crc(uint8_t u8Enable);
+
+/**
+*   @fn     nm_spi_frame_count
+*   @brief  [rdp] Return the number of command frames sent to the WINC
+*/
+uint32_t nm_spi_frame_count(void);
+
 /**
 *   @fn     nm_spi_read_block
 *   @brief  Read block of data
@@ -870,6 +870,22 @@ typedef struct {
         Socket address structure for the remote peer. It is valid for @ref SOCKET_MSG_RECVFROM event.
     */
 } tstrSocketRecvMsg;
+
+/*!
+@struct \
+    tstrSocketRingStats
+
+@brief  [rdp] Counters of a receive ring attached by @ref recv_ring_attach.
+        A stall is a period during which the ring was full, no recv() could be
+        posted and incoming data waited on the WINC.
+*/
+typedef struct {
+    uint32_t                u32Bytes;       /*!< Bytes received into the ring */
+    uint32_t                u32Posts;       /*!< recv() calls posted by the ring */
+    uint32_t                u32Stalls;      /*!< Times the ring filled up */
+    uint32_t                u32StallMs;     /*!< Total time spent full */
+    uint16_t                u16MaxFill;     /*!< Most unread bytes held at once */
+} tstrSocketRingStats;
 /**@}*/     //AsyncCallback
 
 /**@defgroup SocketCallbacks Callbacks
@@ -2251,6 +2267,78 @@ int8_t get_alpn_index(SOCKET sock);
 int8_t get_error_detail(SOCKET sock, tstrSockErr *pstrErr);
 /**@}*/     //PingFn
 
+/*!
+ *@fn   int16_t recv_ring_attach(SOCKET sock, uint8_t *pu8Buf, uint16_t u16Size, uint16_t u16Fill, uint32_t u32Timeoutmsec);
+ *
+ *  [rdp] Receive on a connected TCP socket into a ring buffer.  The driver posts
+ *  recv() into the free space of the ring and reposts it after each
+ *  @ref SOCKET_MSG_RECV for as long as space remains, so data flows from the WINC
+ *  without waiting on the application.  The @ref SOCKET_MSG_RECV event still
+ *  arrives, with pu8Buffer pointing into the ring; the data stays there until
+ *  released by @ref recv_ring_consume.  Errors (including time-outs) are reported
+ *  as usual and are not reposted.
+ *  Must not be called while a recv() is outstanding.  The application must not
+ *  call recv() itself while the ring is attached.  The ring is detached by
+ *  @ref close.
+ *
+ * @param[in]   sock
+ *                  Socket ID obtained by a call to @ref socket.
+ * @param[in]   pu8Buf
+ *                  Ring storage, which must remain valid until @ref close.
+ * @param[in]   u16Size
+ *                  Size of pu8Buf in bytes.
+ * @param[in]   u16Fill
+ *                  Number of bytes at the start of pu8Buf already holding data,
+ *                  e.g. received by an earlier recv().
+ * @param[in]   u32Timeoutmsec
+ *                  Timeout passed to each recv(), 0 for none.
+ *
+ * @return  @ref SOCK_ERR_NO_ERROR, or @ref SOCK_ERR_INVALID_ARG.
+*/
+int16_t recv_ring_attach(SOCKET sock, uint8_t *pu8Buf, uint16_t u16Size, uint16_t u16Fill, uint32_t u32Timeoutmsec);
+
+/*!
+ *@fn   uint16_t recv_ring_peek(SOCKET sock, uint8_t **ppu8Data);
+ *
+ *  [rdp] Return a view of the oldest unread data in the ring, without copying.
+ *  Data that wraps around the end of the ring is returned by a second call,
+ *  after the first part has been consumed.
+ *
+ * @param[in]   sock
+ *                  Socket ID with a ring attached.
+ * @param[out]  ppu8Data
+ *                  Set to the start of the unread data.
+ *
+ * @return  The number of contiguous unread bytes, 0 if none.
+*/
+uint16_t recv_ring_peek(SOCKET sock, uint8_t **ppu8Data);
+
+/*!
+ *@fn   int16_t recv_ring_consume(SOCKET sock, uint16_t u16Len);
+ *
+ *  [rdp] Release data returned by @ref recv_ring_peek and post a recv() into the
+ *  space freed if none is outstanding.  A length of zero only reposts, e.g. to
+ *  resume after @ref SOCK_ERR_TIMEOUT.
+ *
+ * @param[in]   sock
+ *                  Socket ID with a ring attached.
+ * @param[in]   u16Len
+ *                  Number of bytes to release, at most the number unread.
+ *
+ * @return  @ref SOCK_ERR_NO_ERROR, or @ref SOCK_ERR_INVALID_ARG.
+*/
+int16_t recv_ring_consume(SOCKET sock, uint16_t u16Len);
+
+/*!
+ *@fn   int8_t recv_ring_get_stats(SOCKET sock, tstrSocketRingStats *pstrStats);
+ *
+ *  [rdp] Read the counters of the ring attached to a socket.  Must be called
+ *  before @ref close.
+ *
+ * @return  @ref SOCK_ERR_NO_ERROR, or @ref SOCK_ERR_INVALID_ARG.
+*/
+int8_t recv_ring_get_stats(SOCKET sock, tstrSocketRingStats *pstrStats);
+
 #ifdef  __cplusplus
 }
 #endif /* __cplusplus */
@@ -219,4 +219,17 @@ int8_t spi_flash_write(uint8_t* pu8Buf, uint32_t u32Offset, uint32_t u32Sz);
 int8_t spi_flash_erase(uint32_t u32Offset, uint32_t u32Sz);
  /**@}*/
 
+/*!
+ * @fn             void spi_flash_set_busy_hook(tpfSpiFlashBusyHook);
+ * @brief          [rdp] Register a function to call while the flash is busy.\n
+ *                 The hook is called between polls while the WINC loads flash
+ *                 into its memory, programs a page or erases a sector, so the
+ *                 host can do other work in that time.  Pass NULL to remove it.
+ * @warning
+ *                 - The hook must not use the WINC, and should return within
+ *                   about a millisecond.
+ */
+typedef void (*tpfSpiFlashBusyHook)(void);
+void spi_flash_set_busy_hook(tpfSpiFlashBusyHook pfHook);
+
 #endif  //__SPI_FLASH_H__
@@ -265,4 +265,52 @@ WDRV_WINC_STATUS WDRV_WINC_NVMRead
     uint32_t size
 );
 
+//*******************************************************************************
+/*
+  Function:
+    WDRV_WINC_STATUS WDRV_WINC_NVMRegionGet
+    (
+        DRV_HANDLE handle,
+        WDRV_WINC_NVM_REGION region,
+        uint32_t *pAddress,
+        uint32_t *pSize
+    );
+
+  Summary:
+    [rdp] Looks up the location and size of an NVM region.
+
+  Description:
+    Resolves the region from the flexible flash map, or for the raw region
+    from the size reported by the flash, into its absolute address within the
+    SPI flash and its size in bytes.
+
+  Precondition:
+    WDRV_WINC_Initialize should have been called.
+    WDRV_WINC_Open should have been called with the intent
+        DRV_IO_INTENT_EXCLUSIVE to obtain a valid handle.
+
+  Parameters:
+    handle   - Client handle obtained by a call to WDRV_WINC_Open.
+    region   - Region of NVM to look up.
+    pAddress - Pointer to variable to receive the region start address.
+    pSize    - Pointer to variable to receive the region size.
+
+  Returns:
+    WDRV_WINC_STATUS_OK             - The region was found.
+    WDRV_WINC_STATUS_INVALID_ARG    - The parameters were incorrect.
+    WDRV_WINC_STATUS_NOT_OPEN       - The driver instance is not open.
+    WDRV_WINC_STATUS_REQUEST_ERROR  - The request encountered an error.
+
+  Remarks:
+    Offsets passed to the other NVM functions are relative to the address.
+
+*/
+WDRV_WINC_STATUS WDRV_WINC_NVMRegionGet
+(
+    DRV_HANDLE handle,
+    WDRV_WINC_NVM_REGION region,
+    uint32_t *pAddress,
+    uint32_t *pSize
+);
+
 #endif /* _WDRV_WINC_NVM_H */
@@ -331,6 +331,36 @@ WDRV_WINC_STATUS WDRV_WINC_IPAddressSet
 
 uint32_t WDRV_WINC_IPAddressGet(DRV_HANDLE handle);
 
+//*******************************************************************************
+/*
+  Function:
+    uint32_t WDRV_WINC_IPDefaultGatewayGet(DRV_HANDLE handle)
+
+  Summary:
+    Returns the current default gateway IPv4 address.
+
+  Description:
+    Returns the default gateway IPv4 address, either as configured by
+      WDRV_WINC_IPDefaultGatewaySet or as assigned by the DHCP server.
+
+  Precondition:
+    WDRV_WINC_Initialize should have been called.
+    WDRV_WINC_Open should have been called to obtain a valid handle.
+
+  Parameters:
+    handle - Client handle obtained by a call to WDRV_WINC_Open.
+
+  Returns:
+    Gateway address or zero for an error conditions.
+
+  Remarks:
+    The top 8 bits of the IPv4 32 bit representation corresponds to
+      the last byte of the IPv4 address, i.e. 192.168.0.1 = 0x0100A8C0
+
+*/
+
+uint32_t WDRV_WINC_IPDefaultGatewayGet(DRV_HANDLE handle);
+
 //*******************************************************************************
 /*
   Function:
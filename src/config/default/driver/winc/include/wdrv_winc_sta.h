@@ -186,6 +186,58 @@ WDRV_WINC_STATUS WDRV_WINC_BSSReconnect
     WDRV_WINC_BSSCON_NOTIFY_CALLBACK pfNotifyCallback
 );
 
+//*******************************************************************************
+/*
+  Function:
+    WDRV_WINC_STATUS WDRV_WINC_BSSResume
+    (
+        DRV_HANDLE handle,
+        uint32_t ipAddress,
+        uint32_t gatewayAddress,
+        WDRV_WINC_BSSCON_NOTIFY_CALLBACK pfNotifyCallback
+    )
+
+  Summary:
+    Adopts a BSS connection made before the driver was initialized.
+
+  Description:
+    [rdp] When the WINC was left associated while the host hibernated (see
+    nm_drv_set_resume), the driver comes up believing it is disconnected.
+    This marks it connected, restores the IP address and gateway the WINC
+    was given by DHCP, and registers the callback that will be told of a
+    later disconnection.  No request is sent to the WINC: the caller must
+    first confirm that the association still stands, e.g. from
+    m2m_wifi_get_connection_info.
+
+  Precondition:
+    WDRV_WINC_Initialize should have been called.
+    WDRV_WINC_Open should have been called to obtain a valid handle.
+
+  Parameters:
+    handle           - Client handle obtained by a call to WDRV_WINC_Open.
+    ipAddress        - IP address assigned to the WINC.
+    gatewayAddress   - Default gateway address.
+    pfNotifyCallback - Pointer to notification callback function.
+
+  Returns:
+    WDRV_WINC_STATUS_OK              - The connection has been adopted.
+    WDRV_WINC_STATUS_NOT_OPEN        - The driver instance is not open.
+    WDRV_WINC_STATUS_INVALID_ARG     - The parameters were incorrect.
+    WDRV_WINC_STATUS_REQUEST_ERROR   - The driver is already connected.
+
+  Remarks:
+    None.
+
+*/
+
+WDRV_WINC_STATUS WDRV_WINC_BSSResume
+(
+    DRV_HANDLE handle,
+    uint32_t ipAddress,
+    uint32_t gatewayAddress,
+    WDRV_WINC_BSSCON_NOTIFY_CALLBACK pfNotifyCallback
+);
+
 //*******************************************************************************
 /*
   Function:
@@ -54,6 +54,7 @@
 #include "driver/winc_asic.h"
 #else
 #include "m2m_wifi.h"
+#include "m2m_hif.h"
 #ifdef WDRV_WINC_DEVICE_WINC3400
 #include "m2m_flash.h"
 #endif
@@ -880,6 +881,17 @@ static void _WDRV_WINC_WifiCallback(uint8_t msgType, const void *const pMsgConte
                                       ( (uint32_t)pIP[1] << 8 ) |
                                       ( (uint32_t)pIP[0]);
 
+            if (true == pDcpt->pCtrl->useDHCP)
+            {
+                const tstrM2MIPConfig *const pIPConfig = (const tstrM2MIPConfig *const)pMsgContent;
+
+                /* Record the DHCP assigned gateway and DNS server so they can
+                    be queried, they are only applied to the WINC when DHCP is
+                    disabled. */
+                pDcpt->pCtrl->gatewayAddress   = pIPConfig->u32Gateway;
+                pDcpt->pCtrl->dnsServerAddress = pIPConfig->u32DNS;
+            }
+
             if (NULL != pDcpt->pCtrl->pfDHCPAddressEventCB)
             {
                 /* Signal IP address to user application via callback. */
@@ -2185,6 +2197,11 @@ void WDRV_WINC_Tasks(SYS_MODULE_OBJ object)
                     {
                         OSAL_SEM_Post(&pDcpt->pCtrl->drvEventSemaphore);
                     }
+                    else
+                    {
+                        /* [rdp] See SYS_STATUS_READY. */
+                        WDRV_WINC_INTUnmask();
+                    }
                 }
 
                 break;
@@ -2316,6 +2333,7 @@ void WDRV_WINC_Tasks(SYS_MODULE_OBJ object)
 
                 if (0 != (pDcpt->pCtrl->intent & DRV_IO_INTENT_EXCLUSIVE))
                 {
+                    WDRV_WINC_INTUnmask();
                     break;
                 }
 
@@ -2327,6 +2345,17 @@ void WDRV_WINC_Tasks(SYS_MODULE_OBJ object)
                 {
                     OSAL_SEM_Post(&pDcpt->pCtrl->drvEventSemaphore);
                 }
+                else if (0 != hif_rx_pending())
+                {
+                    /* [rdp] Messages may remain queued: come back for them
+                     * after the other tasks have run. */
+                    OSAL_SEM_Post(&pDcpt->pCtrl->drvEventSemaphore);
+                }
+                else
+                {
+                    /* [rdp] The queue is empty: let the next message interrupt. */
+                    WDRV_WINC_INTUnmask();
+                }
             }
 
             break;
@@ -3903,5 +3932,9 @@ void WDRV_WINC_ISR(void)
         return;
     }
 
+    /* [rdp] One interrupt per burst: WDRV_WINC_Tasks() unmasks the line once
+     * it has drained the WINC's message queue. */
+    WDRV_WINC_INTMask();
+    hif_irq_stamp();
     OSAL_SEM_PostISR(&pDcpt->pCtrl->drvEventSemaphore);
 }
@@ -748,3 +748,75 @@ WDRV_WINC_STATUS WDRV_WINC_NVMRead
 
     return WDRV_WINC_STATUS_OK;
 }
+
+//*******************************************************************************
+/*
+  Function:
+    WDRV_WINC_STATUS WDRV_WINC_NVMRegionGet
+    (
+        DRV_HANDLE handle,
+        WDRV_WINC_NVM_REGION region,
+        uint32_t *pAddress,
+        uint32_t *pSize
+    );
+
+  Summary:
+    [rdp] Looks up the location and size of an NVM region.
+
+  Description:
+    Resolves the region into its absolute address and size in the SPI flash.
+
+  Remarks:
+    See wdrv_winc_nvm.h for usage information.
+
+*/
+WDRV_WINC_STATUS WDRV_WINC_NVMRegionGet
+(
+    DRV_HANDLE handle,
+    WDRV_WINC_NVM_REGION region,
+    uint32_t *pAddress,
+    uint32_t *pSize
+)
+{
+    WDRV_WINC_DCPT *const pDcpt = (WDRV_WINC_DCPT *const)handle;
+    bool found;
+
+    /* Ensure the driver handle, pointers and region are valid. */
+    if ((DRV_HANDLE_INVALID == handle) || (NULL == pDcpt) || (NULL == pDcpt->pCtrl)
+            || (NULL == pAddress) || (NULL == pSize) || (region >= NUM_WDRV_WINC_NVM_REGIONS))
+    {
+        return WDRV_WINC_STATUS_INVALID_ARG;
+    }
+
+    /* Ensure the driver instance has been opened for use. */
+    if (false == pDcpt->isOpen)
+    {
+        return WDRV_WINC_STATUS_NOT_OPEN;
+    }
+
+    /* Ensure the driver is opened for exclusive flash access. */
+    if (0 == (pDcpt->pCtrl->intent & DRV_IO_INTENT_EXCLUSIVE))
+    {
+        return WDRV_WINC_STATUS_NOT_OPEN;
+    }
+
+#ifdef WDRV_WINC_DEVICE_WINC1500
+    /* The lookup may read the flash size and control sector. */
+    if (M2M_SUCCESS != spi_flash_enable(1))
+    {
+        return WDRV_WINC_STATUS_REQUEST_ERROR;
+    }
+#endif
+
+    found = _WDRV_WINC_NVMFindSection(region, pAddress, pSize);
+
+#ifdef WDRV_WINC_DEVICE_WINC1500
+    /* Return flash to power save mode. */
+    if (M2M_SUCCESS != spi_flash_enable(0))
+    {
+        return WDRV_WINC_STATUS_REQUEST_ERROR;
+    }
+#endif
+
+    return (true == found) ? WDRV_WINC_STATUS_OK : WDRV_WINC_STATUS_REQUEST_ERROR;
+}
@@ -208,6 +208,42 @@ uint32_t WDRV_WINC_IPAddressGet(DRV_HANDLE handle)
     return pDcpt->pCtrl->ipAddress;
 }
 
+//*******************************************************************************
+/*
+  Function:
+    uint32_t WDRV_WINC_IPDefaultGatewayGet(DRV_HANDLE handle)
+
+  Summary:
+    Returns the current default gateway IPv4 address.
+
+  Description:
+    Returns the default gateway either configured statically or assigned
+      by DHCP.
+
+  Remarks:
+    See wdrv_winc_socket.h for usage information.
+
+*/
+
+uint32_t WDRV_WINC_IPDefaultGatewayGet(DRV_HANDLE handle)
+{
+    const WDRV_WINC_DCPT *const pDcpt = (const WDRV_WINC_DCPT *const)handle;
+
+    /* Ensure the driver handle is valid. */
+    if ((DRV_HANDLE_INVALID == handle) || (NULL == pDcpt) || (NULL == pDcpt->pCtrl))
+    {
+        return 0;
+    }
+
+    /* Ensure driver is open and has obtained an IP address. */
+    if ((false == pDcpt->isOpen) || (false == pDcpt->pCtrl->haveIPAddress))
+    {
+        return 0;
+    }
+
+    return pDcpt->pCtrl->gatewayAddress;
+}
+
 //*******************************************************************************
 /*
   Function:
@@ -456,6 +456,68 @@ WDRV_WINC_STATUS WDRV_WINC_BSSReconnect
     return WDRV_WINC_STATUS_OK;
 }
 
+//*******************************************************************************
+/*
+  Function:
+    WDRV_WINC_STATUS WDRV_WINC_BSSResume
+    (
+        DRV_HANDLE handle,
+        uint32_t ipAddress,
+        uint32_t gatewayAddress,
+        WDRV_WINC_BSSCON_NOTIFY_CALLBACK pfNotifyCallback
+    )
+
+  Summary:
+    Adopts a BSS connection made before the driver was initialized.
+
+  Description:
+    [rdp] Marks the driver connected to a BSS that the WINC kept while the host
+    was reset, restoring the IP configuration it had then.
+
+  Remarks:
+    See wdrv_winc_sta.h for usage information.
+
+*/
+
+WDRV_WINC_STATUS WDRV_WINC_BSSResume
+(
+    DRV_HANDLE handle,
+    uint32_t ipAddress,
+    uint32_t gatewayAddress,
+    WDRV_WINC_BSSCON_NOTIFY_CALLBACK pfNotifyCallback
+)
+{
+    WDRV_WINC_DCPT *pDcpt = (WDRV_WINC_DCPT *)handle;
+
+    /* Ensure the driver handle is valid. */
+    if ((DRV_HANDLE_INVALID == handle) || (NULL == pDcpt) || (NULL == pDcpt->pCtrl))
+    {
+        return WDRV_WINC_STATUS_INVALID_ARG;
+    }
+
+    /* Ensure the driver instance has been opened for use. */
+    if (false == pDcpt->isOpen)
+    {
+        return WDRV_WINC_STATUS_NOT_OPEN;
+    }
+
+    /* Ensure WINC is not connected. */
+    if (true == pDcpt->pCtrl->isConnected)
+    {
+        return WDRV_WINC_STATUS_REQUEST_ERROR;
+    }
+
+    pDcpt->pCtrl->pfConnectNotifyCB   = pfNotifyCallback;
+    pDcpt->pCtrl->isConnected         = true;
+#ifdef WDRV_WINC_NETWORK_MODE_SOCKET
+    pDcpt->pCtrl->ipAddress           = ipAddress;
+    pDcpt->pCtrl->gatewayAddress      = gatewayAddress;
+    pDcpt->pCtrl->haveIPAddress       = true;
+#endif
+
+    return WDRV_WINC_STATUS_OK;
+}
+
 //*******************************************************************************
 /*
   Function:
@@ -35,7 +35,6 @@
 #include "mu_str.h"
 #include "mu_strbuf.h"
 #include "nv_data.h"
-#include "winc_imager.h"
 #include "yb_log.h"
 #include <ctype.h>
 #include <stdbool.h>
@@ -68,6 +67,15 @@ typedef struct {
   const char *file_name;
   mu_cfg_parser_t parser;
   char winc_image_filename[MAX_CONFIG_VALUE_LENGTH];
+  char winc_image_region[MAX_CONFIG_VALUE_LENGTH];
+  char download_path[MAX_CONFIG_VALUE_LENGTH];
+  char download_file[MAX_CONFIG_VALUE_LENGTH];
+  uint32_t download_length;
+  uint8_t download_sha256[MAX_CONFIG_DOWNLOAD_HASH_SIZE];
+  size_t download_sha256_len;
+  char upload_path[MAX_CONFIG_VALUE_LENGTH];
+  char upload_file[MAX_CONFIG_VALUE_LENGTH];
+  int wifi_profile; // profile of the most recent wifi_ssid, -1 if none
 } config_task_ctx_t;
 
 // *****************************************************************************
@@ -84,11 +92,23 @@ static void on_match(mu_str_t *key, mu_str_t *value);
  */
 static bool match_cstring(mu_str_t *mu_str, const char *cstr);
 
+/**
+ * @brief Decode up to max_len bytes of hex digits from mu_str into buf.
+ * Returns the number of bytes decoded, or 0 if a non-hex digit is found.
+ */
+static size_t mu_str_to_hex(mu_str_t *mu_str, uint8_t *buf, size_t max_len);
+
 /**
  * @brief Convert a mu_str to a floating point value.
  */
 static float mu_str_to_float(mu_str_t *mu_str);
 
+/**
+ * @brief Convert a comma separated list of channel numbers, e.g. "1,6,11", to
+ * a channel mask with bit n-1 set for channel n.
+ */
+static uint16_t mu_str_to_channel_mask(mu_str_t *mu_str);
+
 // *****************************************************************************
 // Local (private, static) storage
 
@@ -110,6 +130,14 @@ void config_task_init(const char *filename) {
   memset(&s_config_task_ctx.winc_image_filename,
          0,
          sizeof(s_config_task_ctx.winc_image_filename));
+  s_config_task_ctx.winc_image_region[0] = '\0';
+  s_config_task_ctx.download_path[0] = '\0';
+  s_config_task_ctx.download_file[0] = '\0';
+  s_config_task_ctx.download_length = 0;
+  s_config_task_ctx.download_sha256_len = 0;
+  s_config_task_ctx.upload_path[0] = '\0';
+  s_config_task_ctx.upload_file[0] = '\0';
+  s_config_task_ctx.wifi_profile = -1;
       mu_cfg_parser_init(&s_config_task_ctx.parser, on_match);
 }
 
@@ -208,12 +236,22 @@ bool config_task_failed(void) {
 
 void config_task_shutdown(void) {}
 
-const char *config_task_get_wifi_ssid(void) {
-  return nv_data()->config_task_nv_data.wifi_ssid;
+int config_task_get_wifi_profile_count(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  int count = 0;
+  while (count < MAX_CONFIG_WIFI_PROFILES &&
+         nv->wifi_profiles[count].ssid[0] != '\0') {
+    count += 1;
+  }
+  return count;
+}
+
+const char *config_task_get_wifi_ssid(int i) {
+  return nv_data()->config_task_nv_data.wifi_profiles[i].ssid;
 }
 
-const char *config_task_get_wifi_pass(void) {
-  return nv_data()->config_task_nv_data.wifi_pass;
+const char *config_task_get_wifi_pass(int i) {
+  return nv_data()->config_task_nv_data.wifi_profiles[i].pass;
 }
 
 yb_rtc_ms_t config_task_get_wake_interval_ms(void) {
@@ -224,6 +262,131 @@ yb_rtc_ms_t config_task_get_timeout_ms(void) {
   return nv_data()->config_task_nv_data.timeout_ms;
 }
 
+int config_task_get_probe_endpoint_count(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  int count = 0;
+  while (count < MAX_CONFIG_PROBE_ENDPOINTS &&
+         nv->probe_endpoints[count][0] != '\0') {
+    count += 1;
+  }
+  return count;
+}
+
+const char *config_task_get_probe_endpoint(int i) {
+  return nv_data()->config_task_nv_data.probe_endpoints[i];
+}
+
+const char *config_task_get_ping_host(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  return (nv->ping_host[0] == '\0') ? NULL : nv->ping_host;
+}
+
+uint8_t config_task_get_ping_count(void) {
+  return nv_data()->config_task_nv_data.ping_count;
+}
+
+const char *config_task_get_bench_host(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  return (nv->bench_host[0] == '\0') ? NULL : nv->bench_host;
+}
+
+uint16_t config_task_get_bench_port(void) {
+  return nv_data()->config_task_nv_data.bench_port;
+}
+
+uint32_t config_task_get_bench_up_bytes(void) {
+  return nv_data()->config_task_nv_data.bench_up_bytes;
+}
+
+uint32_t config_task_get_bench_down_bytes(void) {
+  return nv_data()->config_task_nv_data.bench_down_bytes;
+}
+
+const char *config_task_get_udp_host(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  return (nv->udp_host[0] == '\0') ? NULL : nv->udp_host;
+}
+
+uint16_t config_task_get_udp_port(void) {
+  return nv_data()->config_task_nv_data.udp_port;
+}
+
+const char *config_task_get_udp_key(void) {
+  return nv_data()->config_task_nv_data.udp_key;
+}
+
+uint8_t config_task_get_survey_every(void) {
+  return nv_data()->config_task_nv_data.survey_every;
+}
+
+bool config_task_get_survey_passive(void) {
+  return nv_data()->config_task_nv_data.survey_passive;
+}
+
+uint16_t config_task_get_survey_channels(void) {
+  return nv_data()->config_task_nv_data.survey_channels;
+}
+
+const char *config_task_get_winc_power(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  return (nv->winc_power[0] == '\0') ? NULL : nv->winc_power;
+}
+
+yb_rtc_ms_t config_task_get_winc_park_ms(void) {
+  return nv_data()->config_task_nv_data.winc_park_ms;
+}
+
+const char *config_task_get_sntp_server(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  return (nv->sntp_server[0] == '\0') ? NULL : nv->sntp_server;
+}
+
+const char *config_task_get_winc_spi_crc(void) {
+  config_task_nv_data_t *nv = &nv_data()->config_task_nv_data;
+  return (nv->winc_spi_crc[0] == '\0') ? NULL : nv->winc_spi_crc;
+}
+
+const char *config_task_get_download_path(void) {
+  if (s_config_task_ctx.download_path[0] == '\0') {
+    return NULL;
+  } else {
+    return s_config_task_ctx.download_path;
+  }
+}
+
+const char *config_task_get_download_file(void) {
+  if (s_config_task_ctx.download_file[0] == '\0') {
+    return NULL;
+  } else {
+    return s_config_task_ctx.download_file;
+  }
+}
+
+uint32_t config_task_get_download_length(void) {
+  return s_config_task_ctx.download_length;
+}
+
+size_t config_task_get_download_sha256(const uint8_t **hash) {
+  *hash = s_config_task_ctx.download_sha256;
+  return s_config_task_ctx.download_sha256_len;
+}
+
+const char *config_task_get_upload_path(void) {
+  if (s_config_task_ctx.upload_path[0] == '\0') {
+    return NULL;
+  } else {
+    return s_config_task_ctx.upload_path;
+  }
+}
+
+const char *config_task_get_upload_file(void) {
+  if (s_config_task_ctx.upload_file[0] == '\0') {
+    return NULL;
+  } else {
+    return s_config_task_ctx.upload_file;
+  }
+}
+
 const char *config_task_get_winc_image_filename(void) {
   if (s_config_task_ctx.winc_image_filename[0] == '\0') {
     return NULL;
@@ -232,6 +395,14 @@ const char *config_task_get_winc_image_filename(void) {
   }
 }
 
+const char *config_task_get_winc_image_region(void) {
+  if (s_config_task_ctx.winc_image_region[0] == '\0') {
+    return NULL;
+  } else {
+    return s_config_task_ctx.winc_image_region;
+  }
+}
+
 // *****************************************************************************
 // Local (private, static) code
 
@@ -257,18 +428,102 @@ static void on_match(mu_str_t *key, mu_str_t *val) {
               mu_str_ref_rd(val));
 
   if (match_cstring(key, "wifi_ssid")) {
-    mu_str_to_cstr(val, nv->wifi_ssid, MAX_CONFIG_VALUE_LENGTH);
+    // may appear multiple times: each one starts a new profile
+    int i = config_task_get_wifi_profile_count();
+    if (i < MAX_CONFIG_WIFI_PROFILES) {
+      mu_str_to_cstr(val, nv->wifi_profiles[i].ssid, MAX_CONFIG_VALUE_LENGTH);
+      s_config_task_ctx.wifi_profile = i;
+    } else {
+      s_config_task_ctx.wifi_profile = -1;
+      YB_LOG_WARN("Ignoring wifi_ssid beyond the first %d",
+                  MAX_CONFIG_WIFI_PROFILES);
+    }
   } else if (match_cstring(key, "wifi_pass")) {
-    mu_str_to_cstr(val, nv->wifi_pass, MAX_CONFIG_VALUE_LENGTH);
+    // belongs to the most recent wifi_ssid
+    int i = s_config_task_ctx.wifi_profile;
+    if (i >= 0) {
+      mu_str_to_cstr(val, nv->wifi_profiles[i].pass, MAX_CONFIG_VALUE_LENGTH);
+    } else {
+      YB_LOG_WARN("Ignoring wifi_pass without a preceding wifi_ssid");
+    }
   } else if (match_cstring(key, "wake_interval_ms")) {
     nv->wake_interval_ms = mu_str_to_float(val);
   } else if (match_cstring(key, "timeout_ms")) {
     nv->timeout_ms = mu_str_to_float(val);
+  } else if (match_cstring(key, "probe_endpoint")) {
+    // may appear multiple times: each one fills the next free slot
+    int i = config_task_get_probe_endpoint_count();
+    if (i < MAX_CONFIG_PROBE_ENDPOINTS) {
+      mu_str_to_cstr(val, nv->probe_endpoints[i], MAX_CONFIG_VALUE_LENGTH);
+    } else {
+      YB_LOG_WARN("Ignoring probe_endpoint beyond the first %d",
+                  MAX_CONFIG_PROBE_ENDPOINTS);
+    }
+  } else if (match_cstring(key, "ping_host")) {
+    mu_str_to_cstr(val, nv->ping_host, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "ping_count")) {
+    float count = mu_str_to_float(val);
+    nv->ping_count = (count < 0) ? 0 : (count > UINT8_MAX) ? UINT8_MAX : count;
+  } else if (match_cstring(key, "bench_host")) {
+    mu_str_to_cstr(val, nv->bench_host, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "bench_port")) {
+    nv->bench_port = mu_str_to_float(val);
+  } else if (match_cstring(key, "bench_up_bytes")) {
+    nv->bench_up_bytes = mu_str_to_float(val);
+  } else if (match_cstring(key, "bench_down_bytes")) {
+    nv->bench_down_bytes = mu_str_to_float(val);
+  } else if (match_cstring(key, "udp_host")) {
+    mu_str_to_cstr(val, nv->udp_host, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "udp_port")) {
+    nv->udp_port = mu_str_to_float(val);
+  } else if (match_cstring(key, "udp_key")) {
+    mu_str_to_cstr(val, nv->udp_key, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "survey_every")) {
+    float every = mu_str_to_float(val);
+    nv->survey_every = (every < 0)           ? 0
+                       : (every > UINT8_MAX) ? UINT8_MAX
+                                             : every;
+  } else if (match_cstring(key, "survey_passive")) {
+    nv->survey_passive = mu_str_to_float(val) != 0;
+  } else if (match_cstring(key, "survey_channels")) {
+    nv->survey_channels = mu_str_to_channel_mask(val);
+  } else if (match_cstring(key, "winc_power")) {
+    mu_str_to_cstr(val, nv->winc_power, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "winc_park_ms")) {
+    nv->winc_park_ms = mu_str_to_float(val);
+  } else if (match_cstring(key, "sntp_server")) {
+    mu_str_to_cstr(val, nv->sntp_server, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "winc_spi_crc")) {
+    mu_str_to_cstr(val, nv->winc_spi_crc, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "download_path")) {
+    // like winc_image_filename, the download_* params are only used at cold
+    // boot (while the SD card is mounted) so are not stored in nv ram
+    mu_str_to_cstr(
+        val, s_config_task_ctx.download_path, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "download_file")) {
+    mu_str_to_cstr(
+        val, s_config_task_ctx.download_file, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "download_length")) {
+    s_config_task_ctx.download_length = mu_str_to_float(val);
+  } else if (match_cstring(key, "download_sha256")) {
+    s_config_task_ctx.download_sha256_len =
+        mu_str_to_hex(val,
+                      s_config_task_ctx.download_sha256,
+                      MAX_CONFIG_DOWNLOAD_HASH_SIZE);
+  } else if (match_cstring(key, "upload_path")) {
+    // upload_* params are also only used at cold boot
+    mu_str_to_cstr(val, s_config_task_ctx.upload_path, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "upload_file")) {
+    mu_str_to_cstr(val, s_config_task_ctx.upload_file, MAX_CONFIG_VALUE_LENGTH);
   } else if (match_cstring(key, "winc_image_filename")) {
     // unlike the other config params, winc_image_filename is not stored in nv
     // ram since it is only used once at cold boot
     mu_str_to_cstr(
         val, s_config_task_ctx.winc_image_filename, MAX_CONFIG_VALUE_LENGTH);
+  } else if (match_cstring(key, "winc_image_region")) {
+    // likewise only used at cold boot, by the imager
+    mu_str_to_cstr(
+        val, s_config_task_ctx.winc_image_region, MAX_CONFIG_VALUE_LENGTH);
   } else {
       printf("unrecognized key '%*s'", 
               mu_str_available_rd(key), 
@@ -295,3 +550,41 @@ static float mu_str_to_float(mu_str_t *mu_str) {
   sscanf((const char *)mu_str_ref_rd(mu_str), fmt, &val);
   return val;
 }
+
+static size_t mu_str_to_hex(mu_str_t *mu_str, uint8_t *buf, size_t max_len) {
+  const char *s = (const char *)mu_str_ref_rd(mu_str);
+  size_t n_digits = mu_str_available_rd(mu_str);
+  size_t n = 0;
+
+  for (size_t i = 0; i + 1 < n_digits && n < max_len; i += 2) {
+    char hex[3] = {s[i], s[i + 1], '\0'};
+    char *end;
+    unsigned long byte = strtoul(hex, &end, 16);
+    if (*end != '\0') {
+      YB_LOG_WARN("Ignoring malformed hex value '%*s'", n_digits, s);
+      return 0;
+    }
+    buf[n++] = (uint8_t)byte;
+  }
+  return n;
+}
+
+static uint16_t mu_str_to_channel_mask(mu_str_t *mu_str) {
+  const char *s = (const char *)mu_str_ref_rd(mu_str);
+  size_t len = mu_str_available_rd(mu_str);
+  uint16_t mask = 0;
+  int channel = 0;
+
+  for (size_t i = 0; i <= len; i++) {
+    if (i < len && s[i] >= '0' && s[i] <= '9') {
+      channel = channel * 10 + (s[i] - '0');
+    } else if (channel >= 1 && channel <= 14) {
+      mask |= 1 << (channel - 1);
+      channel = 0;
+    } else if (channel != 0) {
+      YB_LOG_WARN("Ignoring channel %d", channel);
+      channel = 0;
+    }
+  }
+  return mask;
+}
@@ -33,6 +33,7 @@
 
 #include "yb_rtc.h"
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 // =============================================================================
@@ -49,6 +50,23 @@ extern "C" {
 #define MAX_CONFIG_VALUE_LENGTH 40
 #define MAX_CONFIG_LINE_LENGTH (MAX_CONFIG_KEY_LENGTH + MAX_CONFIG_VALUE_LENGTH)
 
+// Number of wifi_ssid / wifi_pass pairs that may be configured.
+#define MAX_CONFIG_WIFI_PROFILES 4
+
+// Matches the number of TCP sockets the WINC can hold open at once.
+#define MAX_CONFIG_PROBE_ENDPOINTS 7
+
+// A SHA-256 prefix: 32 hex digits fit within MAX_CONFIG_VALUE_LENGTH.
+#define MAX_CONFIG_DOWNLOAD_HASH_SIZE 16
+
+/**
+ * @brief One set of wifi credentials.
+ */
+typedef struct {
+  char ssid[MAX_CONFIG_VALUE_LENGTH];
+  char pass[MAX_CONFIG_VALUE_LENGTH];
+} config_task_wifi_profile_t;
+
 /**
  * @brief Results of parsing the config.txt file are stored here.
  *
@@ -56,10 +74,37 @@ extern "C" {
  * across reboots.
  */
 typedef struct {
-  char wifi_ssid[MAX_CONFIG_VALUE_LENGTH];
-  char wifi_pass[MAX_CONFIG_VALUE_LENGTH];
+  // wifi credentials in config.txt order, empty ssid unused
+  config_task_wifi_profile_t wifi_profiles[MAX_CONFIG_WIFI_PROFILES];
   yb_rtc_ms_t wake_interval_ms;
   yb_rtc_ms_t timeout_ms;
+  // "host:port" endpoints for the connectivity probe, empty strings unused
+  char probe_endpoints[MAX_CONFIG_PROBE_ENDPOINTS][MAX_CONFIG_VALUE_LENGTH];
+  // host to ping after the gateway, empty string to ping only the gateway
+  char ping_host[MAX_CONFIG_VALUE_LENGTH];
+  // # of echo requests per ping target, 0 disables the ping burst
+  uint8_t ping_count;
+  // cooperating endpoint for the throughput benchmark, empty string disables
+  char bench_host[MAX_CONFIG_VALUE_LENGTH];
+  uint16_t bench_port;
+  uint32_t bench_up_bytes;
+  uint32_t bench_down_bytes;
+  // server for the UDP report path, empty string to report over HTTP
+  char udp_host[MAX_CONFIG_VALUE_LENGTH];
+  uint16_t udp_port;
+  char udp_key[MAX_CONFIG_VALUE_LENGTH]; // HMAC shared secret
+  // run the site survey every survey_every wakes, 0 disables it
+  uint8_t survey_every;
+  bool survey_passive;
+  uint16_t survey_channels; // bit n-1 set to scan channel n, 0 = all
+  // WINC power profile name, or "cycle"; empty string for the default
+  char winc_power[MAX_CONFIG_VALUE_LENGTH];
+  // park the WINC if wake_interval_ms is no longer than this, 0 = never
+  yb_rtc_ms_t winc_park_ms;
+  // SNTP server for the WINC's clock, empty string for the WINC's default
+  char sntp_server[MAX_CONFIG_VALUE_LENGTH];
+  // WINC SPI CRC checking: "on", "off" or "auto"; empty string for off
+  char winc_spi_crc[MAX_CONFIG_VALUE_LENGTH];
 } config_task_nv_data_t;
 
 // *****************************************************************************
@@ -87,9 +132,20 @@ bool config_task_failed(void);
  */
 void config_task_shutdown(void);
 
-const char *config_task_get_wifi_ssid(void);
+/**
+ * @brief Return the number of wifi_ssid entries read from config.txt.
+ */
+int config_task_get_wifi_profile_count(void);
 
-const char *config_task_get_wifi_pass(void);
+/**
+ * @brief Return the SSID of the i'th wifi profile.
+ */
+const char *config_task_get_wifi_ssid(int i);
+
+/**
+ * @brief Return the password of the i'th wifi profile.
+ */
+const char *config_task_get_wifi_pass(int i);
 
 yb_rtc_ms_t config_task_get_wake_interval_ms(void);
 
@@ -97,6 +153,111 @@ yb_rtc_ms_t config_task_get_timeout_ms(void);
 
 const char *config_task_get_winc_image_filename(void);
 
+/**
+ * @brief Return the WINC flash region named by winc_image_region, or NULL.
+ */
+const char *config_task_get_winc_image_region(void);
+
+/**
+ * @brief Return the download_path (on APP_HOST_NAME) to fetch at cold boot, or
+ * NULL if none.
+ */
+const char *config_task_get_download_path(void);
+
+/**
+ * @brief Return the SD card file to store the download in, or NULL if none.
+ */
+const char *config_task_get_download_file(void);
+
+/**
+ * @brief Return the required download length, 0 if not specified.
+ */
+uint32_t config_task_get_download_length(void);
+
+/**
+ * @brief Set *hash to the required leading bytes of the download's SHA-256
+ * and return how many there are (0 if not specified).
+ */
+size_t config_task_get_download_sha256(const uint8_t **hash);
+
+/**
+ * @brief Return the upload_path (on APP_HOST_NAME) to POST to at cold boot, or
+ * NULL if none.
+ */
+const char *config_task_get_upload_path(void);
+
+/**
+ * @brief Return the SD card file to upload, or NULL if none.
+ */
+const char *config_task_get_upload_file(void);
+
+/**
+ * @brief Return the number of probe_endpoint entries read from config.txt.
+ */
+int config_task_get_probe_endpoint_count(void);
+
+/**
+ * @brief Return the i'th probe endpoint as a "host:port" string.
+ */
+const char *config_task_get_probe_endpoint(int i);
+
+/**
+ * @brief Return the ping_host read from config.txt, or NULL if none.
+ */
+const char *config_task_get_ping_host(void);
+
+/**
+ * @brief Return the number of echo requests to send to each ping target.
+ */
+uint8_t config_task_get_ping_count(void);
+
+/**
+ * @brief Return the bench_host read from config.txt, or NULL if none.
+ */
+const char *config_task_get_bench_host(void);
+
+uint16_t config_task_get_bench_port(void);
+
+uint32_t config_task_get_bench_up_bytes(void);
+
+uint32_t config_task_get_bench_down_bytes(void);
+
+/**
+ * @brief Return the udp_host read from config.txt, or NULL if none.
+ */
+const char *config_task_get_udp_host(void);
+
+uint16_t config_task_get_udp_port(void);
+
+const char *config_task_get_udp_key(void);
+
+uint8_t config_task_get_survey_every(void);
+
+bool config_task_get_survey_passive(void);
+
+/**
+ * @brief Return the survey_channels read from config.txt as a
+ * WDRV_WINC_CHANNEL_MASK, or 0 if not specified.
+ */
+uint16_t config_task_get_survey_channels(void);
+
+/**
+ * @brief Return the winc_power read from config.txt, or NULL if none.
+ */
+const char *config_task_get_winc_power(void);
+
+yb_rtc_ms_t config_task_get_winc_park_ms(void);
+
+/**
+ * @brief Return the sntp_server read from config.txt, or NULL if none.
+ */
+const char *config_task_get_sntp_server(void);
+
+/**
+ * @brief Return the winc_spi_crc read from config.txt, or NULL if none.
+ */
+const char *config_task_get_winc_spi_crc(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -33,25 +33,75 @@
 #include "definitions.h"
 #include "mu_str.h"
 #include "mu_strbuf.h"
+#include "nv_data.h"
 #include "wdrv_winc_client_api.h"
 #include "winc_task.h" // should be app.h
+#include "yb_hmac.h"
 #include "yb_log.h"
+#include "yb_rtc.h"
 #include <stdbool.h>
+#include <ctype.h>
 #include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 // *****************************************************************************
 // Local (private) types and definitions
 
+// The WINC does not report resumption directly, but skipping the key exchange
+// is unmistakably faster.  A handshake that could have resumed, and completes
+// in less than this percentage of the mean full handshake, counts as resumed.
+#define HTTP_TASK_TLS_RESUMED_PERCENT 50
+
+// Each full handshake moves the mean 1 / this of the way to its duration.
+#define HTTP_TASK_TLS_MEAN_WEIGHT 4
+
+// A cached DNS answer older than this fraction of its TTL is still used, but
+// a fresh lookup is started in the background to refresh it.
+#define HTTP_TASK_DNS_REFRESH_RATIO 0.5
+
+// Once the response has started, a gap this long with no further data ends the
+// exchange even if the server has not closed the connection.
+#define HTTP_TASK_RECV_IDLE_MS 500.0
+
+// Benchmark gaps between completions longer than this are counted as stalls:
+// the radio or the peer was not keeping the pipe full.
+#define HTTP_TASK_BENCH_STALL_MS 50.0
+
+// Benchmark gaps longer than the minimum TCP retransmission timeout suggest
+// that a segment was lost and retransmitted.
+#define HTTP_TASK_BENCH_RTO_MS 200.0
+
+// Largest payload the WINC accepts in a single send().
+#define HTTP_TASK_BENCH_CHUNK_SIZE SOCKET_BUFFER_MAX_LENGTH
+
+// A download that has received nothing for this long is treated as finished;
+// the length and hash checks then decide whether it was complete.
+#define HTTP_TASK_SINK_IDLE_MS 5000.0
+
+#define HTTP_TASK_SINK_SUFFIX ".part"
+
 #define HTTP_TASK_STATES(M)                                                    \
   M(HTTP_TASK_STATE_INIT)                                                      \
+  M(HTTP_TASK_STATE_CONFIGURE_TLS)                                             \
   M(HTTP_TASK_STATE_AWAIT_IP_LINK)                                             \
   M(HTTP_TASK_STATE_START_DNS)                                                 \
   M(HTTP_TASK_STATE_AWAIT_DNS)                                                 \
   M(HTTP_TASK_STATE_START_SOCKET)                                              \
   M(HTTP_TASK_STATE_AWAIT_SOCKET)                                              \
+  M(HTTP_TASK_STATE_AWAIT_SECURE)                                              \
   M(HTTP_TASK_STATE_START_SEND)                                                \
   M(HTTP_TASK_STATE_AWAIT_SEND)                                                \
+  M(HTTP_TASK_STATE_SOURCE_SEND)                                               \
   M(HTTP_TASK_STATE_AWAIT_RESPONSE)                                            \
+  M(HTTP_TASK_STATE_SINK_RECEIVE)                                              \
+  M(HTTP_TASK_STATE_SINK_FINISH)                                               \
+  M(HTTP_TASK_STATE_SINK_ABORT)                                                \
+  M(HTTP_TASK_STATE_BENCH_START)                                               \
+  M(HTTP_TASK_STATE_BENCH_UPLOAD)                                              \
+  M(HTTP_TASK_STATE_BENCH_DOWNLOAD)                                            \
+  M(HTTP_TASK_STATE_BENCH_REPORT)                                              \
   M(HTTP_TASK_STATE_SUCCESS)                                                   \
   M(HTTP_TASK_STATE_ERROR)
 
@@ -65,11 +115,74 @@ typedef struct {
   uint32_t host_ipv4;        // host address, used in preference to host_name
   uint16_t host_port;        // host port
   bool use_tls;              // set to true to use SSL/TLS
+  yb_rtc_ms_t dns_ttl_ms;    // lifetime of a DNS cache entry, 0 = no cache
+  bool host_from_cache;      // true if host_ipv4 came from the DNS cache
+  bool dns_pending;          // true while a gethostbyname() is outstanding
+  yb_rtc_tics_t dns_start_at; // time at which gethostbyname() was called
   mu_strbuf_t *request_msg;  // HTTP request (header and body)
   mu_strbuf_t *response_msg; // Buffer to hold response
   SOCKET client_socket;      // socket...
+  yb_rtc_tics_t started_at;  // time at which http_task_init() was called
+  yb_rtc_tics_t connect_at;  // time at which connect() was called
+  yb_rtc_tics_t secure_at;   // time at which secure() was called
+  yb_rtc_tics_t send_at;     // time at which send() was called
+  yb_rtc_tics_t first_recv_at; // time of the first SOCKET_MSG_RECV
+  yb_rtc_tics_t last_recv_at;  // time of the most recent SOCKET_MSG_RECV
+  yb_rtc_ms_t tls_handshake_ms; // duration of TLS handshake, 0 if none
+  bool tls_resumed;          // true if TLS handshake resumed a cached session
+  bool bench_mode;           // true if http_task_set_bench() was called
+  uint32_t bench_up_bytes;   // # of bytes to upload in benchmark mode
+  uint32_t bench_down_bytes; // # of bytes to download in benchmark mode
+  yb_rtc_ms_t bench_budget_ms; // time allowed for the benchmark transfer
+  bool bench_send_pending;   // true while a benchmark send() is outstanding
+  bool bench_header_sent;    // true once the YBBENCH line has been sent
+  yb_rtc_tics_t bench_start_at; // start of the current transfer direction
+  yb_rtc_tics_t bench_last_at;  // most recent send or receive completion
+  http_task_timing_t *timing; // phase timing record, lives in nv_data
 } http_task_ctx_t;
 
+/**
+ * @brief State of a response body being streamed to a file.  The WINC driver
+ * receives the body into a two block ring attached to the socket while step()
+ * hashes and writes completed blocks straight out of the ring.
+ */
+typedef struct {
+  bool active;             // true if http_task_set_sink() was called
+  char filename[HTTP_TASK_SINK_MAX_PATH];
+  char part_filename[HTTP_TASK_SINK_MAX_PATH + sizeof(HTTP_TASK_SINK_SUFFIX)];
+  uint32_t expected_len;   // required body length, 0 = Content-Length or none
+  uint8_t expected_hash[HTTP_TASK_SINK_HASH_SIZE];
+  size_t hash_len;         // # of bytes of expected_hash to check, 0 = none
+  SYS_FS_HANDLE file;      // the .part file
+  yb_sha256_t sha;         // running hash of the bytes written
+  size_t header_len;       // # of header bytes accumulated in response_msg
+  bool headers_done;       // true once the blank line has been seen
+  int32_t content_length;  // Content-Length header, -1 if absent
+  uint32_t received;       // # of body bytes received so far
+  bool eof;                // true once the body is complete or closed
+  bool failed;             // true if the response cannot be accepted
+  uint8_t ring[2 * HTTP_TASK_SINK_BLOCK_SIZE]; // see recv_ring_attach()
+} http_task_sink_ctx_t;
+
+/**
+ * @brief State of a request body being streamed from a file.  send() copies
+ * each chunk to the WINC, so one buffer suffices: the next chunk is read while
+ * the WINC transmits the previous ones.
+ */
+typedef struct {
+  bool active;             // true if http_task_set_source() was called
+  char filename[HTTP_TASK_SINK_MAX_PATH];
+  SYS_FS_HANDLE file;      // the file being uploaded
+  uint8_t in_flight;       // # of send() calls awaiting SOCKET_MSG_SEND
+  size_t chunk_len;        // # of bytes in chunk, 0 = chunk is free
+  bool eof;                // true once the whole file has been read
+  bool failed;             // true if a send did not complete
+  bool waiting;            // true while the window is blocking a ready chunk
+  yb_rtc_tics_t waiting_at; // time at which waiting became true
+  yb_rtc_tics_t start_at;  // time of the first body read
+  uint8_t chunk[HTTP_TASK_SOURCE_CHUNK_SIZE];
+} http_task_source_ctx_t;
+
 // *****************************************************************************
 // Local (private, static) forward declarations
 
@@ -82,15 +195,159 @@ static void http_task_socket_callback(SOCKET socket,
 
 static void http_task_resolver_cb(uint8_t *pu8DomainName, uint32_t u32ServerIP);
 
+/**
+ * @brief Register the resolver callback and start a DNS lookup on host_name.
+ * Returns false if the lookup could not be started.
+ */
+static bool http_task_start_dns(void);
+
+/**
+ * @brief Return the 32 bit FNV-1a hash of a null-terminated string.
+ */
+static uint32_t http_task_hash_name(const char *name);
+
+/**
+ * @brief Return the DNS cache entry for name, or NULL if there is none.
+ */
+static http_task_dns_entry_t *http_task_dns_cache_find(const char *name);
+
+/**
+ * @brief Return true if the DNS cache entry has not yet expired.
+ */
+static bool http_task_dns_entry_is_fresh(http_task_dns_entry_t *entry);
+
+/**
+ * @brief Store a DNS answer, replacing the entry for name or the oldest one.
+ */
+static void http_task_dns_cache_store(const char *name,
+                                      uint32_t ipv4,
+                                      yb_rtc_ms_t lookup_ms);
+
+/**
+ * @brief Set SNI, session caching and (optionally) X.509 bypass on a freshly
+ * opened TLS socket.  Returns NULL on success or a string citing the error.
+ */
+static const char *http_task_configure_tls_socket(SOCKET sock);
+
+/**
+ * @brief Record the duration of a completed TLS handshake and classify it as
+ * full or resumed.
+ *
+ * Only a handshake made since an earlier one, with no WINC reset in between,
+ * can resume: the session cache is in the WINC's RAM.
+ */
+static void http_task_record_tls_handshake(void);
+
+/**
+ * @brief Post a recv() into the response buffer.
+ */
+static void http_task_start_recv(void);
+
+/**
+ * @brief Finish the timing record at the last byte received and log it.
+ */
+static void http_task_finish_timing(void);
+
+/**
+ * @brief Handle SOCKET_MSG_RECV when streaming the body to a file.
+ */
+static void http_task_sink_on_recv(tstrSocketRecvMsg *recv_msg);
+
+/**
+ * @brief Find the end of the response headers in response_msg, check the
+ * status and Content-Length, move any body bytes to the start of the ring and
+ * attach it to the socket.  Returns false if the headers are not yet complete.
+ */
+static bool http_task_sink_parse_headers(void);
+
+/**
+ * @brief Mark the body complete once Content-Length bytes have arrived.
+ */
+static void http_task_sink_check_length(void);
+
+/**
+ * @brief Copy the ring's stall counters to nv_data.
+ */
+static void http_task_sink_record_ring(void);
+
+/**
+ * @brief Hash and write len bytes to the .part file.  Returns false on a
+ * short write.
+ */
+static bool http_task_sink_write(const uint8_t *data, size_t len);
+
+/**
+ * @brief Close the .part file, check its length and hash and rename it.
+ * Returns NULL on success or a string citing the error.
+ */
+static const char *http_task_sink_finish(void);
+
+/**
+ * @brief Read the next chunk of the source file, timing the read.  Returns
+ * false on a read error.
+ */
+static bool http_task_source_read(void);
+
+/**
+ * @brief send() the pending chunk if the window has room.  Returns true if the
+ * chunk was accepted.
+ */
+static bool http_task_source_send(void);
+
+/**
+ * @brief Start or stop charging elapsed time to radio_wait_ms.
+ */
+static void http_task_source_wait(bool waiting);
+
+/**
+ * @brief Close the source file and compute and log upload throughput.
+ */
+static void http_task_source_finish(void);
+
+/**
+ * @brief Issue the next benchmark send(): the YBBENCH line first, then filler
+ * until bench_up_bytes have been sent.
+ */
+static void http_task_bench_send(void);
+
+/**
+ * @brief Account for a completed benchmark send or receive of nbytes.
+ */
+static void http_task_bench_account(http_task_bench_dir_t *dir,
+                                    uint32_t nbytes);
+
+/**
+ * @brief Handle SOCKET_MSG_RECV in benchmark mode.
+ */
+static void http_task_bench_on_recv(tstrSocketRecvMsg *recv_msg);
+
+/**
+ * @brief Compute goodput for each direction and log the benchmark results.
+ */
+static void http_task_bench_report(void);
+
 // *****************************************************************************
 // Local (private, static) storage
 
 static http_task_ctx_t s_http_task_ctx;
 
+static http_task_sink_ctx_t s_http_task_sink;
+
+static http_task_source_ctx_t s_http_task_source;
+
 #define EXPAND_TASK_STATE_NAME(_name) #_name,
 static const char *s_http_task_state_names[] = {
     HTTP_TASK_STATES(EXPAND_TASK_STATE_NAME)};
 
+// Cheapest acceptable cipher suites for the WINC1500.  Static RSA key exchange
+// costs one public key operation on the client, where DHE and ECDHE require
+// the WINC to compute an ephemeral key pair on every full handshake.
+static uint16_t s_tls_cipher_suites[] = {
+    WDRV_WINC_TLS_RSA_WITH_AES_128_CBC_SHA,
+    WDRV_WINC_TLS_RSA_WITH_AES_128_CBC_SHA256,
+    WDRV_WINC_TLS_RSA_WITH_AES_128_GCM_SHA256,
+};
+
 // *****************************************************************************
 // Public code
 
@@ -99,6 +356,7 @@ void http_task_init(DRV_HANDLE winc_handle,
                     const char *host_ipv4,
                     uint16_t host_port,
                     bool use_tls,
+                    yb_rtc_ms_t dns_ttl_ms,
                     mu_strbuf_t *request_msg,
                     mu_strbuf_t *response_msg) {
   http_task_ctx_t *p = &s_http_task_ctx; // typing avoidance
@@ -107,20 +365,102 @@ void http_task_init(DRV_HANDLE winc_handle,
   p->host_ipv4 = (host_ipv4 == NULL) ? 0 : inet_addr(host_ipv4);
   p->host_port = host_port;
   p->use_tls = use_tls;
+  p->dns_ttl_ms = dns_ttl_ms;
+  p->host_from_cache = false;
+  p->dns_pending = false;
   p->request_msg = request_msg;
   p->response_msg = response_msg;
   p->client_socket = -1;
+  p->tls_handshake_ms = 0;
+  p->tls_resumed = false;
   p->state = HTTP_TASK_STATE_INIT;
+  p->started_at = yb_rtc_now();
+  p->bench_mode = false;
+  s_http_task_sink.active = false;
+  s_http_task_source.active = false;
+  p->timing = &nv_data()->http_task_nv_data.timing;
 
   socketInit();
   WDRV_WINC_SocketRegisterEventCallback(winc_handle, http_task_socket_callback);
 }
 
+void http_task_set_bench(uint32_t up_bytes,
+                         uint32_t down_bytes,
+                         yb_rtc_ms_t budget_ms) {
+  s_http_task_ctx.bench_mode = true;
+  s_http_task_ctx.bench_up_bytes = up_bytes;
+  s_http_task_ctx.bench_down_bytes = down_bytes;
+  s_http_task_ctx.bench_budget_ms = budget_ms;
+  memset(&nv_data()->http_task_nv_data.bench, 0, sizeof(http_task_bench_t));
+  // Connection setup to the benchmark server is timed in the bench record.
+  s_http_task_ctx.timing = &nv_data()->http_task_nv_data.bench.timing;
+}
+
+void http_task_set_sink(const char *filename,
+                        uint32_t expected_len,
+                        const uint8_t *expected_hash,
+                        size_t hash_len) {
+  http_task_sink_ctx_t *sink = &s_http_task_sink;
+
+  memset(&nv_data()->http_task_nv_data.sink, 0, sizeof(http_task_sink_t));
+  sink->active = true;
+  strncpy(sink->filename, filename, sizeof(sink->filename) - 1);
+  sink->filename[sizeof(sink->filename) - 1] = '\0';
+  snprintf(sink->part_filename,
+           sizeof(sink->part_filename),
+           "%s%s",
+           sink->filename,
+           HTTP_TASK_SINK_SUFFIX);
+  sink->expected_len = expected_len;
+  sink->hash_len = (expected_hash == NULL) ? 0 : hash_len;
+  if (sink->hash_len > HTTP_TASK_SINK_HASH_SIZE) {
+    sink->hash_len = HTTP_TASK_SINK_HASH_SIZE;
+  }
+  memcpy(sink->expected_hash, expected_hash, sink->hash_len);
+  sink->file = SYS_FS_HANDLE_INVALID;
+}
+
+void http_task_set_source(const char *filename) {
+  http_task_source_ctx_t *source = &s_http_task_source;
+
+  memset(&nv_data()->http_task_nv_data.source, 0, sizeof(http_task_source_t));
+  source->active = true;
+  strncpy(source->filename, filename, sizeof(source->filename) - 1);
+  source->filename[sizeof(source->filename) - 1] = '\0';
+  source->file = SYS_FS_HANDLE_INVALID;
+}
+
 void http_task_step(void) {
   switch (s_http_task_ctx.state) {
 
   case HTTP_TASK_STATE_INIT: {
-    http_task_set_state(HTTP_TASK_STATE_AWAIT_IP_LINK);
+    // Cleared here rather than in http_task_init() so that benchmark mode can
+    // redirect the record without disturbing the preceding request's timing.
+    memset(s_http_task_ctx.timing, 0, sizeof(http_task_timing_t));
+    if (s_http_task_ctx.use_tls) {
+      http_task_set_state(HTTP_TASK_STATE_CONFIGURE_TLS);
+    } else {
+      http_task_set_state(HTTP_TASK_STATE_AWAIT_IP_LINK);
+    }
+  } break;
+
+  case HTTP_TASK_STATE_CONFIGURE_TLS: {
+    WDRV_WINC_CIPHER_SUITE_CONTEXT cipher_suites;
+    if (WDRV_WINC_STATUS_OK !=
+        WDRV_WINC_SSLCTXCipherSuitesSet(&cipher_suites,
+                                        s_tls_cipher_suites,
+                                        sizeof(s_tls_cipher_suites) /
+                                            sizeof(s_tls_cipher_suites[0]))) {
+      YB_LOG_ERROR("WDRV_WINC_SSLCTXCipherSuitesSet() failed");
+      http_task_set_state(HTTP_TASK_STATE_ERROR);
+    } else if (WDRV_WINC_STATUS_OK !=
+               WDRV_WINC_SSLActiveCipherSuitesSet(
+                   s_http_task_ctx.winc_handle, &cipher_suites, NULL)) {
+      YB_LOG_ERROR("WDRV_WINC_SSLActiveCipherSuitesSet() failed");
+      http_task_set_state(HTTP_TASK_STATE_ERROR);
+    } else {
+      http_task_set_state(HTTP_TASK_STATE_AWAIT_IP_LINK);
+    }
   } break;
 
   case HTTP_TASK_STATE_AWAIT_IP_LINK: {
@@ -136,12 +476,37 @@ void http_task_step(void) {
   } break;
 
   case HTTP_TASK_STATE_START_DNS: {
-    if (WDRV_WINC_STATUS_OK !=
-        WDRV_WINC_SocketRegisterResolverCallback(s_http_task_ctx.winc_handle,
-                                                 http_task_resolver_cb)) {
+    http_task_nv_data_t *nv = &nv_data()->http_task_nv_data;
+    http_task_dns_entry_t *entry =
+        http_task_dns_cache_find(s_http_task_ctx.host_name);
+
+    if (s_http_task_ctx.dns_ttl_ms > 0 && !s_http_task_ctx.host_from_cache &&
+        entry != NULL && http_task_dns_entry_is_fresh(entry)) {
+      // Use the cached answer and bypass the resolver.
+      char s[20];
+      YB_LOG_INFO("%s cached as %s",
+                  s_http_task_ctx.host_name,
+                  inet_ntop(AF_INET, &entry->ipv4, s, sizeof(s)));
+      s_http_task_ctx.host_ipv4 = entry->ipv4;
+      s_http_task_ctx.host_from_cache = true;
+      nv->dns_hit_count += 1;
+      nv->dns_saved_ms += entry->lookup_ms;
+      YB_LOG_INFO("DNS cache hits / lookups = %ld / %ld, %d ms saved",
+                  nv->dns_hit_count,
+                  nv->dns_hit_count + nv->dns_miss_count,
+                  (int)nv->dns_saved_ms);
+      if (yb_rtc_elapsed_ms(entry->resolved_at) >
+          s_http_task_ctx.dns_ttl_ms * HTTP_TASK_DNS_REFRESH_RATIO) {
+        // Getting old: refresh in the background while we connect.
+        http_task_start_dns();
+      }
+      http_task_set_state(HTTP_TASK_STATE_START_SOCKET);
+    } else if (!http_task_start_dns()) {
       http_task_set_state(HTTP_TASK_STATE_ERROR);
     } else {
-      gethostbyname((const char *)s_http_task_ctx.host_name);
+      // Cache miss, cache disabled or cached address failed to connect.
+      s_http_task_ctx.host_from_cache = false;
+      nv->dns_miss_count += 1;
       http_task_set_state(HTTP_TASK_STATE_AWAIT_DNS);
     }
   } break;
@@ -153,18 +518,28 @@ void http_task_step(void) {
   case HTTP_TASK_STATE_START_SOCKET: {
     const char *err = NULL;
     do {
-      uint8_t flags = s_http_task_ctx.use_tls ? SOCKET_CONFIG_SSL_ON : 0;
+      // TLS is started explicitly with secure() once TCP connects, so that the
+      // TCP and TLS handshakes can be timed separately.
+      uint8_t flags = s_http_task_ctx.use_tls ? SOCKET_CONFIG_SSL_DELAY : 0;
       s_http_task_ctx.client_socket = socket(AF_INET, SOCK_STREAM, flags);
       if (s_http_task_ctx.client_socket < 0) {
         err = "Unable to open a socket";
         break;
       }
 
+      if (s_http_task_ctx.use_tls) {
+        err = http_task_configure_tls_socket(s_http_task_ctx.client_socket);
+        if (err != NULL) {
+          break;
+        }
+      }
+
       struct sockaddr_in addr;
       addr.sin_family = AF_INET;
       addr.sin_port = _htons(s_http_task_ctx.host_port);
       addr.sin_addr.s_addr = s_http_task_ctx.host_ipv4;
 
+      s_http_task_ctx.connect_at = yb_rtc_now();
       if (connect(s_http_task_ctx.client_socket,
                   (struct sockaddr *)&addr,
                   sizeof(struct sockaddr_in)) < 0) {
@@ -187,11 +562,52 @@ void http_task_step(void) {
     // remain here until http_task_socket_callback() advances state
   } break;
 
+  case HTTP_TASK_STATE_AWAIT_SECURE: {
+    // remain here until http_task_socket_callback() advances state
+  } break;
+
   case HTTP_TASK_STATE_START_SEND: {
-    recv(s_http_task_ctx.client_socket,
-         mu_strbuf_wdata(s_http_task_ctx.response_msg),
-         mu_strbuf_capacity(s_http_task_ctx.response_msg),
-         0);
+    if (s_http_task_ctx.bench_mode) {
+      http_task_set_state(HTTP_TASK_STATE_BENCH_START);
+      break;
+    }
+    if (s_http_task_sink.active) {
+      http_task_sink_ctx_t *sink = &s_http_task_sink;
+      sink->file = SYS_FS_FileOpen(sink->part_filename, SYS_FS_FILE_OPEN_WRITE);
+      if (sink->file == SYS_FS_HANDLE_INVALID) {
+        YB_LOG_ERROR("Unable to create %s, error %d",
+                     sink->part_filename,
+                     SYS_FS_Error());
+        http_task_set_state(HTTP_TASK_STATE_ERROR);
+        break;
+      }
+      yb_sha256_init(&sink->sha);
+      sink->header_len = 0;
+      sink->headers_done = false;
+      sink->content_length = -1;
+      sink->received = 0;
+      sink->eof = false;
+      sink->failed = false;
+    }
+    if (s_http_task_source.active) {
+      http_task_source_ctx_t *source = &s_http_task_source;
+      source->file = SYS_FS_FileOpen(source->filename, SYS_FS_FILE_OPEN_READ);
+      if (source->file == SYS_FS_HANDLE_INVALID) {
+        YB_LOG_ERROR("Unable to open %s, error %d",
+                     source->filename,
+                     SYS_FS_Error());
+        http_task_set_state(HTTP_TASK_STATE_ERROR);
+        break;
+      }
+      source->in_flight = 1; // the request headers
+      source->chunk_len = 0;
+      source->eof = false;
+      source->failed = false;
+      source->waiting = false;
+      source->start_at = yb_rtc_now();
+    }
+    http_task_start_recv();
+    s_http_task_ctx.send_at = yb_rtc_now();
     send(s_http_task_ctx.client_socket,
          (void *)mu_strbuf_rdata(s_http_task_ctx.request_msg),
          mu_strbuf_capacity(s_http_task_ctx.request_msg),
@@ -199,7 +615,38 @@ void http_task_step(void) {
     YB_LOG_INFO("Sending\n==>>>\n%*s==>>>",
                 mu_strbuf_capacity(s_http_task_ctx.request_msg),
                 mu_strbuf_rdata(s_http_task_ctx.request_msg));
-    http_task_set_state(HTTP_TASK_STATE_AWAIT_SEND);
+    if (s_http_task_source.active) {
+      http_task_set_state(HTTP_TASK_STATE_SOURCE_SEND);
+    } else {
+      http_task_set_state(HTTP_TASK_STATE_AWAIT_SEND);
+    }
+  } break;
+
+  case HTTP_TASK_STATE_SOURCE_SEND: {
+    // Each pass either reads the next chunk from the SD card or hands it to
+    // the WINC.  http_task_socket_callback() opens the window as sends finish.
+    http_task_source_ctx_t *source = &s_http_task_source;
+    if (source->failed) {
+      http_task_source_finish();
+      http_task_set_state(HTTP_TASK_STATE_ERROR);
+    } else if (source->chunk_len == 0 && !source->eof) {
+      if (!http_task_source_read()) {
+        http_task_source_finish();
+        http_task_set_state(HTTP_TASK_STATE_ERROR);
+      }
+    } else if (source->chunk_len > 0) {
+      http_task_source_wait(!http_task_source_send());
+    } else if (source->in_flight > 0) {
+      // the file has been read: wait for the last sends to drain
+      http_task_source_wait(true);
+    } else {
+      http_task_source_wait(false);
+      http_task_source_finish();
+      s_http_task_ctx.timing->send_ms =
+          yb_rtc_elapsed_ms(s_http_task_ctx.send_at);
+      winc_task_set_idle(true);
+      http_task_set_state(HTTP_TASK_STATE_AWAIT_RESPONSE);
+    }
   } break;
 
   case HTTP_TASK_STATE_AWAIT_SEND: {
@@ -207,7 +654,112 @@ void http_task_step(void) {
   } break;
 
   case HTTP_TASK_STATE_AWAIT_RESPONSE: {
-    // remain here until http_task_socket_callback() advances state
+    // http_task_socket_callback() advances state when the server closes the
+    // connection.  Servers that hold it open are cut off after an idle gap.
+    if (s_http_task_ctx.timing->rx_bytes > 0 &&
+        yb_rtc_elapsed_ms(s_http_task_ctx.last_recv_at) >
+            HTTP_TASK_RECV_IDLE_MS) {
+      http_task_finish_timing();
+      http_task_set_state(HTTP_TASK_STATE_SUCCESS);
+    }
+  } break;
+
+  case HTTP_TASK_STATE_SINK_RECEIVE: {
+    // The WINC driver fills the ring; here whole blocks are written to the SD
+    // card while it receives into the rest.  Blocks are only ever consumed
+    // whole, so a full block never wraps around the end of the ring.
+    http_task_sink_ctx_t *sink = &s_http_task_sink;
+    uint8_t *data = NULL;
+    uint16_t len = sink->headers_done
+                       ? recv_ring_peek(s_http_task_ctx.client_socket, &data)
+                       : 0;
+    if (sink->failed) {
+      http_task_set_state(HTTP_TASK_STATE_SINK_ABORT);
+    } else if (len >= HTTP_TASK_SINK_BLOCK_SIZE) {
+      if (!http_task_sink_write(data, HTTP_TASK_SINK_BLOCK_SIZE)) {
+        http_task_set_state(HTTP_TASK_STATE_SINK_ABORT);
+        break;
+      }
+      recv_ring_consume(s_http_task_ctx.client_socket,
+                        HTTP_TASK_SINK_BLOCK_SIZE);
+    } else if (sink->eof) {
+      http_task_set_state(HTTP_TASK_STATE_SINK_FINISH);
+    } else if (yb_rtc_elapsed_ms(s_http_task_ctx.last_recv_at) >
+               HTTP_TASK_SINK_IDLE_MS) {
+      YB_LOG_WARN("Download idle for %d ms", (int)HTTP_TASK_SINK_IDLE_MS);
+      sink->eof = true;
+    } else {
+      // remain in this state while the body arrives
+    }
+  } break;
+
+  case HTTP_TASK_STATE_SINK_FINISH: {
+    const char *err = http_task_sink_finish();
+    if (err != NULL) {
+      YB_LOG_ERROR("%s", err);
+      http_task_set_state(HTTP_TASK_STATE_SINK_ABORT);
+    } else {
+      http_task_finish_timing();
+      http_task_set_state(HTTP_TASK_STATE_SUCCESS);
+    }
+  } break;
+
+  case HTTP_TASK_STATE_SINK_ABORT: {
+    // Never leave a partial download where it could be mistaken for a good one.
+    if (s_http_task_sink.file != SYS_FS_HANDLE_INVALID) {
+      SYS_FS_FileClose(s_http_task_sink.file);
+      s_http_task_sink.file = SYS_FS_HANDLE_INVALID;
+    }
+    SYS_FS_FileDirectoryRemove(s_http_task_sink.part_filename);
+    http_task_set_state(HTTP_TASK_STATE_ERROR);
+  } break;
+
+  case HTTP_TASK_STATE_BENCH_START: {
+    s_http_task_ctx.bench_send_pending = false;
+    s_http_task_ctx.bench_header_sent = false;
+    s_http_task_ctx.bench_start_at = yb_rtc_now();
+    s_http_task_ctx.bench_last_at = s_http_task_ctx.bench_start_at;
+    http_task_bench_send();
+    http_task_set_state(HTTP_TASK_STATE_BENCH_UPLOAD);
+  } break;
+
+  case HTTP_TASK_STATE_BENCH_UPLOAD: {
+    // http_task_socket_callback() clears bench_send_pending on SOCKET_MSG_SEND
+    // so that exactly one send() is outstanding at a time.
+    http_task_bench_t *bench = &nv_data()->http_task_nv_data.bench;
+    if (yb_rtc_elapsed_ms(s_http_task_ctx.bench_start_at) >
+        s_http_task_ctx.bench_budget_ms) {
+      YB_LOG_WARN("Benchmark upload exceeded budget");
+      http_task_set_state(HTTP_TASK_STATE_BENCH_REPORT);
+    } else if (s_http_task_ctx.bench_send_pending) {
+      // remain in this state until the send completes
+    } else if (bench->up.bytes < s_http_task_ctx.bench_up_bytes) {
+      http_task_bench_send();
+    } else if (s_http_task_ctx.bench_down_bytes == 0) {
+      http_task_set_state(HTTP_TASK_STATE_BENCH_REPORT);
+    } else {
+      // Download time runs from the end of the upload, so includes one round
+      // trip for the server to start sending.
+      s_http_task_ctx.bench_start_at = yb_rtc_now();
+      s_http_task_ctx.bench_last_at = s_http_task_ctx.bench_start_at;
+      http_task_start_recv();
+      http_task_set_state(HTTP_TASK_STATE_BENCH_DOWNLOAD);
+    }
+  } break;
+
+  case HTTP_TASK_STATE_BENCH_DOWNLOAD: {
+    // http_task_bench_on_recv() advances state when the download completes.
+    if (yb_rtc_elapsed_ms(s_http_task_ctx.bench_start_at) >
+        s_http_task_ctx.bench_budget_ms) {
+      YB_LOG_WARN("Benchmark download exceeded budget");
+      http_task_set_state(HTTP_TASK_STATE_BENCH_REPORT);
+    }
+  } break;
+
+  case HTTP_TASK_STATE_BENCH_REPORT: {
+    http_task_bench_report();
+    http_task_shutdown();
+    http_task_set_state(HTTP_TASK_STATE_SUCCESS);
   } break;
 
   case HTTP_TASK_STATE_SUCCESS: {
@@ -234,6 +786,71 @@ void http_task_shutdown(void) {
     shutdown(s_http_task_ctx.client_socket);
     s_http_task_ctx.client_socket = -1;
   }
+  if (s_http_task_sink.active &&
+      s_http_task_sink.file != SYS_FS_HANDLE_INVALID) {
+    // interrupted mid-download
+    SYS_FS_FileClose(s_http_task_sink.file);
+    s_http_task_sink.file = SYS_FS_HANDLE_INVALID;
+    SYS_FS_FileDirectoryRemove(s_http_task_sink.part_filename);
+  }
+  if (s_http_task_source.active &&
+      s_http_task_source.file != SYS_FS_HANDLE_INVALID) {
+    // interrupted mid-upload
+    SYS_FS_FileClose(s_http_task_source.file);
+    s_http_task_source.file = SYS_FS_HANDLE_INVALID;
+  }
+}
+
+yb_rtc_ms_t http_task_get_tls_handshake_ms(void) {
+  return s_http_task_ctx.tls_handshake_ms;
+}
+
+bool http_task_tls_was_resumed(void) { return s_http_task_ctx.tls_resumed; }
+
+void http_task_forget_tls_session(void) {
+  nv_data()->http_task_nv_data.tls_session_cached = false;
+}
+
+const http_task_timing_t *http_task_get_timing(void) {
+  return &nv_data()->http_task_nv_data.timing;
+}
+
+size_t http_task_encode_timing(uint8_t *buf, size_t size) {
+  const http_task_timing_t *timing = http_task_get_timing();
+  yb_rtc_ms_t times[] = {timing->dns_ms,
+                         timing->connect_ms,
+                         timing->tls_ms,
+                         timing->send_ms,
+                         timing->ttfb_ms,
+                         timing->transfer_ms,
+                         timing->total_ms};
+  size_t n = 0;
+
+  if (size < HTTP_TASK_TIMING_WIRE_SIZE) {
+    return 0;
+  }
+  for (size_t i = 0; i < sizeof(times) / sizeof(times[0]); i++) {
+    uint16_t ms = (times[i] > UINT16_MAX) ? UINT16_MAX : (uint16_t)times[i];
+    buf[n++] = (uint8_t)(ms >> 8);
+    buf[n++] = (uint8_t)(ms);
+  }
+  buf[n++] = (uint8_t)(timing->rx_bytes >> 24);
+  buf[n++] = (uint8_t)(timing->rx_bytes >> 16);
+  buf[n++] = (uint8_t)(timing->rx_bytes >> 8);
+  buf[n++] = (uint8_t)(timing->rx_bytes);
+  return n;
+}
+
+const http_task_bench_t *http_task_get_bench(void) {
+  return &nv_data()->http_task_nv_data.bench;
+}
+
+const http_task_sink_t *http_task_get_sink(void) {
+  return &nv_data()->http_task_nv_data.sink;
+}
+
+const http_task_source_t *http_task_get_source(void) {
+  return &nv_data()->http_task_nv_data.source;
 }
 
 // *****************************************************************************
@@ -255,6 +872,8 @@ static const char *http_task_state_name(http_task_state_t state) {
 static void http_task_socket_callback(SOCKET socket,
                                       uint8_t msg_type,
                                       void *msg) {
+  http_task_timing_t *timing = s_http_task_ctx.timing;
+
   if (socket != s_http_task_ctx.client_socket) {
     YB_LOG_DEBUG("Received socket callback for unknown socket");
     return;
@@ -264,22 +883,113 @@ static void http_task_socket_callback(SOCKET socket,
   case SOCKET_MSG_CONNECT: {
     // arrive here in response to a connect() request
     tstrSocketConnectMsg *connect_msg = (tstrSocketConnectMsg *)msg;
-    if (connect_msg != NULL && connect_msg->s8Error >= 0) {
+    if (connect_msg != NULL && connect_msg->s8Error < 0 &&
+        s_http_task_ctx.host_from_cache) {
+      // The cached address may be stale: forget it and ask DNS.
+      YB_LOG_WARN("Connect to cached address failed (%d), resolving %s",
+                  connect_msg->s8Error,
+                  s_http_task_ctx.host_name);
+      http_task_dns_entry_t *entry =
+          http_task_dns_cache_find(s_http_task_ctx.host_name);
+      if (entry != NULL) {
+        entry->ipv4 = 0;
+      }
+      shutdown(s_http_task_ctx.client_socket);
+      s_http_task_ctx.client_socket = -1;
+      http_task_set_state(HTTP_TASK_STATE_START_DNS);
+    } else if (connect_msg != NULL && connect_msg->s8Error >= 0) {
       // successful connection -- initiate a TCP/IP exchange
       YB_LOG_INFO("Socket %d connected", socket);
+      timing->connect_ms = yb_rtc_elapsed_ms(s_http_task_ctx.connect_at);
+      if (!s_http_task_ctx.use_tls) {
+        http_task_set_state(HTTP_TASK_STATE_START_SEND);
+      } else if (secure(socket) < 0) {
+        YB_LOG_ERROR("secure() failed");
+        http_task_set_state(HTTP_TASK_STATE_ERROR);
+      } else {
+        s_http_task_ctx.secure_at = yb_rtc_now();
+        http_task_set_state(HTTP_TASK_STATE_AWAIT_SECURE);
+      }
+    }
+  } break;
+
+  case SOCKET_MSG_SECURE: {
+    // arrive here when the TLS handshake started by secure() completes
+    tstrSocketConnectMsg *secure_msg = (tstrSocketConnectMsg *)msg;
+    if (secure_msg != NULL && secure_msg->s8Error >= 0) {
+      http_task_record_tls_handshake();
       http_task_set_state(HTTP_TASK_STATE_START_SEND);
+    } else {
+      YB_LOG_ERROR("TLS handshake failed (%d)",
+                   secure_msg == NULL ? 0 : secure_msg->s8Error);
+      http_task_set_state(HTTP_TASK_STATE_ERROR);
     }
   } break;
 
   case SOCKET_MSG_SEND: {
     // Arrive here when send() completes
-    http_task_set_state(HTTP_TASK_STATE_AWAIT_RESPONSE);
+    if (s_http_task_ctx.bench_mode) {
+      int16_t sent = (msg == NULL) ? 0 : *(int16_t *)msg;
+      s_http_task_ctx.bench_send_pending = false;
+      if (sent < 0) {
+        YB_LOG_ERROR("Benchmark send failed (%d)", sent);
+        http_task_set_state(HTTP_TASK_STATE_BENCH_REPORT);
+      } else if (!s_http_task_ctx.bench_header_sent) {
+        // upload timing starts once the YBBENCH line is out
+        s_http_task_ctx.bench_header_sent = true;
+        s_http_task_ctx.bench_start_at = yb_rtc_now();
+        s_http_task_ctx.bench_last_at = s_http_task_ctx.bench_start_at;
+      } else {
+        http_task_bench_account(&nv_data()->http_task_nv_data.bench.up, sent);
+      }
+      break;
+    }
+    if (s_http_task_source.active) {
+      int16_t sent = (msg == NULL) ? 0 : *(int16_t *)msg;
+      if (s_http_task_source.in_flight > 0) {
+        s_http_task_source.in_flight -= 1;
+      }
+      if (sent < 0) {
+        YB_LOG_ERROR("Upload send failed (%d)", sent);
+        s_http_task_source.failed = true;
+      }
+      break;
+    }
+    timing->send_ms = yb_rtc_elapsed_ms(s_http_task_ctx.send_at);
+    // Nothing to do until the server answers.
+    winc_task_set_idle(true);
+    if (s_http_task_sink.active) {
+      // The idle timeout runs from here until the first of the response.
+      s_http_task_ctx.last_recv_at = yb_rtc_now();
+      http_task_set_state(HTTP_TASK_STATE_SINK_RECEIVE);
+    } else {
+      http_task_set_state(HTTP_TASK_STATE_AWAIT_RESPONSE);
+    }
   } break;
 
   case SOCKET_MSG_RECV: {
     // Arrive here when recv() completes
     tstrSocketRecvMsg *recv_msg = (tstrSocketRecvMsg *)msg;
-    if (recv_msg != NULL && recv_msg->s16BufferSize > 0) {
+    // The server has started answering: the rest arrives at full power.
+    winc_task_set_idle(false);
+    if (s_http_task_ctx.bench_mode) {
+      http_task_bench_on_recv(recv_msg);
+    } else if (s_http_task_sink.active) {
+      http_task_sink_on_recv(recv_msg);
+    } else if (recv_msg != NULL && recv_msg->s16BufferSize > 0 &&
+               timing->rx_bytes > 0) {
+      // continuation of the response: count it and keep reading
+      s_http_task_ctx.last_recv_at = yb_rtc_now();
+      timing->rx_bytes += recv_msg->s16BufferSize;
+      if (recv_msg->u16RemainingSize == 0) {
+        http_task_start_recv();
+      }
+    } else if (recv_msg != NULL && recv_msg->s16BufferSize > 0) {
+      s_http_task_ctx.first_recv_at = yb_rtc_now();
+      s_http_task_ctx.last_recv_at = s_http_task_ctx.first_recv_at;
+      timing->ttfb_ms = yb_rtc_difference_ms(s_http_task_ctx.first_recv_at,
+                                             s_http_task_ctx.send_at);
+      timing->rx_bytes = recv_msg->s16BufferSize;
       bool print_dots = false;
       uint32_t to_print = recv_msg->s16BufferSize;
       if (to_print > 200) {
@@ -290,7 +1000,18 @@ static void http_task_socket_callback(SOCKET socket,
       YB_LOG_INFO("Received response:\n==<<<\n%s%s\n==<<<",
                   (char *)recv_msg->pu8Buffer,
                   print_dots ? "..." : "");
+      // Keep reading (over the same buffer) to time the whole transfer.
+      if (recv_msg->u16RemainingSize == 0) {
+        http_task_start_recv();
+      }
+    } else if (timing->rx_bytes > 0) {
+      // Server closed the connection after the response: the exchange is done.
+      http_task_finish_timing();
       http_task_set_state(HTTP_TASK_STATE_SUCCESS);
+    } else {
+      YB_LOG_ERROR("Connection closed before response (%d)",
+                   recv_msg == NULL ? 0 : recv_msg->s16BufferSize);
+      http_task_set_state(HTTP_TASK_STATE_ERROR);
     }
 
   } break;
@@ -304,10 +1025,572 @@ static void http_task_socket_callback(SOCKET socket,
 static void http_task_resolver_cb(uint8_t *pu8DomainName,
                                   uint32_t u32ServerIP) {
   char s[20];
+  yb_rtc_ms_t lookup_ms = yb_rtc_elapsed_ms(s_http_task_ctx.dns_start_at);
+
+  s_http_task_ctx.dns_pending = false;
+  if (u32ServerIP == 0) {
+    YB_LOG_ERROR("Unable to resolve %s", pu8DomainName);
+    if (s_http_task_ctx.state == HTTP_TASK_STATE_AWAIT_DNS) {
+      http_task_set_state(HTTP_TASK_STATE_ERROR);
+    }
+    return;
+  }
 
-  YB_LOG_INFO("%s resolved to %s",
+  YB_LOG_INFO("%s resolved to %s in %d ms",
               pu8DomainName,
-              inet_ntop(AF_INET, &u32ServerIP, s, sizeof(s)));
-  s_http_task_ctx.host_ipv4 = u32ServerIP;
-  http_task_set_state(HTTP_TASK_STATE_START_SOCKET);
+              inet_ntop(AF_INET, &u32ServerIP, s, sizeof(s)),
+              (int)lookup_ms);
+  if (s_http_task_ctx.state == HTTP_TASK_STATE_AWAIT_DNS) {
+    s_http_task_ctx.timing->dns_ms = lookup_ms;
+  }
+  if (s_http_task_ctx.dns_ttl_ms > 0) {
+    http_task_dns_cache_store(
+        s_http_task_ctx.host_name, u32ServerIP, lookup_ms);
+  }
+  if (s_http_task_ctx.state == HTTP_TASK_STATE_AWAIT_DNS) {
+    s_http_task_ctx.host_ipv4 = u32ServerIP;
+    http_task_set_state(HTTP_TASK_STATE_START_SOCKET);
+  } else {
+    // Background refresh: the cache is updated for the next wake.
+  }
+}
+
+static bool http_task_start_dns(void) {
+  if (s_http_task_ctx.dns_pending) {
+    // A lookup is already in flight; its answer will serve both purposes.
+    return true;
+  } else if (WDRV_WINC_STATUS_OK !=
+             WDRV_WINC_SocketRegisterResolverCallback(
+                 s_http_task_ctx.winc_handle, http_task_resolver_cb)) {
+    return false;
+  } else if (gethostbyname(s_http_task_ctx.host_name) < 0) {
+    return false;
+  } else {
+    s_http_task_ctx.dns_start_at = yb_rtc_now();
+    s_http_task_ctx.dns_pending = true;
+    return true;
+  }
+}
+
+static uint32_t http_task_hash_name(const char *name) {
+  uint32_t hash = 2166136261u;
+  while (*name != '\0') {
+    hash ^= (uint8_t)*name++;
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+static http_task_dns_entry_t *http_task_dns_cache_find(const char *name) {
+  http_task_dns_entry_t *cache = nv_data()->http_task_nv_data.dns_cache;
+  uint32_t hash = http_task_hash_name(name);
+
+  for (int i = 0; i < HTTP_TASK_DNS_CACHE_SIZE; i++) {
+    if (cache[i].ipv4 != 0 && cache[i].name_hash == hash) {
+      return &cache[i];
+    }
+  }
+  return NULL;
+}
+
+static bool http_task_dns_entry_is_fresh(http_task_dns_entry_t *entry) {
+  // signed difference handles RTC wraparound
+  return (int32_t)(entry->expires_at - yb_rtc_now()) > 0;
+}
+
+static void http_task_dns_cache_store(const char *name,
+                                      uint32_t ipv4,
+                                      yb_rtc_ms_t lookup_ms) {
+  http_task_dns_entry_t *entry = http_task_dns_cache_find(name);
+
+  if (entry == NULL) {
+    // Take an unused entry, else evict the one that expires soonest.
+    http_task_dns_entry_t *cache = nv_data()->http_task_nv_data.dns_cache;
+    entry = &cache[0];
+    for (int i = 0; i < HTTP_TASK_DNS_CACHE_SIZE; i++) {
+      if (cache[i].ipv4 == 0) {
+        entry = &cache[i];
+        break;
+      } else if ((int32_t)(cache[i].expires_at - entry->expires_at) < 0) {
+        entry = &cache[i];
+      }
+    }
+  }
+  entry->name_hash = http_task_hash_name(name);
+  entry->ipv4 = ipv4;
+  entry->resolved_at = yb_rtc_now();
+  entry->expires_at =
+      yb_rtc_offset(entry->resolved_at, s_http_task_ctx.dns_ttl_ms);
+  entry->lookup_ms = lookup_ms;
+}
+
+static const char *http_task_configure_tls_socket(SOCKET sock) {
+  int enable = 1;
+  const char *host_name = s_http_task_ctx.host_name;
+
+  if (host_name != NULL &&
+      setsockopt(sock,
+                 SOL_SSL_SOCKET,
+                 SO_SSL_SNI,
+                 host_name,
+                 strlen(host_name) + 1) < 0) {
+    return "setsockopt(SO_SSL_SNI) failed";
+  }
+  // The WINC keeps its session cache in its own RAM, so a session can only be
+  // resumed if the WINC has not been reset since the previous handshake.
+  if (setsockopt(sock,
+                 SOL_SSL_SOCKET,
+                 SO_SSL_ENABLE_SESSION_CACHING,
+                 &enable,
+                 sizeof(enable)) < 0) {
+    return "setsockopt(SO_SSL_ENABLE_SESSION_CACHING) failed";
+  }
+  if (APP_HOST_TLS_BYPASS_X509 &&
+      setsockopt(sock,
+                 SOL_SSL_SOCKET,
+                 SO_SSL_BYPASS_X509_VERIF,
+                 &enable,
+                 sizeof(enable)) < 0) {
+    return "setsockopt(SO_SSL_BYPASS_X509_VERIF) failed";
+  }
+  return NULL;
+}
+
+static void http_task_record_tls_handshake(void) {
+  http_task_nv_data_t *nv = &nv_data()->http_task_nv_data;
+  yb_rtc_ms_t ms = yb_rtc_elapsed_ms(s_http_task_ctx.secure_at);
+
+  s_http_task_ctx.tls_handshake_ms = ms;
+  s_http_task_ctx.timing->tls_ms = ms;
+  s_http_task_ctx.tls_resumed =
+      nv->tls_session_cached && nv->tls_full_handshake_ms > 0 &&
+      ms * 100 < nv->tls_full_handshake_ms * HTTP_TASK_TLS_RESUMED_PERCENT;
+
+  nv->tls_session_cached = true;
+  nv->tls_handshake_count += 1;
+  if (s_http_task_ctx.tls_resumed) {
+    nv->tls_resumed_count += 1;
+  } else if (nv->tls_full_handshake_ms == 0) {
+    nv->tls_full_handshake_ms = ms;
+  } else {
+    nv->tls_full_handshake_ms +=
+        (ms - nv->tls_full_handshake_ms) / HTTP_TASK_TLS_MEAN_WEIGHT;
+  }
+  YB_LOG_INFO("TLS handshake took %d ms (%s), %ld of %ld resumed",
+              (int)ms,
+              s_http_task_ctx.tls_resumed ? "resumed" : "full",
+              nv->tls_resumed_count,
+              nv->tls_handshake_count);
+}
+
+static void http_task_start_recv(void) {
+  recv(s_http_task_ctx.client_socket,
+       mu_strbuf_wdata(s_http_task_ctx.response_msg),
+       mu_strbuf_capacity(s_http_task_ctx.response_msg),
+       0);
+}
+
+static void http_task_finish_timing(void) {
+  http_task_timing_t *timing = s_http_task_ctx.timing;
+
+  timing->transfer_ms = yb_rtc_difference_ms(s_http_task_ctx.last_recv_at,
+                                             s_http_task_ctx.first_recv_at);
+  timing->total_ms = yb_rtc_difference_ms(s_http_task_ctx.last_recv_at,
+                                          s_http_task_ctx.started_at);
+  YB_LOG_INFO("Timing (ms): dns=%d connect=%d tls=%d send=%d ttfb=%d "
+              "transfer=%d total=%d (%ld bytes)",
+              (int)timing->dns_ms,
+              (int)timing->connect_ms,
+              (int)timing->tls_ms,
+              (int)timing->send_ms,
+              (int)timing->ttfb_ms,
+              (int)timing->transfer_ms,
+              (int)timing->total_ms,
+              timing->rx_bytes);
+}
+
+static void http_task_sink_on_recv(tstrSocketRecvMsg *recv_msg) {
+  http_task_sink_ctx_t *sink = &s_http_task_sink;
+  http_task_timing_t *timing = s_http_task_ctx.timing;
+
+  if (recv_msg == NULL || recv_msg->s16BufferSize <= 0) {
+    // Server closed the connection: whatever has arrived is the whole body.
+    if (!sink->headers_done) {
+      YB_LOG_ERROR("Connection closed before response headers (%d)",
+                   recv_msg == NULL ? 0 : recv_msg->s16BufferSize);
+      sink->failed = true;
+    }
+    sink->eof = true;
+    return;
+  }
+
+  s_http_task_ctx.last_recv_at = yb_rtc_now();
+  if (timing->rx_bytes == 0) {
+    s_http_task_ctx.first_recv_at = s_http_task_ctx.last_recv_at;
+    timing->ttfb_ms = yb_rtc_difference_ms(s_http_task_ctx.first_recv_at,
+                                           s_http_task_ctx.send_at);
+  }
+  timing->rx_bytes += recv_msg->s16BufferSize;
+
+  if (sink->headers_done) {
+    // The data is already in the ring and the driver has reposted recv().
+    sink->received += recv_msg->s16BufferSize;
+    http_task_sink_check_length();
+    return;
+  }
+
+  sink->header_len += recv_msg->s16BufferSize;
+  if (http_task_sink_parse_headers()) {
+    // step() takes it from here.
+  } else if (sink->header_len >=
+             mu_strbuf_capacity(s_http_task_ctx.response_msg)) {
+    YB_LOG_ERROR("Response headers exceed %d bytes",
+                 mu_strbuf_capacity(s_http_task_ctx.response_msg));
+    sink->failed = true;
+  } else {
+    // Headers continue: append the next segment to them.
+    recv(s_http_task_ctx.client_socket,
+         mu_strbuf_wdata(s_http_task_ctx.response_msg) + sink->header_len,
+         mu_strbuf_capacity(s_http_task_ctx.response_msg) - sink->header_len,
+         0);
+  }
+}
+
+static bool http_task_sink_parse_headers(void) {
+  static const char content_length[] = "\r\ncontent-length:";
+  http_task_sink_ctx_t *sink = &s_http_task_sink;
+  char *buf = (char *)mu_strbuf_wdata(s_http_task_ctx.response_msg);
+  size_t end = 0;
+
+  // Find the blank line that ends the headers.
+  for (size_t i = 3; i < sink->header_len; i++) {
+    if (memcmp(&buf[i - 3], "\r\n\r\n", 4) == 0) {
+      end = i + 1;
+      break;
+    }
+  }
+  if (end == 0) {
+    return false;
+  }
+  sink->headers_done = true;
+
+  // "HTTP/1.x 200 OK"
+  if (end < 12 || strncmp(buf, "HTTP/1.", 7) != 0 ||
+      strncmp(&buf[9], "200", 3) != 0) {
+    YB_LOG_ERROR("Download refused: %.*s", 12, buf);
+    sink->failed = true;
+    return true;
+  }
+
+  // Header names are case-insensitive.
+  for (size_t i = 0; i + sizeof(content_length) - 1 < end; i++) {
+    size_t j = 0;
+    while (j < sizeof(content_length) - 1 &&
+           tolower((unsigned char)buf[i + j]) == content_length[j]) {
+      j++;
+    }
+    if (j == sizeof(content_length) - 1) {
+      sink->content_length = atol(&buf[i + j]);
+      break;
+    }
+  }
+
+  // Body bytes that arrived with the headers start the ring, and the driver
+  // receives the rest of the body after them.
+  sink->received = sink->header_len - end;
+  if (sink->received > sizeof(sink->ring)) {
+    YB_LOG_ERROR("Response headers and body exceed %d bytes",
+                 sizeof(sink->ring));
+    sink->failed = true;
+    return true;
+  }
+  memcpy(sink->ring, &buf[end], sink->received);
+  if (recv_ring_attach(s_http_task_ctx.client_socket,
+                       sink->ring,
+                       sizeof(sink->ring),
+                       sink->received,
+                       0) != SOCK_ERR_NO_ERROR) {
+    YB_LOG_ERROR("Unable to attach receive ring");
+    sink->failed = true;
+    return true;
+  }
+  http_task_sink_check_length();
+  return true;
+}
+
+static void http_task_sink_check_length(void) {
+  http_task_sink_ctx_t *sink = &s_http_task_sink;
+
+  if (sink->content_length >= 0 &&
+      sink->received >= (uint32_t)sink->content_length) {
+    sink->eof = true;
+  }
+}
+
+static void http_task_sink_record_ring(void) {
+  http_task_sink_t *stats = &nv_data()->http_task_nv_data.sink;
+  tstrSocketRingStats ring_stats;
+
+  if (recv_ring_get_stats(s_http_task_ctx.client_socket, &ring_stats) ==
+      SOCK_ERR_NO_ERROR) {
+    stats->recv_stalls = ring_stats.u32Stalls;
+    stats->recv_stall_ms = ring_stats.u32StallMs;
+    stats->recv_posts = ring_stats.u32Posts;
+  }
+}
+
+static bool http_task_sink_write(const uint8_t *data, size_t len) {
+  http_task_sink_t *stats = &nv_data()->http_task_nv_data.sink;
+  yb_rtc_tics_t start = yb_rtc_now();
+
+  yb_sha256_update(&s_http_task_sink.sha, data, len);
+  size_t written = SYS_FS_FileWrite(s_http_task_sink.file, data, len);
+  stats->write_ms += yb_rtc_elapsed_ms(start);
+  stats->block_writes += 1;
+  if (written != len) {
+    YB_LOG_ERROR("Short write to %s (%d of %d bytes)",
+                 s_http_task_sink.part_filename,
+                 written,
+                 len);
+    return false;
+  }
+  stats->body_bytes += written;
+  return true;
+}
+
+static const char *http_task_sink_finish(void) {
+  http_task_sink_ctx_t *sink = &s_http_task_sink;
+  http_task_sink_t *stats = &nv_data()->http_task_nv_data.sink;
+  uint8_t digest[YB_SHA256_DIGEST_SIZE];
+
+  if (!sink->headers_done) {
+    // Nothing was received, or not enough to hold a status line: keep the
+    // existing file rather than replace it with an empty one.
+    return "No response received";
+  }
+
+  // The final, partial block, which may wrap around the end of the ring.
+  uint8_t *data;
+  uint16_t len;
+  while ((len = recv_ring_peek(s_http_task_ctx.client_socket, &data)) > 0) {
+    if (!http_task_sink_write(data, len)) {
+      return "Unable to write final block";
+    }
+    recv_ring_consume(s_http_task_ctx.client_socket, len);
+  }
+  http_task_sink_record_ring();
+  SYS_FS_FileClose(sink->file);
+  sink->file = SYS_FS_HANDLE_INVALID;
+  yb_sha256_final(&sink->sha, digest);
+
+  uint32_t expected_len = sink->expected_len;
+  if (expected_len == 0 && sink->content_length >= 0) {
+    expected_len = sink->content_length;
+  }
+  YB_LOG_INFO("Downloaded %ld bytes to %s: %ld writes in %ld ms, %d stalls "
+              "(%ld ms) over %ld recv()s",
+              stats->body_bytes,
+              sink->filename,
+              stats->block_writes,
+              stats->write_ms,
+              stats->recv_stalls,
+              stats->recv_stall_ms,
+              stats->recv_posts);
+  if (expected_len != 0 && stats->body_bytes != expected_len) {
+    YB_LOG_ERROR("Expected %ld bytes", expected_len);
+    return "Download length mismatch";
+  }
+  if (sink->hash_len > 0 &&
+      memcmp(digest, sink->expected_hash, sink->hash_len) != 0) {
+    return "Download hash mismatch";
+  }
+
+  // FAT cannot replace a file atomically.  Removing the old file first leaves
+  // a window in which only the verified .part file exists, never one in which
+  // filename holds a partial download.
+  SYS_FS_FileDirectoryRemove(sink->filename);
+  if (SYS_FS_FileDirectoryRenameMove(sink->part_filename, sink->filename) !=
+      SYS_FS_RES_SUCCESS) {
+    return "Unable to rename download";
+  }
+  stats->verified = true;
+  memcpy(stats->verified_hash, sink->expected_hash, sink->hash_len);
+  return NULL;
+}
+
+static bool http_task_source_read(void) {
+  http_task_source_ctx_t *source = &s_http_task_source;
+  http_task_source_t *stats = &nv_data()->http_task_nv_data.source;
+  yb_rtc_tics_t start = yb_rtc_now();
+
+  size_t n = SYS_FS_FileRead(
+      source->file, source->chunk, HTTP_TASK_SOURCE_CHUNK_SIZE);
+  stats->sd_wait_ms += yb_rtc_elapsed_ms(start);
+  if (n == (size_t)-1) {
+    YB_LOG_ERROR("Unable to read %s, error %d",
+                 source->filename,
+                 SYS_FS_Error());
+    return false;
+  }
+  source->chunk_len = n;
+  if (n < HTTP_TASK_SOURCE_CHUNK_SIZE) {
+    source->eof = true;
+  }
+  return true;
+}
+
+static bool http_task_source_send(void) {
+  http_task_source_ctx_t *source = &s_http_task_source;
+  http_task_source_t *stats = &nv_data()->http_task_nv_data.source;
+
+  if (source->in_flight >= HTTP_TASK_SOURCE_WINDOW) {
+    return false;
+  }
+  if (send(s_http_task_ctx.client_socket,
+           source->chunk,
+           source->chunk_len,
+           0) < 0) {
+    // The WINC has no room for it yet: try again on the next step.
+    stats->sends_refused += 1;
+    return false;
+  }
+  source->in_flight += 1;
+  if (source->in_flight > stats->max_in_flight) {
+    stats->max_in_flight = source->in_flight;
+  }
+  stats->body_bytes += source->chunk_len;
+  source->chunk_len = 0;
+  return true;
+}
+
+static void http_task_source_wait(bool waiting) {
+  http_task_source_ctx_t *source = &s_http_task_source;
+
+  if (waiting && !source->waiting) {
+    source->waiting_at = yb_rtc_now();
+  } else if (!waiting && source->waiting) {
+    nv_data()->http_task_nv_data.source.radio_wait_ms +=
+        yb_rtc_elapsed_ms(source->waiting_at);
+  }
+  source->waiting = waiting;
+}
+
+static void http_task_source_finish(void) {
+  http_task_source_ctx_t *source = &s_http_task_source;
+  http_task_source_t *stats = &nv_data()->http_task_nv_data.source;
+
+  if (source->file != SYS_FS_HANDLE_INVALID) {
+    SYS_FS_FileClose(source->file);
+    source->file = SYS_FS_HANDLE_INVALID;
+  }
+  stats->ms = yb_rtc_elapsed_ms(source->start_at);
+  stats->bytes_per_s =
+      (stats->ms == 0) ? 0
+                       : (uint32_t)((uint64_t)stats->body_bytes * 1000 /
+                                    stats->ms);
+  YB_LOG_INFO("Uploaded %ld bytes from %s in %ld ms = %ld bytes/s: "
+              "sd_wait=%ld ms radio_wait=%ld ms refused=%u max_in_flight=%u",
+              stats->body_bytes,
+              source->filename,
+              stats->ms,
+              stats->bytes_per_s,
+              stats->sd_wait_ms,
+              stats->radio_wait_ms,
+              stats->sends_refused,
+              stats->max_in_flight);
+}
+
+static void http_task_bench_send(void) {
+  http_task_bench_t *bench = &nv_data()->http_task_nv_data.bench;
+  uint8_t *buf = mu_strbuf_wdata(s_http_task_ctx.response_msg);
+  size_t len;
+
+  if (!s_http_task_ctx.bench_header_sent) {
+    len = snprintf((char *)buf,
+                   mu_strbuf_capacity(s_http_task_ctx.response_msg),
+                   "YBBENCH %lu %lu\r\n",
+                   s_http_task_ctx.bench_up_bytes,
+                   s_http_task_ctx.bench_down_bytes);
+  } else {
+    // The filler is whatever is in the response buffer: only its length counts.
+    len = s_http_task_ctx.bench_up_bytes - bench->up.bytes;
+    if (len > mu_strbuf_capacity(s_http_task_ctx.response_msg)) {
+      len = mu_strbuf_capacity(s_http_task_ctx.response_msg);
+    }
+    if (len > HTTP_TASK_BENCH_CHUNK_SIZE) {
+      len = HTTP_TASK_BENCH_CHUNK_SIZE;
+    }
+  }
+  if (send(s_http_task_ctx.client_socket, buf, len, 0) < 0) {
+    YB_LOG_ERROR("Benchmark send() failed");
+    http_task_set_state(HTTP_TASK_STATE_BENCH_REPORT);
+  } else {
+    s_http_task_ctx.bench_send_pending = true;
+  }
+}
+
+static void http_task_bench_account(http_task_bench_dir_t *dir,
+                                    uint32_t nbytes) {
+  yb_rtc_tics_t now = yb_rtc_now();
+  yb_rtc_ms_t gap_ms = yb_rtc_difference_ms(now, s_http_task_ctx.bench_last_at);
+
+  if (gap_ms > HTTP_TASK_BENCH_STALL_MS) {
+    dir->stalls += 1;
+  }
+  if (gap_ms > HTTP_TASK_BENCH_RTO_MS) {
+    dir->long_gaps += 1;
+  }
+  if (gap_ms > dir->max_gap_ms) {
+    dir->max_gap_ms = (gap_ms >= UINT16_MAX) ? UINT16_MAX : (uint16_t)gap_ms;
+  }
+  dir->bytes += nbytes;
+  dir->ms = yb_rtc_difference_ms(now, s_http_task_ctx.bench_start_at);
+  s_http_task_ctx.bench_last_at = now;
+}
+
+static void http_task_bench_on_recv(tstrSocketRecvMsg *recv_msg) {
+  http_task_bench_dir_t *down = &nv_data()->http_task_nv_data.bench.down;
+
+  if (s_http_task_ctx.state != HTTP_TASK_STATE_BENCH_DOWNLOAD) {
+    // e.g. the budget expired with a recv() still posted
+    return;
+  } else if (recv_msg == NULL || recv_msg->s16BufferSize <= 0) {
+    // server closed the connection: the download is over
+    if (down->bytes < s_http_task_ctx.bench_down_bytes) {
+      YB_LOG_WARN("Benchmark download closed early (%d)",
+                  recv_msg == NULL ? 0 : recv_msg->s16BufferSize);
+    }
+    http_task_set_state(HTTP_TASK_STATE_BENCH_REPORT);
+    return;
+  }
+
+  http_task_bench_account(down, recv_msg->s16BufferSize);
+  if (down->bytes >= s_http_task_ctx.bench_down_bytes) {
+    http_task_set_state(HTTP_TASK_STATE_BENCH_REPORT);
+  } else if (recv_msg->u16RemainingSize == 0) {
+    // Repost immediately into the same buffer: the data itself is discarded.
+    http_task_start_recv();
+  }
+}
+
+static void http_task_bench_report(void) {
+  http_task_bench_t *bench = &nv_data()->http_task_nv_data.bench;
+  http_task_bench_dir_t *dirs[] = {&bench->up, &bench->down};
+  const char *names[] = {"up", "down"};
+
+  for (int i = 0; i < 2; i++) {
+    http_task_bench_dir_t *dir = dirs[i];
+    // bytes * 8 / ms = kbit/s; 64 bit product avoids overflow past 512 KB.
+    dir->goodput_kbps =
+        (dir->ms == 0) ? 0 : (uint32_t)((uint64_t)dir->bytes * 8 / dir->ms);
+    YB_LOG_INFO("Benchmark %s: %ld bytes in %ld ms = %ld kbps, stalls=%u "
+                "long_gaps=%u max_gap=%u ms",
+                names[i],
+                dir->bytes,
+                dir->ms,
+                dir->goodput_kbps,
+                dir->stalls,
+                dir->long_gaps,
+                dir->max_gap_ms);
+  }
 }
@@ -32,6 +32,7 @@
 
 #include "driver/driver_common.h"
 #include "mu_strbuf.h"
+#include "yb_rtc.h"
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -45,6 +46,121 @@ extern "C" {
 // *****************************************************************************
 // Public types and definitions
 
+#define HTTP_TASK_DNS_CACHE_SIZE 4
+
+// Response bodies streamed to a file are written in blocks of this many bytes,
+// a whole number of 512 byte SD sectors.
+#define HTTP_TASK_SINK_BLOCK_SIZE 4096
+
+// Size of the expected hash kept for the most recent download: a SHA-256
+// prefix.
+#define HTTP_TASK_SINK_HASH_SIZE 16
+
+#define HTTP_TASK_SINK_MAX_PATH 64
+
+// Request bodies streamed from a file are read and sent in chunks of this many
+// bytes: two 512 byte SD sectors, within the WINC's 1400 byte send() limit.
+#define HTTP_TASK_SOURCE_CHUNK_SIZE 1024
+
+// Number of send() calls allowed to await SOCKET_MSG_SEND at any one time.
+#define HTTP_TASK_SOURCE_WINDOW 4
+
+/**
+ * @brief A cached DNS answer.  An entry with ipv4 == 0 is unused.
+ */
+typedef struct {
+  uint32_t name_hash;        // FNV-1a hash of the host name
+  uint32_t ipv4;             // resolved address
+  yb_rtc_tics_t resolved_at; // RTC time at which the answer arrived
+  yb_rtc_tics_t expires_at;  // RTC time at which the answer goes stale
+  yb_rtc_ms_t lookup_ms;     // how long the DNS lookup took
+} http_task_dns_entry_t;
+
+// Size of the timing record in the wire format of http_task_encode_timing().
+#define HTTP_TASK_TIMING_WIRE_SIZE 18
+
+/**
+ * @brief Phase timing of one HTTP request, in milliseconds.  Phases that did
+ * not take place (e.g. DNS answered from the cache, or TLS disabled) are zero.
+ */
+typedef struct {
+  yb_rtc_ms_t dns_ms;      // gethostbyname() to resolver callback
+  yb_rtc_ms_t connect_ms;  // connect() to SOCKET_MSG_CONNECT
+  yb_rtc_ms_t tls_ms;      // secure() to SOCKET_MSG_SECURE
+  yb_rtc_ms_t send_ms;     // send() to SOCKET_MSG_SEND
+  yb_rtc_ms_t ttfb_ms;     // send() to first SOCKET_MSG_RECV
+  yb_rtc_ms_t transfer_ms; // first to last SOCKET_MSG_RECV
+  yb_rtc_ms_t total_ms;    // http_task_init() to last SOCKET_MSG_RECV
+  uint32_t rx_bytes;       // # of response bytes received
+} http_task_timing_t;
+
+/**
+ * @brief Throughput of one direction of a benchmark run.  A gap is the time
+ * between consecutive send or receive completions.
+ */
+typedef struct {
+  uint32_t bytes;        // # of payload bytes moved
+  uint32_t ms;           // duration of the transfer
+  uint32_t goodput_kbps; // bytes * 8 / ms
+  uint16_t stalls;       // # of gaps longer than HTTP_TASK_BENCH_STALL_MS
+  uint16_t long_gaps;    // # of gaps longer than HTTP_TASK_BENCH_RTO_MS
+  uint16_t max_gap_ms;   // longest gap
+} http_task_bench_dir_t;
+
+typedef struct {
+  http_task_timing_t timing;  // connection setup to the benchmark server
+  http_task_bench_dir_t up;   // device to server
+  http_task_bench_dir_t down; // server to device
+} http_task_bench_t;
+
+/**
+ * @brief Outcome of the most recent response body streamed to a file.
+ */
+typedef struct {
+  uint32_t body_bytes;   // # of body bytes written to the file
+  uint32_t block_writes; // # of SYS_FS_FileWrite() calls
+  uint32_t write_ms;     // total time spent in SYS_FS_FileWrite()
+  uint16_t recv_stalls;  // # of times the receive ring filled up
+  uint32_t recv_stall_ms; // total time the receive ring was full
+  uint32_t recv_posts;   // # of recv() calls posted by the receive ring
+  bool verified;         // true if length and hash matched and file renamed
+  uint8_t verified_hash[HTTP_TASK_SINK_HASH_SIZE]; // expected hash, if verified
+} http_task_sink_t;
+
+/**
+ * @brief Throughput of the most recent request body streamed from a file.
+ * sd_wait_ms is time spent in SYS_FS_FileRead(); radio_wait_ms is time a
+ * chunk was ready but the send window was full or draining.
+ */
+typedef struct {
+  uint32_t body_bytes;     // # of body bytes sent
+  uint32_t ms;             // first body read to last SOCKET_MSG_SEND
+  uint32_t bytes_per_s;    // body_bytes * 1000 / ms
+  uint32_t sd_wait_ms;     // total time spent reading the file
+  uint32_t radio_wait_ms;  // total time waiting on the send window
+  uint16_t sends_refused;  // # of send() calls refused with a full buffer
+  uint8_t max_in_flight;   // most sends outstanding at once
+} http_task_source_t;
+
+/**
+ * @brief Data that is preserved across reboots.
+ */
+typedef struct {
+  http_task_timing_t timing;            // timing of the most recent request
+  uint32_t tls_handshake_count;         // # of completed TLS handshakes
+  uint32_t tls_resumed_count;           // # of handshakes that were resumed
+  yb_rtc_ms_t tls_full_handshake_ms;    // moving mean of full handshakes
+  bool tls_session_cached;              // a handshake completed since the WINC
+                                        // was last reset
+  http_task_dns_entry_t dns_cache[HTTP_TASK_DNS_CACHE_SIZE];
+  uint32_t dns_hit_count;               // # of wakes that used a cached answer
+  uint32_t dns_miss_count;              // # of wakes that waited on DNS
+  yb_rtc_ms_t dns_saved_ms;             // total DNS latency avoided by hits
+  http_task_bench_t bench;              // results of the most recent benchmark
+  http_task_sink_t sink;                // most recent download to a file
+  http_task_source_t source;            // most recent upload from a file
+} http_task_nv_data_t;
+
 // *****************************************************************************
 // Public declarations
 
@@ -62,6 +178,8 @@ extern "C" {
  * @param host_ipv4 An IP Version 4 numeric address that identifies the host.
           If is is NULL, then host_name must resolve to a valid host.
  * @param use_tls If true, use TLS to when connecting.
+ * @param dns_ttl_ms How long a resolved host_name address may be reused from
+ *        the DNS cache in nv_data.  Zero disables the cache.
  * @param req_str The user-supplied buffer containing the entire HTTP request,
  *        including header and body.
  * @param req_length The length of the req_buf.
@@ -74,9 +192,66 @@ void http_task_init(DRV_HANDLE winc_handle,
                     const char *host_ipv4,
                     uint16_t host_port,
                     bool use_tls,
+                    yb_rtc_ms_t dns_ttl_ms,
                     mu_strbuf_t *request_msg,
                     mu_strbuf_t *response_msg);
 
+/**
+ * @brief Switch http_task into benchmark mode.
+ *
+ * Must be called after http_task_init() and before the first call to
+ * http_task_step().  Instead of sending request_msg, http_task sends the line
+ * "YBBENCH <up_bytes> <down_bytes>\r\n" followed by up_bytes of filler, one
+ * send() at a time.  The server is expected to read them and then reply with
+ * down_bytes of its own, which are received back to back into response_msg.
+ * Goodput, stalls and long gaps in each direction are recorded in nv_data.
+ *
+ * @param up_bytes Number of bytes to upload.
+ * @param down_bytes Number of bytes to download.
+ * @param budget_ms Time allowed for the transfer.  When it expires the partial
+ *        results are recorded and http_task succeeds.
+ */
+void http_task_set_bench(uint32_t up_bytes,
+                         uint32_t down_bytes,
+                         yb_rtc_ms_t budget_ms);
+
+/**
+ * @brief Stream the response body to a file instead of response_msg.
+ *
+ * Must be called after http_task_init() and before the first call to
+ * http_task_step().  The file system must be mounted.  The body is written to
+ * "<filename>.part" in HTTP_TASK_SINK_BLOCK_SIZE blocks while the WINC driver
+ * receives the next into a ring of two blocks, then checked and renamed to
+ * filename.  http_task fails (and deletes the partial file) on a non-200
+ * status, a length mismatch or a hash mismatch.
+ *
+ * @param filename Destination path, at most HTTP_TASK_SINK_MAX_PATH chars.
+ * @param expected_len Required body length, or 0 to check against the
+ *        Content-Length header (if present).
+ * @param expected_hash Required leading bytes of the body's SHA-256, or NULL.
+ * @param hash_len Number of bytes in expected_hash, at most
+ *        HTTP_TASK_SINK_HASH_SIZE.
+ */
+void http_task_set_sink(const char *filename,
+                        uint32_t expected_len,
+                        const uint8_t *expected_hash,
+                        size_t hash_len);
+
+/**
+ * @brief Stream the request body from a file after request_msg.
+ *
+ * Must be called after http_task_init() and before the first call to
+ * http_task_step().  The file system must be mounted.  request_msg holds only
+ * the request headers, whose Content-Length must match the file size.  The
+ * file is read in HTTP_TASK_SOURCE_CHUNK_SIZE chunks, and up to
+ * HTTP_TASK_SOURCE_WINDOW send() calls are kept outstanding so that the next
+ * chunk is read from the SD card while earlier ones are on the air.  The
+ * response is then received into response_msg as usual.
+ *
+ * @param filename Source path, at most HTTP_TASK_SINK_MAX_PATH chars.
+ */
+void http_task_set_source(const char *filename);
+
 /**
  * @brief Advance the http_task state machine.
  */
@@ -91,6 +266,48 @@ bool http_task_failed(void);
  */
 void http_task_shutdown(void);
 
+/**
+ * @brief Return the duration of this wake's TLS handshake in milliseconds, or
+ * 0 if no TLS handshake has completed.
+ */
+yb_rtc_ms_t http_task_get_tls_handshake_ms(void);
+
+/**
+ * @brief Return true if this wake's TLS handshake appears to have resumed a
+ * cached session rather than performing a full handshake.
+ */
+bool http_task_tls_was_resumed(void);
+
+/**
+ * @brief Note that the WINC was reset, losing the TLS session cache it keeps
+ * in its RAM: the next handshake cannot be a resumed one.
+ */
+void http_task_forget_tls_session(void);
+
+/**
+ * @brief Return the phase timing of the most recent request.
+ *
+ * The record lives in nv_data, so after a reboot it still describes the
+ * request made during the previous wake.
+ */
+const http_task_timing_t *http_task_get_timing(void);
+
+/**
+ * @brief Write the timing record of the most recent request into buf and
+ * return the number of bytes written, or 0 if buf is too small.
+ *
+ * The record is HTTP_TASK_TIMING_WIRE_SIZE bytes: dns_ms, connect_ms, tls_ms,
+ * send_ms, ttfb_ms, transfer_ms and total_ms as 16 bit big-endian values,
+ * saturating at 65535, then rx_bytes as a 32 bit big-endian value.
+ */
+size_t http_task_encode_timing(uint8_t *buf, size_t size);
+
+const http_task_bench_t *http_task_get_bench(void);
+
+const http_task_sink_t *http_task_get_sink(void);
+
+const http_task_source_t *http_task_get_source(void);
+
 #ifdef __cplusplus
 }
 #endif
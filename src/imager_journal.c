@@ -0,0 +1,270 @@
+/**
+ * @file imager_journal.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "imager_journal.h"
+
+#include "definitions.h"
+#include "imager_manifest.h"
+#include "spi_flash_map.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define IMAGER_JOURNAL_MAGIC 0x4a574259 // "YBWJ"
+
+// The erase block below the manifest holds the records, a head followed by
+// one record per entry, each written as a single quad word.
+#define IMAGER_JOURNAL_LOG_ADDRESS                                             \
+  (FLASH_ADDR + FLASH_SIZE - 2 * NVMCTRL_FLASH_BLOCKSIZE)
+
+#define IMAGER_JOURNAL_RECORDS                                                 \
+  (NVMCTRL_FLASH_BLOCKSIZE / sizeof(imager_journal_record_t))
+
+// The blocks below that hold the sector contents, in a ring of slots used in
+// turn so that no one block is erased for every sector of a patch.  Each block
+// holds two slots; an entry whose slot starts a block erases it, and the entry
+// before it always sits in the previous block, so erasing a block never loses
+// the last entry.
+#define IMAGER_JOURNAL_SLOT_BLOCKS 4
+
+#define IMAGER_JOURNAL_SLOTS                                                   \
+  (IMAGER_JOURNAL_SLOT_BLOCKS * NVMCTRL_FLASH_BLOCKSIZE / FLASH_SECTOR_SZ)
+
+#define IMAGER_JOURNAL_SLOTS_ADDRESS                                           \
+  (IMAGER_JOURNAL_LOG_ADDRESS -                                                \
+   IMAGER_JOURNAL_SLOT_BLOCKS * NVMCTRL_FLASH_BLOCKSIZE)
+
+#define IMAGER_JOURNAL_NVM_ERRORS                                              \
+  (NVMCTRL_INTFLAG_ADDRE_Msk | NVMCTRL_INTFLAG_PROGE_Msk |                     \
+   NVMCTRL_INTFLAG_LOCKE_Msk | NVMCTRL_INTFLAG_NVME_Msk)
+
+typedef struct {
+  uint32_t magic;
+  uint8_t patch_id[IMAGER_JOURNAL_ID_SIZE];
+} imager_journal_head_t;
+
+typedef struct {
+  uint32_t sector;
+  uint32_t op_position;
+  uint32_t op_done;
+  uint32_t check; // CRC-32 of the fields above xor that of the sector contents
+} imager_journal_record_t;
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Return the record at the given index of the log.
+ */
+static const imager_journal_record_t *imager_journal_record(uint16_t index);
+
+/**
+ * @brief Return the address of the sector contents saved with a record.
+ */
+static uint32_t imager_journal_slot(uint16_t index);
+
+/**
+ * @brief Return the check value of a record and the contents saved with it.
+ */
+static uint32_t imager_journal_check(const imager_journal_record_t *record,
+                                     const uint8_t *data);
+
+/**
+ * @brief Return true if the record at index and its contents are intact.
+ *
+ * A record cut short by a reset, or whose contents were, is not.
+ */
+static bool imager_journal_valid(uint16_t index);
+
+/**
+ * @brief Return true if the record at index has never been written.
+ */
+static bool imager_journal_unused(uint16_t index);
+
+/**
+ * @brief Wait for the NVM controller to finish a command.
+ *
+ * @return false if the command failed.
+ */
+static bool imager_journal_wait(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+// Index of the next record to write, or 0 if no journal is open.
+static uint16_t s_next;
+
+// Pages are written from RAM, a whole page at a time.
+static uint32_t s_page[NVMCTRL_FLASH_PAGESIZE / sizeof(uint32_t)];
+
+// *****************************************************************************
+// Public code
+
+bool imager_journal_begin(const uint8_t *patch_id) {
+  imager_journal_head_t head;
+
+  s_next = 0;
+  NVMCTRL_BlockErase(IMAGER_JOURNAL_LOG_ADDRESS);
+  if (!imager_journal_wait()) {
+    return false;
+  }
+  head.magic = IMAGER_JOURNAL_MAGIC;
+  memcpy(head.patch_id, patch_id, IMAGER_JOURNAL_ID_SIZE);
+  NVMCTRL_QuadWordWrite((const uint32_t *)&head, IMAGER_JOURNAL_LOG_ADDRESS);
+  if (!imager_journal_wait() ||
+      memcmp((const void *)IMAGER_JOURNAL_LOG_ADDRESS, &head, sizeof(head)) !=
+          0) {
+    return false;
+  }
+  s_next = 1;
+  return true;
+}
+
+bool imager_journal_append(const imager_journal_entry_t *entry,
+                           const uint8_t *data) {
+  imager_journal_record_t record;
+  uint32_t slot;
+
+  if (s_next == 0 || s_next == IMAGER_JOURNAL_RECORDS) {
+    return false;
+  }
+  // The contents go in first: a record is only valid once they are complete.
+  slot = imager_journal_slot(s_next);
+  if (slot % NVMCTRL_FLASH_BLOCKSIZE == 0) {
+    NVMCTRL_BlockErase(slot);
+    if (!imager_journal_wait()) {
+      return false;
+    }
+  }
+  for (uint32_t i = 0; i < FLASH_SECTOR_SZ; i += NVMCTRL_FLASH_PAGESIZE) {
+    memcpy(s_page, data + i, NVMCTRL_FLASH_PAGESIZE);
+    NVMCTRL_PageWrite(s_page, slot + i);
+    if (!imager_journal_wait()) {
+      return false;
+    }
+  }
+
+  record.sector = entry->sector;
+  record.op_position = entry->op_position;
+  record.op_done = entry->op_done;
+  record.check = imager_journal_check(&record, data);
+  NVMCTRL_QuadWordWrite((const uint32_t *)&record,
+                        (uint32_t)imager_journal_record(s_next));
+  // Even a failed write uses up the record.
+  s_next += 1;
+  return imager_journal_wait() && imager_journal_valid(s_next - 1);
+}
+
+const uint8_t *imager_journal_last(const uint8_t *patch_id,
+                                   imager_journal_entry_t *entry) {
+  const imager_journal_head_t *head =
+      (const imager_journal_head_t *)IMAGER_JOURNAL_LOG_ADDRESS;
+  const uint8_t *data = NULL;
+
+  s_next = 0;
+  if (head->magic != IMAGER_JOURNAL_MAGIC ||
+      memcmp(head->patch_id, patch_id, IMAGER_JOURNAL_ID_SIZE) != 0) {
+    return NULL;
+  }
+  s_next = IMAGER_JOURNAL_RECORDS;
+  for (uint16_t i = 1; i < IMAGER_JOURNAL_RECORDS; i++) {
+    if (imager_journal_unused(i)) {
+      s_next = i;
+      break;
+    }
+    if (imager_journal_valid(i)) {
+      const imager_journal_record_t *record = imager_journal_record(i);
+      entry->sector = record->sector;
+      entry->op_position = record->op_position;
+      entry->op_done = record->op_done;
+      data = (const uint8_t *)imager_journal_slot(i);
+    }
+  }
+  return data;
+}
+
+bool imager_journal_clear(void) {
+  s_next = 0;
+  if (imager_journal_unused(0)) {
+    // Spare the block an erase when there is nothing to discard.
+    return true;
+  }
+  NVMCTRL_BlockErase(IMAGER_JOURNAL_LOG_ADDRESS);
+  return imager_journal_wait();
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static const imager_journal_record_t *imager_journal_record(uint16_t index) {
+  return (const imager_journal_record_t *)IMAGER_JOURNAL_LOG_ADDRESS + index;
+}
+
+static uint32_t imager_journal_slot(uint16_t index) {
+  // Record 0 is the head, so record 1 has the first slot.
+  return IMAGER_JOURNAL_SLOTS_ADDRESS +
+         ((index - 1) % IMAGER_JOURNAL_SLOTS) * FLASH_SECTOR_SZ;
+}
+
+static uint32_t imager_journal_check(const imager_journal_record_t *record,
+                                     const uint8_t *data) {
+  return imager_manifest_crc32(record,
+                               offsetof(imager_journal_record_t, check)) ^
+         imager_manifest_crc32(data, FLASH_SECTOR_SZ);
+}
+
+static bool imager_journal_valid(uint16_t index) {
+  const imager_journal_record_t *record = imager_journal_record(index);
+  return record->check ==
+         imager_journal_check(record,
+                              (const uint8_t *)imager_journal_slot(index));
+}
+
+static bool imager_journal_unused(uint16_t index) {
+  const uint32_t *words = (const uint32_t *)imager_journal_record(index);
+  for (size_t i = 0; i < sizeof(imager_journal_record_t) / sizeof(uint32_t);
+       i++) {
+    if (words[i] != 0xffffffff) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool imager_journal_wait(void) {
+  while (NVMCTRL_IsBusy()) {
+    // The journal is in the other flash bank, so code keeps running.
+  }
+  return (NVMCTRL_ErrorGet() & IMAGER_JOURNAL_NVM_ERRORS) == 0;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file imager_journal.h
+ *
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Journal that lets imager_task resume a patch cut short by a reset.
+ *
+ * A patch is applied in place, so a WINC sector being rewritten holds neither
+ * its old contents nor its new ones until it is done, and the old contents are
+ * needed to rebuild it.  Before touching a sector, imager_task saves the new
+ * contents here along with where it is in the patch.  After a reset, the last
+ * entry holds everything needed to finish that sector and carry on: the
+ * sectors before it already match the target and those after it still hold
+ * the source.
+ *
+ * The journal lives in internal flash, in the erase blocks just below the
+ * manifest: one block of entries and a ring of blocks for the sector contents.
+ */
+
+#ifndef _IMAGER_JOURNAL_H_
+#define _IMAGER_JOURNAL_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// Bytes of the patch's ops hash that tie the journal to the patch.
+#define IMAGER_JOURNAL_ID_SIZE 12
+
+typedef struct {
+  uint16_t sector;      // WINC sector whose new contents are journaled
+  uint32_t op_position; // file offset of the op in progress after the sector
+  uint32_t op_done;     // bytes of that op applied
+} imager_journal_entry_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Start a journal for a patch, discarding any earlier one.
+ *
+ * @param patch_id The first IMAGER_JOURNAL_ID_SIZE bytes of the ops hash.
+ * @return true on success.
+ */
+bool imager_journal_begin(const uint8_t *patch_id);
+
+/**
+ * @brief Save the new contents of a sector before it is rewritten.
+ *
+ * @param entry The sector and the position in the patch that follows it.
+ * @param data The FLASH_SECTOR_SZ bytes the sector is about to hold.
+ * @return true once both are safely in flash.
+ */
+bool imager_journal_append(const imager_journal_entry_t *entry,
+                           const uint8_t *data);
+
+/**
+ * @brief Find the last entry of the journal for a patch.
+ *
+ * Later calls to imager_journal_append() add to this journal.
+ *
+ * @param patch_id The first IMAGER_JOURNAL_ID_SIZE bytes of the ops hash.
+ * @param entry Receives the entry.
+ * @return The contents saved with the entry, or NULL if there is no journal
+ *         for the patch or it holds no intact entry.
+ */
+const uint8_t *imager_journal_last(const uint8_t *patch_id,
+                                   imager_journal_entry_t *entry);
+
+/**
+ * @brief Discard the journal, once the patch it records is complete.
+ *
+ * @return true on success.
+ */
+bool imager_journal_clear(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _IMAGER_JOURNAL_H_ */
@@ -0,0 +1,142 @@
+/**
+ * @file imager_manifest.c
+ *
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "imager_manifest.h"
+
+#include "definitions.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define IMAGER_MANIFEST_MAGIC 0x57494d32 // "WIM2"
+
+// The last erase block of flash, which the linker script keeps free.
+#define IMAGER_MANIFEST_ADDRESS                                                \
+  (FLASH_ADDR + FLASH_SIZE - NVMCTRL_FLASH_BLOCKSIZE)
+
+#define IMAGER_MANIFEST_PAGES                                                  \
+  ((sizeof(imager_manifest_t) + NVMCTRL_FLASH_PAGESIZE - 1) /                  \
+   NVMCTRL_FLASH_PAGESIZE)
+
+#define IMAGER_MANIFEST_NVM_ERRORS                                             \
+  (NVMCTRL_INTFLAG_ADDRE_Msk | NVMCTRL_INTFLAG_PROGE_Msk |                     \
+   NVMCTRL_INTFLAG_LOCKE_Msk | NVMCTRL_INTFLAG_NVME_Msk)
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Wait for the NVM controller to finish a command.
+ *
+ * @return false if the command failed.
+ */
+static bool imager_manifest_wait(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+// Pages are written from RAM, a whole page at a time.
+static uint32_t s_page[NVMCTRL_FLASH_PAGESIZE / sizeof(uint32_t)];
+
+// *****************************************************************************
+// Public code
+
+const imager_manifest_t *imager_manifest_load(void) {
+  const imager_manifest_t *manifest =
+      (const imager_manifest_t *)IMAGER_MANIFEST_ADDRESS;
+
+  if (manifest->magic != IMAGER_MANIFEST_MAGIC) {
+    return NULL;
+  }
+  if (manifest->crc !=
+      imager_manifest_crc32(manifest, offsetof(imager_manifest_t, crc))) {
+    return NULL;
+  }
+  return manifest;
+}
+
+bool imager_manifest_save(imager_manifest_t *manifest) {
+  const uint8_t *src = (const uint8_t *)manifest;
+  size_t remaining = sizeof(imager_manifest_t);
+  uint32_t address = IMAGER_MANIFEST_ADDRESS;
+
+  manifest->magic = IMAGER_MANIFEST_MAGIC;
+  manifest->crc =
+      imager_manifest_crc32(manifest, offsetof(imager_manifest_t, crc));
+
+  if (!imager_manifest_erase()) {
+    return false;
+  }
+  for (int i = 0; i < IMAGER_MANIFEST_PAGES; i++) {
+    size_t n = (remaining < sizeof(s_page)) ? remaining : sizeof(s_page);
+    memset(s_page, 0xff, sizeof(s_page));
+    memcpy(s_page, src, n);
+    NVMCTRL_PageWrite(s_page, address);
+    if (!imager_manifest_wait()) {
+      return false;
+    }
+    src += n;
+    remaining -= n;
+    address += NVMCTRL_FLASH_PAGESIZE;
+  }
+  return imager_manifest_load() != NULL;
+}
+
+bool imager_manifest_erase(void) {
+  NVMCTRL_BlockErase(IMAGER_MANIFEST_ADDRESS);
+  return imager_manifest_wait();
+}
+
+uint32_t imager_manifest_crc32(const void *data, size_t length) {
+  DMAC_CRC_SETUP setup;
+  uint32_t crc;
+
+  setup.polynomial_type = DMAC_CRC_TYPE_32;
+  setup.crc_mode = DMAC_CRC_MODE_DEFAULT;
+  setup.seed = 0xffffffff;
+
+  crc = DMAC_CRCCalculate((void *)data, length, setup);
+  DMAC_CRCDisable();
+  return crc;
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static bool imager_manifest_wait(void) {
+  while (NVMCTRL_IsBusy()) {
+    // The manifest is in the other flash bank, so code keeps running.
+  }
+  return (NVMCTRL_ErrorGet() & IMAGER_MANIFEST_NVM_ERRORS) == 0;
+}
@@ -0,0 +1,107 @@
+/**
+ * @file imager_manifest.h
+ *
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Record of the WINC image last verified by imager_task.
+ *
+ * The manifest is kept in the last erase block of internal flash, so it
+ * survives cold boots, which clear nv_data.  It lets imager_task skip reading
+ * the whole WINC flash when neither the image file nor the WINC firmware has
+ * changed since the last full comparison.
+ */
+
+#ifndef _IMAGER_MANIFEST_H_
+#define _IMAGER_MANIFEST_H_
+
+// *****************************************************************************
+// Includes
+
+#include "yb_hmac.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// One CRC per 4 KB sector of the WINC flash region.
+#define IMAGER_MANIFEST_SECTOR_COUNT 256
+
+typedef struct {
+  uint32_t magic;            // set by imager_manifest_save()
+  uint32_t region;           // WDRV_WINC_NVM_REGION the image was written to
+  uint32_t file_size;        // size of the image file
+  uint32_t file_stamp;       // FAT modification date << 16 | time of the file
+  uint32_t winc_version;     // working image version in the control sector
+  uint32_t winc_control_crc; // CRC of the control sector
+  uint8_t image_sha256[YB_SHA256_DIGEST_SIZE]; // hash of the image file
+  uint32_t sector_crcs[IMAGER_MANIFEST_SECTOR_COUNT]; // CRC-32 of each sector
+  uint32_t crc;              // CRC-32 of the fields above
+} imager_manifest_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Return the saved manifest, or NULL if none is saved or it is corrupt.
+ */
+const imager_manifest_t *imager_manifest_load(void);
+
+/**
+ * @brief Save a manifest, replacing any saved one.
+ *
+ * Sets the magic and crc fields of manifest before writing it.
+ *
+ * @return true on success.
+ */
+bool imager_manifest_save(imager_manifest_t *manifest);
+
+/**
+ * @brief Erase the saved manifest.
+ *
+ * Called before the WINC flash is changed, so that a reflash cut short by a
+ * reset is never mistaken for a complete one.
+ *
+ * @return true on success.
+ */
+bool imager_manifest_erase(void);
+
+/**
+ * @brief Return the CRC-32 of length bytes of data, using the DMAC CRC engine.
+ */
+uint32_t imager_manifest_crc32(const void *data, size_t length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _IMAGER_MANIFEST_H_ */
@@ -0,0 +1,95 @@
+/**
+ * @file imager_patch.c
+ *
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "imager_patch.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define IMAGER_PATCH_MAGIC 0x50574259 // "YBWP"
+#define IMAGER_PATCH_FORMAT 1
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Return the little-endian uint32 at buf.
+ */
+static uint32_t imager_patch_get_u32(const uint8_t *buf);
+
+// *****************************************************************************
+// Public code
+
+bool imager_patch_parse_header(const uint8_t *buf,
+                               imager_patch_header_t *header) {
+  if (imager_patch_get_u32(&buf[0]) != IMAGER_PATCH_MAGIC ||
+      imager_patch_get_u32(&buf[4]) != IMAGER_PATCH_FORMAT) {
+    return false;
+  }
+  header->source_size = imager_patch_get_u32(&buf[8]);
+  header->target_size = imager_patch_get_u32(&buf[12]);
+  header->source_version = imager_patch_get_u32(&buf[16]);
+  header->target_version = imager_patch_get_u32(&buf[20]);
+  memcpy(header->source_sha256, &buf[24], YB_SHA256_DIGEST_SIZE);
+  memcpy(header->target_sha256, &buf[56], YB_SHA256_DIGEST_SIZE);
+  memcpy(header->ops_sha256, &buf[88], YB_SHA256_DIGEST_SIZE);
+  return true;
+}
+
+bool imager_patch_parse_op(const uint8_t *buf, imager_patch_op_t *op) {
+  op->type = (imager_patch_op_type_t)buf[0];
+  op->offset = imager_patch_get_u32(&buf[1]);
+  op->length = imager_patch_get_u32(&buf[5]);
+  if (op->length == 0) {
+    return false;
+  }
+  switch (op->type) {
+  case IMAGER_PATCH_OP_COPY:
+    // guard against the offset wrapping when added to the length
+    return op->offset + op->length > op->offset;
+  case IMAGER_PATCH_OP_INSERT:
+    return op->offset == 0;
+  default:
+    return false;
+  }
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static uint32_t imager_patch_get_u32(const uint8_t *buf) {
+  return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+         ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
@@ -0,0 +1,114 @@
+/**
+ * @file imager_patch.h
+ *
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Format of the binary patches applied by imager_task.
+ *
+ * A patch rebuilds a WINC flash region (the target) from its current contents
+ * (the source).  It is a header followed by a stream of ops, each a fixed size
+ * op header optionally followed by data.  COPY takes bytes from the source at
+ * a given offset, INSERT takes them from the patch.  Together the ops produce
+ * the target in order.
+ *
+ * The patch is applied in place, one sector at a time, so a COPY into a target
+ * sector may only read from that sector or a later one: earlier sectors have
+ * already been rewritten.  tools/winc_patch.py makes patches that obey this.
+ * imager_journal.h describes how a patch cut short by a reset is resumed.
+ *
+ * All fields are little-endian.
+ */
+
+#ifndef _IMAGER_PATCH_H_
+#define _IMAGER_PATCH_H_
+
+// *****************************************************************************
+// Includes
+
+#include "yb_hmac.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define IMAGER_PATCH_HEADER_SIZE 120
+#define IMAGER_PATCH_OP_SIZE 9
+
+typedef struct {
+  uint32_t source_size;    // bytes of the region the patch applies to
+  uint32_t target_size;    // bytes of the region the patch produces
+  uint32_t source_version; // working firmware of the source, or 0 if unknown
+  uint32_t target_version; // working firmware of the target, or 0 if unknown
+  uint8_t source_sha256[YB_SHA256_DIGEST_SIZE]; // hash of the source bytes
+  uint8_t target_sha256[YB_SHA256_DIGEST_SIZE]; // hash of the target bytes
+  uint8_t ops_sha256[YB_SHA256_DIGEST_SIZE]; // hash of everything after header
+} imager_patch_header_t;
+
+typedef enum {
+  IMAGER_PATCH_OP_COPY = 1,   // copy length bytes of the source from offset
+  IMAGER_PATCH_OP_INSERT = 2, // the next length bytes of the patch
+} imager_patch_op_type_t;
+
+typedef struct {
+  imager_patch_op_type_t type;
+  uint32_t offset; // source offset of a COPY, 0 for an INSERT
+  uint32_t length;
+} imager_patch_op_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Decode a patch header.
+ *
+ * @param buf The first IMAGER_PATCH_HEADER_SIZE bytes of a file.
+ * @param header Receives the decoded header.
+ * @return false if the file is not a patch in a format this code understands.
+ */
+bool imager_patch_parse_header(const uint8_t *buf,
+                               imager_patch_header_t *header);
+
+/**
+ * @brief Decode an op header.
+ *
+ * @param buf IMAGER_PATCH_OP_SIZE bytes of the patch.
+ * @param op Receives the decoded op.
+ * @return false if the op is malformed.
+ */
+bool imager_patch_parse_op(const uint8_t *buf, imager_patch_op_t *op);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _IMAGER_PATCH_H_ */
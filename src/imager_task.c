@@ -31,32 +31,64 @@
 #include "imager_task.h"
 
 #include "definitions.h"
+#include "imager_journal.h"
+#include "imager_manifest.h"
+#include "imager_patch.h"
+#include "spi_flash.h"
 #include "spi_flash_map.h"
 #include "wdrv_winc_client_api.h"
+#include "yb_hmac.h"
 #include "yb_log.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 // *****************************************************************************
 // Local (private) types and definitions
 
-#define SECTOR_TO_OFFSET(_sector) ((_sector)*FLASH_SECTOR_SZ)
-// #define WINC_SECTOR_COUNT 128 // TODO: look up dynamically
-#define WINC_SECTOR_COUNT 256 // TODO: look up dynamically
-#define WINC_IMAGE_SIZE SECTOR_TO_OFFSET(WINC_SECTOR_COUNT)
+#define SECTOR_TO_OFFSET(_sector) ((uint32_t)(_sector)*FLASH_SECTOR_SZ)
+#define SECTOR_PAGES (FLASH_SECTOR_SZ / FLASH_PAGE_SZ)
+#define BYTES_TO_SECTORS(_bytes)                                               \
+  (((_bytes) + FLASH_SECTOR_SZ - 1) / FLASH_SECTOR_SZ)
+
+// WDRV_WINC_NVMEraseSector() numbers sectors with a uint8_t, and the manifest
+// holds a CRC for each sector, so a region may have no more sectors than this.
+#define MAX_REGION_SECTORS IMAGER_MANIFEST_SECTOR_COUNT
+
+// The sector holding the control structure, which names the working firmware.
+#define WINC_CONTROL_SECTOR (M2M_CONTROL_FLASH_OFFSET / FLASH_SECTOR_SZ)
+#define WINC_CONTROL_OFFSET (M2M_CONTROL_FLASH_OFFSET % FLASH_SECTOR_SZ)
+
+// When the manifest matches, this many sectors are read back from the WINC and
+// checked against their CRCs in the manifest.
+#define IMAGER_TASK_SPOT_CHECKS 4
+
+// The next sector of the image file is read from the SD card in slices of this
+// many bytes, each short enough to run while the WINC is busy with its flash.
+#define IMAGER_TASK_SLICE_SIZE 512
 
 #define STATES(M)                                                              \
   M(IMAGER_TASK_STATE_INIT)                                                    \
   M(IMAGER_TASK_STATE_OPENING_WINC)                                            \
+  M(IMAGER_TASK_STATE_LOCATING_REGION)                                         \
   M(IMAGER_TASK_STATE_VALIDATING_IMAGE_FILE)                                   \
   M(IMAGER_TASK_STATE_OPENING_IMAGE_FILE)                                      \
+  M(IMAGER_TASK_STATE_READING_WINC_VERSION)                                    \
+  M(IMAGER_TASK_STATE_CHECKING_MANIFEST)                                       \
+  M(IMAGER_TASK_STATE_SPOT_CHECKING_SECTORS)                                   \
+  M(IMAGER_TASK_STATE_CHECKING_PATCH)                                          \
+  M(IMAGER_TASK_STATE_HASHING_WINC_SECTORS)                                    \
+  M(IMAGER_TASK_STATE_STARTING_COMPARISON)                                     \
   M(IMAGER_TASK_STATE_COMPARING_SECTORS)                                       \
   M(IMAGER_TASK_STATE_READING_FILE_SECTOR)                                     \
+  M(IMAGER_TASK_STATE_PATCHING_SECTOR)                                         \
   M(IMAGER_TASK_STATE_READING_WINC_SECTOR)                                     \
   M(IMAGER_TASK_STATE_COMPARING_BUFFERS)                                       \
   M(IMAGER_TASK_STATE_ERASING_WINC_SECTOR)                                     \
-  M(IMAGER_TASK_STATE_WRITING_WINC_SECTOR)                                     \
+  M(IMAGER_TASK_STATE_WRITING_WINC_PAGES)                                      \
+  M(IMAGER_TASK_STATE_VERIFYING_WINC_SECTOR)                                   \
   M(IMAGER_TASK_STATE_INCREMENT_WRITE_SECTOR)                                  \
+  M(IMAGER_TASK_STATE_SAVING_MANIFEST)                                         \
   M(IMAGER_TASK_STATE_CLOSING_RESOURCES)                                       \
   M(IMAGER_TASK_STATE_SUCCESS)                                                 \
   M(IMAGER_TASK_STATE_ERROR)
@@ -64,12 +96,73 @@
 #define EXPAND_ENUM_ID(_name) _name,
 typedef enum { STATES(EXPAND_ENUM_ID) } imager_task_state_t;
 
+#define PHASES(M)                                                              \
+  M(IMAGER_TASK_PHASE_SD_READ)                                                 \
+  M(IMAGER_TASK_PHASE_PATCH)                                                   \
+  M(IMAGER_TASK_PHASE_WINC_READ)                                               \
+  M(IMAGER_TASK_PHASE_COMPARE)                                                 \
+  M(IMAGER_TASK_PHASE_ERASE)                                                   \
+  M(IMAGER_TASK_PHASE_WRITE)                                                   \
+  M(IMAGER_TASK_PHASE_VERIFY)
+
+typedef enum {
+  PHASES(EXPAND_ENUM_ID) IMAGER_TASK_PHASE_COUNT
+} imager_task_phase_t;
+
+typedef struct {
+  uint32_t bytes;
+  uint32_t ticks; // SYS_TIME counts, less any SD reads nested within
+} imager_task_phase_stats_t;
+
+typedef struct {
+  const char *name;
+  WDRV_WINC_NVM_REGION region;
+} imager_task_region_t;
+
 typedef struct {
   imager_task_state_t state;
   const char *filename;
+  const imager_task_region_t *region;
   SYS_FS_HANDLE file_handle;
   DRV_HANDLE winc_handle;
-  uint16_t sector;
+  uint32_t region_address; // start of the region in the WINC flash
+  uint16_t region_sectors; // size of the region in sectors
+  uint32_t image_size;     // bytes of the image the region is brought up to
+  uint16_t file_sectors;   // size of the image in sectors, rounded up
+  bool is_patch;           // the file is a patch rather than an image
+  imager_patch_header_t patch;
+  uint32_t patch_ops_size;   // bytes of the patch after its header
+  uint32_t patch_ops_hashed; // bytes of those hashed so far
+  imager_patch_op_t op;      // op being applied
+  uint32_t op_position;      // file offset of op
+  uint32_t op_done;          // bytes of op applied so far
+  yb_sha256_t source_hash;   // hash of the WINC region as the patch source
+  imager_journal_entry_t journal_entry; // last entry of the patch's journal
+  const uint8_t *journal_data; // sector saved with journal_entry, or NULL
+  bool resumed;                // the patch resumed from journal_entry
+  uint16_t sector;       // sector being compared against the WINC
+  uint16_t load_sector;  // sector being read from the file
+  size_t load_bytes;     // bytes of load_sector read so far
+  bool load_failed;      // a read of load_sector failed
+  uint16_t page_mask;    // pages of sector to program, one bit per page
+  bool needs_erase;      // sector must be erased before programming
+  uint16_t sectors_erased;  // # of sectors erased and reprogrammed
+  uint16_t sectors_patched; // # of sectors reprogrammed without an erase
+  uint16_t pages_written;   // # of pages programmed
+  uint32_t started_at;   // SYS_TIME count when the image file was opened
+  uint32_t phase_start;  // SYS_TIME count when the current phase began
+  uint32_t phase_hidden; // hidden_ticks when the current phase began
+  imager_task_phase_stats_t phases[IMAGER_TASK_PHASE_COUNT];
+  uint32_t hidden_bytes; // bytes read from SD while the WINC flash was busy
+  uint32_t hidden_ticks; // ...and the time spent doing so
+  uint32_t winc_version;     // working firmware version read from the WINC
+  uint32_t winc_control_crc; // CRC of the control structure read from the WINC
+  uint16_t spot_first;       // first sector eligible for spot checks
+  uint16_t spot_sectors;     // # of sectors eligible for spot checks
+  uint32_t spot_seed;        // state of the spot check sector generator
+  uint8_t spot_count;        // # of sectors spot checked so far
+  bool manifest_erased;      // the saved manifest has been erased
+  yb_sha256_t image_hash;    // hash of the image sectors so far
 } imager_task_ctx_t;
 
 // *****************************************************************************
@@ -79,6 +172,126 @@ static void imager_task_set_state(imager_task_state_t new_state);
 
 static const char *imager_task_state_name(imager_task_state_t state);
 
+/**
+ * @brief Return the region with the given name, or NULL if there is none.
+ */
+static const imager_task_region_t *imager_task_find_region(const char *name);
+
+/**
+ * @brief Return the number of bytes of the image in the given sector.
+ *
+ * This is a whole sector except perhaps for the last one.
+ */
+static size_t imager_task_sector_length(uint16_t sector);
+
+/**
+ * @brief Return the state that starts a full comparison of the region.
+ *
+ * A patch is checked against the WINC before it is applied.
+ */
+static imager_task_state_t imager_task_full_check_state(void);
+
+/**
+ * @brief Check the ops of the patch against the hash in its header.
+ *
+ * @return false if the ops could not be read or do not match.
+ */
+static bool imager_task_check_patch_ops(void);
+
+/**
+ * @brief Rebuild the current sector of the target in its file buffer.
+ *
+ * Applies the patch ops covering the sector, copying from the WINC region or
+ * reading from the patch.
+ *
+ * @return false if an op is malformed or reads from a rewritten sector.
+ */
+static bool imager_task_patch_sector(void);
+
+/**
+ * @brief Pick up a patch cut short by a reset where its journal left off.
+ *
+ * Restores the sector in journal_entry to its file buffer and the position in
+ * the patch that follows it.
+ *
+ * @return false if the journal does not fit the patch.
+ */
+static bool imager_task_resume_patch(void);
+
+/**
+ * @brief Return true if the current sector is the one restored from the
+ * journal, which is already in the journal and has all its bytes.
+ */
+static bool imager_task_is_resumed_sector(void);
+
+/**
+ * @brief Return the buffer that holds (or will hold) the given file sector.
+ *
+ * Sectors alternate between two buffers, so the next sector can be read from
+ * the SD card while the WINC is still working on the current one.
+ */
+static uint8_t *imager_task_file_buffer(uint16_t sector);
+
+/**
+ * @brief Read the next slice of load_sector from the image file.
+ *
+ * @param hidden true if called while the WINC flash is busy.
+ * @return false if the read failed.
+ */
+static bool imager_task_load_slice(bool hidden);
+
+/**
+ * @brief Read ahead into the next sector while the WINC flash is busy.
+ *
+ * Registered with spi_flash_set_busy_hook() while the image file is open.
+ */
+static void imager_task_flash_busy(void);
+
+/**
+ * @brief Find the pages of the current sector that differ from the WINC.
+ *
+ * Sets page_mask to the differing pages.  Programming can only clear bits, so
+ * needs_erase is set if any differing byte has a bit to set.
+ */
+static void imager_task_diff_pages(void);
+
+/**
+ * @brief Program the pages of the current sector named in page_mask.
+ *
+ * @return false if programming failed.
+ */
+static bool imager_task_write_pages(void);
+
+/**
+ * @brief Record the CRC of the file sector just compared in the manifest.
+ */
+static void imager_task_record_sector(void);
+
+/**
+ * @brief Return true if the saved manifest matches the image file and WINC.
+ */
+static bool imager_task_manifest_matches(const imager_manifest_t *saved);
+
+/**
+ * @brief Choose the sectors to spot check: for the raw region, those of the
+ * active firmware, otherwise the whole region.
+ */
+static void imager_task_set_spot_range(void);
+
+/**
+ * @brief Return the next sector to spot check.
+ */
+static uint16_t imager_task_spot_sector(void);
+
+static void imager_task_phase_begin(void);
+
+static void imager_task_phase_end(imager_task_phase_t phase, uint32_t bytes);
+
+/**
+ * @brief Log the time and throughput of each phase of the reflash.
+ */
+static void imager_task_log_stats(void);
+
 static void cleanup(void);
 
 // *****************************************************************************
@@ -86,43 +299,105 @@ static void cleanup(void);
 
 static imager_task_ctx_t s_imager_task_ctx;
 
-static uint8_t CACHE_ALIGN s_file_buffer[FLASH_SECTOR_SZ];
+static uint8_t CACHE_ALIGN s_file_buffers[2][FLASH_SECTOR_SZ];
 static uint8_t CACHE_ALIGN s_winc_buffer[FLASH_SECTOR_SZ];
 
+// Built up during a full comparison and saved when it completes.
+static imager_manifest_t s_manifest;
+
 #define EXPAND_NAME(_name) #_name,
 static const char *s_imager_task_state_names[] = {STATES(EXPAND_NAME)};
 
+static const char *s_imager_task_phase_names[] = {PHASES(EXPAND_NAME)};
+
+// Regions of the flexible flash map that an image file may target.
+static const imager_task_region_t s_imager_task_regions[] = {
+    {"raw", WDRV_WINC_NVM_REGION_RAW},
+    {"firmware", WDRV_WINC_NVM_REGION_FIRMWARE_ACTIVE},
+    {"firmware_inactive", WDRV_WINC_NVM_REGION_FIRMWARE_INACTIVE},
+    {"pll_gain", WDRV_WINC_NVM_REGION_PLL_AND_GAIN_TABLES},
+    {"root_certs", WDRV_WINC_NVM_REGION_ROOT_CERTS},
+    {"local_certs", WDRV_WINC_NVM_REGION_LOCAL_CERTS},
+    {"http_files", WDRV_WINC_NVM_REGION_HTTP_FILES},
+};
+
 // *****************************************************************************
 // Public code
 
-void imager_task_init(const char *filename) {
+void imager_task_init(const char *filename, const char *region) {
+  memset(&s_imager_task_ctx, 0, sizeof(s_imager_task_ctx));
+  memset(&s_manifest, 0, sizeof(s_manifest));
   s_imager_task_ctx.state = IMAGER_TASK_STATE_INIT;
   s_imager_task_ctx.filename = filename;
+  s_imager_task_ctx.region =
+      imager_task_find_region((region == NULL) ? "raw" : region);
 }
 
 void imager_task_step(void) {
   switch (s_imager_task_ctx.state) {
 
   case IMAGER_TASK_STATE_INIT: {
-    imager_task_set_state(IMAGER_TASK_STATE_OPENING_IMAGE_FILE);
+    if (s_imager_task_ctx.region == NULL) {
+      YB_LOG_ERROR("Unknown WINC flash region for %s",
+                   s_imager_task_ctx.filename);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    } else {
+      imager_task_set_state(IMAGER_TASK_STATE_OPENING_WINC);
+    }
   } break;
 
   case IMAGER_TASK_STATE_OPENING_WINC: {
+    if (SYS_STATUS_READY != WDRV_WINC_Status(sysObj.drvWifiWinc)) {
+      // remain in this state until the WINC driver is initialized
+      break;
+    }
     s_imager_task_ctx.winc_handle = WDRV_WINC_Open(0, DRV_IO_INTENT_EXCLUSIVE);
     if (s_imager_task_ctx.winc_handle != DRV_HANDLE_INVALID) {
       YB_LOG_DEBUG("Opened WINC1500");
-      imager_task_set_state(IMAGER_TASK_STATE_VALIDATING_IMAGE_FILE);
+      imager_task_set_state(IMAGER_TASK_STATE_LOCATING_REGION);
     } else {
       YB_LOG_ERROR("Unable to open WINC1500");
+      s_imager_task_ctx.winc_handle = 0;
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
     }
   } break;
 
+  case IMAGER_TASK_STATE_LOCATING_REGION: {
+    // The raw region's size comes from spi_flash_get_size(), the others from
+    // the flexible flash map.
+    uint32_t address;
+    uint32_t size;
+    if (WDRV_WINC_NVMRegionGet(s_imager_task_ctx.winc_handle,
+                               s_imager_task_ctx.region->region,
+                               &address,
+                               &size) != WDRV_WINC_STATUS_OK) {
+      YB_LOG_ERROR("Unable to locate WINC region %s",
+                   s_imager_task_ctx.region->name);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    } else if (((address | size) & (FLASH_SECTOR_SZ - 1)) != 0 ||
+               size / FLASH_SECTOR_SZ > MAX_REGION_SECTORS) {
+      YB_LOG_ERROR("WINC region %s (%ld bytes at 0x%lx) is unsupported",
+                   s_imager_task_ctx.region->name,
+                   size,
+                   address);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    } else {
+      YB_LOG_DEBUG("WINC region %s is %ld bytes at 0x%lx",
+                   s_imager_task_ctx.region->name,
+                   size,
+                   address);
+      s_imager_task_ctx.region_address = address;
+      s_imager_task_ctx.region_sectors = size / FLASH_SECTOR_SZ;
+      imager_task_set_state(IMAGER_TASK_STATE_VALIDATING_IMAGE_FILE);
+    }
+  } break;
+
   case IMAGER_TASK_STATE_VALIDATING_IMAGE_FILE: {
-    // Checking to see winc.img file exists and is the correct size.
+    // Checking to see winc.img file exists and fits the region.
     // Note: we deckare stat_buf as static since it is large and we don't want
     // to overflow the stack.
     static SYS_FS_FSTAT stat_buf;
+    uint32_t region_size = SECTOR_TO_OFFSET(s_imager_task_ctx.region_sectors);
 
     if (SYS_FS_FileStat(s_imager_task_ctx.filename, &stat_buf) !=
         SYS_FS_RES_SUCCESS) {
@@ -130,130 +405,482 @@ void imager_task_step(void) {
       YB_LOG_ERROR("Unable to determine size of %s",
                    s_imager_task_ctx.filename);
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
-    } else if (stat_buf.fsize != WINC_IMAGE_SIZE) {
-      // File size doesn't match WINC image size
-      YB_LOG_ERROR("Expected %s to be %ld bytes, but found %ld",
+    } else if (stat_buf.fsize == 0 || stat_buf.fsize > region_size) {
+      // File size doesn't fit the region
+      YB_LOG_ERROR("Expected %s to be at most %ld bytes, but found %ld",
                    s_imager_task_ctx.filename,
-                   WINC_IMAGE_SIZE,
+                   region_size,
                    stat_buf.fsize);
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
     } else {
-      // File looks like a WINC image.
+      // File looks like a WINC image (or a patch).
       YB_LOG_DEBUG("Found valid %s file", s_imager_task_ctx.filename);
+      s_imager_task_ctx.image_size = stat_buf.fsize;
+      s_manifest.region = s_imager_task_ctx.region->region;
+      s_manifest.file_size = stat_buf.fsize;
+      s_manifest.file_stamp = ((uint32_t)stat_buf.fdate << 16) | stat_buf.ftime;
       imager_task_set_state(IMAGER_TASK_STATE_OPENING_IMAGE_FILE);
     }
   } break;
 
   case IMAGER_TASK_STATE_OPENING_IMAGE_FILE: {
+    uint8_t *header = s_file_buffers[0];
+    uint32_t region_size = SECTOR_TO_OFFSET(s_imager_task_ctx.region_sectors);
+
     s_imager_task_ctx.file_handle =
         SYS_FS_FileOpen(s_imager_task_ctx.filename, SYS_FS_FILE_OPEN_READ);
-    if (s_imager_task_ctx.file_handle != SYS_FS_HANDLE_INVALID) {
-      YB_LOG_INFO("Comparing image file %s against WINC contents ",
+    if (s_imager_task_ctx.file_handle == SYS_FS_HANDLE_INVALID) {
+      YB_LOG_ERROR("Unable to open image file %s", s_imager_task_ctx.filename);
+      s_imager_task_ctx.file_handle = 0;
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+      break;
+    }
+    // A file that starts with a patch header is a patch, anything else is an
+    // image.
+    if (s_imager_task_ctx.image_size >= IMAGER_PATCH_HEADER_SIZE &&
+        SYS_FS_FileRead(s_imager_task_ctx.file_handle,
+                        header,
+                        IMAGER_PATCH_HEADER_SIZE) == IMAGER_PATCH_HEADER_SIZE &&
+        imager_patch_parse_header(header, &s_imager_task_ctx.patch)) {
+      imager_patch_header_t *patch = &s_imager_task_ctx.patch;
+      if (patch->target_size == 0 || patch->target_size > region_size ||
+          patch->source_size > region_size) {
+        YB_LOG_ERROR("Patch %s does not fit WINC region %s",
+                     s_imager_task_ctx.filename,
+                     s_imager_task_ctx.region->name);
+        imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+        break;
+      }
+      YB_LOG_INFO("%s patches %ld bytes into %ld bytes",
+                  s_imager_task_ctx.filename,
+                  patch->source_size,
+                  patch->target_size);
+      s_imager_task_ctx.is_patch = true;
+      s_imager_task_ctx.patch_ops_size =
+          s_imager_task_ctx.image_size - IMAGER_PATCH_HEADER_SIZE;
+      s_imager_task_ctx.image_size = patch->target_size;
+    }
+    s_imager_task_ctx.file_sectors =
+        BYTES_TO_SECTORS(s_imager_task_ctx.image_size);
+    imager_task_set_state(IMAGER_TASK_STATE_READING_WINC_VERSION);
+  } break;
+
+  case IMAGER_TASK_STATE_READING_WINC_VERSION: {
+    // The control structure names the firmware the WINC will run, and changes
+    // whenever that firmware does.
+    tstrOtaControlSec control;
+    if (WDRV_WINC_NVMRead(s_imager_task_ctx.winc_handle,
+                          WDRV_WINC_NVM_REGION_RAW,
+                          &control,
+                          M2M_CONTROL_FLASH_OFFSET,
+                          sizeof(control)) == WDRV_WINC_STATUS_OK) {
+      s_imager_task_ctx.winc_version =
+          control.u32OtaCurrentworkingImagFirmwareVer;
+      s_imager_task_ctx.winc_control_crc = control.u32OtaControlSecCrc;
+      // Unless the image rewrites the control sector, the WINC will go on
+      // reporting these.
+      s_manifest.winc_version = s_imager_task_ctx.winc_version;
+      s_manifest.winc_control_crc = s_imager_task_ctx.winc_control_crc;
+      imager_task_set_state(IMAGER_TASK_STATE_CHECKING_MANIFEST);
+    } else {
+      YB_LOG_ERROR("Failed to read WINC control sector");
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    }
+  } break;
+
+  case IMAGER_TASK_STATE_CHECKING_MANIFEST: {
+    const imager_manifest_t *saved = imager_manifest_load();
+    if (saved == NULL) {
+      YB_LOG_INFO("No WINC image manifest - comparing all sectors");
+      imager_task_set_state(imager_task_full_check_state());
+    } else if (!imager_task_manifest_matches(saved)) {
+      YB_LOG_INFO("%s or WINC firmware changed - comparing all sectors",
                   s_imager_task_ctx.filename);
-      s_imager_task_ctx.sector = 0;
-      imager_task_set_state(IMAGER_TASK_STATE_COMPARING_SECTORS);
+      imager_task_set_state(imager_task_full_check_state());
     } else {
-      YB_LOG_ERROR("Unable to open image file %s", s_imager_task_ctx.filename);
+      imager_task_set_spot_range();
+      s_imager_task_ctx.spot_count = 0;
+      s_imager_task_ctx.spot_seed = SYS_TIME_CounterGet();
+      s_imager_task_ctx.started_at = SYS_TIME_CounterGet();
+      imager_task_set_state(IMAGER_TASK_STATE_SPOT_CHECKING_SECTORS);
+    }
+  } break;
+
+  case IMAGER_TASK_STATE_SPOT_CHECKING_SECTORS: {
+    if (s_imager_task_ctx.spot_count == IMAGER_TASK_SPOT_CHECKS) {
+      YB_LOG_INFO("WINC firmware matches manifest for %s, spot checked %d "
+                  "sectors in %d ms",
+                  s_imager_task_ctx.filename,
+                  IMAGER_TASK_SPOT_CHECKS,
+                  (int)SYS_TIME_CountToMS(SYS_TIME_CounterGet() -
+                                          s_imager_task_ctx.started_at));
+      imager_task_set_state(IMAGER_TASK_STATE_CLOSING_RESOURCES);
+      break;
+    }
+    uint16_t sector = imager_task_spot_sector();
+    imager_task_phase_begin();
+    if (WDRV_WINC_NVMRead(s_imager_task_ctx.winc_handle,
+                          s_imager_task_ctx.region->region,
+                          s_winc_buffer,
+                          SECTOR_TO_OFFSET(sector),
+                          FLASH_SECTOR_SZ) != WDRV_WINC_STATUS_OK) {
+      YB_LOG_ERROR("Failed to read sector %d from WINC", sector);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+      break;
+    }
+    imager_task_phase_end(IMAGER_TASK_PHASE_WINC_READ, FLASH_SECTOR_SZ);
+    if (imager_manifest_crc32(s_winc_buffer, FLASH_SECTOR_SZ) !=
+        imager_manifest_load()->sector_crcs[sector]) {
+      YB_LOG_WARN("WINC sector %d differs from manifest - comparing all "
+                  "sectors",
+                  sector);
+      imager_task_set_state(imager_task_full_check_state());
+    } else {
+      s_imager_task_ctx.spot_count += 1;
+    }
+  } break;
+
+  case IMAGER_TASK_STATE_CHECKING_PATCH: {
+    // Before touching the WINC, make sure the patch is intact and meant for
+    // the firmware the WINC holds.
+    imager_patch_header_t *patch = &s_imager_task_ctx.patch;
+    // A reset part way through the patch may have left the control sector
+    // half written, so its version is only checked when there is no journal.
+    s_imager_task_ctx.journal_data = imager_journal_last(
+        patch->ops_sha256, &s_imager_task_ctx.journal_entry);
+    if (s_imager_task_ctx.region->region == WDRV_WINC_NVM_REGION_RAW &&
+        s_imager_task_ctx.journal_data == NULL &&
+        patch->source_version != 0 &&
+        s_imager_task_ctx.winc_version != patch->source_version &&
+        s_imager_task_ctx.winc_version != patch->target_version) {
+      YB_LOG_ERROR("%s patches WINC firmware 0x%lx, but found 0x%lx",
+                   s_imager_task_ctx.filename,
+                   patch->source_version,
+                   s_imager_task_ctx.winc_version);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    } else if (!imager_task_check_patch_ops()) {
+      YB_LOG_ERROR("Patch %s is corrupt", s_imager_task_ctx.filename);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    } else {
+      s_imager_task_ctx.sector = 0;
+      s_imager_task_ctx.started_at = SYS_TIME_CounterGet();
+      yb_sha256_init(&s_imager_task_ctx.source_hash);
+      yb_sha256_init(&s_imager_task_ctx.image_hash);
+      imager_task_set_state(IMAGER_TASK_STATE_HASHING_WINC_SECTORS);
+    }
+  } break;
+
+  case IMAGER_TASK_STATE_HASHING_WINC_SECTORS: {
+    // Hash the region both as the patch source and as its target: a patch
+    // applied on an earlier boot leaves the WINC matching the target.
+    imager_patch_header_t *patch = &s_imager_task_ctx.patch;
+    uint32_t hash_size = (patch->source_size > patch->target_size)
+                             ? patch->source_size
+                             : patch->target_size;
+    uint8_t digest[YB_SHA256_DIGEST_SIZE];
+
+    if (s_imager_task_ctx.sector == BYTES_TO_SECTORS(hash_size)) {
+      yb_sha256_final(&s_imager_task_ctx.image_hash, s_manifest.image_sha256);
+      yb_sha256_final(&s_imager_task_ctx.source_hash, digest);
+      if (memcmp(s_manifest.image_sha256,
+                 patch->target_sha256,
+                 YB_SHA256_DIGEST_SIZE) == 0) {
+        // The sector CRCs were recorded while hashing.
+        YB_LOG_INFO("WINC region %s %s by %s",
+                    s_imager_task_ctx.region->name,
+                    s_imager_task_ctx.resumed ? "patched" : "already patched",
+                    s_imager_task_ctx.filename);
+        imager_task_set_state(IMAGER_TASK_STATE_SAVING_MANIFEST);
+      } else if (memcmp(digest, patch->source_sha256, YB_SHA256_DIGEST_SIZE) ==
+                 0) {
+        imager_task_set_state(IMAGER_TASK_STATE_STARTING_COMPARISON);
+      } else if (s_imager_task_ctx.journal_data != NULL &&
+                 !s_imager_task_ctx.resumed) {
+        // Cut short by a reset: the target up to the journaled sector, the
+        // source after it.
+        imager_task_set_state(imager_task_resume_patch()
+                                  ? IMAGER_TASK_STATE_READING_WINC_SECTOR
+                                  : IMAGER_TASK_STATE_ERROR);
+      } else {
+        YB_LOG_ERROR("WINC region %s matches neither the source nor the "
+                     "target of %s",
+                     s_imager_task_ctx.region->name,
+                     s_imager_task_ctx.filename);
+        imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+      }
+      break;
+    }
+
+    uint32_t offset = SECTOR_TO_OFFSET(s_imager_task_ctx.sector);
+    imager_task_phase_begin();
+    if (WDRV_WINC_NVMRead(s_imager_task_ctx.winc_handle,
+                          s_imager_task_ctx.region->region,
+                          s_winc_buffer,
+                          offset,
+                          FLASH_SECTOR_SZ) != WDRV_WINC_STATUS_OK) {
+      YB_LOG_ERROR("Failed to read sector %d from WINC",
+                   s_imager_task_ctx.sector);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+      break;
+    }
+    imager_task_phase_end(IMAGER_TASK_PHASE_WINC_READ, FLASH_SECTOR_SZ);
+    if (offset < patch->source_size) {
+      uint32_t n = patch->source_size - offset;
+      yb_sha256_update(&s_imager_task_ctx.source_hash,
+                       s_winc_buffer,
+                       (n < FLASH_SECTOR_SZ) ? n : FLASH_SECTOR_SZ);
+    }
+    if (offset < patch->target_size) {
+      uint32_t n = patch->target_size - offset;
+      yb_sha256_update(&s_imager_task_ctx.image_hash,
+                       s_winc_buffer,
+                       (n < FLASH_SECTOR_SZ) ? n : FLASH_SECTOR_SZ);
+      s_manifest.sector_crcs[s_imager_task_ctx.sector] =
+          imager_manifest_crc32(s_winc_buffer, FLASH_SECTOR_SZ);
+    }
+    s_imager_task_ctx.sector += 1;
+  } break;
+
+  case IMAGER_TASK_STATE_STARTING_COMPARISON: {
+    // Rewind to the first sector of the image or the first op of the patch.
+    int32_t start = s_imager_task_ctx.is_patch ? IMAGER_PATCH_HEADER_SIZE : 0;
+    if (SYS_FS_FileSeek(s_imager_task_ctx.file_handle,
+                        start,
+                        SYS_FS_SEEK_SET) < 0) {
+      YB_LOG_ERROR("Unable to rewind %s", s_imager_task_ctx.filename);
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+      break;
     }
+    YB_LOG_INFO("%s %s against WINC region %s",
+                s_imager_task_ctx.is_patch ? "Applying patch" : "Comparing",
+                s_imager_task_ctx.filename,
+                s_imager_task_ctx.region->name);
+    s_imager_task_ctx.sector = 0;
+    s_imager_task_ctx.load_sector = 0;
+    s_imager_task_ctx.load_bytes = 0;
+    s_imager_task_ctx.op.length = 0;
+    s_imager_task_ctx.op_done = 0;
+    s_imager_task_ctx.started_at = SYS_TIME_CounterGet();
+    memset(s_imager_task_ctx.phases, 0, sizeof(s_imager_task_ctx.phases));
+    yb_sha256_init(&s_imager_task_ctx.image_hash);
+    if (!s_imager_task_ctx.is_patch) {
+      // The file is read in order, so only an image can be read ahead.
+      spi_flash_set_busy_hook(imager_task_flash_busy);
+    }
+    imager_task_set_state(IMAGER_TASK_STATE_COMPARING_SECTORS);
   } break;
 
   case IMAGER_TASK_STATE_COMPARING_SECTORS: {
-    if (s_imager_task_ctx.sector == WINC_SECTOR_COUNT) {
+    if (s_imager_task_ctx.sector == s_imager_task_ctx.file_sectors &&
+        s_imager_task_ctx.resumed) {
+      // Only the sectors from the journal on were hashed, so hash the whole
+      // region again to check the result.
+      YB_LOG_INFO("Finished resumed patch %s", s_imager_task_ctx.filename);
+      imager_task_log_stats();
+      s_imager_task_ctx.sector = 0;
+      yb_sha256_init(&s_imager_task_ctx.source_hash);
+      yb_sha256_init(&s_imager_task_ctx.image_hash);
+      imager_task_set_state(IMAGER_TASK_STATE_HASHING_WINC_SECTORS);
+    } else if (s_imager_task_ctx.sector == s_imager_task_ctx.file_sectors) {
+      yb_sha256_final(&s_imager_task_ctx.image_hash, s_manifest.image_sha256);
+      if (s_imager_task_ctx.is_patch &&
+          memcmp(s_manifest.image_sha256,
+                 s_imager_task_ctx.patch.target_sha256,
+                 YB_SHA256_DIGEST_SIZE) != 0) {
+        YB_LOG_ERROR("WINC region %s does not match the target of %s",
+                     s_imager_task_ctx.region->name,
+                     s_imager_task_ctx.filename);
+        imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+        break;
+      }
       YB_LOG_INFO("WINC firmware matches %s", s_imager_task_ctx.filename);
-      imager_task_set_state(IMAGER_TASK_STATE_CLOSING_RESOURCES);
+      imager_task_log_stats();
+      imager_task_set_state(IMAGER_TASK_STATE_SAVING_MANIFEST);
     } else {
       YB_LOG_DEBUG("Comparing sector %d out of %d",
                    s_imager_task_ctx.sector,
-                   WINC_SECTOR_COUNT);
-      imager_task_set_state(IMAGER_TASK_STATE_READING_FILE_SECTOR);
+                   s_imager_task_ctx.file_sectors);
+      imager_task_set_state(s_imager_task_ctx.is_patch
+                                ? IMAGER_TASK_STATE_PATCHING_SECTOR
+                                : IMAGER_TASK_STATE_READING_FILE_SECTOR);
     }
   } break;
 
   case IMAGER_TASK_STATE_READING_FILE_SECTOR: {
-    size_t n_read = SYS_FS_FileRead(
-        s_imager_task_ctx.file_handle, s_file_buffer, FLASH_SECTOR_SZ);
-    if (n_read == FLASH_SECTOR_SZ) {
-      imager_task_set_state(IMAGER_TASK_STATE_READING_WINC_SECTOR);
-    } else if (n_read == -1) {
-      YB_LOG_ERROR("Reading image file %s failed", s_imager_task_ctx.filename);
+    // Finish whatever of this sector was not read ahead while the WINC was
+    // busy with the previous one, then start reading ahead into the next.
+    size_t length = imager_task_sector_length(s_imager_task_ctx.sector);
+    while (!s_imager_task_ctx.load_failed &&
+           s_imager_task_ctx.load_bytes < length) {
+      imager_task_load_slice(false);
+    }
+    if (s_imager_task_ctx.load_failed) {
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
     } else {
-      YB_LOG_ERROR("Read %ld bytes from %s, expected %ld",
-                   n_read,
-                   s_imager_task_ctx.filename,
-                   FLASH_SECTOR_SZ);
+      s_imager_task_ctx.load_sector = s_imager_task_ctx.sector + 1;
+      s_imager_task_ctx.load_bytes = 0;
+      imager_task_set_state(IMAGER_TASK_STATE_READING_WINC_SECTOR);
+    }
+  } break;
+
+  case IMAGER_TASK_STATE_PATCHING_SECTOR: {
+    // Rebuild this sector of the target from the WINC and the patch.
+    imager_task_phase_begin();
+    if (imager_task_patch_sector()) {
+      imager_task_phase_end(
+          IMAGER_TASK_PHASE_PATCH,
+          imager_task_sector_length(s_imager_task_ctx.sector));
+      imager_task_set_state(IMAGER_TASK_STATE_READING_WINC_SECTOR);
+    } else {
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
     }
   } break;
 
   case IMAGER_TASK_STATE_READING_WINC_SECTOR: {
+    imager_task_phase_begin();
     if (WDRV_WINC_NVMRead(s_imager_task_ctx.winc_handle,
-                          WDRV_WINC_NVM_REGION_RAW,
+                          s_imager_task_ctx.region->region,
                           s_winc_buffer,
                           SECTOR_TO_OFFSET(s_imager_task_ctx.sector),
                           FLASH_SECTOR_SZ) == WDRV_WINC_STATUS_OK) {
+      imager_task_phase_end(IMAGER_TASK_PHASE_WINC_READ, FLASH_SECTOR_SZ);
       imager_task_set_state(IMAGER_TASK_STATE_COMPARING_BUFFERS);
     } else {
-      YB_LOG_ERROR("Failed to read %ld bytes from %s",
-                   FLASH_SECTOR_SZ,
-                   s_imager_task_ctx.filename);
+      YB_LOG_ERROR("Failed to read sector %d from WINC",
+                   s_imager_task_ctx.sector);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
     }
   } break;
 
   case IMAGER_TASK_STATE_COMPARING_BUFFERS: {
-    bool buffers_differ = false;
-    for (int i = 0; i < FLASH_SECTOR_SZ; i++) {
-      if (s_winc_buffer[i] != s_file_buffer[i]) {
-        buffers_differ = true;
-        break;
-      }
+    size_t length = imager_task_sector_length(s_imager_task_ctx.sector);
+    uint8_t *file_buffer = imager_task_file_buffer(s_imager_task_ctx.sector);
+    imager_task_phase_begin();
+    if (!imager_task_is_resumed_sector()) {
+      // Beyond the end of the file, keep what the WINC already has.
+      memcpy(file_buffer + length,
+             s_winc_buffer + length,
+             FLASH_SECTOR_SZ - length);
     }
-    if (!buffers_differ) {
+    imager_task_diff_pages();
+    imager_task_record_sector();
+    imager_task_phase_end(IMAGER_TASK_PHASE_COMPARE, FLASH_SECTOR_SZ);
+    if (s_imager_task_ctx.page_mask == 0) {
       // buffers match - advance to next sector
       YB_LOG_INFO(".");
       imager_task_set_state(IMAGER_TASK_STATE_INCREMENT_WRITE_SECTOR);
-    } else {
+      break;
+    }
+    if (!s_imager_task_ctx.manifest_erased) {
+      // Until the full comparison completes, the WINC matches no manifest.
+      if (!imager_manifest_erase()) {
+        YB_LOG_WARN("Unable to erase WINC image manifest");
+      }
+      s_imager_task_ctx.manifest_erased = true;
+      if (s_imager_task_ctx.is_patch &&
+          !imager_journal_begin(s_imager_task_ctx.patch.ops_sha256)) {
+        YB_LOG_ERROR("Unable to start a journal for %s",
+                     s_imager_task_ctx.filename);
+        imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+        break;
+      }
+    }
+    if (s_imager_task_ctx.is_patch && !imager_task_is_resumed_sector()) {
+      // The sector's old contents are needed to rebuild it, so save the new
+      // ones before changing it.
+      imager_journal_entry_t entry = {
+          .sector = s_imager_task_ctx.sector,
+          .op_position = s_imager_task_ctx.op_position,
+          .op_done = s_imager_task_ctx.op_done,
+      };
+      if (!imager_journal_append(&entry, file_buffer)) {
+        YB_LOG_ERROR("Unable to journal sector %d", s_imager_task_ctx.sector);
+        imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+        break;
+      }
+    }
+    if (s_imager_task_ctx.needs_erase) {
       // buffers differ - erase and overwrite this sector
       imager_task_set_state(IMAGER_TASK_STATE_ERASING_WINC_SECTOR);
+    } else {
+      // only bits to clear - program the differing pages in place
+      s_imager_task_ctx.sectors_patched += 1;
+      imager_task_set_state(IMAGER_TASK_STATE_WRITING_WINC_PAGES);
     }
   } break;
 
   case IMAGER_TASK_STATE_ERASING_WINC_SECTOR: {
     // Erase sector in preparation for overwriting
     YB_LOG_INFO("!");
+    imager_task_phase_begin();
     if (WDRV_WINC_NVMEraseSector(s_imager_task_ctx.winc_handle,
-                                 WDRV_WINC_NVM_REGION_RAW,
+                                 s_imager_task_ctx.region->region,
                                  s_imager_task_ctx.sector,
                                  1) == WDRV_WINC_STATUS_OK) {
+      imager_task_phase_end(IMAGER_TASK_PHASE_ERASE, FLASH_SECTOR_SZ);
       YB_LOG_DEBUG("Erased sector %d", s_imager_task_ctx.sector);
-      imager_task_set_state(IMAGER_TASK_STATE_WRITING_WINC_SECTOR);
+      s_imager_task_ctx.sectors_erased += 1;
+      // The sector now reads as all ones: program every page that doesn't.
+      memset(s_winc_buffer, 0xff, FLASH_SECTOR_SZ);
+      imager_task_diff_pages();
+      imager_task_set_state(IMAGER_TASK_STATE_WRITING_WINC_PAGES);
     } else {
-      YB_LOG_ERROR("Erasing sector %s failed", s_imager_task_ctx.sector);
+      YB_LOG_ERROR("Erasing sector %d failed", s_imager_task_ctx.sector);
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
     }
   } break;
 
-  case IMAGER_TASK_STATE_WRITING_WINC_SECTOR: {
-    // image file sector is already in s_sector_buf.  Write to WINC.
-    if (WDRV_WINC_NVMWrite(s_imager_task_ctx.winc_handle,
-                           WDRV_WINC_NVM_REGION_RAW,
-                           s_file_buffer,
-                           SECTOR_TO_OFFSET(s_imager_task_ctx.sector),
-                           FLASH_SECTOR_SZ) == WDRV_WINC_STATUS_OK) {
+  case IMAGER_TASK_STATE_WRITING_WINC_PAGES: {
+    // image file sector is already in its file buffer.  Write to WINC.
+    if (imager_task_write_pages()) {
       YB_LOG_DEBUG("Wrote sector %d", s_imager_task_ctx.sector);
-      imager_task_set_state(IMAGER_TASK_STATE_INCREMENT_WRITE_SECTOR);
+      imager_task_set_state(IMAGER_TASK_STATE_VERIFYING_WINC_SECTOR);
     } else {
-      YB_LOG_ERROR("Writing sector %s failed", s_imager_task_ctx.sector);
+      YB_LOG_ERROR("Writing sector %d failed", s_imager_task_ctx.sector);
       imager_task_set_state(IMAGER_TASK_STATE_ERROR);
     }
   } break;
 
+  case IMAGER_TASK_STATE_VERIFYING_WINC_SECTOR: {
+    // Read the sector back and check it against the CRC of the file sector.
+    imager_task_phase_begin();
+    if (WDRV_WINC_NVMRead(s_imager_task_ctx.winc_handle,
+                          s_imager_task_ctx.region->region,
+                          s_winc_buffer,
+                          SECTOR_TO_OFFSET(s_imager_task_ctx.sector),
+                          FLASH_SECTOR_SZ) != WDRV_WINC_STATUS_OK) {
+      YB_LOG_ERROR("Failed to read back sector %d from WINC",
+                   s_imager_task_ctx.sector);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    } else if (imager_manifest_crc32(s_winc_buffer, FLASH_SECTOR_SZ) !=
+               s_manifest.sector_crcs[s_imager_task_ctx.sector]) {
+      YB_LOG_ERROR("Sector %d failed verification", s_imager_task_ctx.sector);
+      imager_task_set_state(IMAGER_TASK_STATE_ERROR);
+    } else {
+      imager_task_phase_end(IMAGER_TASK_PHASE_VERIFY, FLASH_SECTOR_SZ);
+      imager_task_set_state(IMAGER_TASK_STATE_INCREMENT_WRITE_SECTOR);
+    }
+  } break;
+
   case IMAGER_TASK_STATE_INCREMENT_WRITE_SECTOR: {
     s_imager_task_ctx.sector += 1;
     imager_task_set_state(IMAGER_TASK_STATE_COMPARING_SECTORS);
   } break;
 
+  case IMAGER_TASK_STATE_SAVING_MANIFEST: {
+    // Any patch is complete, and its journal must not be replayed.
+    if (!imager_journal_clear()) {
+      YB_LOG_WARN("Unable to clear WINC patch journal");
+    }
+    // A failure here only costs a full comparison on the next cold boot.
+    if (imager_manifest_save(&s_manifest)) {
+      YB_LOG_INFO("Saved WINC image manifest");
+    } else {
+      YB_LOG_WARN("Unable to save WINC image manifest");
+    }
+    imager_task_set_state(IMAGER_TASK_STATE_CLOSING_RESOURCES);
+  } break;
+
   case IMAGER_TASK_STATE_CLOSING_RESOURCES: {
     // Close file and WINC before declaring success
     cleanup();
@@ -297,15 +924,373 @@ static const char *imager_task_state_name(imager_task_state_t state) {
   return s_imager_task_state_names[state];
 }
 
+static const imager_task_region_t *imager_task_find_region(const char *name) {
+  size_t n = sizeof(s_imager_task_regions) / sizeof(s_imager_task_regions[0]);
+  for (size_t i = 0; i < n; i++) {
+    if (strcmp(s_imager_task_regions[i].name, name) == 0) {
+      return &s_imager_task_regions[i];
+    }
+  }
+  return NULL;
+}
+
+static size_t imager_task_sector_length(uint16_t sector) {
+  uint32_t remaining = s_imager_task_ctx.image_size - SECTOR_TO_OFFSET(sector);
+  return (remaining < FLASH_SECTOR_SZ) ? remaining : FLASH_SECTOR_SZ;
+}
+
+static imager_task_state_t imager_task_full_check_state(void) {
+  return s_imager_task_ctx.is_patch ? IMAGER_TASK_STATE_CHECKING_PATCH
+                                    : IMAGER_TASK_STATE_STARTING_COMPARISON;
+}
+
+static bool imager_task_check_patch_ops(void) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  uint8_t digest[YB_SHA256_DIGEST_SIZE];
+  uint32_t hashed = 0;
+
+  if (SYS_FS_FileSeek(ctx->file_handle,
+                      IMAGER_PATCH_HEADER_SIZE,
+                      SYS_FS_SEEK_SET) < 0) {
+    return false;
+  }
+  yb_sha256_init(&ctx->image_hash);
+  while (hashed < ctx->patch_ops_size) {
+    size_t n = ctx->patch_ops_size - hashed;
+    if (n > FLASH_SECTOR_SZ) {
+      n = FLASH_SECTOR_SZ;
+    }
+    if (SYS_FS_FileRead(ctx->file_handle, s_file_buffers[0], n) != n) {
+      return false;
+    }
+    yb_sha256_update(&ctx->image_hash, s_file_buffers[0], n);
+    hashed += n;
+  }
+  yb_sha256_final(&ctx->image_hash, digest);
+  return memcmp(digest, ctx->patch.ops_sha256, YB_SHA256_DIGEST_SIZE) == 0;
+}
+
+static bool imager_task_patch_sector(void) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  uint8_t *buffer = imager_task_file_buffer(ctx->sector);
+  uint32_t sector_start = SECTOR_TO_OFFSET(ctx->sector);
+  size_t length = imager_task_sector_length(ctx->sector);
+  size_t filled = 0;
+
+  while (filled < length) {
+    if (ctx->op_done == ctx->op.length) {
+      uint8_t op[IMAGER_PATCH_OP_SIZE];
+      int32_t position = SYS_FS_FileTell(ctx->file_handle);
+      if (position < 0 ||
+          SYS_FS_FileRead(ctx->file_handle, op, sizeof(op)) != sizeof(op) ||
+          !imager_patch_parse_op(op, &ctx->op)) {
+        YB_LOG_ERROR("Bad op in %s at sector %d", ctx->filename, ctx->sector);
+        return false;
+      }
+      ctx->op_position = position;
+      ctx->op_done = 0;
+    }
+    size_t n = ctx->op.length - ctx->op_done;
+    if (n > length - filled) {
+      n = length - filled;
+    }
+    if (ctx->op.type == IMAGER_PATCH_OP_INSERT) {
+      if (SYS_FS_FileRead(ctx->file_handle, buffer + filled, n) != n) {
+        YB_LOG_ERROR("Reading sector %d of %s failed",
+                     ctx->sector,
+                     ctx->filename);
+        return false;
+      }
+    } else {
+      uint32_t source = ctx->op.offset + ctx->op_done;
+      // Sectors before this one have already been rewritten.
+      if (source < sector_start || source + n > ctx->patch.source_size) {
+        YB_LOG_ERROR("%s copies from 0x%lx into sector %d",
+                     ctx->filename,
+                     source,
+                     ctx->sector);
+        return false;
+      }
+      if (WDRV_WINC_NVMRead(ctx->winc_handle,
+                            ctx->region->region,
+                            buffer + filled,
+                            source,
+                            n) != WDRV_WINC_STATUS_OK) {
+        YB_LOG_ERROR("Failed to read 0x%lx from WINC", source);
+        return false;
+      }
+    }
+    ctx->op_done += n;
+    filled += n;
+  }
+  return true;
+}
+
+static bool imager_task_resume_patch(void) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  const imager_journal_entry_t *entry = &ctx->journal_entry;
+  uint8_t op[IMAGER_PATCH_OP_SIZE];
+  uint32_t position = entry->op_position + IMAGER_PATCH_OP_SIZE;
+
+  if (entry->sector >= ctx->file_sectors ||
+      SYS_FS_FileSeek(ctx->file_handle,
+                      entry->op_position,
+                      SYS_FS_SEEK_SET) < 0 ||
+      SYS_FS_FileRead(ctx->file_handle, op, sizeof(op)) != sizeof(op) ||
+      !imager_patch_parse_op(op, &ctx->op) ||
+      entry->op_done > ctx->op.length) {
+    YB_LOG_ERROR("Journal does not fit %s", ctx->filename);
+    return false;
+  }
+  // An INSERT resumes part way through its bytes.
+  if (ctx->op.type == IMAGER_PATCH_OP_INSERT) {
+    position += entry->op_done;
+  }
+  if (SYS_FS_FileSeek(ctx->file_handle, position, SYS_FS_SEEK_SET) < 0) {
+    YB_LOG_ERROR("Unable to seek in %s", ctx->filename);
+    return false;
+  }
+  YB_LOG_INFO("Resuming patch %s at sector %d of %d",
+              ctx->filename,
+              entry->sector,
+              ctx->file_sectors);
+  ctx->op_position = entry->op_position;
+  ctx->op_done = entry->op_done;
+  ctx->sector = entry->sector;
+  memcpy(imager_task_file_buffer(ctx->sector),
+         ctx->journal_data,
+         FLASH_SECTOR_SZ);
+  ctx->resumed = true;
+  // The manifest was erased before the journal was started.
+  ctx->manifest_erased = true;
+  ctx->started_at = SYS_TIME_CounterGet();
+  memset(ctx->phases, 0, sizeof(ctx->phases));
+  yb_sha256_init(&ctx->image_hash);
+  return true;
+}
+
+static bool imager_task_is_resumed_sector(void) {
+  return s_imager_task_ctx.resumed &&
+         s_imager_task_ctx.sector == s_imager_task_ctx.journal_entry.sector;
+}
+
+static uint8_t *imager_task_file_buffer(uint16_t sector) {
+  return s_file_buffers[sector & 1];
+}
+
+static bool imager_task_load_slice(bool hidden) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  size_t n_wanted = imager_task_sector_length(ctx->load_sector) -
+                    ctx->load_bytes;
+  if (n_wanted > IMAGER_TASK_SLICE_SIZE) {
+    n_wanted = IMAGER_TASK_SLICE_SIZE;
+  }
+
+  uint32_t start = SYS_TIME_CounterGet();
+  size_t n_read =
+      SYS_FS_FileRead(ctx->file_handle,
+                      imager_task_file_buffer(ctx->load_sector) +
+                          ctx->load_bytes,
+                      n_wanted);
+  uint32_t ticks = SYS_TIME_CounterGet() - start;
+
+  if (n_read != n_wanted) {
+    // Report once: later calls see load_failed and do nothing.
+    YB_LOG_ERROR("Reading sector %d of %s failed",
+                 ctx->load_sector,
+                 ctx->filename);
+    ctx->load_failed = true;
+    return false;
+  }
+  ctx->load_bytes += n_read;
+  ctx->phases[IMAGER_TASK_PHASE_SD_READ].bytes += n_read;
+  ctx->phases[IMAGER_TASK_PHASE_SD_READ].ticks += ticks;
+  if (hidden) {
+    ctx->hidden_bytes += n_read;
+    ctx->hidden_ticks += ticks;
+  }
+  return true;
+}
+
+static void imager_task_flash_busy(void) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  // The sector being read ahead never shares a buffer with ctx->sector, which
+  // is the one the WINC may be reading from or writing to.
+  if (ctx->load_sector < ctx->file_sectors && !ctx->load_failed &&
+      ctx->load_bytes < imager_task_sector_length(ctx->load_sector)) {
+    imager_task_load_slice(true);
+  }
+}
+
+static void imager_task_diff_pages(void) {
+  const uint8_t *file_buffer =
+      imager_task_file_buffer(s_imager_task_ctx.sector);
+
+  s_imager_task_ctx.page_mask = 0;
+  s_imager_task_ctx.needs_erase = false;
+  for (int page = 0; page < SECTOR_PAGES; page++) {
+    const uint8_t *want = file_buffer + page * FLASH_PAGE_SZ;
+    const uint8_t *have = s_winc_buffer + page * FLASH_PAGE_SZ;
+    if (memcmp(want, have, FLASH_PAGE_SZ) == 0) {
+      continue;
+    }
+    s_imager_task_ctx.page_mask |= 1 << page;
+    for (int i = 0; i < FLASH_PAGE_SZ; i++) {
+      if ((want[i] & ~have[i]) != 0) {
+        s_imager_task_ctx.needs_erase = true;
+        break;
+      }
+    }
+  }
+}
+
+static bool imager_task_write_pages(void) {
+  uint8_t *file_buffer = imager_task_file_buffer(s_imager_task_ctx.sector);
+  uint16_t mask = s_imager_task_ctx.page_mask;
+  int page = 0;
+  int written = 0;
+
+  imager_task_phase_begin();
+  while (page < SECTOR_PAGES) {
+    if ((mask & (1 << page)) == 0) {
+      page += 1;
+      continue;
+    }
+    // Program each run of adjacent pages with a single call.
+    int run = 1;
+    while (page + run < SECTOR_PAGES && (mask & (1 << (page + run))) != 0) {
+      run += 1;
+    }
+    if (WDRV_WINC_NVMWrite(s_imager_task_ctx.winc_handle,
+                           s_imager_task_ctx.region->region,
+                           file_buffer + page * FLASH_PAGE_SZ,
+                           SECTOR_TO_OFFSET(s_imager_task_ctx.sector) +
+                               page * FLASH_PAGE_SZ,
+                           run * FLASH_PAGE_SZ) != WDRV_WINC_STATUS_OK) {
+      return false;
+    }
+    written += run;
+    page += run;
+  }
+  imager_task_phase_end(IMAGER_TASK_PHASE_WRITE, written * FLASH_PAGE_SZ);
+  s_imager_task_ctx.pages_written += written;
+  return true;
+}
+
+static void imager_task_record_sector(void) {
+  uint16_t sector = s_imager_task_ctx.sector;
+  const uint8_t *buffer = imager_task_file_buffer(sector);
+
+  s_manifest.sector_crcs[sector] =
+      imager_manifest_crc32(buffer, FLASH_SECTOR_SZ);
+  yb_sha256_update(&s_imager_task_ctx.image_hash,
+                   buffer,
+                   imager_task_sector_length(sector));
+  if (s_imager_task_ctx.region->region == WDRV_WINC_NVM_REGION_RAW &&
+      sector == WINC_CONTROL_SECTOR) {
+    // Once written, this is what the WINC reports on the next cold boot.
+    tstrOtaControlSec control;
+    memcpy(&control, buffer + WINC_CONTROL_OFFSET, sizeof(control));
+    s_manifest.winc_version = control.u32OtaCurrentworkingImagFirmwareVer;
+    s_manifest.winc_control_crc = control.u32OtaControlSecCrc;
+  }
+}
+
+static bool imager_task_manifest_matches(const imager_manifest_t *saved) {
+  return saved->region == s_manifest.region &&
+         saved->file_size == s_manifest.file_size &&
+         saved->file_stamp == s_manifest.file_stamp &&
+         saved->winc_version == s_imager_task_ctx.winc_version &&
+         saved->winc_control_crc == s_imager_task_ctx.winc_control_crc;
+}
+
+static void imager_task_set_spot_range(void) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  uint32_t address;
+  uint32_t size;
+
+  ctx->spot_first = 0;
+  ctx->spot_sectors = ctx->file_sectors;
+  if (ctx->region->region == WDRV_WINC_NVM_REGION_RAW &&
+      WDRV_WINC_NVMRegionGet(ctx->winc_handle,
+                             WDRV_WINC_NVM_REGION_FIRMWARE_ACTIVE,
+                             &address,
+                             &size) == WDRV_WINC_STATUS_OK) {
+    uint32_t first = address / FLASH_SECTOR_SZ;
+    uint32_t end = (address + size) / FLASH_SECTOR_SZ;
+    if (end > ctx->file_sectors) {
+      end = ctx->file_sectors;
+    }
+    if (first < end) {
+      ctx->spot_first = first;
+      ctx->spot_sectors = end - first;
+    }
+  }
+}
+
+static uint16_t imager_task_spot_sector(void) {
+  // A different sample each boot, seeded from the free running timer.
+  s_imager_task_ctx.spot_seed =
+      s_imager_task_ctx.spot_seed * 1664525 + 1013904223;
+  return s_imager_task_ctx.spot_first +
+         (s_imager_task_ctx.spot_seed >> 16) % s_imager_task_ctx.spot_sectors;
+}
+
+static void imager_task_phase_begin(void) {
+  s_imager_task_ctx.phase_start = SYS_TIME_CounterGet();
+  s_imager_task_ctx.phase_hidden = s_imager_task_ctx.hidden_ticks;
+}
+
+static void imager_task_phase_end(imager_task_phase_t phase, uint32_t bytes) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  uint32_t ticks = SYS_TIME_CounterGet() - ctx->phase_start;
+  // Charge SD reads made from the busy hook to the SD phase alone.
+  ticks -= ctx->hidden_ticks - ctx->phase_hidden;
+  ctx->phases[phase].bytes += bytes;
+  ctx->phases[phase].ticks += ticks;
+}
+
+static void imager_task_log_stats(void) {
+  imager_task_ctx_t *ctx = &s_imager_task_ctx;
+  uint32_t ticks_per_ms = SYS_TIME_FrequencyGet() / 1000;
+
+  if (ticks_per_ms == 0) {
+    return;
+  }
+  for (int i = 0; i < IMAGER_TASK_PHASE_COUNT; i++) {
+    imager_task_phase_stats_t *phase = &ctx->phases[i];
+    uint32_t ms = phase->ticks / ticks_per_ms;
+    YB_LOG_INFO("%s: %ld KB in %ld ms, %ld KB/s",
+                s_imager_task_phase_names[i],
+                phase->bytes / 1024,
+                ms,
+                (ms == 0) ? 0
+                          : (uint32_t)((uint64_t)phase->bytes * 1000 / 1024 /
+                                       ms));
+  }
+  YB_LOG_INFO("%ld KB of SD reads in %ld ms overlapped WINC flash access",
+              ctx->hidden_bytes / 1024,
+              ctx->hidden_ticks / ticks_per_ms);
+  YB_LOG_INFO("Erased %d sectors, patched %d in place, wrote %d pages",
+              ctx->sectors_erased,
+              ctx->sectors_patched,
+              ctx->pages_written);
+  YB_LOG_INFO("Reflash took %ld ms",
+              (SYS_TIME_CounterGet() - ctx->started_at) / ticks_per_ms);
+}
+
 static void cleanup(void) {
+  spi_flash_set_busy_hook(NULL);
   if (s_imager_task_ctx.winc_handle != 0) {
     // TODO: is 0 a valid file handle?  If so, allocate a flag to know if we
     // need to call Close
     WDRV_WINC_Close(s_imager_task_ctx.winc_handle);
+    s_imager_task_ctx.winc_handle = 0;
   }
   if (s_imager_task_ctx.file_handle != 0) {
     // TODO: is 0 a valid file handle?  If so, allocate a flag to know if we
     // need to call Close
     SYS_FS_FileClose(s_imager_task_ctx.file_handle);
+    s_imager_task_ctx.file_handle = 0;
   }
 }
@@ -46,7 +46,15 @@ extern "C" {
 // *****************************************************************************
 // Public declarations
 
-void imager_task_init(const char *filename);
+/**
+ * @brief Prepare to bring a region of the WINC flash up to date with a file.
+ *
+ * @param filename The image file on the SD card.
+ * @param region The WINC flash region to compare and write: "raw" (the whole
+ * flash), "firmware", "firmware_inactive", "pll_gain", "root_certs",
+ * "local_certs" or "http_files".  NULL means "raw".
+ */
+void imager_task_init(const char *filename, const char *region);
 
 void imager_task_step(void);
 
@@ -33,6 +33,13 @@
 
 #include "app.h"
 #include "config_task.h"
+#include "http_task.h"
+#include "ping_task.h"
+#include "probe_task.h"
+#include "survey_task.h"
+#include "udp_task.h"
+#include "winc_task.h"
+#include "yb_rtc.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -49,6 +56,13 @@ extern "C" {
 typedef struct {
   app_nv_data_t app_nv_data;
   config_task_nv_data_t config_task_nv_data;
+  http_task_nv_data_t http_task_nv_data;
+  ping_task_nv_data_t ping_task_nv_data;
+  probe_task_nv_data_t probe_task_nv_data;
+  survey_task_nv_data_t survey_task_nv_data;
+  udp_task_nv_data_t udp_task_nv_data;
+  winc_task_nv_data_t winc_task_nv_data;
+  yb_rtc_nv_data_t yb_rtc_nv_data;
 } nv_data_t;
 
 // *****************************************************************************
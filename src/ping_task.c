@@ -0,0 +1,416 @@
+/**
+ * @file ping_task.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "ping_task.h"
+
+#include "definitions.h"
+#include "nv_data.h"
+#include "wdrv_winc_client_api.h"
+#include "yb_log.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+// Hop limit for echo requests.  The gateway is one hop away; the host may be
+// anywhere on the internet.
+#define PING_TASK_TTL 64
+
+// The WINC reports PING_ERR_TIMEOUT on its own, but if no response of any kind
+// arrives within this time the echo is counted as lost and the burst moves on.
+#define PING_TASK_ECHO_TIMEOUT_MS ((yb_rtc_ms_t)3000.0)
+
+#define STATES(M)                                                              \
+  M(PING_TASK_STATE_INIT)                                                      \
+  M(PING_TASK_STATE_AWAIT_IP_LINK)                                             \
+  M(PING_TASK_STATE_AWAIT_DNS)                                                 \
+  M(PING_TASK_STATE_SEND_ECHO)                                                 \
+  M(PING_TASK_STATE_AWAIT_ECHO)                                                \
+  M(PING_TASK_STATE_REPORT)                                                    \
+  M(PING_TASK_STATE_SUCCESS)                                                   \
+  M(PING_TASK_STATE_ERROR)
+
+#define EXPAND_STATE_ENUM_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_ENUM_IDS) } ping_task_state_t;
+
+/**
+ * @brief Running sums for one target, reduced into a ping_task_stats_t when
+ * the burst completes.
+ */
+typedef struct {
+  ping_task_stats_t *stats; // lives in nv_data
+  uint32_t rtt_sum_ms;
+  uint32_t jitter_sum_ms;
+  uint32_t prev_rtt_ms;
+} ping_target_t;
+
+typedef enum {
+  PING_TARGET_GATEWAY,
+  PING_TARGET_HOST,
+  PING_TARGET_COUNT,
+} ping_target_id_t;
+
+typedef struct {
+  ping_task_state_t state;
+  DRV_HANDLE winc_handle;
+  char host[HOSTNAME_MAX_SIZE];
+  uint8_t count;
+  yb_rtc_ms_t budget_ms;
+  yb_rtc_tics_t started_at;
+  yb_rtc_tics_t echo_at; // time at which the current echo request was sent
+  int target;            // index of the target being pinged
+  ping_target_t targets[PING_TARGET_COUNT];
+} ping_task_ctx_t;
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+static void ping_task_set_state(ping_task_state_t new_state);
+
+static const char *ping_task_state_name(ping_task_state_t state);
+
+static void ping_task_resolver_cb(uint8_t *pu8DomainName,
+                                  uint32_t u32ServerIP);
+
+static void ping_task_echo_cb(DRV_HANDLE handle,
+                              uint32_t ipAddress,
+                              uint32_t rtt,
+                              WDRV_WINC_ICMP_ECHO_STATUS statusCode);
+
+/**
+ * @brief Return true if the budget for the whole burst has been used up.
+ */
+static bool ping_task_budget_exhausted(void);
+
+/**
+ * @brief Fold one round trip time into the running sums of the current target.
+ */
+static void ping_record_reply(ping_target_t *target, uint32_t rtt_ms);
+
+/**
+ * @brief Reduce the running sums into average, jitter and loss, and print them.
+ */
+static void ping_report(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static ping_task_ctx_t s_ping_task_ctx;
+
+#define EXPAND_STATE_NAMES(_name) #_name,
+static const char *s_ping_task_state_names[] = {STATES(EXPAND_STATE_NAMES)};
+
+static const char *s_ping_target_names[] = {"gateway", "host"};
+
+// *****************************************************************************
+// Public code
+
+void ping_task_init(DRV_HANDLE winc_handle,
+                    const char *host,
+                    uint8_t count,
+                    yb_rtc_ms_t budget_ms) {
+  ping_task_nv_data_t *nv = &nv_data()->ping_task_nv_data;
+
+  memset(&s_ping_task_ctx, 0, sizeof(s_ping_task_ctx));
+  memset(nv, 0, sizeof(ping_task_nv_data_t));
+  s_ping_task_ctx.state = PING_TASK_STATE_INIT;
+  s_ping_task_ctx.winc_handle = winc_handle;
+  s_ping_task_ctx.count = count;
+  s_ping_task_ctx.budget_ms = budget_ms;
+  s_ping_task_ctx.targets[PING_TARGET_GATEWAY].stats = &nv->gateway;
+  s_ping_task_ctx.targets[PING_TARGET_HOST].stats = &nv->host;
+  if (host != NULL) {
+    strncpy(s_ping_task_ctx.host, host, sizeof(s_ping_task_ctx.host) - 1);
+  }
+
+  socketInit();
+}
+
+void ping_task_step(void) {
+  switch (s_ping_task_ctx.state) {
+
+  case PING_TASK_STATE_INIT: {
+    s_ping_task_ctx.started_at = yb_rtc_now();
+    ping_task_set_state(PING_TASK_STATE_AWAIT_IP_LINK);
+  } break;
+
+  case PING_TASK_STATE_AWAIT_IP_LINK: {
+    ping_task_nv_data_t *nv = &nv_data()->ping_task_nv_data;
+
+    if (WDRV_WINC_IPLinkActive(s_ping_task_ctx.winc_handle) == false) {
+      if (ping_task_budget_exhausted()) {
+        YB_LOG_ERROR("No IP link within ping budget");
+        ping_task_set_state(PING_TASK_STATE_ERROR);
+      } else {
+        // remain in this state until the WINC reports IP Link active.
+      }
+      break;
+    }
+
+    nv->gateway.ipv4 =
+        WDRV_WINC_IPDefaultGatewayGet(s_ping_task_ctx.winc_handle);
+    if (nv->gateway.ipv4 == 0) {
+      YB_LOG_WARN("No default gateway, skipping gateway ping");
+    }
+
+    if (s_ping_task_ctx.host[0] == '\0') {
+      ping_task_set_state(PING_TASK_STATE_SEND_ECHO);
+    } else if ((nv->host.ipv4 = inet_addr(s_ping_task_ctx.host)) != 0) {
+      // numeric address: no DNS lookup needed
+      ping_task_set_state(PING_TASK_STATE_SEND_ECHO);
+    } else if (WDRV_WINC_STATUS_OK !=
+               WDRV_WINC_SocketRegisterResolverCallback(
+                   s_ping_task_ctx.winc_handle, ping_task_resolver_cb)) {
+      YB_LOG_ERROR("Unable to register resolver callback");
+      ping_task_set_state(PING_TASK_STATE_SEND_ECHO);
+    } else if (gethostbyname(s_ping_task_ctx.host) < 0) {
+      YB_LOG_ERROR("gethostbyname(%s) failed", s_ping_task_ctx.host);
+      ping_task_set_state(PING_TASK_STATE_SEND_ECHO);
+    } else {
+      ping_task_set_state(PING_TASK_STATE_AWAIT_DNS);
+    }
+  } break;
+
+  case PING_TASK_STATE_AWAIT_DNS: {
+    // wait for ping_task_resolver_cb to advance state.
+    if (ping_task_budget_exhausted()) {
+      YB_LOG_WARN("DNS lookup for %s exceeded ping budget",
+                  s_ping_task_ctx.host);
+      ping_task_set_state(PING_TASK_STATE_REPORT);
+    }
+  } break;
+
+  case PING_TASK_STATE_SEND_ECHO: {
+    ping_target_t *target = &s_ping_task_ctx.targets[s_ping_task_ctx.target];
+
+    if (ping_task_budget_exhausted()) {
+      YB_LOG_WARN("Ping budget of %d ms exhausted",
+                  (int)s_ping_task_ctx.budget_ms);
+      ping_task_set_state(PING_TASK_STATE_REPORT);
+
+    } else if (target->stats->ipv4 == 0 ||
+               target->stats->sent >= s_ping_task_ctx.count) {
+      // this target is finished (or absent): move on to the next
+      s_ping_task_ctx.target += 1;
+      if (s_ping_task_ctx.target >= PING_TARGET_COUNT) {
+        ping_task_set_state(PING_TASK_STATE_REPORT);
+      }
+
+    } else if (WDRV_WINC_STATUS_OK !=
+               WDRV_WINC_ICMPEchoRequest(s_ping_task_ctx.winc_handle,
+                                         target->stats->ipv4,
+                                         PING_TASK_TTL,
+                                         ping_task_echo_cb)) {
+      YB_LOG_ERROR("WDRV_WINC_ICMPEchoRequest() failed");
+      ping_task_set_state(PING_TASK_STATE_REPORT);
+
+    } else {
+      target->stats->sent += 1;
+      s_ping_task_ctx.echo_at = yb_rtc_now();
+      ping_task_set_state(PING_TASK_STATE_AWAIT_ECHO);
+    }
+  } break;
+
+  case PING_TASK_STATE_AWAIT_ECHO: {
+    // wait for ping_task_echo_cb to advance state.
+    if (yb_rtc_elapsed_ms(s_ping_task_ctx.echo_at) >
+        PING_TASK_ECHO_TIMEOUT_MS) {
+      YB_LOG_WARN("No echo response from the WINC");
+      ping_task_set_state(PING_TASK_STATE_SEND_ECHO);
+    }
+  } break;
+
+  case PING_TASK_STATE_REPORT: {
+    ping_report();
+    ping_task_set_state(PING_TASK_STATE_SUCCESS);
+  } break;
+
+  case PING_TASK_STATE_SUCCESS: {
+    // remain in this state
+  } break;
+
+  case PING_TASK_STATE_ERROR: {
+    // remain in this state
+  } break;
+
+  } // switch
+}
+
+bool ping_task_succeeded(void) {
+  return s_ping_task_ctx.state == PING_TASK_STATE_SUCCESS;
+}
+
+bool ping_task_failed(void) {
+  return s_ping_task_ctx.state == PING_TASK_STATE_ERROR;
+}
+
+void ping_task_shutdown(void) {
+  // Nothing to release: late echo responses are ignored once the burst is over.
+}
+
+size_t ping_task_encode(uint8_t *buf, size_t size) {
+  ping_task_nv_data_t *nv = &nv_data()->ping_task_nv_data;
+  const ping_task_stats_t *targets[] = {&nv->gateway, &nv->host};
+  size_t n = 0;
+
+  if (size < sizeof(targets) / sizeof(targets[0]) * PING_TASK_WIRE_SIZE) {
+    return 0;
+  }
+  for (size_t i = 0; i < sizeof(targets) / sizeof(targets[0]); i++) {
+    const ping_task_stats_t *stats = targets[i];
+    uint16_t times[] = {
+        stats->min_ms, stats->avg_ms, stats->max_ms, stats->jitter_ms};
+    buf[n++] = stats->sent;
+    buf[n++] = stats->received;
+    buf[n++] = stats->loss_pct;
+    for (size_t j = 0; j < sizeof(times) / sizeof(times[0]); j++) {
+      buf[n++] = (uint8_t)(times[j] >> 8);
+      buf[n++] = (uint8_t)(times[j]);
+    }
+  }
+  return n;
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void ping_task_set_state(ping_task_state_t new_state) {
+  if (new_state != s_ping_task_ctx.state) {
+    YB_LOG_INFO("%s => %s",
+                ping_task_state_name(s_ping_task_ctx.state),
+                ping_task_state_name(new_state));
+    s_ping_task_ctx.state = new_state;
+  }
+}
+
+static const char *ping_task_state_name(ping_task_state_t state) {
+  return s_ping_task_state_names[state];
+}
+
+static void ping_task_resolver_cb(uint8_t *pu8DomainName,
+                                  uint32_t u32ServerIP) {
+  if (s_ping_task_ctx.state != PING_TASK_STATE_AWAIT_DNS ||
+      strcmp(s_ping_task_ctx.host, (const char *)pu8DomainName) != 0) {
+    YB_LOG_DEBUG("Ignoring DNS answer for %s", pu8DomainName);
+    return;
+  }
+  if (u32ServerIP == 0) {
+    YB_LOG_ERROR("Unable to resolve %s", s_ping_task_ctx.host);
+  }
+  nv_data()->ping_task_nv_data.host.ipv4 = u32ServerIP;
+  ping_task_set_state(PING_TASK_STATE_SEND_ECHO);
+}
+
+static void ping_task_echo_cb(DRV_HANDLE handle,
+                              uint32_t ipAddress,
+                              uint32_t rtt,
+                              WDRV_WINC_ICMP_ECHO_STATUS statusCode) {
+  (void)handle;
+  ping_target_t *target = &s_ping_task_ctx.targets[s_ping_task_ctx.target];
+
+  if (s_ping_task_ctx.state != PING_TASK_STATE_AWAIT_ECHO ||
+      ipAddress != target->stats->ipv4) {
+    // a late response to an echo that was already written off
+    YB_LOG_DEBUG("Ignoring stale echo response");
+    return;
+  }
+  if (statusCode == WDRV_WINC_ICMP_ECHO_STATUS_SUCCESS) {
+    ping_record_reply(target, rtt);
+  } else {
+    YB_LOG_DEBUG("Echo to %s failed with status %d",
+                 s_ping_target_names[s_ping_task_ctx.target],
+                 statusCode);
+  }
+  ping_task_set_state(PING_TASK_STATE_SEND_ECHO);
+}
+
+static bool ping_task_budget_exhausted(void) {
+  return yb_rtc_elapsed_ms(s_ping_task_ctx.started_at) >
+         s_ping_task_ctx.budget_ms;
+}
+
+static void ping_record_reply(ping_target_t *target, uint32_t rtt_ms) {
+  ping_task_stats_t *stats = target->stats;
+  uint16_t rtt16 = (rtt_ms > UINT16_MAX) ? UINT16_MAX : (uint16_t)rtt_ms;
+
+  if (stats->received == 0 || rtt16 < stats->min_ms) {
+    stats->min_ms = rtt16;
+  }
+  if (rtt16 > stats->max_ms) {
+    stats->max_ms = rtt16;
+  }
+  if (stats->received > 0) {
+    target->jitter_sum_ms += (rtt_ms > target->prev_rtt_ms)
+                                 ? rtt_ms - target->prev_rtt_ms
+                                 : target->prev_rtt_ms - rtt_ms;
+  }
+  target->prev_rtt_ms = rtt_ms;
+  target->rtt_sum_ms += rtt_ms;
+  stats->received += 1;
+}
+
+static void ping_report(void) {
+  char s[20];
+
+  YB_LOG_INFO("Ping results (ms):");
+  for (int i = 0; i < PING_TARGET_COUNT; i++) {
+    ping_target_t *target = &s_ping_task_ctx.targets[i];
+    ping_task_stats_t *stats = target->stats;
+
+    if (stats->sent == 0) {
+      continue;
+    }
+    // Integer arithmetic throughout: round to nearest.
+    stats->loss_pct =
+        ((stats->sent - stats->received) * 100 + stats->sent / 2) / stats->sent;
+    if (stats->received > 0) {
+      stats->avg_ms =
+          (target->rtt_sum_ms + stats->received / 2) / stats->received;
+    }
+    if (stats->received > 1) {
+      stats->jitter_ms = (target->jitter_sum_ms + (stats->received - 1) / 2) /
+                         (stats->received - 1);
+    }
+    YB_LOG_INFO("  %s (%s) sent=%u received=%u loss=%u%% min=%u avg=%u max=%u "
+                "jitter=%u",
+                s_ping_target_names[i],
+                inet_ntop(AF_INET, &stats->ipv4, s, sizeof(s)),
+                stats->sent,
+                stats->received,
+                stats->loss_pct,
+                stats->min_ms,
+                stats->avg_ms,
+                stats->max_ms,
+                stats->jitter_ms);
+  }
+}
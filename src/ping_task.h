@@ -0,0 +1,128 @@
+/**
+ * @file ping_task.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Send a burst of ICMP echo requests to the default gateway and to a configured
+// host, and summarize the round trip times.  The gateway figures isolate the
+// wireless hop; the host figures include the upstream path.
+
+#ifndef _PING_TASK_H_
+#define _PING_TASK_H_
+
+// *****************************************************************************
+// Includes
+
+#include "driver/driver_common.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+/**
+ * @brief Round trip statistics for one ping target.  Times are in milliseconds
+ * and are only meaningful when received > 0.  Jitter is the mean absolute
+ * difference between consecutive round trip times.
+ */
+typedef struct {
+  uint32_t ipv4;      // target address, 0 if not pinged
+  uint8_t sent;       // # of echo requests sent
+  uint8_t received;   // # of echo replies received
+  uint8_t loss_pct;   // 100 * (sent - received) / sent
+  uint16_t min_ms;    // fastest round trip
+  uint16_t avg_ms;    // mean round trip
+  uint16_t max_ms;    // slowest round trip
+  uint16_t jitter_ms; // mean |rtt[i] - rtt[i-1]|
+} ping_task_stats_t;
+
+// Size of one target's record in the wire format of ping_task_encode().
+#define PING_TASK_WIRE_SIZE 11
+
+/**
+ * @brief Data that is preserved across reboots.
+ *
+ * Holds the statistics from the most recent ping burst.
+ */
+typedef struct {
+  ping_task_stats_t gateway;
+  ping_task_stats_t host;
+} ping_task_nv_data_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the ping_task.
+ *
+ * @param winc_handle A handle on the WINC device.
+ * @param host Host name or dotted quad to ping after the gateway.  If NULL or
+ *        empty, only the gateway is pinged.
+ * @param count Number of echo requests to send to each target.
+ * @param budget_ms Time allowed for the whole burst.  Echo requests that have
+ *        not been sent when the budget expires are not counted as lost.
+ */
+void ping_task_init(DRV_HANDLE winc_handle,
+                    const char *host,
+                    uint8_t count,
+                    yb_rtc_ms_t budget_ms);
+
+/**
+ * @brief Advance the ping_task state machine.
+ */
+void ping_task_step(void);
+
+bool ping_task_succeeded(void);
+
+bool ping_task_failed(void);
+
+/**
+ * @brief Release any resources allocated by ping_task.
+ */
+void ping_task_shutdown(void);
+
+/**
+ * @brief Write the statistics of the most recent burst into buf, gateway then
+ * host, and return the number of bytes written, or 0 if buf is too small.
+ *
+ * Each target is PING_TASK_WIRE_SIZE bytes: sent, received and loss_pct, then
+ * min_ms, avg_ms, max_ms and jitter_ms as 16 bit big-endian values.  A target
+ * that was not pinged has sent == 0.
+ */
+size_t ping_task_encode(uint8_t *buf, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _PING_TASK_H_ */
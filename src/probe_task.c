@@ -0,0 +1,459 @@
+/**
+ * @file probe_task.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "probe_task.h"
+
+#include "definitions.h"
+#include "nv_data.h"
+#include "wdrv_winc_client_api.h"
+#include "yb_log.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define PROBE_TASK_DEFAULT_PORT 80
+
+// Only the arrival of the first byte matters, so the receive buffer is tiny.
+#define PROBE_TASK_RECV_SIZE 16
+
+// A minimal request that elicits a response from an HTTP server.  Servers that
+// speak first (SMTP, SSH, ...) will answer regardless.
+#define PROBE_TASK_REQUEST "HEAD / HTTP/1.0\r\n\r\n"
+
+#define STATES(M)                                                              \
+  M(PROBE_TASK_STATE_INIT)                                                     \
+  M(PROBE_TASK_STATE_PROBING)                                                  \
+  M(PROBE_TASK_STATE_REPORT)                                                   \
+  M(PROBE_TASK_STATE_SUCCESS)                                                  \
+  M(PROBE_TASK_STATE_ERROR)
+
+#define EXPAND_STATE_ENUM_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_ENUM_IDS) } probe_task_state_t;
+
+/**
+ * @brief Progress of a single endpoint through the probe.
+ */
+typedef enum {
+  PROBE_PHASE_UNRESOLVED, // waiting for its turn at the resolver
+  PROBE_PHASE_RESOLVING,  // gethostbyname() outstanding
+  PROBE_PHASE_RESOLVED,   // address known, ready to connect
+  PROBE_PHASE_CONNECTING, // connect() outstanding
+  PROBE_PHASE_AWAIT_BYTE, // connected, waiting for the first byte
+  PROBE_PHASE_DONE,       // result is final
+} probe_phase_t;
+
+typedef struct {
+  char host[HOSTNAME_MAX_SIZE];
+  uint16_t port;
+  probe_phase_t phase;
+  SOCKET socket;
+  yb_rtc_tics_t dns_at;        // time at which gethostbyname() was called
+  yb_rtc_tics_t connect_at;    // time at which connect() was called
+  probe_task_result_t *result; // lives in nv_data
+  uint8_t recv_buf[PROBE_TASK_RECV_SIZE];
+} probe_endpoint_t;
+
+typedef struct {
+  probe_task_state_t state;
+  DRV_HANDLE winc_handle;
+  yb_rtc_ms_t budget_ms;
+  yb_rtc_tics_t started_at;
+  int endpoint_count;
+  probe_endpoint_t endpoints[PROBE_TASK_MAX_ENDPOINTS];
+} probe_task_ctx_t;
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+static void probe_task_set_state(probe_task_state_t new_state);
+
+static const char *probe_task_state_name(probe_task_state_t state);
+
+static void probe_task_socket_callback(SOCKET socket,
+                                       uint8_t msg_type,
+                                       void *msg);
+
+static void probe_task_resolver_cb(uint8_t *pu8DomainName,
+                                   uint32_t u32ServerIP);
+
+/**
+ * @brief Start a DNS lookup for the endpoint.
+ */
+static void probe_start_dns(probe_endpoint_t *ep);
+
+/**
+ * @brief Open a socket for the endpoint and start connecting.
+ */
+static void probe_start_connect(probe_endpoint_t *ep);
+
+/**
+ * @brief Record the final result for an endpoint and close its socket.
+ */
+static void probe_finish(probe_endpoint_t *ep, probe_result_t result);
+
+/**
+ * @brief Return the endpoint using the given socket, or NULL.
+ */
+static probe_endpoint_t *probe_find_by_socket(SOCKET socket);
+
+/**
+ * @brief Convert a duration to a saturated 16 bit millisecond count.
+ */
+static uint16_t probe_ms16(yb_rtc_ms_t ms);
+
+/**
+ * @brief Print the result table.
+ */
+static void probe_report(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static probe_task_ctx_t s_probe_task_ctx;
+
+#define EXPAND_STATE_NAMES(_name) #_name,
+static const char *s_probe_task_state_names[] = {STATES(EXPAND_STATE_NAMES)};
+
+#define EXPAND_PROBE_RESULT_NAME(_name) #_name,
+static const char *s_probe_result_names[] = {
+    PROBE_TASK_RESULTS(EXPAND_PROBE_RESULT_NAME)};
+
+// *****************************************************************************
+// Public code
+
+void probe_task_init(DRV_HANDLE winc_handle, yb_rtc_ms_t budget_ms) {
+  s_probe_task_ctx.state = PROBE_TASK_STATE_INIT;
+  s_probe_task_ctx.winc_handle = winc_handle;
+  s_probe_task_ctx.budget_ms = budget_ms;
+  s_probe_task_ctx.endpoint_count = 0;
+  nv_data()->probe_task_nv_data.result_count = 0;
+}
+
+void probe_task_add_endpoint(const char *endpoint) {
+  probe_task_nv_data_t *nv = &nv_data()->probe_task_nv_data;
+  int i = s_probe_task_ctx.endpoint_count;
+
+  if (i >= PROBE_TASK_MAX_ENDPOINTS) {
+    YB_LOG_WARN("Too many probe endpoints, ignoring %s", endpoint);
+    return;
+  }
+  probe_endpoint_t *ep = &s_probe_task_ctx.endpoints[i];
+  s_probe_task_ctx.endpoint_count = i + 1;
+  nv->result_count = i + 1;
+
+  ep->result = &nv->results[i];
+  memset(ep->result, 0, sizeof(probe_task_result_t));
+  ep->socket = -1;
+  ep->phase = PROBE_PHASE_UNRESOLVED;
+  ep->port = PROBE_TASK_DEFAULT_PORT;
+  strncpy(ep->host, endpoint, sizeof(ep->host) - 1);
+  ep->host[sizeof(ep->host) - 1] = '\0';
+
+  char *colon = strrchr(ep->host, ':');
+  if (colon != NULL) {
+    *colon = '\0';
+    ep->port = atoi(colon + 1);
+  }
+  if (ep->host[0] == '\0' || ep->port == 0) {
+    YB_LOG_ERROR("Cannot parse probe endpoint '%s'", endpoint);
+    probe_finish(ep, PROBE_RESULT_BAD_ENDPOINT);
+  } else if ((ep->result->ipv4 = inet_addr(ep->host)) != 0) {
+    // numeric address: no DNS lookup needed
+    ep->phase = PROBE_PHASE_RESOLVED;
+  }
+}
+
+void probe_task_step(void) {
+  switch (s_probe_task_ctx.state) {
+
+  case PROBE_TASK_STATE_INIT: {
+    if (WDRV_WINC_STATUS_OK !=
+        WDRV_WINC_SocketRegisterResolverCallback(s_probe_task_ctx.winc_handle,
+                                                 probe_task_resolver_cb)) {
+      YB_LOG_ERROR("Unable to register resolver callback");
+      probe_task_set_state(PROBE_TASK_STATE_ERROR);
+    } else if (WDRV_WINC_STATUS_OK !=
+               WDRV_WINC_SocketRegisterEventCallback(
+                   s_probe_task_ctx.winc_handle, probe_task_socket_callback)) {
+      YB_LOG_ERROR("Unable to register socket callback");
+      probe_task_set_state(PROBE_TASK_STATE_ERROR);
+    } else {
+      s_probe_task_ctx.started_at = yb_rtc_now();
+      probe_task_set_state(PROBE_TASK_STATE_PROBING);
+    }
+  } break;
+
+  case PROBE_TASK_STATE_PROBING: {
+    // Lookups are issued one at a time, but every endpoint connects as soon as
+    // its address is known, so the connects proceed in parallel.
+    bool resolving = false;
+    bool all_done = true;
+    for (int i = 0; i < s_probe_task_ctx.endpoint_count; i++) {
+      if (s_probe_task_ctx.endpoints[i].phase == PROBE_PHASE_RESOLVING) {
+        resolving = true;
+      }
+    }
+    for (int i = 0; i < s_probe_task_ctx.endpoint_count; i++) {
+      probe_endpoint_t *ep = &s_probe_task_ctx.endpoints[i];
+      if (ep->phase == PROBE_PHASE_UNRESOLVED && !resolving) {
+        probe_start_dns(ep);
+        resolving = (ep->phase == PROBE_PHASE_RESOLVING);
+      } else if (ep->phase == PROBE_PHASE_RESOLVED) {
+        probe_start_connect(ep);
+      }
+      if (ep->phase != PROBE_PHASE_DONE) {
+        all_done = false;
+      }
+    }
+
+    if (all_done) {
+      probe_task_set_state(PROBE_TASK_STATE_REPORT);
+    } else if (yb_rtc_elapsed_ms(s_probe_task_ctx.started_at) >
+               s_probe_task_ctx.budget_ms) {
+      YB_LOG_WARN("Probe budget of %d ms exhausted",
+                  (int)s_probe_task_ctx.budget_ms);
+      for (int i = 0; i < s_probe_task_ctx.endpoint_count; i++) {
+        probe_endpoint_t *ep = &s_probe_task_ctx.endpoints[i];
+        if (ep->phase != PROBE_PHASE_DONE) {
+          probe_finish(ep, PROBE_RESULT_TIMED_OUT);
+        }
+      }
+      probe_task_set_state(PROBE_TASK_STATE_REPORT);
+    } else {
+      // remain in this state while probes are outstanding
+    }
+  } break;
+
+  case PROBE_TASK_STATE_REPORT: {
+    probe_report();
+    probe_task_set_state(PROBE_TASK_STATE_SUCCESS);
+  } break;
+
+  case PROBE_TASK_STATE_SUCCESS: {
+    // remain in this state
+  } break;
+
+  case PROBE_TASK_STATE_ERROR: {
+    // remain in this state
+  } break;
+
+  } // switch
+}
+
+bool probe_task_succeeded(void) {
+  return s_probe_task_ctx.state == PROBE_TASK_STATE_SUCCESS;
+}
+
+bool probe_task_failed(void) {
+  return s_probe_task_ctx.state == PROBE_TASK_STATE_ERROR;
+}
+
+void probe_task_shutdown(void) {
+  for (int i = 0; i < s_probe_task_ctx.endpoint_count; i++) {
+    probe_endpoint_t *ep = &s_probe_task_ctx.endpoints[i];
+    if (ep->socket >= 0) {
+      shutdown(ep->socket);
+      ep->socket = -1;
+    }
+  }
+}
+
+const char *probe_task_result_name(probe_result_t result) {
+  return s_probe_result_names[result];
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void probe_task_set_state(probe_task_state_t new_state) {
+  if (new_state != s_probe_task_ctx.state) {
+    YB_LOG_INFO("%s => %s",
+                probe_task_state_name(s_probe_task_ctx.state),
+                probe_task_state_name(new_state));
+    s_probe_task_ctx.state = new_state;
+  }
+}
+
+static const char *probe_task_state_name(probe_task_state_t state) {
+  return s_probe_task_state_names[state];
+}
+
+static void probe_task_socket_callback(SOCKET socket,
+                                       uint8_t msg_type,
+                                       void *msg) {
+  probe_endpoint_t *ep = probe_find_by_socket(socket);
+  if (ep == NULL) {
+    YB_LOG_DEBUG("Received probe callback for unknown socket");
+    return;
+  }
+
+  switch (msg_type) {
+  case SOCKET_MSG_CONNECT: {
+    tstrSocketConnectMsg *connect_msg = (tstrSocketConnectMsg *)msg;
+    if (connect_msg == NULL || connect_msg->s8Error < 0) {
+      ep->result->error = (connect_msg == NULL) ? 0 : connect_msg->s8Error;
+      probe_finish(ep, PROBE_RESULT_CONNECT_FAILED);
+    } else {
+      ep->result->connect_ms = probe_ms16(yb_rtc_elapsed_ms(ep->connect_at));
+      ep->phase = PROBE_PHASE_AWAIT_BYTE;
+      recv(ep->socket, ep->recv_buf, sizeof(ep->recv_buf), 0);
+      send(ep->socket,
+           (void *)PROBE_TASK_REQUEST,
+           sizeof(PROBE_TASK_REQUEST) - 1,
+           0);
+    }
+  } break;
+
+  case SOCKET_MSG_SEND: {
+    // nothing to do: the probe is complete when the first byte arrives.
+  } break;
+
+  case SOCKET_MSG_RECV: {
+    tstrSocketRecvMsg *recv_msg = (tstrSocketRecvMsg *)msg;
+    if (recv_msg != NULL && recv_msg->s16BufferSize > 0) {
+      ep->result->first_byte_ms =
+          probe_ms16(yb_rtc_elapsed_ms(ep->connect_at));
+      probe_finish(ep, PROBE_RESULT_OK);
+    } else {
+      // peer closed or reset the connection without sending anything
+      ep->result->error = (recv_msg == NULL) ? 0 : recv_msg->s16BufferSize;
+      probe_finish(ep, PROBE_RESULT_CLOSED);
+    }
+  } break;
+
+  default: {
+    YB_LOG_WARN("Unrecognized socket callback type %d", msg_type);
+  }
+  } // switch
+}
+
+static void probe_task_resolver_cb(uint8_t *pu8DomainName,
+                                   uint32_t u32ServerIP) {
+  for (int i = 0; i < s_probe_task_ctx.endpoint_count; i++) {
+    probe_endpoint_t *ep = &s_probe_task_ctx.endpoints[i];
+    if (ep->phase == PROBE_PHASE_RESOLVING &&
+        strcmp(ep->host, (const char *)pu8DomainName) == 0) {
+      ep->result->dns_ms = probe_ms16(yb_rtc_elapsed_ms(ep->dns_at));
+      if (u32ServerIP == 0) {
+        probe_finish(ep, PROBE_RESULT_DNS_FAILED);
+      } else {
+        ep->result->ipv4 = u32ServerIP;
+        ep->phase = PROBE_PHASE_RESOLVED;
+      }
+      return;
+    }
+  }
+  YB_LOG_DEBUG("Ignoring DNS answer for %s", pu8DomainName);
+}
+
+static void probe_start_dns(probe_endpoint_t *ep) {
+  ep->dns_at = yb_rtc_now();
+  if (gethostbyname(ep->host) < 0) {
+    probe_finish(ep, PROBE_RESULT_DNS_FAILED);
+  } else {
+    ep->phase = PROBE_PHASE_RESOLVING;
+  }
+}
+
+static void probe_start_connect(probe_endpoint_t *ep) {
+  struct sockaddr_in addr;
+
+  ep->socket = socket(AF_INET, SOCK_STREAM, 0);
+  if (ep->socket < 0) {
+    ep->result->error = ep->socket;
+    probe_finish(ep, PROBE_RESULT_SOCKET_FAILED);
+    return;
+  }
+  addr.sin_family = AF_INET;
+  addr.sin_port = _htons(ep->port);
+  addr.sin_addr.s_addr = ep->result->ipv4;
+
+  ep->connect_at = yb_rtc_now();
+  int8_t err =
+      connect(ep->socket, (struct sockaddr *)&addr, sizeof(struct sockaddr_in));
+  if (err < 0) {
+    ep->result->error = err;
+    probe_finish(ep, PROBE_RESULT_CONNECT_FAILED);
+  } else {
+    ep->phase = PROBE_PHASE_CONNECTING;
+  }
+}
+
+static void probe_finish(probe_endpoint_t *ep, probe_result_t result) {
+  ep->result->result = result;
+  ep->phase = PROBE_PHASE_DONE;
+  if (ep->socket >= 0) {
+    shutdown(ep->socket);
+    ep->socket = -1;
+  }
+}
+
+static probe_endpoint_t *probe_find_by_socket(SOCKET socket) {
+  for (int i = 0; i < s_probe_task_ctx.endpoint_count; i++) {
+    if (s_probe_task_ctx.endpoints[i].socket == socket) {
+      return &s_probe_task_ctx.endpoints[i];
+    }
+  }
+  return NULL;
+}
+
+static uint16_t probe_ms16(yb_rtc_ms_t ms) {
+  if (ms <= 0) {
+    return 0;
+  } else if (ms >= UINT16_MAX) {
+    return UINT16_MAX;
+  } else {
+    return (uint16_t)ms;
+  }
+}
+
+static void probe_report(void) {
+  char s[20];
+
+  YB_LOG_INFO("Probe results (ms):");
+  for (int i = 0; i < s_probe_task_ctx.endpoint_count; i++) {
+    probe_endpoint_t *ep = &s_probe_task_ctx.endpoints[i];
+    probe_task_result_t *r = ep->result;
+    YB_LOG_INFO("  %s:%u (%s) dns=%u connect=%u first_byte=%u %s (%d)",
+                ep->host,
+                ep->port,
+                inet_ntop(AF_INET, &r->ipv4, s, sizeof(s)),
+                r->dns_ms,
+                r->connect_ms,
+                r->first_byte_ms,
+                probe_task_result_name(r->result),
+                r->error);
+  }
+}
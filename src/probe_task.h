@@ -0,0 +1,132 @@
+/**
+ * @file probe_task.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _PROBE_TASK_H_
+#define _PROBE_TASK_H_
+
+// *****************************************************************************
+// Includes
+
+#include "driver/driver_common.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// Matches TCP_SOCK_MAX: the WINC cannot hold more TCP sockets open at once.
+#define PROBE_TASK_MAX_ENDPOINTS 7
+
+#define PROBE_TASK_RESULTS(M)                                                  \
+  M(PROBE_RESULT_PENDING)                                                      \
+  M(PROBE_RESULT_OK)                                                           \
+  M(PROBE_RESULT_BAD_ENDPOINT)                                                 \
+  M(PROBE_RESULT_DNS_FAILED)                                                   \
+  M(PROBE_RESULT_SOCKET_FAILED)                                                \
+  M(PROBE_RESULT_CONNECT_FAILED)                                               \
+  M(PROBE_RESULT_CLOSED)                                                       \
+  M(PROBE_RESULT_TIMED_OUT)
+
+#define EXPAND_PROBE_RESULT_ENUM(_name) _name,
+typedef enum { PROBE_TASK_RESULTS(EXPAND_PROBE_RESULT_ENUM) } probe_result_t;
+
+/**
+ * @brief Compact outcome of probing one endpoint.  Times are in milliseconds
+ * (saturating at UINT16_MAX) and are zero for phases that did not complete.
+ */
+typedef struct {
+  uint32_t ipv4;          // resolved address
+  uint16_t dns_ms;        // gethostbyname() to resolver callback
+  uint16_t connect_ms;    // connect() to SOCKET_MSG_CONNECT
+  uint16_t first_byte_ms; // connect() to first SOCKET_MSG_RECV
+  uint8_t result;         // a probe_result_t
+  int8_t error;           // WINC socket error code, if any
+} probe_task_result_t;
+
+/**
+ * @brief Data that is preserved across reboots.
+ *
+ * Holds the result table of the most recent probe, indexed in the order that
+ * endpoints were added.
+ */
+typedef struct {
+  uint8_t result_count;
+  probe_task_result_t results[PROBE_TASK_MAX_ENDPOINTS];
+} probe_task_nv_data_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the probe_task.
+ *
+ * @param winc_handle A handle on the WINC device.
+ * @param budget_ms Endpoints that have not completed within this time are
+ *        reported as PROBE_RESULT_TIMED_OUT.
+ */
+void probe_task_init(DRV_HANDLE winc_handle, yb_rtc_ms_t budget_ms);
+
+/**
+ * @brief Add an endpoint to probe, in the form "host:port" or "a.b.c.d:port".
+ * The port defaults to 80 if omitted.
+ *
+ * Must be called after probe_task_init() and before the first call to
+ * probe_task_step().  Endpoints beyond PROBE_TASK_MAX_ENDPOINTS are ignored.
+ */
+void probe_task_add_endpoint(const char *endpoint);
+
+/**
+ * @brief Advance the probe_task state machine.
+ */
+void probe_task_step(void);
+
+bool probe_task_succeeded(void);
+
+bool probe_task_failed(void);
+
+/**
+ * @brief Release any resources allocated by probe_task.
+ */
+void probe_task_shutdown(void);
+
+/**
+ * @brief Return the name of a probe_result_t.
+ */
+const char *probe_task_result_name(probe_result_t result);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _PROBE_TASK_H_ */
@@ -0,0 +1,416 @@
+/**
+ * @file survey_task.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+
+// *****************************************************************************
+// Includes
+
+#include "survey_task.h"
+
+#include "definitions.h"
+#include "nv_data.h"
+#include "wdrv_winc_client_api.h"
+#include "yb_log.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+// Active scans send probes and wait a short slot for the answers: two slots of
+// 20 ms per channel finds nearly every AP that a 30 ms default slot would.
+#define SURVEY_TASK_NUM_SLOTS 2
+#define SURVEY_TASK_ACTIVE_SLOT_MS 20
+#define SURVEY_TASK_NUM_PROBES 2
+
+// Passive scans must listen for a whole beacon interval (102.4 ms) per slot.
+#define SURVEY_TASK_PASSIVE_SLOT_MS 110
+
+// A known BSS is reported again once its RSSI has moved this far.
+#define SURVEY_TASK_RSSI_DELTA 6
+
+#define STATES(M)                                                              \
+  M(SURVEY_TASK_STATE_INIT)                                                    \
+  M(SURVEY_TASK_STATE_START_SCAN)                                              \
+  M(SURVEY_TASK_STATE_AWAIT_SCAN)                                              \
+  M(SURVEY_TASK_STATE_AWAIT_RESULT)                                            \
+  M(SURVEY_TASK_STATE_REPORT)                                                  \
+  M(SURVEY_TASK_STATE_SUCCESS)                                                 \
+  M(SURVEY_TASK_STATE_ERROR)
+
+#define EXPAND_STATE_ENUM_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_ENUM_IDS) } survey_task_state_t;
+
+typedef struct {
+  survey_task_state_t state;
+  DRV_HANDLE winc_handle;
+  uint16_t channel_mask;    // 0 = leave unchanged
+  bool passive;
+  yb_rtc_ms_t budget_ms;
+  bool configured;          // true if the scan parameters need restoring
+  yb_rtc_tics_t started_at; // time at which the scan was requested
+  uint8_t found;            // # of results the scan reported
+  uint8_t read;             // # of results read so far
+} survey_task_ctx_t;
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+static void survey_task_set_state(survey_task_state_t new_state);
+
+static const char *survey_task_state_name(survey_task_state_t state);
+
+/**
+ * @brief Return true if the scan budget has been used up.
+ */
+static bool survey_task_budget_exhausted(void);
+
+/**
+ * @brief Merge one scan result into the table in nv_data.
+ */
+static void survey_task_record(const WDRV_WINC_BSS_INFO *info);
+
+/**
+ * @brief Return the table entry for bssid, an unused entry, or the entry that
+ * has gone unseen the longest, in that order of preference.
+ */
+static survey_task_bss_t *survey_task_find_slot(const uint8_t *bssid);
+
+/**
+ * @brief Return the 32 bit FNV-1a hash of len bytes.
+ */
+static uint32_t survey_task_hash(const uint8_t *data, size_t len);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static survey_task_ctx_t s_survey_task_ctx;
+
+#define EXPAND_STATE_NAMES(_name) #_name,
+static const char *s_survey_task_state_names[] = {STATES(EXPAND_STATE_NAMES)};
+
+// *****************************************************************************
+// Public code
+
+void survey_task_init(DRV_HANDLE winc_handle,
+                      uint16_t channel_mask,
+                      bool passive,
+                      yb_rtc_ms_t budget_ms) {
+  s_survey_task_ctx.winc_handle = winc_handle;
+  s_survey_task_ctx.channel_mask = channel_mask;
+  s_survey_task_ctx.passive = passive;
+  s_survey_task_ctx.budget_ms = budget_ms;
+  s_survey_task_ctx.configured = false;
+  s_survey_task_ctx.found = 0;
+  s_survey_task_ctx.read = 0;
+  s_survey_task_ctx.state = SURVEY_TASK_STATE_INIT;
+}
+
+void survey_task_step(void) {
+  switch (s_survey_task_ctx.state) {
+
+  case SURVEY_TASK_STATE_INIT: {
+    const char *err = NULL;
+    do {
+      s_survey_task_ctx.configured = true;
+      if (WDRV_WINC_STATUS_OK !=
+          WDRV_WINC_BSSFindSetScanParameters(s_survey_task_ctx.winc_handle,
+                                             SURVEY_TASK_NUM_SLOTS,
+                                             SURVEY_TASK_ACTIVE_SLOT_MS,
+                                             SURVEY_TASK_PASSIVE_SLOT_MS,
+                                             SURVEY_TASK_NUM_PROBES)) {
+        err = "WDRV_WINC_BSSFindSetScanParameters() failed";
+        break;
+      }
+      if (s_survey_task_ctx.channel_mask != 0 &&
+          WDRV_WINC_STATUS_OK != WDRV_WINC_BSSFindSetEnabledChannels(
+                                     s_survey_task_ctx.winc_handle,
+                                     s_survey_task_ctx.channel_mask)) {
+        err = "WDRV_WINC_BSSFindSetEnabledChannels() failed";
+        break;
+      }
+    } while (0);
+
+    if (err != NULL) {
+      YB_LOG_ERROR("%s", err);
+      survey_task_set_state(SURVEY_TASK_STATE_ERROR);
+    } else {
+      survey_task_set_state(SURVEY_TASK_STATE_START_SCAN);
+    }
+  } break;
+
+  case SURVEY_TASK_STATE_START_SCAN: {
+    s_survey_task_ctx.started_at = yb_rtc_now();
+    if (WDRV_WINC_STATUS_OK !=
+        WDRV_WINC_BSSFindFirst(s_survey_task_ctx.winc_handle,
+                               WDRV_WINC_ALL_CHANNELS,
+                               !s_survey_task_ctx.passive,
+                               NULL,
+                               NULL)) {
+      YB_LOG_ERROR("WDRV_WINC_BSSFindFirst() failed");
+      survey_task_set_state(SURVEY_TASK_STATE_ERROR);
+    } else {
+      survey_task_set_state(SURVEY_TASK_STATE_AWAIT_SCAN);
+    }
+  } break;
+
+  case SURVEY_TASK_STATE_AWAIT_SCAN: {
+    if (survey_task_budget_exhausted()) {
+      survey_task_set_state(SURVEY_TASK_STATE_REPORT);
+    } else if (WDRV_WINC_BSSFindInProgress(s_survey_task_ctx.winc_handle)) {
+      // remain in this state until the scan completes
+    } else {
+      s_survey_task_ctx.found =
+          WDRV_WINC_BSSFindGetNumBSSResults(s_survey_task_ctx.winc_handle);
+      nv_data()->survey_task_nv_data.last_scan_ms =
+          yb_rtc_elapsed_ms(s_survey_task_ctx.started_at);
+      if (s_survey_task_ctx.found == 0) {
+        survey_task_set_state(SURVEY_TASK_STATE_REPORT);
+      } else {
+        // The driver has already requested the first result.
+        survey_task_set_state(SURVEY_TASK_STATE_AWAIT_RESULT);
+      }
+    }
+  } break;
+
+  case SURVEY_TASK_STATE_AWAIT_RESULT: {
+    // Each result is a separate round trip to the WINC: poll for it, record
+    // it, then ask for the next.
+    WDRV_WINC_BSS_INFO info;
+    if (survey_task_budget_exhausted()) {
+      survey_task_set_state(SURVEY_TASK_STATE_REPORT);
+    } else if (WDRV_WINC_STATUS_OK !=
+               WDRV_WINC_BSSFindGetInfo(s_survey_task_ctx.winc_handle,
+                                        &info)) {
+      // remain in this state until the result arrives
+    } else {
+      survey_task_record(&info);
+      s_survey_task_ctx.read += 1;
+      if (WDRV_WINC_STATUS_OK !=
+          WDRV_WINC_BSSFindNext(s_survey_task_ctx.winc_handle, NULL)) {
+        // WDRV_WINC_STATUS_BSS_FIND_END, or no way to get the rest
+        survey_task_set_state(SURVEY_TASK_STATE_REPORT);
+      }
+    }
+  } break;
+
+  case SURVEY_TASK_STATE_REPORT: {
+    survey_task_nv_data_t *nv = &nv_data()->survey_task_nv_data;
+    int dirty = 0;
+    for (int i = 0; i < SURVEY_TASK_MAX_BSS; i++) {
+      if (nv->bss[i].flags & SURVEY_TASK_FLAG_DIRTY) {
+        dirty += 1;
+      }
+    }
+    nv->survey_count += 1;
+    nv->last_found = s_survey_task_ctx.found;
+    YB_LOG_INFO("Survey %u: %u of %u BSSs read in %d ms, %d to report, %u "
+                "evictions",
+                nv->survey_count,
+                s_survey_task_ctx.read,
+                s_survey_task_ctx.found,
+                (int)yb_rtc_elapsed_ms(s_survey_task_ctx.started_at),
+                dirty,
+                nv->evictions);
+    survey_task_set_state(SURVEY_TASK_STATE_SUCCESS);
+  } break;
+
+  case SURVEY_TASK_STATE_SUCCESS: {
+    // remain in this state
+  } break;
+
+  case SURVEY_TASK_STATE_ERROR: {
+    // remain in this state
+  } break;
+
+  } // switch
+}
+
+bool survey_task_succeeded(void) {
+  return s_survey_task_ctx.state == SURVEY_TASK_STATE_SUCCESS;
+}
+
+bool survey_task_failed(void) {
+  return s_survey_task_ctx.state == SURVEY_TASK_STATE_ERROR;
+}
+
+void survey_task_shutdown(void) {
+  if (!s_survey_task_ctx.configured) {
+    return;
+  }
+  // Leave the WINC scanning as it would by default, e.g. for winc_task.
+  WDRV_WINC_BSSFindSetScanParameters(s_survey_task_ctx.winc_handle,
+                                     M2M_SCAN_DEFAULT_NUM_SLOTS,
+                                     M2M_SCAN_DEFAULT_SLOT_TIME,
+                                     M2M_SCAN_DEFAULT_PASSIVE_SLOT_TIME,
+                                     M2M_SCAN_DEFAULT_NUM_PROBE);
+  if (s_survey_task_ctx.channel_mask != 0) {
+    WDRV_WINC_BSSFindSetEnabledChannels(s_survey_task_ctx.winc_handle,
+                                        WDRV_WINC_CM_2_4G_ALL);
+  }
+  s_survey_task_ctx.configured = false;
+}
+
+size_t survey_task_encode(uint8_t *buf, size_t size) {
+  survey_task_nv_data_t *nv = &nv_data()->survey_task_nv_data;
+  size_t n = 1;
+
+  if (size < 1) {
+    return 0;
+  }
+  buf[0] = 0;
+  for (int i = 0; i < SURVEY_TASK_MAX_BSS; i++) {
+    survey_task_bss_t *bss = &nv->bss[i];
+    bss->flags &= ~SURVEY_TASK_FLAG_PENDING;
+    if ((bss->flags & SURVEY_TASK_FLAG_DIRTY) == 0 ||
+        n + SURVEY_TASK_WIRE_SIZE > size) {
+      continue;
+    }
+    memcpy(&buf[n], bss->bssid, sizeof(bss->bssid));
+    buf[n + 6] = (uint8_t)(bss->auth << 4) | (bss->channel & 0x0f);
+    buf[n + 7] = (uint8_t)bss->rssi;
+    n += SURVEY_TASK_WIRE_SIZE;
+    buf[0] += 1;
+    bss->flags |= SURVEY_TASK_FLAG_PENDING;
+  }
+  return n;
+}
+
+void survey_task_encoded_delivered(void) {
+  survey_task_nv_data_t *nv = &nv_data()->survey_task_nv_data;
+
+  for (int i = 0; i < SURVEY_TASK_MAX_BSS; i++) {
+    survey_task_bss_t *bss = &nv->bss[i];
+    if (bss->flags & SURVEY_TASK_FLAG_PENDING) {
+      bss->flags &= ~(SURVEY_TASK_FLAG_PENDING | SURVEY_TASK_FLAG_DIRTY);
+      bss->reported_rssi = bss->rssi;
+    }
+  }
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void survey_task_set_state(survey_task_state_t new_state) {
+  if (new_state != s_survey_task_ctx.state) {
+    YB_LOG_INFO("%s => %s",
+                survey_task_state_name(s_survey_task_ctx.state),
+                survey_task_state_name(new_state));
+    s_survey_task_ctx.state = new_state;
+  }
+}
+
+static const char *survey_task_state_name(survey_task_state_t state) {
+  return s_survey_task_state_names[state];
+}
+
+static bool survey_task_budget_exhausted(void) {
+  if (yb_rtc_elapsed_ms(s_survey_task_ctx.started_at) <=
+      s_survey_task_ctx.budget_ms) {
+    return false;
+  }
+  YB_LOG_WARN("Survey exceeded its %d ms budget",
+              (int)s_survey_task_ctx.budget_ms);
+  nv_data()->survey_task_nv_data.budget_overruns += 1;
+  return true;
+}
+
+static void survey_task_record(const WDRV_WINC_BSS_INFO *info) {
+  survey_task_nv_data_t *nv = &nv_data()->survey_task_nv_data;
+  uint16_t this_survey = nv->survey_count + 1;
+  const uint8_t *bssid = info->ctx.bssid.addr;
+  survey_task_bss_t *bss = survey_task_find_slot(bssid);
+
+  YB_LOG_INFO("  %02x:%02x:%02x:%02x:%02x:%02x ch %2d rssi %d auth %d %.*s",
+              bssid[0],
+              bssid[1],
+              bssid[2],
+              bssid[3],
+              bssid[4],
+              bssid[5],
+              info->ctx.channel,
+              info->rssi,
+              info->authType,
+              info->ctx.ssid.length,
+              info->ctx.ssid.name);
+
+  if (bss->seen_count == 0 || memcmp(bss->bssid, bssid, 6) != 0) {
+    // a new BSS, possibly displacing a stale one
+    memset(bss, 0, sizeof(survey_task_bss_t));
+    memcpy(bss->bssid, bssid, 6);
+    bss->flags = SURVEY_TASK_FLAG_DIRTY;
+  } else if (bss->channel != info->ctx.channel ||
+             bss->auth != info->authType ||
+             bss->reported_rssi - info->rssi >= SURVEY_TASK_RSSI_DELTA ||
+             info->rssi - bss->reported_rssi >= SURVEY_TASK_RSSI_DELTA) {
+    bss->flags |= SURVEY_TASK_FLAG_DIRTY;
+  }
+  bss->channel = info->ctx.channel;
+  bss->auth = info->authType;
+  bss->rssi = info->rssi;
+  bss->ssid_hash = survey_task_hash(info->ctx.ssid.name, info->ctx.ssid.length);
+  if (bss->last_survey != this_survey && bss->seen_count < UINT16_MAX) {
+    bss->seen_count += 1;
+  }
+  bss->last_survey = this_survey;
+}
+
+static survey_task_bss_t *survey_task_find_slot(const uint8_t *bssid) {
+  survey_task_nv_data_t *nv = &nv_data()->survey_task_nv_data;
+  survey_task_bss_t *unused = NULL;
+  survey_task_bss_t *stalest = &nv->bss[0];
+
+  for (int i = 0; i < SURVEY_TASK_MAX_BSS; i++) {
+    survey_task_bss_t *bss = &nv->bss[i];
+    if (bss->seen_count == 0) {
+      if (unused == NULL) {
+        unused = bss;
+      }
+    } else if (memcmp(bss->bssid, bssid, 6) == 0) {
+      return bss;
+    } else if ((uint16_t)(nv->survey_count - bss->last_survey) >
+               (uint16_t)(nv->survey_count - stalest->last_survey)) {
+      stalest = bss;
+    }
+  }
+  if (unused != NULL) {
+    return unused;
+  }
+  nv->evictions += 1;
+  return stalest;
+}
+
+static uint32_t survey_task_hash(const uint8_t *data, size_t len) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+}
@@ -0,0 +1,147 @@
+/**
+ * @file survey_task.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Scan for every BSS within range and keep a compact, deduplicated table of
+// them in nv_data so that the RF environment can be reported with the
+// telemetry.  Records that are new or have changed since they were last
+// reported are marked dirty until a report carrying them is acknowledged.
+
+#ifndef _SURVEY_TASK_H_
+#define _SURVEY_TASK_H_
+
+// *****************************************************************************
+// Includes
+
+#include "driver/driver_common.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+// Number of distinct BSSs remembered across wakes.  When the table is full the
+// BSS that has gone unseen the longest is replaced.
+#define SURVEY_TASK_MAX_BSS 24
+
+// Size of one record in the wire format produced by survey_task_encode().
+#define SURVEY_TASK_WIRE_SIZE 8
+
+/**
+ * @brief One BSS seen by the survey.  An entry with seen_count == 0 is unused.
+ */
+typedef struct {
+  uint8_t bssid[6];      // MAC address of the AP
+  uint8_t channel;       // 1 - 14
+  uint8_t auth;          // WDRV_WINC_AUTH_TYPE
+  int8_t rssi;           // RSSI at the most recent sighting
+  int8_t reported_rssi;  // RSSI when the record was last reported
+  uint8_t flags;         // SURVEY_TASK_FLAG_xxx
+  uint16_t seen_count;   // # of surveys that have seen this BSS
+  uint16_t last_survey;  // survey_count at the most recent sighting
+  uint32_t ssid_hash;    // FNV-1a hash of the SSID
+} survey_task_bss_t;
+
+#define SURVEY_TASK_FLAG_DIRTY 0x01   // changed since last reported
+#define SURVEY_TASK_FLAG_PENDING 0x02 // in a report awaiting acknowledgement
+
+/**
+ * @brief Data that is preserved across reboots.
+ */
+typedef struct {
+  survey_task_bss_t bss[SURVEY_TASK_MAX_BSS];
+  uint16_t survey_count;    // # of completed surveys
+  uint16_t budget_overruns; // # of surveys cut short by the budget
+  uint16_t evictions;       // # of records replaced to make room
+  uint8_t last_found;       // # of BSSs reported by the most recent scan
+  uint16_t last_scan_ms;    // duration of the most recent scan
+} survey_task_nv_data_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the survey_task.
+ *
+ * Must be called while the WINC is open but not connecting: the scan would
+ * otherwise compete with the association for the radio.
+ *
+ * @param winc_handle A handle on the WINC device.
+ * @param channel_mask WDRV_WINC_CHANNEL_MASK of the channels to scan, or 0 to
+ *        leave the WINC's enabled channels unchanged.
+ * @param passive If true, listen for beacons rather than sending probes.
+ *        Slower, but also finds APs that do not answer probe requests.
+ * @param budget_ms Time allowed for the scan and for reading its results.
+ *        Results not read when the budget expires are dropped.
+ */
+void survey_task_init(DRV_HANDLE winc_handle,
+                      uint16_t channel_mask,
+                      bool passive,
+                      yb_rtc_ms_t budget_ms);
+
+/**
+ * @brief Advance the survey_task state machine.
+ */
+void survey_task_step(void);
+
+bool survey_task_succeeded(void);
+
+bool survey_task_failed(void);
+
+/**
+ * @brief Release any resources allocated by survey_task and restore the WINC's
+ * default scan parameters.
+ */
+void survey_task_shutdown(void);
+
+/**
+ * @brief Write as many dirty records as fit into buf and mark them pending.
+ *
+ * Returns the number of bytes written: a count byte followed by that many
+ * SURVEY_TASK_WIRE_SIZE records of BSSID (6 bytes), auth << 4 | channel and
+ * RSSI.
+ */
+size_t survey_task_encode(uint8_t *buf, size_t size);
+
+/**
+ * @brief Mark the records written by the last survey_task_encode() as
+ * reported.
+ */
+void survey_task_encoded_delivered(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _SURVEY_TASK_H_ */
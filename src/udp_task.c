@@ -0,0 +1,472 @@
+/**
+ * @file udp_task.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "udp_task.h"
+
+#include "definitions.h"
+#include "nv_data.h"
+#include "wdrv_winc_client_api.h"
+#include "yb_hmac.h"
+#include "yb_log.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define UDP_TASK_DATAGRAM_SIZE                                                 \
+  (UDP_TASK_HEADER_SIZE + UDP_TASK_MAX_PAYLOAD + UDP_TASK_MAC_SIZE)
+
+// The WINC reports SOCK_ERR_TIMEOUT when recvfrom() times out.  If that report
+// is this late, give up waiting for it and treat the attempt as timed out.
+#define UDP_TASK_TIMEOUT_GRACE_MS ((yb_rtc_ms_t)500.0)
+
+#define STATES(M)                                                              \
+  M(UDP_TASK_STATE_INIT)                                                       \
+  M(UDP_TASK_STATE_AWAIT_IP_LINK)                                              \
+  M(UDP_TASK_STATE_AWAIT_DNS)                                                  \
+  M(UDP_TASK_STATE_START_SOCKET)                                               \
+  M(UDP_TASK_STATE_AWAIT_BIND)                                                 \
+  M(UDP_TASK_STATE_SEND_REPORT)                                                \
+  M(UDP_TASK_STATE_AWAIT_ACK)                                                  \
+  M(UDP_TASK_STATE_SUCCESS)                                                    \
+  M(UDP_TASK_STATE_ERROR)
+
+#define EXPAND_STATE_ENUM_IDS(_name) _name,
+typedef enum { STATES(EXPAND_STATE_ENUM_IDS) } udp_task_state_t;
+
+typedef struct {
+  udp_task_state_t state;
+  DRV_HANDLE winc_handle;
+  char host[HOSTNAME_MAX_SIZE];
+  uint32_t host_ipv4;
+  uint16_t port;
+  const char *key;
+  uint8_t max_attempts;
+  uint8_t attempts;           // # of datagrams sent for this report
+  uint32_t seq;               // sequence number of this report
+  yb_rtc_ms_t ack_timeout_ms; // current ack timeout, doubles on each retry
+  yb_rtc_tics_t first_sent_at; // time at which the first datagram was sent
+  yb_rtc_tics_t sent_at;       // time at which the latest datagram was sent
+  SOCKET socket;
+  size_t report_len;
+  uint8_t report[UDP_TASK_DATAGRAM_SIZE];
+  uint8_t recv_buf[UDP_TASK_DATAGRAM_SIZE];
+} udp_task_ctx_t;
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+static void udp_task_set_state(udp_task_state_t new_state);
+
+static const char *udp_task_state_name(udp_task_state_t state);
+
+static void udp_task_socket_callback(SOCKET socket,
+                                     uint8_t msg_type,
+                                     void *msg);
+
+static void udp_task_resolver_cb(uint8_t *pu8DomainName, uint32_t u32ServerIP);
+
+/**
+ * @brief Assemble the report datagram: header, payload and MAC.
+ */
+static size_t udp_build_datagram(uint8_t *buf,
+                                 uint8_t type,
+                                 uint32_t seq,
+                                 const void *payload,
+                                 size_t payload_len);
+
+/**
+ * @brief Return a non-zero random number from the TRNG.
+ */
+static uint32_t udp_draw_epoch(void);
+
+/**
+ * @brief Return true if buf holds an authentic ack for the current report.
+ */
+static bool udp_is_valid_ack(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Resend the report with a doubled timeout, or give up.
+ */
+static void udp_retry_or_fail(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static udp_task_ctx_t s_udp_task_ctx;
+
+#define EXPAND_STATE_NAMES(_name) #_name,
+static const char *s_udp_task_state_names[] = {STATES(EXPAND_STATE_NAMES)};
+
+// *****************************************************************************
+// Public code
+
+void udp_task_init(DRV_HANDLE winc_handle,
+                   const char *host,
+                   uint16_t port,
+                   const char *key,
+                   const void *payload,
+                   size_t payload_len,
+                   uint8_t max_attempts,
+                   yb_rtc_ms_t ack_timeout_ms) {
+  udp_task_nv_data_t *nv = &nv_data()->udp_task_nv_data;
+  udp_task_ctx_t *p = &s_udp_task_ctx; // typing avoidance
+
+  p->state = UDP_TASK_STATE_INIT;
+  p->winc_handle = winc_handle;
+  strncpy(p->host, host, sizeof(p->host) - 1);
+  p->host[sizeof(p->host) - 1] = '\0';
+  p->host_ipv4 = inet_addr(p->host);
+  p->port = port;
+  p->key = key;
+  p->max_attempts = (max_attempts == 0) ? 1 : max_attempts;
+  p->attempts = 0;
+  p->ack_timeout_ms = ack_timeout_ms;
+  p->socket = -1;
+
+  // Sequence numbers persist across wakes so that the server can discard
+  // replayed or duplicated reports.  A cold boot clears them, so each cold
+  // boot starts a new epoch.
+  if (nv->epoch == 0) {
+    nv->epoch = udp_draw_epoch();
+    YB_LOG_INFO("UDP report epoch is %08lx", nv->epoch);
+  }
+  p->seq = nv->next_seq++;
+  nv->report_count += 1;
+  nv->last_attempts = 0;
+  if (payload_len > UDP_TASK_MAX_PAYLOAD) {
+    YB_LOG_WARN("UDP report truncated to %d bytes", UDP_TASK_MAX_PAYLOAD);
+    payload_len = UDP_TASK_MAX_PAYLOAD;
+  }
+  p->report_len = udp_build_datagram(
+      p->report, UDP_TASK_TYPE_REPORT, p->seq, payload, payload_len);
+
+  socketInit();
+}
+
+void udp_task_step(void) {
+  switch (s_udp_task_ctx.state) {
+
+  case UDP_TASK_STATE_INIT: {
+    if (WDRV_WINC_STATUS_OK !=
+        WDRV_WINC_SocketRegisterEventCallback(s_udp_task_ctx.winc_handle,
+                                              udp_task_socket_callback)) {
+      YB_LOG_ERROR("Unable to register socket callback");
+      udp_task_set_state(UDP_TASK_STATE_ERROR);
+    } else {
+      udp_task_set_state(UDP_TASK_STATE_AWAIT_IP_LINK);
+    }
+  } break;
+
+  case UDP_TASK_STATE_AWAIT_IP_LINK: {
+    if (WDRV_WINC_IPLinkActive(s_udp_task_ctx.winc_handle) == false) {
+      // remain in this state until the WINC reports IP Link active.
+    } else if (s_udp_task_ctx.host_ipv4 != 0) {
+      // numeric address: no DNS lookup needed
+      udp_task_set_state(UDP_TASK_STATE_START_SOCKET);
+    } else if (WDRV_WINC_STATUS_OK !=
+               WDRV_WINC_SocketRegisterResolverCallback(
+                   s_udp_task_ctx.winc_handle, udp_task_resolver_cb)) {
+      YB_LOG_ERROR("Unable to register resolver callback");
+      udp_task_set_state(UDP_TASK_STATE_ERROR);
+    } else if (gethostbyname(s_udp_task_ctx.host) < 0) {
+      YB_LOG_ERROR("gethostbyname(%s) failed", s_udp_task_ctx.host);
+      udp_task_set_state(UDP_TASK_STATE_ERROR);
+    } else {
+      udp_task_set_state(UDP_TASK_STATE_AWAIT_DNS);
+    }
+  } break;
+
+  case UDP_TASK_STATE_AWAIT_DNS: {
+    // remain in this state until advanced by udp_task_resolver_cb()
+  } break;
+
+  case UDP_TASK_STATE_START_SOCKET: {
+    struct sockaddr_in addr;
+
+    s_udp_task_ctx.socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s_udp_task_ctx.socket < 0) {
+      YB_LOG_ERROR("Unable to open a UDP socket");
+      udp_task_set_state(UDP_TASK_STATE_ERROR);
+      break;
+    }
+    // Bind so that the ack, addressed to our source port, is delivered.
+    addr.sin_family = AF_INET;
+    addr.sin_port = _htons(s_udp_task_ctx.port);
+    addr.sin_addr.s_addr = 0;
+    if (bind(s_udp_task_ctx.socket,
+             (struct sockaddr *)&addr,
+             sizeof(struct sockaddr_in)) < 0) {
+      YB_LOG_ERROR("bind() failed");
+      udp_task_set_state(UDP_TASK_STATE_ERROR);
+    } else {
+      udp_task_set_state(UDP_TASK_STATE_AWAIT_BIND);
+    }
+  } break;
+
+  case UDP_TASK_STATE_AWAIT_BIND: {
+    // remain here until udp_task_socket_callback() advances state
+  } break;
+
+  case UDP_TASK_STATE_SEND_REPORT: {
+    struct sockaddr_in addr;
+    addr.sin_family = AF_INET;
+    addr.sin_port = _htons(s_udp_task_ctx.port);
+    addr.sin_addr.s_addr = s_udp_task_ctx.host_ipv4;
+
+    s_udp_task_ctx.sent_at = yb_rtc_now();
+    if (s_udp_task_ctx.attempts == 0) {
+      s_udp_task_ctx.first_sent_at = s_udp_task_ctx.sent_at;
+    }
+    if (sendto(s_udp_task_ctx.socket,
+               s_udp_task_ctx.report,
+               s_udp_task_ctx.report_len,
+               0,
+               (struct sockaddr *)&addr,
+               sizeof(struct sockaddr_in)) < 0) {
+      YB_LOG_ERROR("sendto() failed");
+      udp_task_set_state(UDP_TASK_STATE_ERROR);
+      break;
+    }
+    s_udp_task_ctx.attempts += 1;
+    nv_data()->udp_task_nv_data.last_attempts = s_udp_task_ctx.attempts;
+    // The WINC ignores this if a recvfrom() from a previous attempt is still
+    // outstanding, in which case that one delivers the ack.
+    recvfrom(s_udp_task_ctx.socket,
+             s_udp_task_ctx.recv_buf,
+             sizeof(s_udp_task_ctx.recv_buf),
+             (uint32_t)s_udp_task_ctx.ack_timeout_ms);
+    udp_task_set_state(UDP_TASK_STATE_AWAIT_ACK);
+  } break;
+
+  case UDP_TASK_STATE_AWAIT_ACK: {
+    // udp_task_socket_callback() advances state on an ack or a timeout.
+    if (yb_rtc_elapsed_ms(s_udp_task_ctx.sent_at) >
+        s_udp_task_ctx.ack_timeout_ms + UDP_TASK_TIMEOUT_GRACE_MS) {
+      udp_retry_or_fail();
+    }
+  } break;
+
+  case UDP_TASK_STATE_SUCCESS: {
+    // remain in this state
+  } break;
+
+  case UDP_TASK_STATE_ERROR: {
+    // remain in this state
+  } break;
+
+  } // switch
+}
+
+bool udp_task_succeeded(void) {
+  return s_udp_task_ctx.state == UDP_TASK_STATE_SUCCESS;
+}
+
+bool udp_task_failed(void) {
+  return s_udp_task_ctx.state == UDP_TASK_STATE_ERROR;
+}
+
+void udp_task_shutdown(void) {
+  if (s_udp_task_ctx.socket >= 0) {
+    shutdown(s_udp_task_ctx.socket);
+    s_udp_task_ctx.socket = -1;
+  }
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void udp_task_set_state(udp_task_state_t new_state) {
+  if (new_state != s_udp_task_ctx.state) {
+    YB_LOG_INFO("%s => %s",
+                udp_task_state_name(s_udp_task_ctx.state),
+                udp_task_state_name(new_state));
+    s_udp_task_ctx.state = new_state;
+  }
+}
+
+static const char *udp_task_state_name(udp_task_state_t state) {
+  return s_udp_task_state_names[state];
+}
+
+static void udp_task_socket_callback(SOCKET socket,
+                                     uint8_t msg_type,
+                                     void *msg) {
+  udp_task_nv_data_t *nv = &nv_data()->udp_task_nv_data;
+
+  if (socket != s_udp_task_ctx.socket) {
+    YB_LOG_DEBUG("Received socket callback for unknown socket");
+    return;
+  }
+
+  switch (msg_type) {
+  case SOCKET_MSG_BIND: {
+    tstrSocketBindMsg *bind_msg = (tstrSocketBindMsg *)msg;
+    if (bind_msg != NULL && bind_msg->status == 0) {
+      udp_task_set_state(UDP_TASK_STATE_SEND_REPORT);
+    } else {
+      YB_LOG_ERROR("bind failed (%d)",
+                   bind_msg == NULL ? 0 : bind_msg->status);
+      udp_task_set_state(UDP_TASK_STATE_ERROR);
+    }
+  } break;
+
+  case SOCKET_MSG_SENDTO: {
+    // nothing to do: the ack, not the send, completes the report.
+  } break;
+
+  case SOCKET_MSG_RECVFROM: {
+    tstrSocketRecvMsg *recv_msg = (tstrSocketRecvMsg *)msg;
+    if (s_udp_task_ctx.state != UDP_TASK_STATE_AWAIT_ACK) {
+      // e.g. a late ack after the report was given up
+    } else if (recv_msg != NULL && recv_msg->s16BufferSize > 0 &&
+               udp_is_valid_ack(recv_msg->pu8Buffer,
+                                recv_msg->s16BufferSize)) {
+      // RTT from the latest send: an ack to an earlier attempt makes this an
+      // underestimate, never an overestimate.
+      yb_rtc_ms_t rtt_ms = yb_rtc_elapsed_ms(s_udp_task_ctx.sent_at);
+      nv->last_rtt_ms = (rtt_ms >= UINT16_MAX) ? UINT16_MAX : (uint16_t)rtt_ms;
+      nv->acked_count += 1;
+      YB_LOG_INFO("UDP report %ld acked after %d attempt(s), %d ms",
+                  s_udp_task_ctx.seq,
+                  s_udp_task_ctx.attempts,
+                  (int)yb_rtc_elapsed_ms(s_udp_task_ctx.first_sent_at));
+      udp_task_set_state(UDP_TASK_STATE_SUCCESS);
+    } else if (recv_msg != NULL && recv_msg->s16BufferSize > 0) {
+      // Not ours, forged or stale: keep listening for the real ack.
+      nv->bad_ack_count += 1;
+      recvfrom(s_udp_task_ctx.socket,
+               s_udp_task_ctx.recv_buf,
+               sizeof(s_udp_task_ctx.recv_buf),
+               (uint32_t)s_udp_task_ctx.ack_timeout_ms);
+    } else {
+      // SOCK_ERR_TIMEOUT or other error
+      udp_retry_or_fail();
+    }
+  } break;
+
+  default: {
+    YB_LOG_WARN("Unrecognized socket callback type %d", msg_type);
+  }
+  } // switch
+}
+
+static void udp_task_resolver_cb(uint8_t *pu8DomainName, uint32_t u32ServerIP) {
+  if (s_udp_task_ctx.state != UDP_TASK_STATE_AWAIT_DNS ||
+      strcmp(s_udp_task_ctx.host, (const char *)pu8DomainName) != 0) {
+    YB_LOG_DEBUG("Ignoring DNS answer for %s", pu8DomainName);
+  } else if (u32ServerIP == 0) {
+    YB_LOG_ERROR("Unable to resolve %s", pu8DomainName);
+    udp_task_set_state(UDP_TASK_STATE_ERROR);
+  } else {
+    s_udp_task_ctx.host_ipv4 = u32ServerIP;
+    udp_task_set_state(UDP_TASK_STATE_START_SOCKET);
+  }
+}
+
+static size_t udp_build_datagram(uint8_t *buf,
+                                 uint8_t type,
+                                 uint32_t seq,
+                                 const void *payload,
+                                 size_t payload_len) {
+  uint32_t epoch = nv_data()->udp_task_nv_data.epoch;
+  size_t n = UDP_TASK_HEADER_SIZE + payload_len;
+
+  buf[0] = 'Y';
+  buf[1] = 'B';
+  buf[2] = UDP_TASK_VERSION;
+  buf[3] = type;
+  buf[4] = (uint8_t)(epoch >> 24);
+  buf[5] = (uint8_t)(epoch >> 16);
+  buf[6] = (uint8_t)(epoch >> 8);
+  buf[7] = (uint8_t)(epoch);
+  buf[8] = (uint8_t)(seq >> 24);
+  buf[9] = (uint8_t)(seq >> 16);
+  buf[10] = (uint8_t)(seq >> 8);
+  buf[11] = (uint8_t)(seq);
+  buf[12] = (uint8_t)payload_len;
+  if (payload_len > 0) {
+    memcpy(&buf[UDP_TASK_HEADER_SIZE], payload, payload_len);
+  }
+  yb_hmac_sha256(s_udp_task_ctx.key,
+                 strlen(s_udp_task_ctx.key),
+                 buf,
+                 n,
+                 &buf[n],
+                 UDP_TASK_MAC_SIZE);
+  return n + UDP_TASK_MAC_SIZE;
+}
+
+static uint32_t udp_draw_epoch(void) {
+  uint32_t epoch;
+
+  MCLK_REGS->MCLK_APBCMASK |= MCLK_APBCMASK_TRNG_Msk;
+  TRNG_REGS->TRNG_CTRLA = TRNG_CTRLA_ENABLE_Msk;
+  do {
+    while ((TRNG_REGS->TRNG_INTFLAG & TRNG_INTFLAG_DATARDY_Msk) == 0) {
+      // a new word is ready every 84 clock cycles
+    }
+    epoch = TRNG_REGS->TRNG_DATA;
+  } while (epoch == 0);
+  TRNG_REGS->TRNG_CTRLA = 0;
+  MCLK_REGS->MCLK_APBCMASK &= ~MCLK_APBCMASK_TRNG_Msk;
+  return epoch;
+}
+
+static bool udp_is_valid_ack(const uint8_t *buf, size_t len) {
+  uint8_t expected[UDP_TASK_HEADER_SIZE + UDP_TASK_MAC_SIZE];
+  uint8_t diff = 0;
+
+  if (len != sizeof(expected)) {
+    return false;
+  }
+  udp_build_datagram(expected, UDP_TASK_TYPE_ACK, s_udp_task_ctx.seq, NULL, 0);
+  // Compare every byte so that timing does not reveal how much matched.
+  for (size_t i = 0; i < sizeof(expected); i++) {
+    diff |= expected[i] ^ buf[i];
+  }
+  return diff == 0;
+}
+
+static void udp_retry_or_fail(void) {
+  if (s_udp_task_ctx.attempts >= s_udp_task_ctx.max_attempts) {
+    YB_LOG_WARN("UDP report %ld not acked after %d attempts",
+                s_udp_task_ctx.seq,
+                s_udp_task_ctx.attempts);
+    udp_task_set_state(UDP_TASK_STATE_ERROR);
+  } else {
+    nv_data()->udp_task_nv_data.retry_count += 1;
+    s_udp_task_ctx.ack_timeout_ms *= 2;
+    udp_task_set_state(UDP_TASK_STATE_SEND_REPORT);
+  }
+}
@@ -0,0 +1,137 @@
+/**
+ * @file udp_task.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Deliver a short report in a single authenticated UDP datagram and wait for
+// the server's acknowledgement, retrying a bounded number of times.  This
+// avoids the TCP (and TLS) handshakes of the HTTP path when only a few dozen
+// bytes need to be reported.
+//
+// Datagram layout (multi-byte fields are big-endian):
+//
+//   0  'Y' 'B'
+//   2  version (UDP_TASK_VERSION)
+//   3  type (UDP_TASK_TYPE_REPORT or UDP_TASK_TYPE_ACK)
+//   4  epoch (32 bits), drawn from the TRNG at the first report of each cold
+//      boot, never zero
+//   8  sequence number (32 bits), restarting at zero with each epoch
+//  12  payload length (8 bits), zero for an ack
+//  13  payload
+//  13 + length: first UDP_TASK_MAC_SIZE bytes of HMAC-SHA256 over bytes 0 ..
+//      12 + length, keyed with the shared secret
+//
+// The server acknowledges a report by returning an ack with the same epoch and
+// sequence number, authenticated with the same key.  Sequence numbers restart
+// when a cold boot clears nv_data, so the server should track them per epoch:
+// an ack captured in an earlier epoch never authenticates a later report.
+// tools/udp_receiver.py is a stand-in server.
+
+#ifndef _UDP_TASK_H_
+#define _UDP_TASK_H_
+
+// *****************************************************************************
+// Includes
+
+#include "driver/driver_common.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define UDP_TASK_VERSION 2
+#define UDP_TASK_TYPE_REPORT 1
+#define UDP_TASK_TYPE_ACK 2
+#define UDP_TASK_HEADER_SIZE 13
+#define UDP_TASK_MAC_SIZE 16
+#define UDP_TASK_MAX_PAYLOAD 128
+
+/**
+ * @brief Data that is preserved across reboots.
+ */
+typedef struct {
+  uint32_t epoch;         // epoch of this cold boot, 0 until the first report
+  uint32_t next_seq;      // sequence number of the next report
+  uint32_t report_count;  // # of reports attempted
+  uint32_t acked_count;   // # of reports acknowledged
+  uint32_t retry_count;   // # of datagrams resent for want of an ack
+  uint32_t bad_ack_count; // # of datagrams rejected as acks
+  uint16_t last_rtt_ms;   // sendto() to ack of the last acknowledged report
+  uint8_t last_attempts;  // # of datagrams sent for the last report
+} udp_task_nv_data_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Initialize the udp_task.
+ *
+ * @param winc_handle A handle on the WINC device.
+ * @param host Server host name or dotted quad.
+ * @param port Server UDP port.  The report is also sent from this port.
+ * @param key Shared secret for the HMAC, null terminated.
+ * @param payload The report, copied into the datagram.  Payloads longer than
+ *        UDP_TASK_MAX_PAYLOAD are truncated.
+ * @param max_attempts Number of times the datagram is sent before giving up.
+ * @param ack_timeout_ms Time to wait for the first ack.  It doubles on each
+ *        retry.
+ */
+void udp_task_init(DRV_HANDLE winc_handle,
+                   const char *host,
+                   uint16_t port,
+                   const char *key,
+                   const void *payload,
+                   size_t payload_len,
+                   uint8_t max_attempts,
+                   yb_rtc_ms_t ack_timeout_ms);
+
+/**
+ * @brief Advance the udp_task state machine.
+ */
+void udp_task_step(void);
+
+bool udp_task_succeeded(void);
+
+bool udp_task_failed(void);
+
+/**
+ * @brief Release any resources allocated by udp_task.
+ */
+void udp_task_shutdown(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _UDP_TASK_H_ */
@@ -30,25 +30,111 @@
 
 #include "winc_task.h"
 
+#include "config_task.h"
+#include "driver/spi/drv_spi_trace.h"
 #include "http_task.h"
+#include "m2m_hif.h"
+#include "nmcrc.h"
+#include "nmspi.h"
+#include "nv_data.h"
+#include "ping_task.h"
+#include "probe_task.h"
+#include "survey_task.h"
+#include "udp_task.h"
 #include "wdrv_winc_client_api.h"
+#include "wdrv_winc_spi.h"
 #include "yb_log.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 // *****************************************************************************
 // Local (private) types and definitions
 
+// An all-channel active scan normally completes in under two seconds.  A scan
+// that fails reports nothing at all, so give up waiting after this long.
+#define WINC_TASK_SCAN_TIMEOUT_MS 5000.0
+
+// Weight of a profile's past success rate in its score, in dB of RSSI: a
+// profile that always connects outranks one that never does by this much.
+#define WINC_TASK_SUCCESS_WEIGHT_DB 20
+
+// Bonus for the profile that connected last time, so that two APs of similar
+// strength do not alternate from one wake to the next.
+#define WINC_TASK_PREFERRED_BONUS_DB 5
+
+// The WINC answers m2m_wifi_get_connection_info() within a few ms of resuming.
+#define WINC_TASK_RESUME_TIMEOUT_MS 1000.0
+
+// A DHCP exchange normally completes within a second of associating.
+#define WINC_TASK_DHCP_TIMEOUT_MS 10000.0
+
+// Time allowed to see the WINC's clock tick over to the next second.
+#define WINC_TASK_TIME_SYNC_TIMEOUT_MS 1500.0
+
+// The WINC reports a time before this (2020-01-01) until SNTP has answered.
+#define WINC_TASK_MIN_VALID_UTC 1577836800
+
+// With winc_spi_crc set to auto, SPI CRC checking stays on until this many
+// data CRCs in a row have checked out.  An error restarts the count.
+#define WINC_TASK_CRC_PROBATION 5000
+
+/**
+ * @brief How often a failure of one cause is retried with the same profile.
+ * Successive retries wait backoff_ms, 2 * backoff_ms, 4 * backoff_ms...
+ */
+typedef struct {
+  const char *name;
+  uint8_t budget;      // # of attempts with one profile, including the first
+  uint16_t backoff_ms; // wait before the first retry
+} winc_task_retry_t;
+
+/**
+ * @brief A WINC power profile.  The power mode and TX power can only be set
+ * before the first connection request, so apply to the whole wake.  The idle
+ * power-save mode is used only while waiting on a peer.
+ */
+typedef struct {
+  const char *name;           // as given by winc_power in config.txt
+  uint8_t pwr_mode;           // tenuM2mPwrMode
+  uint8_t tx_power;           // tenuM2mTxPwrLevel
+  WDRV_WINC_PS_MODE idle_ps;  // power save while waiting on a peer
+} winc_task_power_profile_t;
+
 #define STATES(M)                                                              \
   M(WINC_TASK_STATE_INIT)                                                      \
   M(WINC_TASK_STATE_REQ_OPEN)                                                  \
   M(WINC_TASK_STATE_PRINT_VERSION)                                             \
   M(WINC_TASK_STATE_REQ_DHCP)                                                  \
+  M(WINC_TASK_STATE_SET_POWER)                                                 \
+  M(WINC_TASK_STATE_START_RESUME)                                              \
+  M(WINC_TASK_STATE_AWAIT_RESUME)                                              \
+  M(WINC_TASK_STATE_START_SURVEY_TASK)                                         \
+  M(WINC_TASK_STATE_AWAIT_SURVEY_TASK)                                         \
+  M(WINC_TASK_STATE_SELECT_PROFILE)                                            \
+  M(WINC_TASK_STATE_START_SCAN)                                                \
+  M(WINC_TASK_STATE_AWAIT_SCAN)                                                \
   M(WINC_TASK_STATE_CONFIGURING_STA)                                           \
   M(WINC_TASK_STATE_START_CONNECT)                                             \
   M(WINC_TASK_STATE_AWAIT_CONNECT)                                             \
+  M(WINC_TASK_STATE_AWAIT_DHCP)                                                \
+  M(WINC_TASK_STATE_BACKOFF)                                                   \
+  M(WINC_TASK_STATE_START_PING_TASK)                                           \
+  M(WINC_TASK_STATE_AWAIT_PING_TASK)                                           \
+  M(WINC_TASK_STATE_START_UDP_TASK)                                            \
+  M(WINC_TASK_STATE_AWAIT_UDP_TASK)                                            \
   M(WINC_TASK_STATE_START_HTTP_TASK)                                           \
   M(WINC_TASK_STATE_AWAIT_HTTP_TASK)                                           \
+  M(WINC_TASK_STATE_START_DOWNLOAD_TASK)                                       \
+  M(WINC_TASK_STATE_AWAIT_DOWNLOAD_TASK)                                       \
+  M(WINC_TASK_STATE_START_UPLOAD_TASK)                                         \
+  M(WINC_TASK_STATE_AWAIT_UPLOAD_TASK)                                         \
+  M(WINC_TASK_STATE_START_BENCH_TASK)                                          \
+  M(WINC_TASK_STATE_AWAIT_BENCH_TASK)                                          \
+  M(WINC_TASK_STATE_START_PROBE_TASK)                                          \
+  M(WINC_TASK_STATE_AWAIT_PROBE_TASK)                                          \
+  M(WINC_TASK_STATE_START_TIME_SYNC)                                           \
+  M(WINC_TASK_STATE_AWAIT_TIME_SYNC)                                           \
   M(WINC_TASK_STATE_START_DISCONNECT)                                          \
   M(WINC_TASK_STATE_AWAIT_DISCONNECT)                                          \
   M(WINC_TASK_STATE_SUCCESS)                                                   \
@@ -62,7 +148,30 @@ typedef struct {
   const char *ssid;
   const char *pass;
   DRV_HANDLE wdrHandle;
-  uint32_t timeUTC;
+  uint32_t timeUTC;        // most recent answer from the WINC's clock
+  bool time_ready;         // true once timeUTC has been answered
+  bool time_synced;        // true once this wake has tried to sync the RTC
+  uint32_t time_prev;      // the WINC's clock at the previous answer
+  yb_rtc_tics_t time_at;   // RTC count when timeUTC arrived
+  yb_rtc_tics_t time_prev_at; // RTC count when time_prev arrived
+  yb_rtc_tics_t time_sync_at; // time at which the RTC sync was started
+  int profile;             // index of the profile being tried
+  uint8_t tried;           // bitmap of profiles tried this wake
+  bool scanned;            // true once this wake's scan has been started
+  bool scan_done;          // true once the scan results have been read
+  yb_rtc_tics_t scan_at;   // time at which the scan was started
+  bool idle;               // true while in the idle power-save mode
+  yb_rtc_tics_t idle_at;   // time at which idle became true
+  bool resumed;            // true if the link was kept from the last wake
+  bool park;               // true to park the WINC at shutdown
+  yb_rtc_tics_t resume_at; // time at which the resume was started
+  yb_rtc_ms_t ready_ms;    // uptime at which the WINC driver was ready
+  yb_rtc_ms_t link_ms;     // uptime at which the link came up, 0 if not
+  bool link_up;            // true once associated with an IP address
+  bool expect_disconnect;  // a DISCONNECTED event we caused is still to come
+  uint8_t failures[WINC_TASK_CAUSE_COUNT]; // failures with this profile
+  yb_rtc_tics_t wait_at;   // start of the DHCP wait or backoff
+  yb_rtc_ms_t backoff_ms;  // length of the current backoff
 } winc_task_ctx_t;
 
 // *****************************************************************************
@@ -77,6 +186,28 @@ static WDRV_WINC_BSS_CONTEXT s_bss;
 
 static WDRV_WINC_AUTH_CONTEXT s_auth;
 
+static const char *s_wake_mode_names[WINC_TASK_WAKE_MODES] = {"Reset",
+                                                              "Resumed"};
+
+// Indexed by winc_task_cause_t.  An AP may be rebooting, and association and
+// DHCP failures are usually transient, but a rejected password will recur.
+static const winc_task_retry_t s_retry_policy[WINC_TASK_CAUSE_COUNT] = {
+    {"AP not found", 2, 1000},
+    {"authentication", 1, 0},
+    {"association", 3, 250},
+    {"DHCP timeout", 2, 500},
+    {"link loss", 2, 250},
+};
+
+// The first profile is the WINC's default behavior.
+static const winc_task_power_profile_t
+    s_power_profiles[WINC_TASK_POWER_PROFILE_COUNT] = {
+        {"full", PWR_HIGH, TX_PWR_HIGH, WDRV_WINC_PS_MODE_OFF},
+        {"balanced", PWR_AUTO, TX_PWR_HIGH, WDRV_WINC_PS_MODE_AUTO_HIGH_POWER},
+        {"low", PWR_LOW1, TX_PWR_MED, WDRV_WINC_PS_MODE_AUTO_LOW_POWER},
+        {"lowest", PWR_LOW2, TX_PWR_LOW, WDRV_WINC_PS_MODE_AUTO_LOW_POWER},
+};
+
 // *****************************************************************************
 // Local (private, static) forward declarations
 
@@ -86,6 +217,120 @@ static const char *winc_task_state_name(winc_task_state_t state);
 
 static void print_winc_version(tstrM2mRev *version_info);
 
+/**
+ * @brief Return the state that starts associating: a survey if one is due this
+ * wake, else profile selection.
+ */
+static winc_task_state_t winc_task_associate_state(void);
+
+/**
+ * @brief Return the first state once the link is up: ping if configured, else
+ * the report.
+ */
+static winc_task_state_t winc_task_link_up_state(void);
+
+/**
+ * @brief Return the state that starts the report: UDP if configured, else HTTP.
+ */
+static winc_task_state_t winc_task_report_state(void);
+
+/**
+ * @brief Return the state that starts the first optional stage (download,
+ * upload, benchmark, probe) following the stage that ends in the given state,
+ * or START_DISCONNECT if none are configured.
+ */
+static winc_task_state_t winc_task_next_stage(winc_task_state_t finished);
+
+/**
+ * @brief Finish a diagnostic stage (survey, ping, benchmark, probe) and move
+ * on to the given state, logging a warning if the stage failed.
+ */
+static void winc_task_diagnostic_done(const char *name,
+                                      bool failed,
+                                      winc_task_state_t next);
+
+/**
+ * @brief Return the untried profile with the highest score, or -1 if every
+ * profile has been tried.
+ */
+static int winc_task_best_profile(void);
+
+/**
+ * @brief Return a profile's score: the RSSI seen in this wake's scan plus
+ * bonuses for past success and for having connected last time.
+ */
+static int winc_task_profile_score(int i);
+
+/**
+ * @brief Record the RSSI of each BSS whose SSID matches a profile.
+ */
+static bool winc_task_bss_find_cb(DRV_HANDLE handle,
+                                  uint8_t index,
+                                  uint8_t ofTotal,
+                                  WDRV_WINC_BSS_INFO *pBSSInfo);
+
+/**
+ * @brief Return the index of the power profile named by winc_power in
+ * config.txt.  "cycle" rotates through all of them from one wake to the next.
+ */
+static uint8_t winc_task_choose_power_profile(void);
+
+/**
+ * @brief Add this wake's report latency and awake time to its power profile's
+ * statistics and log the profile's means.
+ *
+ * @param ttfb_ms Time to the first byte of the HTTP response, or to the ack of
+ *        a UDP report.
+ * @param total_ms Time to the end of the HTTP response, or to the UDP ack.
+ */
+static void winc_task_record_power(uint32_t ttfb_ms, uint32_t total_ms);
+
+/**
+ * @brief Map the error reported with a failed connect to its cause.
+ */
+static winc_task_cause_t winc_task_classify(WDRV_WINC_CONN_ERROR errorCode);
+
+/**
+ * @brief Count a failure and either back off and retry the same profile or,
+ * once the cause's budget is spent, move on to the next profile.
+ */
+static void winc_task_connect_failed(winc_task_cause_t cause);
+
+/**
+ * @brief Return true if the WINC should stay associated until the next wake.
+ */
+static bool winc_task_should_park(void);
+
+/**
+ * @brief Add this wake's latency and awake time to the statistics for the way
+ * its link came up, and log their means.
+ */
+static void winc_task_record_wake(void);
+
+/**
+ * @brief Log this wake's SPI traffic to the WINC, and the SPI command frames
+ * spent per HIF message.
+ */
+static void winc_task_log_spi(void);
+
+/**
+ * @brief Return true if SPI CRC checking should be on for this wake.
+ */
+static bool winc_task_want_spi_crc(void);
+
+/**
+ * @brief Add this wake's SPI CRC checks to nv_data and log them.
+ */
+static void winc_task_record_spi_crc(void);
+
+/**
+ * @brief Ask the WINC for its clock.  The answer arrives in
+ * winc_task_systime_cb().
+ */
+static bool winc_task_request_time(void);
+
+static void winc_task_systime_cb(DRV_HANDLE handle, uint32_t timeUTC);
+
 static void winc_task_dhcp_cb(DRV_HANDLE handle, uint32_t ipAddress);
 
 static void winc_task_wifi_notify_cb(DRV_HANDLE handle,
@@ -96,10 +341,33 @@ static void winc_task_wifi_notify_cb(DRV_HANDLE handle,
 // *****************************************************************************
 // Public code
 
-void winc_task_connect(const char *ssid, const char *pass) {
+void winc_task_boot(void) {
+  nm_drv_set_resume(nv_data()->winc_task_nv_data.parked);
+}
+
+void winc_task_connect(void) {
   s_winc_task_ctx.state = WINC_TASK_STATE_INIT;
-  s_winc_task_ctx.ssid = ssid;
-  s_winc_task_ctx.pass = pass;
+  s_winc_task_ctx.ssid = NULL;
+  s_winc_task_ctx.pass = NULL;
+  s_winc_task_ctx.profile = -1;
+  s_winc_task_ctx.tried = 0;
+  s_winc_task_ctx.scanned = false;
+  s_winc_task_ctx.scan_done = false;
+  s_winc_task_ctx.idle = false;
+  s_winc_task_ctx.park = false;
+  s_winc_task_ctx.resumed = nm_drv_resumed();
+  s_winc_task_ctx.ready_ms = app_uptime_ms();
+  s_winc_task_ctx.link_ms = 0;
+  s_winc_task_ctx.link_up = false;
+  s_winc_task_ctx.expect_disconnect = false;
+  s_winc_task_ctx.time_synced = false;
+  if (nv_data()->winc_task_nv_data.parked && !s_winc_task_ctx.resumed) {
+    YB_LOG_WARN("Parked WINC did not respond - reset it");
+    nv_data()->winc_task_nv_data.resume_failures += 1;
+  }
+  if (!s_winc_task_ctx.resumed) {
+    http_task_forget_tls_session();
+  }
 }
 
 void winc_task_disconnect(void) {
@@ -116,6 +384,12 @@ void winc_task_step(void) {
   case WINC_TASK_STATE_REQ_OPEN: {
     s_winc_task_ctx.wdrHandle = WDRV_WINC_Open(0, 0);
     if (s_winc_task_ctx.wdrHandle != DRV_HANDLE_INVALID) {
+      // nm_spi_init() forgets the CRC setting on every wake, so apply it
+      // before the first HIF message, warm boot or cold.
+      bool crc = winc_task_want_spi_crc();
+      if (M2M_SUCCESS != nm_spi_set_crc(crc)) {
+        YB_LOG_WARN("Unable to turn SPI CRC %s", crc ? "on" : "off");
+      }
       if (app_is_cold_boot()) {
         winc_task_set_state(WINC_TASK_STATE_PRINT_VERSION);
       } else {
@@ -140,9 +414,193 @@ void winc_task_step(void) {
     // Request DHCP from Access Point.  Although the WINC handles this
     // internally, registering a callback lets us report when it happens.
     WDRV_WINC_IPUseDHCPSet(s_winc_task_ctx.wdrHandle, &winc_task_dhcp_cb);
+    // The WINC sets its clock by SNTP once it has an address.
+    if (WDRV_WINC_STATUS_OK !=
+        WDRV_WINC_SystemTimeSNTPClientEnable(s_winc_task_ctx.wdrHandle,
+                                             config_task_get_sntp_server(),
+                                             true)) {
+      YB_LOG_WARN("WDRV_WINC_SystemTimeSNTPClientEnable() failed");
+    }
+    winc_task_set_state(WINC_TASK_STATE_SET_POWER);
+  } break;
+
+  case WINC_TASK_STATE_SET_POWER: {
+    // Must precede the first connection request.  A failure here leaves the
+    // WINC at its defaults, so is not fatal.
+    winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+    if (s_winc_task_ctx.resumed) {
+      // Still associated: the profile applied when it connected stands.
+      YB_LOG_INFO("Resumed with power profile %s",
+                  s_power_profiles[nv->power_profile].name);
+      WDRV_WINC_PowerSaveSetMode(s_winc_task_ctx.wdrHandle,
+                                 WDRV_WINC_PS_MODE_OFF);
+      winc_task_set_state(WINC_TASK_STATE_START_RESUME);
+      break;
+    }
+    nv->power_profile = winc_task_choose_power_profile();
+    const winc_task_power_profile_t *profile =
+        &s_power_profiles[nv->power_profile];
+    YB_LOG_INFO("Using power profile %s", profile->name);
+    if (M2M_SUCCESS != m2m_wifi_set_power_profile(profile->pwr_mode)) {
+      YB_LOG_WARN("m2m_wifi_set_power_profile() failed");
+    }
+    if (M2M_SUCCESS != m2m_wifi_set_tx_power(profile->tx_power)) {
+      YB_LOG_WARN("m2m_wifi_set_tx_power() failed");
+    }
+    // full power for the association
+    if (WDRV_WINC_STATUS_OK != WDRV_WINC_PowerSaveSetMode(
+                                   s_winc_task_ctx.wdrHandle,
+                                   WDRV_WINC_PS_MODE_OFF)) {
+      YB_LOG_WARN("WDRV_WINC_PowerSaveSetMode() failed");
+    }
+    winc_task_set_state(winc_task_associate_state());
+  } break;
+
+  case WINC_TASK_STATE_START_RESUME: {
+    // Ask the WINC whether the association survived the hibernation.
+    s_winc_task_ctx.resume_at = yb_rtc_now();
+    if (M2M_SUCCESS != m2m_wifi_get_connection_info()) {
+      YB_LOG_WARN("m2m_wifi_get_connection_info() failed");
+      s_winc_task_ctx.resumed = false;
+      winc_task_set_state(winc_task_associate_state());
+    } else {
+      winc_task_set_state(WINC_TASK_STATE_AWAIT_RESUME);
+    }
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_RESUME: {
+    // The driver caches the answer: poll for it.  An empty SSID means the
+    // WINC has lost the association.
+    winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+    WDRV_WINC_SSID ssid;
+    if (WDRV_WINC_STATUS_OK ==
+        WDRV_WINC_AssocSSIDGet(s_winc_task_ctx.wdrHandle, &ssid, NULL)) {
+      if (ssid.length > 0 &&
+          WDRV_WINC_STATUS_OK ==
+              WDRV_WINC_BSSResume(s_winc_task_ctx.wdrHandle,
+                                  nv->ip_address,
+                                  nv->gateway_address,
+                                  &winc_task_wifi_notify_cb)) {
+        YB_LOG_INFO("Resumed link to %.*s in %d ms",
+                    ssid.length,
+                    ssid.name,
+                    (int)yb_rtc_elapsed_ms(s_winc_task_ctx.resume_at));
+        s_winc_task_ctx.profile = nv->preferred_profile;
+        s_winc_task_ctx.ssid = config_task_get_wifi_ssid(nv->preferred_profile);
+        s_winc_task_ctx.link_ms = app_uptime_ms();
+        s_winc_task_ctx.link_up = true;
+        winc_task_set_state(winc_task_link_up_state());
+      } else {
+        YB_LOG_WARN("Parked link was lost - reconnecting");
+        nv->resume_failures += 1;
+        s_winc_task_ctx.resumed = false;
+        winc_task_set_state(winc_task_associate_state());
+      }
+    } else if (yb_rtc_elapsed_ms(s_winc_task_ctx.resume_at) >
+               WINC_TASK_RESUME_TIMEOUT_MS) {
+      YB_LOG_WARN("No connection info from WINC - reconnecting");
+      nv->resume_failures += 1;
+      s_winc_task_ctx.resumed = false;
+      winc_task_set_state(winc_task_associate_state());
+    } else {
+      // remain in this state until the WINC answers
+    }
+  } break;
+
+  case WINC_TASK_STATE_START_SURVEY_TASK: {
+    // Survey before associating, while the radio is otherwise idle.
+    survey_task_init(winc_task_get_handle(),
+                     config_task_get_survey_channels(),
+                     config_task_get_survey_passive(),
+                     APP_SURVEY_BUDGET_MS);
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_SURVEY_TASK);
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_SURVEY_TASK: {
+    survey_task_step();
+    if (survey_task_failed() || survey_task_succeeded()) {
+      winc_task_diagnostic_done("Survey task", survey_task_failed(),
+                                WINC_TASK_STATE_SELECT_PROFILE);
+      survey_task_shutdown();
+    } else {
+      // survey task has not completed -- remain in this state
+    }
+  } break;
+
+  case WINC_TASK_STATE_SELECT_PROFILE: {
+    // Arrive here at the start of the wake and after each failed connect.
+    winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+    int count = config_task_get_wifi_profile_count();
+    int untried = 0;
+    for (int i = 0; i < count; i++) {
+      if ((s_winc_task_ctx.tried & (1 << i)) == 0) {
+        untried += 1;
+      }
+    }
+
+    if (untried == 0) {
+      YB_LOG_ERROR("Unable to connect with any of %d wifi profiles", count);
+      winc_task_set_state(WINC_TASK_STATE_ERROR);
+      break;
+    } else if (s_winc_task_ctx.tried == 0 && nv->preferred_profile < count &&
+               nv->profiles[nv->preferred_profile].last_ok) {
+      // The usual case: skip the scan and reuse last time's profile.
+      s_winc_task_ctx.profile = nv->preferred_profile;
+    } else if (!s_winc_task_ctx.scanned && untried > 1) {
+      winc_task_set_state(WINC_TASK_STATE_START_SCAN);
+      break;
+    } else {
+      s_winc_task_ctx.profile = winc_task_best_profile();
+    }
+    s_winc_task_ctx.tried |= 1 << s_winc_task_ctx.profile;
+    memset(s_winc_task_ctx.failures, 0, sizeof(s_winc_task_ctx.failures));
+    s_winc_task_ctx.ssid = config_task_get_wifi_ssid(s_winc_task_ctx.profile);
+    s_winc_task_ctx.pass = config_task_get_wifi_pass(s_winc_task_ctx.profile);
+    YB_LOG_INFO("Trying wifi profile %d (%s), score %d",
+                s_winc_task_ctx.profile,
+                s_winc_task_ctx.ssid,
+                winc_task_profile_score(s_winc_task_ctx.profile));
     winc_task_set_state(WINC_TASK_STATE_CONFIGURING_STA);
   } break;
 
+  case WINC_TASK_STATE_START_SCAN: {
+    winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+    for (int i = 0; i < MAX_CONFIG_WIFI_PROFILES; i++) {
+      nv->profiles[i].last_rssi = INT8_MIN;
+    }
+    s_winc_task_ctx.scanned = true;
+    s_winc_task_ctx.scan_done = false;
+    s_winc_task_ctx.scan_at = yb_rtc_now();
+    nv->scan_count += 1;
+    if (WDRV_WINC_STATUS_OK !=
+        WDRV_WINC_BSSFindFirst(s_winc_task_ctx.wdrHandle,
+                               WDRV_WINC_ALL_CHANNELS,
+                               true,
+                               NULL,
+                               winc_task_bss_find_cb)) {
+      // Rank on past success alone.
+      YB_LOG_WARN("WDRV_WINC_BSSFindFirst() failed");
+      winc_task_set_state(WINC_TASK_STATE_SELECT_PROFILE);
+    } else {
+      winc_task_set_state(WINC_TASK_STATE_AWAIT_SCAN);
+    }
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_SCAN: {
+    // winc_task_bss_find_cb() sets scan_done after the last result.
+    if (s_winc_task_ctx.scan_done) {
+      YB_LOG_INFO("Scan took %d ms",
+                  (int)yb_rtc_elapsed_ms(s_winc_task_ctx.scan_at));
+      winc_task_set_state(WINC_TASK_STATE_SELECT_PROFILE);
+    } else if (yb_rtc_elapsed_ms(s_winc_task_ctx.scan_at) >
+               WINC_TASK_SCAN_TIMEOUT_MS) {
+      YB_LOG_WARN("Scan timed out");
+      winc_task_set_state(WINC_TASK_STATE_SELECT_PROFILE);
+    } else {
+      // remain in this state until the scan completes
+    }
+  } break;
+
   case WINC_TASK_STATE_CONFIGURING_STA: {
     const char *err = NULL;
     const char *ssid = s_winc_task_ctx.ssid;
@@ -182,9 +640,13 @@ void winc_task_step(void) {
                              &s_bss,
                              &s_auth,
                              &winc_task_wifi_notify_cb)) {
+      nv_data()
+          ->winc_task_nv_data.profiles[s_winc_task_ctx.profile]
+          .attempts += 1;
       winc_task_set_state(WINC_TASK_STATE_AWAIT_CONNECT);
     } else {
-      // Retry WDRV_WINC_BSSConnect() until STATUS_OK?!?
+      YB_LOG_WARN("WDRV_WINC_BSSConnect() failed");
+      winc_task_connect_failed(WINC_TASK_CAUSE_ASSOC);
     }
   } break;
 
@@ -193,12 +655,91 @@ void winc_task_step(void) {
     asm("nop");
   } break;
 
+  case WINC_TASK_STATE_AWAIT_DHCP: {
+    if (WDRV_WINC_IPLinkActive(s_winc_task_ctx.wdrHandle)) {
+      s_winc_task_ctx.link_ms = app_uptime_ms();
+      s_winc_task_ctx.link_up = true;
+      winc_task_set_state(winc_task_link_up_state());
+    } else if (yb_rtc_elapsed_ms(s_winc_task_ctx.wait_at) >
+               WINC_TASK_DHCP_TIMEOUT_MS) {
+      // The DISCONNECTED event that follows is not a failure of its own,
+      // whenever it arrives.
+      s_winc_task_ctx.expect_disconnect = true;
+      m2m_wifi_disconnect();
+      winc_task_connect_failed(WINC_TASK_CAUSE_DHCP);
+    } else {
+      // remain in this state until DHCP assigns an address
+    }
+  } break;
+
+  case WINC_TASK_STATE_BACKOFF: {
+    // s_bss and s_auth still hold the profile being retried.
+    if (yb_rtc_elapsed_ms(s_winc_task_ctx.wait_at) >
+        s_winc_task_ctx.backoff_ms) {
+      winc_task_set_state(WINC_TASK_STATE_START_CONNECT);
+    } else {
+      // remain in this state until the backoff expires
+    }
+  } break;
+
+  case WINC_TASK_STATE_START_PING_TASK: {
+    ping_task_init(winc_task_get_handle(),
+                   config_task_get_ping_host(),
+                   config_task_get_ping_count(),
+                   APP_PING_BUDGET_MS);
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_PING_TASK);
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_PING_TASK: {
+    ping_task_step();
+    if (ping_task_failed() || ping_task_succeeded()) {
+      winc_task_diagnostic_done("Ping task", ping_task_failed(),
+                                winc_task_report_state());
+    } else {
+      // ping task has not completed -- remain in this state
+    }
+  } break;
+
+  case WINC_TASK_STATE_START_UDP_TASK: {
+    uint8_t report[UDP_TASK_MAX_PAYLOAD];
+    size_t len = app_build_report(report, sizeof(report));
+    udp_task_init(winc_task_get_handle(),
+                  config_task_get_udp_host(),
+                  config_task_get_udp_port(),
+                  config_task_get_udp_key(),
+                  report,
+                  len,
+                  APP_UDP_MAX_ATTEMPTS,
+                  APP_UDP_ACK_TIMEOUT_MS);
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_UDP_TASK);
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_UDP_TASK: {
+    udp_task_step();
+    if (udp_task_failed()) {
+      YB_LOG_WARN("UDP report failed - falling back to HTTP");
+      udp_task_shutdown();
+      winc_task_set_state(WINC_TASK_STATE_START_HTTP_TASK);
+    } else if (udp_task_succeeded()) {
+      // The ack stands in for the HTTP exchange: go on to the optional stages.
+      uint16_t rtt_ms = nv_data()->udp_task_nv_data.last_rtt_ms;
+      app_report_delivered(true);
+      udp_task_shutdown();
+      winc_task_record_power(rtt_ms, rtt_ms);
+      winc_task_set_state(
+          winc_task_next_stage(WINC_TASK_STATE_AWAIT_UDP_TASK));
+    } else {
+      // udp task has not completed -- remain in this state
+    }
+  } break;
+
   case WINC_TASK_STATE_START_HTTP_TASK: {
     http_task_init(winc_task_get_handle(),
                    APP_HOST_NAME,
                    APP_HOST_IP_ADDR,
                    APP_HOST_PORT,
                    APP_HOST_USE_TLS,
+                   APP_HOST_DNS_TTL_MS,
                    app_request_msg(),
                    app_response_msg());
     winc_task_set_state(WINC_TASK_STATE_AWAIT_HTTP_TASK);
@@ -208,15 +749,195 @@ void winc_task_step(void) {
     http_task_step();
     if (http_task_failed()) {
       YB_LOG_FATAL("HTTP task failed - quitting");
+      winc_task_set_idle(false);
       winc_task_set_state(WINC_TASK_STATE_ERROR);
     } else if (http_task_succeeded()) {
-      winc_task_set_state(WINC_TASK_STATE_START_DISCONNECT);
+      winc_task_set_idle(false);
+      const http_task_timing_t *timing = http_task_get_timing();
+      app_report_delivered(false);
+      winc_task_record_power(timing->ttfb_ms, timing->total_ms);
+      winc_task_set_state(
+          winc_task_next_stage(WINC_TASK_STATE_AWAIT_HTTP_TASK));
     } else {
       // http task has not completed -- remain in this state
     }
   } break;
 
+  case WINC_TASK_STATE_START_DOWNLOAD_TASK: {
+    // Rerun http_task to fetch download_path into download_file.
+    const uint8_t *hash;
+    size_t hash_len = config_task_get_download_sha256(&hash);
+    http_task_shutdown();
+    http_task_init(winc_task_get_handle(),
+                   APP_HOST_NAME,
+                   APP_HOST_IP_ADDR,
+                   APP_HOST_PORT,
+                   APP_HOST_USE_TLS,
+                   APP_HOST_DNS_TTL_MS,
+                   app_download_msg(config_task_get_download_path()),
+                   app_response_msg());
+    http_task_set_sink(config_task_get_download_file(),
+                       config_task_get_download_length(),
+                       hash,
+                       hash_len);
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_DOWNLOAD_TASK);
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_DOWNLOAD_TASK: {
+    http_task_step();
+    if (http_task_failed()) {
+      // The previous copy of the file, if any, is left untouched.
+      YB_LOG_WARN("Download of %s failed", config_task_get_download_path());
+    }
+    if (http_task_failed() || http_task_succeeded()) {
+      winc_task_set_state(
+          winc_task_next_stage(WINC_TASK_STATE_AWAIT_DOWNLOAD_TASK));
+    } else {
+      // download has not completed -- remain in this state
+    }
+  } break;
+
+  case WINC_TASK_STATE_START_UPLOAD_TASK: {
+    // Rerun http_task to POST upload_file to upload_path.  stat is static
+    // since it is large (it holds a long file name).
+    static SYS_FS_FSTAT stat;
+    if (SYS_FS_FileStat(config_task_get_upload_file(), &stat) !=
+        SYS_FS_RES_SUCCESS) {
+      YB_LOG_WARN("Unable to stat %s", config_task_get_upload_file());
+      winc_task_set_state(
+          winc_task_next_stage(WINC_TASK_STATE_AWAIT_UPLOAD_TASK));
+      break;
+    }
+    http_task_shutdown();
+    http_task_init(winc_task_get_handle(),
+                   APP_HOST_NAME,
+                   APP_HOST_IP_ADDR,
+                   APP_HOST_PORT,
+                   APP_HOST_USE_TLS,
+                   APP_HOST_DNS_TTL_MS,
+                   app_upload_msg(config_task_get_upload_path(), stat.fsize),
+                   app_response_msg());
+    http_task_set_source(config_task_get_upload_file());
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_UPLOAD_TASK);
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_UPLOAD_TASK: {
+    http_task_step();
+    if (http_task_failed()) {
+      YB_LOG_WARN("Upload of %s failed", config_task_get_upload_file());
+    }
+    if (http_task_failed() || http_task_succeeded()) {
+      winc_task_set_state(
+          winc_task_next_stage(WINC_TASK_STATE_AWAIT_UPLOAD_TASK));
+    } else {
+      // upload has not completed -- remain in this state
+    }
+  } break;
+
+  case WINC_TASK_STATE_START_BENCH_TASK: {
+    // Rerun http_task against the cooperating endpoint in benchmark mode.
+    // bench_host may be a dotted quad or a name to be resolved.
+    http_task_shutdown();
+    http_task_init(winc_task_get_handle(),
+                   config_task_get_bench_host(),
+                   config_task_get_bench_host(),
+                   config_task_get_bench_port(),
+                   false,
+                   APP_HOST_DNS_TTL_MS,
+                   app_request_msg(),
+                   app_response_msg());
+    http_task_set_bench(config_task_get_bench_up_bytes(),
+                        config_task_get_bench_down_bytes(),
+                        APP_BENCH_BUDGET_MS);
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_BENCH_TASK);
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_BENCH_TASK: {
+    http_task_step();
+    if (http_task_failed() || http_task_succeeded()) {
+      winc_task_diagnostic_done(
+          "Benchmark", http_task_failed(),
+          winc_task_next_stage(WINC_TASK_STATE_AWAIT_BENCH_TASK));
+    } else {
+      // benchmark has not completed -- remain in this state
+    }
+  } break;
+
+  case WINC_TASK_STATE_START_PROBE_TASK: {
+    // Release the HTTP socket so the probe can use every TCP socket.
+    http_task_shutdown();
+    probe_task_init(winc_task_get_handle(), APP_PROBE_BUDGET_MS);
+    for (int i = 0; i < config_task_get_probe_endpoint_count(); i++) {
+      probe_task_add_endpoint(config_task_get_probe_endpoint(i));
+    }
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_PROBE_TASK);
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_PROBE_TASK: {
+    probe_task_step();
+    if (probe_task_failed() || probe_task_succeeded()) {
+      winc_task_diagnostic_done("Probe task", probe_task_failed(),
+                                WINC_TASK_STATE_START_DISCONNECT);
+    } else {
+      // probe task has not completed -- remain in this state
+    }
+  } break;
+
+  case WINC_TASK_STATE_START_TIME_SYNC: {
+    // Time the WINC's clock ticking over to the next second: its seconds
+    // alone would leave the RTC up to a second out.
+    s_winc_task_ctx.time_synced = true;
+    s_winc_task_ctx.time_prev = 0;
+    s_winc_task_ctx.time_sync_at = yb_rtc_now();
+    if (winc_task_request_time()) {
+      winc_task_set_state(WINC_TASK_STATE_AWAIT_TIME_SYNC);
+    } else {
+      winc_task_set_state(WINC_TASK_STATE_START_DISCONNECT);
+    }
+  } break;
+
+  case WINC_TASK_STATE_AWAIT_TIME_SYNC: {
+    uint32_t now = s_winc_task_ctx.timeUTC;
+    if (yb_rtc_elapsed_ms(s_winc_task_ctx.time_sync_at) >
+        WINC_TASK_TIME_SYNC_TIMEOUT_MS) {
+      YB_LOG_WARN("Timed out syncing RTC");
+      winc_task_set_state(WINC_TASK_STATE_START_DISCONNECT);
+    } else if (!s_winc_task_ctx.time_ready) {
+      // remain in this state until the WINC answers
+    } else if (now < WINC_TASK_MIN_VALID_UTC) {
+      YB_LOG_INFO("WINC clock not yet set by SNTP");
+      winc_task_set_state(WINC_TASK_STATE_START_DISCONNECT);
+    } else if (s_winc_task_ctx.time_prev != 0 &&
+               now != s_winc_task_ctx.time_prev) {
+      // The second began between the last two answers: split the difference.
+      yb_rtc_tics_t prev_at = s_winc_task_ctx.time_prev_at;
+      yb_rtc_tics_t edge_at =
+          prev_at + (s_winc_task_ctx.time_at - prev_at) / 2;
+      yb_rtc_sync((uint64_t)now * 1000, edge_at);
+      winc_task_set_state(WINC_TASK_STATE_START_DISCONNECT);
+    } else {
+      s_winc_task_ctx.time_prev = now;
+      s_winc_task_ctx.time_prev_at = s_winc_task_ctx.time_at;
+      if (!winc_task_request_time()) {
+        winc_task_set_state(WINC_TASK_STATE_START_DISCONNECT);
+      }
+    }
+  } break;
+
   case WINC_TASK_STATE_START_DISCONNECT: {
+    if (!s_winc_task_ctx.time_synced && yb_rtc_needs_sync()) {
+      // Opportunistic: the report is done and the link is still up.
+      winc_task_set_state(WINC_TASK_STATE_START_TIME_SYNC);
+      break;
+    }
+    if (winc_task_should_park()) {
+      // Stay associated: winc_task_shutdown() parks the WINC.
+      s_winc_task_ctx.park = true;
+      nv_data()->winc_task_nv_data.gateway_address =
+          WDRV_WINC_IPDefaultGatewayGet(s_winc_task_ctx.wdrHandle);
+      winc_task_set_state(WINC_TASK_STATE_SUCCESS);
+      break;
+    }
     m2m_wifi_disconnect();
     winc_task_set_state(WINC_TASK_STATE_AWAIT_DISCONNECT);
   } break;
@@ -247,10 +968,58 @@ bool winc_task_failed(void) {
   return s_winc_task_ctx.state == WINC_TASK_STATE_ERROR;
 }
 
-void winc_task_shutdown(void) { m2m_wifi_deinit(NULL); }
+void winc_task_shutdown(void) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+
+  winc_task_record_wake();
+  winc_task_log_spi();
+  winc_task_record_spi_crc();
+  nv->parked = false;
+  if (s_winc_task_ctx.park) {
+    // Deep automatic power save keeps the association alive on a trickle of
+    // current: the WINC dozes between beacons and answers the AP on its own.
+    if (WDRV_WINC_STATUS_OK ==
+        WDRV_WINC_PowerSaveSetMode(s_winc_task_ctx.wdrHandle,
+                                   WDRV_WINC_PS_MODE_AUTO_LOW_POWER)) {
+      YB_LOG_INFO("Parking WINC");
+      nv->parked = true;
+      // Nothing is read back: make sure the last command is on the wire
+      // before the host hibernates.
+      WDRV_WINC_SPIFlush();
+      return;
+    }
+    YB_LOG_WARN("Unable to park WINC");
+  }
+  m2m_wifi_deinit(NULL);
+}
 
 DRV_HANDLE winc_task_get_handle(void) { return s_winc_task_ctx.wdrHandle; }
 
+void winc_task_set_idle(bool idle) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+  const winc_task_power_profile_t *profile =
+      &s_power_profiles[nv->power_profile];
+
+  if (idle == s_winc_task_ctx.idle ||
+      profile->idle_ps == WDRV_WINC_PS_MODE_OFF) {
+    return;
+  }
+  if (WDRV_WINC_STATUS_OK !=
+      WDRV_WINC_PowerSaveSetMode(s_winc_task_ctx.wdrHandle,
+                                 idle ? profile->idle_ps
+                                      : WDRV_WINC_PS_MODE_OFF)) {
+    YB_LOG_WARN("WDRV_WINC_PowerSaveSetMode() failed");
+    return;
+  }
+  if (idle) {
+    s_winc_task_ctx.idle_at = yb_rtc_now();
+  } else {
+    nv->power[nv->power_profile].idle_ms +=
+        yb_rtc_elapsed_ms(s_winc_task_ctx.idle_at);
+  }
+  s_winc_task_ctx.idle = idle;
+}
+
 // *****************************************************************************
 // Local (private, static) code
 
@@ -260,6 +1029,7 @@ static void winc_task_set_state(winc_task_state_t new_state) {
                 winc_task_state_name(s_winc_task_ctx.state),
                 winc_task_state_name(new_state));
     s_winc_task_ctx.state = new_state;
+    DRV_SPI_TraceMark(winc_task_state_name(new_state));
   }
 }
 
@@ -284,6 +1054,341 @@ static void print_winc_version(tstrM2mRev *version_info) {
               version_info->u8DriverPatch);
 }
 
+static winc_task_state_t winc_task_report_state(void) {
+  if (config_task_get_udp_host() != NULL) {
+    return WINC_TASK_STATE_START_UDP_TASK;
+  } else {
+    return WINC_TASK_STATE_START_HTTP_TASK;
+  }
+}
+
+static winc_task_state_t winc_task_next_stage(winc_task_state_t finished) {
+  // Relies on the optional stages appearing in this order in STATES().
+  if (finished < WINC_TASK_STATE_START_DOWNLOAD_TASK && app_is_cold_boot() &&
+      config_task_get_download_path() != NULL &&
+      config_task_get_download_file() != NULL) {
+    // The SD card is only mounted on a cold boot.
+    return WINC_TASK_STATE_START_DOWNLOAD_TASK;
+  } else if (finished < WINC_TASK_STATE_START_UPLOAD_TASK &&
+             app_is_cold_boot() && config_task_get_upload_path() != NULL &&
+             config_task_get_upload_file() != NULL) {
+    return WINC_TASK_STATE_START_UPLOAD_TASK;
+  } else if (finished < WINC_TASK_STATE_START_BENCH_TASK &&
+             config_task_get_bench_host() != NULL) {
+    return WINC_TASK_STATE_START_BENCH_TASK;
+  } else if (finished < WINC_TASK_STATE_START_PROBE_TASK &&
+             config_task_get_probe_endpoint_count() > 0) {
+    return WINC_TASK_STATE_START_PROBE_TASK;
+  } else {
+    return WINC_TASK_STATE_START_DISCONNECT;
+  }
+}
+
+static void winc_task_diagnostic_done(const char *name,
+                                      bool failed,
+                                      winc_task_state_t next) {
+  // Diagnostic stages only measure the network for the report: the wake has
+  // done its job with or without them, so their failure never fails it.
+  if (failed) {
+    YB_LOG_WARN("%s failed", name);
+  }
+  winc_task_set_state(next);
+}
+
+static int winc_task_best_profile(void) {
+  int best = -1;
+  int best_score = 0;
+
+  for (int i = 0; i < config_task_get_wifi_profile_count(); i++) {
+    if ((s_winc_task_ctx.tried & (1 << i)) != 0) {
+      continue;
+    }
+    int score = winc_task_profile_score(i);
+    if (best < 0 || score > best_score) {
+      best = i;
+      best_score = score;
+    }
+  }
+  return best;
+}
+
+static int winc_task_profile_score(int i) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+  winc_task_profile_stats_t *stats = &nv->profiles[i];
+
+  // Until the first attempt a profile counts as succeeding half the time.
+  int success_pct = (stats->successes + 1) * 100 / (stats->attempts + 2);
+  // A profile the scan did not see (or no scan) ranks below all that it did,
+  // but is still tried: its AP may be hidden or the scan may have failed.
+  int score = s_winc_task_ctx.scanned ? stats->last_rssi : INT8_MIN;
+  score += success_pct * WINC_TASK_SUCCESS_WEIGHT_DB / 100;
+  if (i == nv->preferred_profile) {
+    score += WINC_TASK_PREFERRED_BONUS_DB;
+  }
+  return score;
+}
+
+static bool winc_task_bss_find_cb(DRV_HANDLE handle,
+                                  uint8_t index,
+                                  uint8_t ofTotal,
+                                  WDRV_WINC_BSS_INFO *pBSSInfo) {
+  (void)handle;
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+
+  if (pBSSInfo != NULL) {
+    for (int i = 0; i < config_task_get_wifi_profile_count(); i++) {
+      const char *ssid = config_task_get_wifi_ssid(i);
+      if (pBSSInfo->ctx.ssid.length == strlen(ssid) &&
+          memcmp(pBSSInfo->ctx.ssid.name, ssid, strlen(ssid)) == 0 &&
+          pBSSInfo->rssi > nv->profiles[i].last_rssi) {
+        // the strongest of several APs sharing an SSID
+        nv->profiles[i].last_rssi = pBSSInfo->rssi;
+      }
+    }
+  }
+  if (pBSSInfo == NULL || index >= ofTotal) {
+    s_winc_task_ctx.scan_done = true;
+    return false;
+  }
+  return true;
+}
+
+size_t winc_task_encode_causes(uint8_t *buf, size_t size) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+
+  if (size < WINC_TASK_CAUSE_COUNT) {
+    return 0;
+  }
+  for (int i = 0; i < WINC_TASK_CAUSE_COUNT; i++) {
+    buf[i] = (nv->causes[i] > UINT8_MAX) ? UINT8_MAX : nv->causes[i];
+  }
+  return WINC_TASK_CAUSE_COUNT;
+}
+
+static winc_task_state_t winc_task_associate_state(void) {
+  uint8_t every = config_task_get_survey_every();
+  if (every > 0 && nv_data()->app_nv_data.reboot_count % every == 0) {
+    return WINC_TASK_STATE_START_SURVEY_TASK;
+  } else {
+    return WINC_TASK_STATE_SELECT_PROFILE;
+  }
+}
+
+static winc_task_state_t winc_task_link_up_state(void) {
+  if (config_task_get_ping_count() > 0) {
+    return WINC_TASK_STATE_START_PING_TASK;
+  } else {
+    return winc_task_report_state();
+  }
+}
+
+static winc_task_cause_t winc_task_classify(WDRV_WINC_CONN_ERROR errorCode) {
+  switch (errorCode) {
+  case WDRV_WINC_CONN_ERROR_SCAN:
+    return WINC_TASK_CAUSE_AP_NOT_FOUND;
+  case WDRV_WINC_CONN_ERROR_AUTH:
+  case WDRV_WINC_CONN_ERROR_NOCRED:
+    return WINC_TASK_CAUSE_AUTH;
+  default:
+    // M2M_ERR_JOIN_FAIL and the rest
+    return WINC_TASK_CAUSE_ASSOC;
+  }
+}
+
+static void winc_task_connect_failed(winc_task_cause_t cause) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+  const winc_task_retry_t *policy = &s_retry_policy[cause];
+  uint8_t failures = ++s_winc_task_ctx.failures[cause];
+
+  nv->causes[cause] += 1;
+  s_winc_task_ctx.link_up = false;
+  if (failures < policy->budget) {
+    s_winc_task_ctx.backoff_ms = policy->backoff_ms << (failures - 1);
+    s_winc_task_ctx.wait_at = yb_rtc_now();
+    YB_LOG_WARN("Connect failed (%s): retry %d of %d in %d ms",
+                policy->name,
+                failures,
+                policy->budget - 1,
+                (int)s_winc_task_ctx.backoff_ms);
+    winc_task_set_state(WINC_TASK_STATE_BACKOFF);
+  } else {
+    YB_LOG_WARN("Connect failed (%s): giving up on profile %d",
+                policy->name,
+                s_winc_task_ctx.profile);
+    nv->profiles[s_winc_task_ctx.profile].last_ok = false;
+    winc_task_set_state(WINC_TASK_STATE_SELECT_PROFILE);
+  }
+}
+
+static bool winc_task_should_park(void) {
+  yb_rtc_ms_t park_ms = config_task_get_winc_park_ms();
+  return park_ms > 0 && config_task_get_wake_interval_ms() <= park_ms;
+}
+
+static void winc_task_record_wake(void) {
+  if (s_winc_task_ctx.link_ms == 0) {
+    return; // the link never came up: nothing to compare
+  }
+  int mode = s_winc_task_ctx.resumed ? WINC_TASK_WAKE_RESUMED
+                                     : WINC_TASK_WAKE_RESET;
+  winc_task_wake_stats_t *stats = &nv_data()->winc_task_nv_data.wakes[mode];
+
+  stats->wakes += 1;
+  stats->ready_ms += s_winc_task_ctx.ready_ms;
+  stats->link_ms += s_winc_task_ctx.link_ms;
+  stats->awake_ms += app_uptime_ms();
+  YB_LOG_INFO("%s wakes: %u, mean ready=%ld link=%ld awake=%ld ms",
+              s_wake_mode_names[mode],
+              stats->wakes,
+              stats->ready_ms / stats->wakes,
+              stats->link_ms / stats->wakes,
+              stats->awake_ms / stats->wakes);
+}
+
+static void winc_task_log_spi(void) {
+  WDRV_WINC_SPI_STATS stats;
+  uint32_t ticks_per_ms = SYS_TIME_FrequencyGet() / 1000;
+
+  WDRV_WINC_SPIStatsGet(&stats);
+  if (stats.transfers == 0 || ticks_per_ms == 0) {
+    return;
+  }
+  YB_LOG_INFO("SPI: %ld xfers, %ld/%ld bytes tx/rx, %ld posted, %ld full, "
+              "%ld errors",
+              stats.transfers,
+              stats.txBytes,
+              stats.rxBytes,
+              stats.posted,
+              stats.pipelineFull,
+              stats.errors);
+  YB_LOG_INFO("SPI: busy %ld ms, waited %ld ms of %d ms awake",
+              stats.busyTicks / ticks_per_ms,
+              stats.waitTicks / ticks_per_ms,
+              (int)app_uptime_ms());
+  WDRV_WINC_SPIStatsReset();
+
+  tstrHifStats hif;
+  hif_get_stats(&hif);
+  if (hif.u32TxMsgs > 0 && hif.u32RxMsgs > 0) {
+    // Frames per message, in tenths.
+    YB_LOG_INFO("HIF: %ld tx msgs at %ld.%ld frames, %ld rx msgs at %ld.%ld "
+                "frames, %ld prefetch hits",
+                hif.u32TxMsgs,
+                hif.u32TxFrames / hif.u32TxMsgs,
+                (hif.u32TxFrames * 10 / hif.u32TxMsgs) % 10,
+                hif.u32RxMsgs,
+                hif.u32RxFrames / hif.u32RxMsgs,
+                (hif.u32RxFrames * 10 / hif.u32RxMsgs) % 10,
+                hif.u32RxPrefetchHits);
+  }
+  if (hif.u32Irqs > 0) {
+    // Messages per interrupt in tenths; latency from interrupt to handling.
+    YB_LOG_INFO("HIF: %ld irqs at %ld.%ld msgs (max %d), %ld passes, %ld "
+                "empty, %ld yields, latency avg %ld us max %ld us",
+                hif.u32Irqs,
+                hif.u32RxMsgs / hif.u32Irqs,
+                (hif.u32RxMsgs * 10 / hif.u32Irqs) % 10,
+                hif.u8MaxPassEvents,
+                hif.u32Passes,
+                hif.u32EmptyPasses,
+                hif.u32Yields,
+                (uint32_t)((uint64_t)hif.u32LatencyTicks * 1000 /
+                           hif.u32Irqs / ticks_per_ms),
+                (uint32_t)((uint64_t)hif.u32MaxLatencyTicks * 1000 /
+                           ticks_per_ms));
+  }
+}
+
+static bool winc_task_want_spi_crc(void) {
+  const char *mode = config_task_get_winc_spi_crc();
+
+  if (mode == NULL || strcmp(mode, "off") == 0) {
+    return false;
+  } else if (strcmp(mode, "on") == 0) {
+    return true;
+  } else if (strcmp(mode, "auto") == 0) {
+    return nv_data()->winc_task_nv_data.crc_clean < WINC_TASK_CRC_PROBATION;
+  }
+  YB_LOG_WARN("Unknown winc_spi_crc %s", mode);
+  return false;
+}
+
+static void winc_task_record_spi_crc(void) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+  tstrNmCrcStats crc;
+
+  nm_crc_get_stats(&crc);
+  if (crc.u32Checked == 0) {
+    return;
+  }
+  if (crc.u32Errors > 0) {
+    nv->crc_clean = 0;
+    nv->crc_errors += crc.u32Errors;
+  } else {
+    nv->crc_clean += crc.u32Checked;
+  }
+  YB_LOG_INFO("SPI CRC: %ld checked, %ld errors; %ld clean in a row, %ld "
+              "errors in all (%s)",
+              crc.u32Checked,
+              crc.u32Errors,
+              nv->crc_clean,
+              nv->crc_errors,
+              crc.u8HwUsed ? "dmac" : "tables");
+}
+
+static uint8_t winc_task_choose_power_profile(void) {
+  const char *name = config_task_get_winc_power();
+
+  if (name == NULL) {
+    return 0;
+  } else if (strcmp(name, "cycle") == 0) {
+    return nv_data()->app_nv_data.reboot_count % WINC_TASK_POWER_PROFILE_COUNT;
+  }
+  for (uint8_t i = 0; i < WINC_TASK_POWER_PROFILE_COUNT; i++) {
+    if (strcmp(name, s_power_profiles[i].name) == 0) {
+      return i;
+    }
+  }
+  YB_LOG_WARN("Unknown winc_power '%s'", name);
+  return 0;
+}
+
+static void winc_task_record_power(uint32_t ttfb_ms, uint32_t total_ms) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+  winc_task_power_stats_t *stats = &nv->power[nv->power_profile];
+
+  stats->wakes += 1;
+  stats->ttfb_ms += ttfb_ms;
+  stats->total_ms += total_ms;
+  stats->awake_ms += app_uptime_ms();
+  YB_LOG_INFO("Power profile %s: %u wakes, mean ttfb=%ld total=%ld idle=%ld "
+              "awake=%ld ms",
+              s_power_profiles[nv->power_profile].name,
+              stats->wakes,
+              stats->ttfb_ms / stats->wakes,
+              stats->total_ms / stats->wakes,
+              stats->idle_ms / stats->wakes,
+              stats->awake_ms / stats->wakes);
+}
+
+static bool winc_task_request_time(void) {
+  s_winc_task_ctx.time_ready = false;
+  if (WDRV_WINC_STATUS_OK !=
+      WDRV_WINC_SystemTimeGetCurrent(s_winc_task_ctx.wdrHandle,
+                                     winc_task_systime_cb)) {
+    YB_LOG_WARN("WDRV_WINC_SystemTimeGetCurrent() failed");
+    return false;
+  }
+  return true;
+}
+
+static void winc_task_systime_cb(DRV_HANDLE handle, uint32_t timeUTC) {
+  (void)handle;
+  s_winc_task_ctx.time_at = yb_rtc_now();
+  s_winc_task_ctx.timeUTC = timeUTC;
+  s_winc_task_ctx.time_ready = true;
+}
+
 static void winc_task_dhcp_cb(DRV_HANDLE handle, uint32_t dhcpAddr) {
   // Called asynchronously in response to WDRV_WINC_IPUseDHCPSet()
   (void)handle;
@@ -291,21 +1396,72 @@ static void winc_task_dhcp_cb(DRV_HANDLE handle, uint32_t dhcpAddr) {
 
   YB_LOG_INFO("DHCP address is %s",
               inet_ntop(AF_INET, &dhcpAddr, s, sizeof(s)));
+  // Kept for the driver in case the WINC is parked and resumed.
+  nv_data()->winc_task_nv_data.ip_address = dhcpAddr;
 }
 
 static void winc_task_wifi_notify_cb(DRV_HANDLE handle,
                                      WDRV_WINC_ASSOC_HANDLE assocHandle,
                                      WDRV_WINC_CONN_STATE currentState,
                                      WDRV_WINC_CONN_ERROR errorCode) {
+  winc_task_nv_data_t *nv = &nv_data()->winc_task_nv_data;
+
   if (WDRV_WINC_CONN_STATE_CONNECTED == currentState) {
     YB_LOG_INFO("Connected to AP");
-    winc_task_set_state(WINC_TASK_STATE_START_HTTP_TASK);
+    int i = s_winc_task_ctx.profile;
+    nv->profiles[i].successes += 1;
+    nv->profiles[i].last_ok = true;
+    if (s_winc_task_ctx.tried != (1 << i)) {
+      // an earlier profile failed this wake
+      nv->failover_count += 1;
+    }
+    // Try this profile first next time.
+    nv->preferred_profile = i;
+    s_winc_task_ctx.wait_at = yb_rtc_now();
+    winc_task_set_state(WINC_TASK_STATE_AWAIT_DHCP);
 
-  } else if (WDRV_WINC_CONN_STATE_DISCONNECTED == currentState) {
+  } else if (WDRV_WINC_CONN_STATE_DISCONNECTED == currentState &&
+             s_winc_task_ctx.expect_disconnect &&
+             s_winc_task_ctx.state != WINC_TASK_STATE_AWAIT_DISCONNECT) {
+    // Follows a disconnect made by a DHCP timeout: already handled, even if
+    // it arrives after the next connect attempt has started.
+    YB_LOG_INFO("Disconnected from AP");
+    s_winc_task_ctx.expect_disconnect = false;
+
+  } else if (WDRV_WINC_CONN_STATE_DISCONNECTED == currentState &&
+             s_winc_task_ctx.state == WINC_TASK_STATE_AWAIT_CONNECT) {
+    YB_LOG_WARN("Unable to connect to %s (error %d)",
+                s_winc_task_ctx.ssid,
+                errorCode);
+    winc_task_connect_failed(winc_task_classify(errorCode));
+
+  } else if (WDRV_WINC_CONN_STATE_DISCONNECTED == currentState &&
+             s_winc_task_ctx.state == WINC_TASK_STATE_AWAIT_DISCONNECT) {
     YB_LOG_INFO("Disconnected from AP");
     m2m_wifi_deinit(NULL);
     winc_task_set_state(WINC_TASK_STATE_SUCCESS);
 
+  } else if (WDRV_WINC_CONN_STATE_DISCONNECTED == currentState &&
+             s_winc_task_ctx.state == WINC_TASK_STATE_AWAIT_DHCP) {
+    // The AP dropped us before DHCP finished: retry now rather than wait out
+    // the DHCP timeout.
+    YB_LOG_WARN("Lost connection to %s before DHCP", s_winc_task_ctx.ssid);
+    winc_task_connect_failed(WINC_TASK_CAUSE_LINK_LOSS);
+
+  } else if (WDRV_WINC_CONN_STATE_DISCONNECTED == currentState &&
+             s_winc_task_ctx.link_up) {
+    // Lost the AP mid-wake: abandon the stage in progress and reconnect.
+    YB_LOG_WARN("Lost connection to %s", s_winc_task_ctx.ssid);
+    winc_task_set_idle(false);
+    http_task_shutdown();
+    probe_task_shutdown();
+    ping_task_shutdown();
+    udp_task_shutdown();
+    winc_task_connect_failed(WINC_TASK_CAUSE_LINK_LOSS);
+
+  } else if (WDRV_WINC_CONN_STATE_DISCONNECTED == currentState) {
+    YB_LOG_INFO("Disconnected from AP");
+
   } else {
     YB_LOG_WARN("winc_task_wifi_nofify_cb() received currenState = %d",
                 currentState);
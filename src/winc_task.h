@@ -31,6 +31,7 @@
 // *****************************************************************************
 // Includes
 
+#include "config_task.h"
 #include "definitions.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -45,13 +46,105 @@ extern "C" {
 // *****************************************************************************
 // Public types and definitions
 
+// Number of WINC power profiles, selected by winc_power in config.txt.
+#define WINC_TASK_POWER_PROFILE_COUNT 4
+
+/**
+ * @brief Outcome of the wakes made under one WINC power profile.  Divide each
+ * sum by wakes for the mean.  Awake time stands in for charge per wake.
+ */
+typedef struct {
+  uint16_t wakes;    // # of wakes whose report was delivered
+  uint32_t ttfb_ms;  // sum of http_task_timing_t.ttfb_ms, or UDP ack RTTs
+  uint32_t total_ms; // sum of http_task_timing_t.total_ms, or UDP ack RTTs
+  uint32_t idle_ms;  // sum of time spent in the idle power-save mode
+  uint32_t awake_ms; // sum of uptime when the report was delivered
+} winc_task_power_stats_t;
+
+/**
+ * @brief Why a connection attempt failed, or why an established link ended.
+ */
+typedef enum {
+  WINC_TASK_CAUSE_AP_NOT_FOUND, // no BSS with the profile's SSID in range
+  WINC_TASK_CAUSE_AUTH,         // credentials rejected: retrying won't help
+  WINC_TASK_CAUSE_ASSOC,        // association failed or connect refused
+  WINC_TASK_CAUSE_DHCP,         // associated, but no address in time
+  WINC_TASK_CAUSE_LINK_LOSS,    // disconnected while in use
+  WINC_TASK_CAUSE_COUNT
+} winc_task_cause_t;
+
+// Index into winc_task_nv_data_t.wakes: how the link came up.
+#define WINC_TASK_WAKE_RESET 0   // WINC reset, booted and associated
+#define WINC_TASK_WAKE_RESUMED 1 // WINC stayed associated while parked
+#define WINC_TASK_WAKE_MODES 2
+
+/**
+ * @brief Wake latency of the wakes whose link came up one way.  Divide each
+ * sum by wakes for the mean.  All times are uptime, i.e. since reboot.
+ */
+typedef struct {
+  uint16_t wakes;    // # of wakes whose link came up this way
+  uint32_t ready_ms; // sum of uptime at which the WINC driver was ready
+  uint32_t link_ms;  // sum of uptime at which the link was up
+  uint32_t awake_ms; // sum of uptime at hibernation
+} winc_task_wake_stats_t;
+
+/**
+ * @brief Connection history of one wifi profile.
+ */
+typedef struct {
+  uint16_t attempts;  // # of WDRV_WINC_BSSConnect() calls with this profile
+  uint16_t successes; // # of those that reached CONNECTED
+  int8_t last_rssi;   // RSSI at the most recent scan, INT8_MIN if not seen
+  bool last_ok;       // true if the most recent attempt connected
+} winc_task_profile_stats_t;
+
+/**
+ * @brief Data that is preserved across reboots.
+ */
+typedef struct {
+  uint8_t preferred_profile; // the profile that last connected
+  winc_task_profile_stats_t profiles[MAX_CONFIG_WIFI_PROFILES];
+  uint32_t scan_count;       // # of wakes that needed a scan
+  uint32_t failover_count;   // # of wakes that connected on a later profile
+  uint8_t power_profile;     // power profile used by this wake
+  winc_task_power_stats_t power[WINC_TASK_POWER_PROFILE_COUNT];
+  bool parked;               // true if the WINC was left associated
+  uint32_t ip_address;       // DHCP address, restored when resuming
+  uint32_t gateway_address;  // default gateway, restored when resuming
+  uint32_t resume_failures;  // # of parked links found lost on waking
+  winc_task_wake_stats_t wakes[WINC_TASK_WAKE_MODES];
+  uint16_t causes[WINC_TASK_CAUSE_COUNT]; // # of failures of each cause
+  uint32_t crc_clean;        // # of SPI data CRCs checked since the last error
+  uint32_t crc_errors;       // # of SPI data CRC errors
+} winc_task_nv_data_t;
+
 // *****************************************************************************
 // Public declarations
 
 /**
- * @brief Initialize the winc_task.
+ * @brief Prepare the WINC driver for this wake.  Call from APP_Initialize(),
+ * before the driver's first WDRV_WINC_Tasks().
+ *
+ * If the previous wake parked the WINC (see winc_task_shutdown()), the driver
+ * wakes it instead of resetting it, and winc_task_connect() resumes its link.
+ */
+void winc_task_boot(void);
+
+/**
+ * @brief Initialize the winc_task and connect using the wifi profiles from
+ * config_task.
+ *
+ * If the profile that connected last time also connected on its most recent
+ * attempt, it is tried first without scanning.  Otherwise a single scan ranks
+ * the profiles by RSSI and past success rate, and each is tried in turn until
+ * one connects.
+ *
+ * Each failure is classified (see winc_task_cause_t) and retried with the same
+ * profile after a backoff, until that cause's budget is spent and the next
+ * profile is tried.  Bad credentials are never retried.
  */
-void winc_task_connect(const char *ssid, const char *pass);
+void winc_task_connect(void);
 
 /**
  * @brief Start the disconnect sequence.
@@ -69,6 +162,11 @@ bool winc_task_failed(void);
 
 /**
  * @brief Release any resources allocated by winc_task.
+ *
+ * If the report was made and wake_interval_ms is no longer than winc_park_ms,
+ * the WINC is parked: left associated in its lowest power-save mode, to be
+ * resumed on the next wake.  Otherwise it is shut down, to be reset, booted
+ * and reassociated on the next wake.
  */
 void winc_task_shutdown(void);
 
@@ -79,6 +177,22 @@ void winc_task_shutdown(void);
  */
 DRV_HANDLE winc_task_get_handle(void);
 
+/**
+ * @brief Write the count of connection failures of each cause into buf, one
+ * byte per cause in winc_task_cause_t order, saturating at 255.  Return the
+ * number of bytes written, or 0 if buf is too small.
+ */
+size_t winc_task_encode_causes(uint8_t *buf, size_t size);
+
+/**
+ * @brief Switch the WINC to the power profile's idle power-save mode while
+ * waiting on a peer (idle = true), or back to full power (idle = false).
+ *
+ * Association and bulk transfers run at full power.  Power save trades the
+ * latency of the next packet for radio-off time between beacons.
+ */
+void winc_task_set_idle(bool idle);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,231 @@
+/**
+ * @file yb_hmac.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "yb_hmac.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+#define HMAC_IPAD 0x36
+#define HMAC_OPAD 0x5c
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+static void yb_sha256_compress(yb_sha256_t *ctx, const uint8_t *block);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static const uint32_t s_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+static const uint32_t s_sha256_h0[8] = {0x6a09e667,
+                                        0xbb67ae85,
+                                        0x3c6ef372,
+                                        0xa54ff53a,
+                                        0x510e527f,
+                                        0x9b05688c,
+                                        0x1f83d9ab,
+                                        0x5be0cd19};
+
+// *****************************************************************************
+// Public code
+
+void yb_sha256_init(yb_sha256_t *ctx) {
+  memcpy(ctx->h, s_sha256_h0, sizeof(ctx->h));
+  ctx->length = 0;
+}
+
+void yb_sha256_update(yb_sha256_t *ctx, const void *data, size_t len) {
+  const uint8_t *p = (const uint8_t *)data;
+  size_t used = ctx->length % YB_SHA256_BLOCK_SIZE;
+
+  ctx->length += len;
+  if (used > 0) {
+    // top up the partial block first
+    size_t n = YB_SHA256_BLOCK_SIZE - used;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(&ctx->block[used], p, n);
+    p += n;
+    len -= n;
+    if (used + n < YB_SHA256_BLOCK_SIZE) {
+      return;
+    }
+    yb_sha256_compress(ctx, ctx->block);
+  }
+  while (len >= YB_SHA256_BLOCK_SIZE) {
+    yb_sha256_compress(ctx, p);
+    p += YB_SHA256_BLOCK_SIZE;
+    len -= YB_SHA256_BLOCK_SIZE;
+  }
+  memcpy(ctx->block, p, len);
+}
+
+void yb_sha256_final(yb_sha256_t *ctx, uint8_t digest[YB_SHA256_DIGEST_SIZE]) {
+  uint64_t bits = ctx->length * 8;
+  size_t used = ctx->length % YB_SHA256_BLOCK_SIZE;
+
+  // append 0x80, pad with zeros and finish with the 64 bit big-endian length
+  ctx->block[used++] = 0x80;
+  if (used > YB_SHA256_BLOCK_SIZE - 8) {
+    memset(&ctx->block[used], 0, YB_SHA256_BLOCK_SIZE - used);
+    yb_sha256_compress(ctx, ctx->block);
+    used = 0;
+  }
+  memset(&ctx->block[used], 0, YB_SHA256_BLOCK_SIZE - 8 - used);
+  for (int i = 0; i < 8; i++) {
+    ctx->block[YB_SHA256_BLOCK_SIZE - 1 - i] = (uint8_t)(bits >> (8 * i));
+  }
+  yb_sha256_compress(ctx, ctx->block);
+
+  for (int i = 0; i < 8; i++) {
+    digest[4 * i + 0] = (uint8_t)(ctx->h[i] >> 24);
+    digest[4 * i + 1] = (uint8_t)(ctx->h[i] >> 16);
+    digest[4 * i + 2] = (uint8_t)(ctx->h[i] >> 8);
+    digest[4 * i + 3] = (uint8_t)(ctx->h[i]);
+  }
+}
+
+void yb_hmac_sha256(const void *key,
+                    size_t key_len,
+                    const void *msg,
+                    size_t msg_len,
+                    uint8_t *mac,
+                    size_t mac_len) {
+  yb_sha256_t sha;
+  uint8_t k[YB_SHA256_BLOCK_SIZE];
+  uint8_t pad[YB_SHA256_BLOCK_SIZE];
+  uint8_t digest[YB_SHA256_DIGEST_SIZE];
+
+  // Keys longer than a block are hashed first.
+  memset(k, 0, sizeof(k));
+  if (key_len > YB_SHA256_BLOCK_SIZE) {
+    yb_sha256_init(&sha);
+    yb_sha256_update(&sha, key, key_len);
+    yb_sha256_final(&sha, k);
+  } else {
+    memcpy(k, key, key_len);
+  }
+
+  // inner: H((K ^ ipad) || msg)
+  for (int i = 0; i < YB_SHA256_BLOCK_SIZE; i++) {
+    pad[i] = k[i] ^ HMAC_IPAD;
+  }
+  yb_sha256_init(&sha);
+  yb_sha256_update(&sha, pad, sizeof(pad));
+  yb_sha256_update(&sha, msg, msg_len);
+  yb_sha256_final(&sha, digest);
+
+  // outer: H((K ^ opad) || inner)
+  for (int i = 0; i < YB_SHA256_BLOCK_SIZE; i++) {
+    pad[i] = k[i] ^ HMAC_OPAD;
+  }
+  yb_sha256_init(&sha);
+  yb_sha256_update(&sha, pad, sizeof(pad));
+  yb_sha256_update(&sha, digest, sizeof(digest));
+  yb_sha256_final(&sha, digest);
+
+  if (mac_len > YB_SHA256_DIGEST_SIZE) {
+    mac_len = YB_SHA256_DIGEST_SIZE;
+  }
+  memcpy(mac, digest, mac_len);
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void yb_sha256_compress(yb_sha256_t *ctx, const uint8_t *block) {
+  uint32_t w[64];
+  uint32_t a, b, c, d, e, f, g, h;
+
+  for (int i = 0; i < 16; i++) {
+    w[i] = ((uint32_t)block[4 * i] << 24) | ((uint32_t)block[4 * i + 1] << 16) |
+           ((uint32_t)block[4 * i + 2] << 8) | ((uint32_t)block[4 * i + 3]);
+  }
+  for (int i = 16; i < 64; i++) {
+    uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+    uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+    w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+  }
+
+  a = ctx->h[0];
+  b = ctx->h[1];
+  c = ctx->h[2];
+  d = ctx->h[3];
+  e = ctx->h[4];
+  f = ctx->h[5];
+  g = ctx->h[6];
+  h = ctx->h[7];
+
+  for (int i = 0; i < 64; i++) {
+    uint32_t s1 = ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + s_sha256_k[i] + w[i];
+    uint32_t s0 = ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  ctx->h[0] += a;
+  ctx->h[1] += b;
+  ctx->h[2] += c;
+  ctx->h[3] += d;
+  ctx->h[4] += e;
+  ctx->h[5] += f;
+  ctx->h[6] += g;
+  ctx->h[7] += h;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file yb_hmac.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _YB_HMAC_H_
+#define _YB_HMAC_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stddef.h>
+#include <stdint.h>
+
+// =============================================================================
+// C++ compatibility
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// *****************************************************************************
+// Public types and definitions
+
+#define YB_SHA256_BLOCK_SIZE 64
+#define YB_SHA256_DIGEST_SIZE 32
+
+/**
+ * @brief Incremental SHA-256 state.
+ */
+typedef struct {
+  uint32_t h[8];                        // chaining value
+  uint64_t length;                      // # of bytes hashed so far
+  uint8_t block[YB_SHA256_BLOCK_SIZE];  // partial input block
+} yb_sha256_t;
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Start a new SHA-256 computation.
+ */
+void yb_sha256_init(yb_sha256_t *ctx);
+
+/**
+ * @brief Hash len bytes of data.  May be called any number of times.
+ */
+void yb_sha256_update(yb_sha256_t *ctx, const void *data, size_t len);
+
+/**
+ * @brief Finish the computation and write the 32 byte digest.
+ */
+void yb_sha256_final(yb_sha256_t *ctx, uint8_t digest[YB_SHA256_DIGEST_SIZE]);
+
+/**
+ * @brief Compute HMAC-SHA256 (RFC 2104) of msg under key.
+ *
+ * @param mac Receives the first mac_len bytes of the 32 byte MAC.  Truncation
+ *        to no less than 16 bytes is permitted by RFC 2104.
+ */
+void yb_hmac_sha256(const void *key,
+                    size_t key_len,
+                    const void *msg,
+                    size_t msg_len,
+                    uint8_t *mac,
+                    size_t mac_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* #ifndef _YB_HMAC_H_ */
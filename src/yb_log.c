@@ -31,6 +31,7 @@
 #include "yb_log.h"
 
 #include "app.h"
+#include "yb_rtc.h"
 #include <stdarg.h>
 #include <stdio.h>
 
@@ -66,8 +67,19 @@ void yb_log(yb_log_level_t level, const char *fmt, ...) {
     // printf("%f", ...) hard faults?!?
     // yb_rtc_ms_t t = app_uptime_ms();
     // printf("\n%f [%s] ", t, s);
-    int ms = app_uptime_ms();
-    printf("\n%08d [%s] ", ms, s);
+    if (yb_rtc_is_synced()) {
+      // UTC time of day, to line up with server logs
+      int ms = yb_rtc_utc_ms(yb_rtc_now()) % (24 * 3600 * 1000);
+      printf("\n%02d:%02d:%02d.%03dZ [%s] ",
+             ms / 3600000,
+             ms / 60000 % 60,
+             ms / 1000 % 60,
+             ms % 1000,
+             s);
+    } else {
+      int ms = app_uptime_ms();
+      printf("\n%08d [%s] ", ms, s);
+    }
     va_start(ap, fmt);
     vprintf(fmt, ap);
     va_end(ap);
@@ -31,6 +31,8 @@
 #include "yb_rtc.h"
 
 #include "definitions.h"
+#include "nv_data.h"
+#include "yb_log.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -44,6 +46,16 @@ static yb_rtc_tics_t to_tics(yb_rtc_ms_t offset);
 
 static yb_rtc_ms_t to_ms(yb_rtc_tics_t tics);
 
+/**
+ * @brief Return the RTC count at the given UTC, corrected for drift.
+ */
+static yb_rtc_tics_t from_utc_ms(uint64_t utc_ms);
+
+/**
+ * @brief Return the RTC's rate error as a fraction, e.g. 1e-6 for 1 ppm fast.
+ */
+static double drift_rate(void);
+
 // *****************************************************************************
 // Local (private, static) forward declarations
 
@@ -72,6 +84,77 @@ yb_rtc_tics_t yb_rtc_offset(yb_rtc_tics_t t, yb_rtc_ms_t offset_ms) {
   return t + to_tics(offset_ms);
 }
 
+yb_rtc_tics_t yb_rtc_next_period(yb_rtc_tics_t t, yb_rtc_ms_t period_ms) {
+  uint64_t period = period_ms;
+
+  if (!yb_rtc_is_synced() || period == 0) {
+    return yb_rtc_offset(t, period_ms);
+  }
+  // Round to the nearest multiple so a late or early wake does not skip one.
+  uint64_t target = yb_rtc_utc_ms(t) + period;
+  target = ((target + period / 2) / period) * period;
+  return from_utc_ms(target);
+}
+
+void yb_rtc_sync(uint64_t utc_ms, yb_rtc_tics_t t) {
+  yb_rtc_nv_data_t *nv = &nv_data()->yb_rtc_nv_data;
+
+  if (!nv->synced) {
+    nv->ref_utc_ms = utc_ms;
+    nv->ref_tics = t;
+  } else {
+    nv->last_error_ms = (int64_t)(yb_rtc_utc_ms(t) - utc_ms);
+    // Unsigned: a count may pass through zero once between syncs.
+    yb_rtc_tics_t tics = t - nv->ref_tics;
+    double rtc_ms = tics * 1000.0 / RTC_Timer32FrequencyGet();
+    double utc_elapsed_ms = (int64_t)(utc_ms - nv->ref_utc_ms);
+    if (utc_elapsed_ms > YB_RTC_DRIFT_MAX_INTERVAL_MS || utc_elapsed_ms < 0) {
+      // Too long to measure: start over.
+      nv->ref_utc_ms = utc_ms;
+      nv->ref_tics = t;
+    } else if (utc_elapsed_ms >= YB_RTC_DRIFT_MIN_INTERVAL_MS) {
+      double ppm = (rtc_ms - utc_elapsed_ms) * 1e6 / utc_elapsed_ms;
+      if (ppm > YB_RTC_DRIFT_MAX_PPM || ppm < -YB_RTC_DRIFT_MAX_PPM) {
+        YB_LOG_WARN("Discarding RTC drift of %d ppm", (int)ppm);
+      } else if (!nv->drift_valid) {
+        nv->drift_ppm = ppm;
+        nv->drift_valid = true;
+      } else {
+        // Smooth over the sync jitter of successive measurements.
+        nv->drift_ppm = 0.75 * nv->drift_ppm + 0.25 * ppm;
+      }
+      nv->ref_utc_ms = utc_ms;
+      nv->ref_tics = t;
+    }
+  }
+  nv->sync_utc_ms = utc_ms;
+  nv->sync_tics = t;
+  nv->synced = true;
+  nv->sync_count += 1;
+  YB_LOG_INFO("RTC synced: error %d ms, drift %d ppb",
+              (int)nv->last_error_ms,
+              (int)(nv->drift_ppm * 1000));
+}
+
+bool yb_rtc_is_synced(void) { return nv_data()->yb_rtc_nv_data.synced; }
+
+bool yb_rtc_needs_sync(void) {
+  yb_rtc_nv_data_t *nv = &nv_data()->yb_rtc_nv_data;
+  return !nv->synced ||
+         yb_rtc_elapsed_ms(nv->sync_tics) > YB_RTC_SYNC_INTERVAL_MS;
+}
+
+uint64_t yb_rtc_utc_ms(yb_rtc_tics_t t) {
+  yb_rtc_nv_data_t *nv = &nv_data()->yb_rtc_nv_data;
+
+  if (!nv->synced) {
+    return 0;
+  }
+  double rtc_ms = (int32_t)(t - nv->sync_tics) * 1000.0 /
+                  RTC_Timer32FrequencyGet();
+  return nv->sync_utc_ms + (int64_t)(rtc_ms / (1.0 + drift_rate()));
+}
+
 void yb_rtc_hibernate_until(yb_rtc_tics_t t) {
   yb_rtc_tics_t now = RTC_Timer32CounterGet();
 
@@ -97,3 +180,16 @@ static yb_rtc_ms_t to_ms(yb_rtc_tics_t tics) {
   yb_rtc_ms_t ms = dt * 1000.0 / RTC_Timer32FrequencyGet();
   return ms;
 }
+
+static yb_rtc_tics_t from_utc_ms(uint64_t utc_ms) {
+  yb_rtc_nv_data_t *nv = &nv_data()->yb_rtc_nv_data;
+  double utc_elapsed_ms = (int64_t)(utc_ms - nv->sync_utc_ms);
+  double rtc_ms = utc_elapsed_ms * (1.0 + drift_rate());
+  return nv->sync_tics +
+         (int32_t)(rtc_ms * RTC_Timer32FrequencyGet() / 1000.0);
+}
+
+static double drift_rate(void) {
+  yb_rtc_nv_data_t *nv = &nv_data()->yb_rtc_nv_data;
+  return nv->drift_valid ? nv->drift_ppm * 1e-6 : 0.0;
+}
@@ -56,6 +56,35 @@ typedef float yb_rtc_ms_t;
 
 #define YB_RTC_MINIMUM_HIBERNATE_MS ((yb_rtc_ms_t)10.0)
 
+// Resync with UTC once the last sync is older than this.
+#define YB_RTC_SYNC_INTERVAL_MS ((yb_rtc_ms_t)(3600 * 1000.0))
+
+// The RTC's rate error is measured over at least this long, so that the
+// uncertainty of each sync is small beside the time the RTC has drifted...
+#define YB_RTC_DRIFT_MIN_INTERVAL_MS ((yb_rtc_ms_t)(4 * 3600 * 1000.0))
+
+// ...and over no more than this, within which the 32 bit count cannot wrap.
+#define YB_RTC_DRIFT_MAX_INTERVAL_MS ((yb_rtc_ms_t)(30 * 3600 * 1000.0))
+
+// A measured rate error beyond this is taken to be a bad sync and discarded.
+#define YB_RTC_DRIFT_MAX_PPM 200.0
+
+/**
+ * @brief The mapping from RTC counts to UTC, kept across hibernation.  UTC is
+ * in milliseconds since 1970-01-01.
+ */
+typedef struct {
+  bool synced;             // true once yb_rtc_sync() has been called
+  uint64_t sync_utc_ms;    // UTC at sync_tics
+  yb_rtc_tics_t sync_tics; // RTC count at the most recent sync
+  uint64_t ref_utc_ms;     // UTC at the start of the drift measurement
+  yb_rtc_tics_t ref_tics;  // RTC count at the start of the drift measurement
+  bool drift_valid;        // true once drift_ppm has been measured
+  float drift_ppm;         // RTC rate error, positive if the RTC runs fast
+  float last_error_ms;     // predicted less actual UTC at the most recent sync
+  uint32_t sync_count;     // # of calls to yb_rtc_sync()
+} yb_rtc_nv_data_t;
+
 // *****************************************************************************
 // Public declarations
 
@@ -84,6 +113,40 @@ yb_rtc_ms_t yb_rtc_difference_ms(yb_rtc_tics_t t1, yb_rtc_tics_t t2);
  */
 yb_rtc_tics_t yb_rtc_offset(yb_rtc_tics_t t, yb_rtc_ms_t offset_ms);
 
+/**
+ * @brief Return the time one period after t.
+ *
+ * Once synced to UTC, the result is corrected for the RTC's drift and moved to
+ * the nearest whole multiple of period_ms in UTC, so that devices with the same
+ * period wake together.
+ */
+yb_rtc_tics_t yb_rtc_next_period(yb_rtc_tics_t t, yb_rtc_ms_t period_ms);
+
+/**
+ * @brief Record that UTC was utc_ms when the RTC count was t.
+ *
+ * Corrects the UTC offset and, if the previous syncs span long enough, updates
+ * the drift estimate.  The mapping is kept in nv_data.
+ */
+void yb_rtc_sync(uint64_t utc_ms, yb_rtc_tics_t t);
+
+/**
+ * @brief Return true if yb_rtc_sync() has been called since the last cold boot.
+ */
+bool yb_rtc_is_synced(void);
+
+/**
+ * @brief Return true if the last sync is older than YB_RTC_SYNC_INTERVAL_MS or
+ * there has been none.
+ */
+bool yb_rtc_needs_sync(void);
+
+/**
+ * @brief Return the UTC at RTC count t, corrected for drift, or 0 if not
+ * synced.  t must lie within 18 hours of the last sync.
+ */
+uint64_t yb_rtc_utc_ms(yb_rtc_tics_t t);
+
 /**
  * @brief Hibernate until the specified time arrives.
  *
@@ -0,0 +1,269 @@
+/**
+ * @file fake_drv_spi.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Stand-in for DRV_SPI with the WINC at the far end of the bus.
+ *
+ * Transfers queue as DRV_SPI's do, up to DRV_SPI_QUEUE_SIZE_IDX0 of them, and
+ * complete in order, one at a time: when the test calls fake_spi_complete(),
+ * as the DMA would behind the CPU's back, or when the driver lets interrupts
+ * in while it waits on its semaphore.  A write is clocked onto the wire from
+ * its buffer only when it completes, so a buffer that the driver reuses too
+ * soon shows up as the wrong bytes, and is counted as clobbered.  A read is
+ * answered from the bytes set by fake_spi_set_miso().
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "configuration.h"
+#include "definitions.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define FAKE_SPI_QUEUE DRV_SPI_QUEUE_SIZE_IDX0
+
+// Matches SPI_DMA_MAX_TX_SIZE in wdrv_winc_spi.c.
+#define FAKE_SPI_MAX_TRANSFER 1024
+
+#define FAKE_SPI_WIRE_MAX 16384
+
+typedef struct {
+  const uint8_t *tx;   // bytes to clock out, NULL for a read
+  uint8_t *rx;         // where to put the bytes read, NULL for a write
+  size_t size;
+  bool fail;           // complete with DRV_SPI_TRANSFER_EVENT_ERROR
+  uint8_t tx_copy[FAKE_SPI_MAX_TRANSFER]; // the write as it was queued
+} fake_transfer_t;
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Queue a transfer, or refuse it as DRV_SPI would.
+ */
+static void fake_spi_add(const uint8_t *tx,
+                         uint8_t *rx,
+                         size_t size,
+                         DRV_SPI_TRANSFER_HANDLE *const transferHandle);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static fake_transfer_t s_queue[FAKE_SPI_QUEUE];
+
+static int s_head;        // index of the oldest transfer in s_queue
+
+static int s_in_flight;
+
+static int s_max_in_flight;
+
+static int s_clobbered;
+
+static int s_refused;
+
+static bool s_fail_next;
+
+static bool s_interrupts = true;
+
+static DRV_SPI_TRANSFER_EVENT_HANDLER s_handler;
+
+static uintptr_t s_context;
+
+static uint8_t s_wire[FAKE_SPI_WIRE_MAX];
+
+static size_t s_wire_len;
+
+static const uint8_t *s_miso;
+
+static size_t s_miso_len;
+
+// *****************************************************************************
+// Public code
+
+void fake_spi_reset(void) {
+  s_head = 0;
+  s_in_flight = 0;
+  s_max_in_flight = 0;
+  s_clobbered = 0;
+  s_refused = 0;
+  s_fail_next = false;
+  s_interrupts = true;
+  s_wire_len = 0;
+  s_miso = NULL;
+  s_miso_len = 0;
+}
+
+void fake_spi_set_miso(const void *data, size_t len) {
+  s_miso = data;
+  s_miso_len = len;
+}
+
+void fake_spi_fail_next(void) { s_fail_next = true; }
+
+bool fake_spi_complete(void) {
+  if (s_in_flight == 0) {
+    return false;
+  }
+  fake_transfer_t *t = &s_queue[s_head];
+  s_head = (s_head + 1) % FAKE_SPI_QUEUE;
+  s_in_flight -= 1;
+
+  if (t->tx != NULL) {
+    if (memcmp(t->tx, t->tx_copy, t->size) != 0) {
+      s_clobbered += 1;
+    }
+    size_t n = t->size;
+    if (n > sizeof(s_wire) - s_wire_len) {
+      n = sizeof(s_wire) - s_wire_len;
+    }
+    memcpy(&s_wire[s_wire_len], t->tx, n);
+    s_wire_len += n;
+  } else {
+    for (size_t i = 0; i < t->size; i++) {
+      if (s_miso_len > 0) {
+        t->rx[i] = *s_miso++;
+        s_miso_len -= 1;
+      } else {
+        t->rx[i] = 0;
+      }
+    }
+  }
+  if (s_handler != NULL) {
+    s_handler(t->fail ? DRV_SPI_TRANSFER_EVENT_ERROR
+                      : DRV_SPI_TRANSFER_EVENT_COMPLETE,
+              (DRV_SPI_TRANSFER_HANDLE)(t - s_queue),
+              s_context);
+  }
+  return true;
+}
+
+int fake_spi_in_flight(void) { return s_in_flight; }
+
+int fake_spi_max_in_flight(void) { return s_max_in_flight; }
+
+int fake_spi_clobbered(void) { return s_clobbered; }
+
+int fake_spi_refused(void) { return s_refused; }
+
+const uint8_t *fake_spi_wire(size_t *len) {
+  *len = s_wire_len;
+  return s_wire;
+}
+
+// drv_spi.h
+
+DRV_HANDLE DRV_SPI_Open(const SYS_MODULE_INDEX index,
+                        const DRV_IO_INTENT ioIntent) {
+  (void)index;
+  (void)ioIntent;
+  return 1;
+}
+
+void DRV_SPI_Close(const DRV_HANDLE handle) {
+  (void)handle;
+  s_handler = NULL;
+}
+
+void DRV_SPI_TransferEventHandlerSet(
+    const DRV_HANDLE handle,
+    const DRV_SPI_TRANSFER_EVENT_HANDLER eventHandler,
+    uintptr_t context) {
+  (void)handle;
+  s_handler = eventHandler;
+  s_context = context;
+}
+
+void DRV_SPI_WriteTransferAdd(const DRV_HANDLE handle,
+                              void *pTransmitData,
+                              size_t txSize,
+                              DRV_SPI_TRANSFER_HANDLE *const transferHandle) {
+  (void)handle;
+  fake_spi_add(pTransmitData, NULL, txSize, transferHandle);
+}
+
+void DRV_SPI_WriteReadTransferAdd(
+    const DRV_HANDLE handle,
+    void *pTransmitData,
+    size_t txSize,
+    void *pReceiveData,
+    size_t rxSize,
+    DRV_SPI_TRANSFER_HANDLE *const transferHandle) {
+  // The byte clocked out alongside a read is a dummy the WINC ignores.
+  (void)handle;
+  (void)pTransmitData;
+  (void)txSize;
+  fake_spi_add(NULL, pReceiveData, rxSize, transferHandle);
+}
+
+// sys_int.h.  The bare-metal OSAL brackets every semaphore call with these,
+// so a driver spinning on its semaphore lets a completion in each time round.
+
+bool SYS_INT_Disable(void) {
+  bool was = s_interrupts;
+  s_interrupts = false;
+  return was;
+}
+
+void SYS_INT_Restore(bool state) {
+  s_interrupts = state;
+  if (state) {
+    fake_spi_complete();
+  }
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void fake_spi_add(const uint8_t *tx,
+                         uint8_t *rx,
+                         size_t size,
+                         DRV_SPI_TRANSFER_HANDLE *const transferHandle) {
+  if (s_in_flight == FAKE_SPI_QUEUE || size == 0 ||
+      size > FAKE_SPI_MAX_TRANSFER) {
+    s_refused += 1;
+    *transferHandle = DRV_SPI_TRANSFER_HANDLE_INVALID;
+    return;
+  }
+  fake_transfer_t *t = &s_queue[(s_head + s_in_flight) % FAKE_SPI_QUEUE];
+  t->tx = tx;
+  t->rx = rx;
+  t->size = size;
+  t->fail = s_fail_next;
+  s_fail_next = false;
+  if (tx != NULL) {
+    memcpy(t->tx_copy, tx, size);
+  }
+  s_in_flight += 1;
+  if (s_in_flight > s_max_in_flight) {
+    s_max_in_flight = s_in_flight;
+  }
+  *transferHandle = (DRV_SPI_TRANSFER_HANDLE)(t - s_queue);
+}
@@ -0,0 +1,122 @@
+/**
+ * @file fake_platform.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Host stand-ins for the RTC, system timer and backup RAM, and the
+ * CHECK() tally.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "definitions.h"
+#include "nv_data.h"
+#include "yb_log.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static yb_rtc_tics_t s_now;
+
+static nv_data_t s_nv_data;
+
+static int s_checks_failed;
+
+// *****************************************************************************
+// Public code
+
+void fake_check_failed(const char *file, int line, const char *cond) {
+  printf("\n%s:%d: CHECK(%s) failed\n", file, line, cond);
+  s_checks_failed += 1;
+}
+
+int fake_check_summary(const char *test_name) {
+  printf("\n%s: %s\n", test_name, s_checks_failed ? "FAILED" : "passed");
+  return s_checks_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+void fake_reset(void) {
+  s_now = 0;
+  nv_data_clear();
+  yb_log_set_reporting_level(getenv("V") ? YB_LOG_LEVEL_TRACE
+                                         : YB_LOG_LEVEL_FATAL);
+}
+
+void fake_rtc_advance_ms(uint32_t ms) { s_now += ms; }
+
+// yb_rtc.h
+
+void yb_rtc_init(void) { s_now = 0; }
+
+yb_rtc_tics_t yb_rtc_now(void) { return s_now; }
+
+yb_rtc_ms_t yb_rtc_elapsed_ms(yb_rtc_tics_t since) {
+  return yb_rtc_difference_ms(s_now, since);
+}
+
+yb_rtc_ms_t yb_rtc_difference_ms(yb_rtc_tics_t t1, yb_rtc_tics_t t2) {
+  return (yb_rtc_ms_t)(int32_t)(t1 - t2);
+}
+
+yb_rtc_tics_t yb_rtc_offset(yb_rtc_tics_t t, yb_rtc_ms_t offset_ms) {
+  return t + (int32_t)offset_ms;
+}
+
+bool yb_rtc_is_synced(void) { return false; }
+
+bool yb_rtc_needs_sync(void) { return false; }
+
+void yb_rtc_sync(uint64_t utc_ms, yb_rtc_tics_t t) {
+  (void)utc_ms;
+  (void)t;
+}
+
+uint64_t yb_rtc_utc_ms(yb_rtc_tics_t t) {
+  (void)t;
+  return 0;
+}
+
+// sys_time.h.  One counter tick is one RTC count.
+
+uint32_t SYS_TIME_CounterGet(void) { return s_now; }
+
+uint32_t SYS_TIME_FrequencyGet(void) { return 1000; }
+
+// nv_data.h
+
+nv_data_t *nv_data(void) { return &s_nv_data; }
+
+void nv_data_clear(void) { memset(&s_nv_data, 0, sizeof(s_nv_data)); }
+
+// app.h, for yb_log()
+
+yb_rtc_ms_t app_uptime_ms(void) { return s_now; }
@@ -0,0 +1,500 @@
+/**
+ * @file fake_socket.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Stand-in for the WINC socket layer, with a scripted TCP peer.
+ *
+ * Calls that the WINC answers asynchronously queue their event, and
+ * fake_socket_poll() delivers one event per call to the registered callback,
+ * as the WINC driver's own task would.  The peer reads the request and then
+ * sends a canned response, a segment at a time, into whichever recv() or
+ * receive ring is posted, and closes the connection after it.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "definitions.h"
+#include "socket.h"
+#include "wdrv_winc_client_api.h"
+#include "yb_rtc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+// Matches TCP_SOCK_MAX.
+#define FAKE_SOCKET_MAX 7
+
+// send() calls the WINC buffers before it refuses more with
+// SOCK_ERR_BUFFER_FULL.
+#define FAKE_SOCKET_SEND_SLOTS 8
+
+#define FAKE_SOCKET_MAX_EVENTS 64
+
+#define FAKE_SOCKET_DNS_ADDR 0x0100000a // 10.0.0.1
+
+typedef struct {
+  bool resolver;        // true for a resolver callback, false for a socket one
+  SOCKET sock;
+  uint8_t msg_type;     // SOCKET_MSG_xxx
+  int8_t error;         // s8Error of SOCKET_MSG_CONNECT and SOCKET_MSG_SECURE
+  int16_t sent;         // the payload of SOCKET_MSG_SEND
+  yb_rtc_tics_t due;    // time at which the WINC delivers the event
+} fake_event_t;
+
+typedef struct {
+  bool open;
+  uint8_t *recv_buf;    // posted recv() buffer, NULL if none
+  uint16_t recv_size;
+  uint8_t *ring;        // attached receive ring, NULL if none
+  uint16_t ring_size;
+  uint16_t ring_start;  // index of the oldest unread byte
+  uint16_t ring_fill;   // # of unread bytes
+  bool ring_full;       // true while the ring is full with data waiting
+  tstrSocketRingStats ring_stats;
+  int in_flight;        // # of send() calls awaiting SOCKET_MSG_SEND
+} fake_socket_t;
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+static void fake_socket_queue(fake_event_t *event);
+
+/**
+ * @brief Deliver the next segment of the response, or the close after it.
+ */
+static bool fake_socket_peer_send(fake_socket_t *s);
+
+/**
+ * @brief Return true once the device has sent what the peer waits for.
+ */
+static bool fake_socket_request_done(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static fake_socket_t s_sockets[FAKE_SOCKET_MAX];
+
+static fake_event_t s_events[FAKE_SOCKET_MAX_EVENTS];
+static int s_event_head;
+static int s_event_count;
+
+static tpfAppSocketCb s_socket_cb;
+static tpfAppResolveCb s_resolver_cb;
+static char s_dns_name[HOSTNAME_MAX_SIZE];
+
+static bool s_link_active;
+static int8_t s_connect_error;
+static uint32_t s_send_ms;
+static int s_max_in_flight;
+
+// The peer: one connection, to the socket that last called connect().
+static SOCKET s_peer = -1;
+static const uint8_t *s_response;
+static size_t s_response_len;
+static size_t s_response_pos;
+static size_t s_respond_after;  // 0 = at the end of the request headers
+static uint16_t s_segment;
+static bool s_keep_open;
+static bool s_peer_closed;
+static uint8_t *s_sent;
+static size_t s_sent_len;
+static size_t s_sent_size;
+
+// *****************************************************************************
+// Public code
+
+void fake_socket_reset(void) {
+  memset(s_sockets, 0, sizeof(s_sockets));
+  s_event_head = s_event_count = 0;
+  s_socket_cb = NULL;
+  s_resolver_cb = NULL;
+  s_link_active = true;
+  s_connect_error = 0;
+  s_send_ms = 0;
+  s_max_in_flight = 0;
+  s_peer = -1;
+  s_response = NULL;
+  s_response_len = s_response_pos = 0;
+  s_respond_after = 0;
+  s_segment = SOCKET_BUFFER_MAX_LENGTH;
+  s_keep_open = false;
+  s_peer_closed = false;
+  s_sent_len = 0;
+}
+
+void fake_socket_set_response(const void *data, size_t len) {
+  s_response = data;
+  s_response_len = len;
+}
+
+void fake_socket_respond_after(size_t nbytes) { s_respond_after = nbytes; }
+
+void fake_socket_set_segment(uint16_t nbytes) { s_segment = nbytes; }
+
+void fake_socket_set_keep_open(bool keep_open) { s_keep_open = keep_open; }
+
+void fake_socket_set_connect_error(int8_t error) { s_connect_error = error; }
+
+void fake_socket_set_link(bool active) { s_link_active = active; }
+
+void fake_socket_set_send_ms(uint32_t ms) { s_send_ms = ms; }
+
+bool fake_socket_poll(void) {
+  if (s_event_count > 0 && s_events[s_event_head].due <= yb_rtc_now()) {
+    fake_event_t event = s_events[s_event_head];
+    s_event_head = (s_event_head + 1) % FAKE_SOCKET_MAX_EVENTS;
+    s_event_count -= 1;
+    if (event.resolver) {
+      if (s_resolver_cb != NULL) {
+        s_resolver_cb((uint8_t *)s_dns_name, FAKE_SOCKET_DNS_ADDR);
+      }
+      return true;
+    }
+    if (!s_sockets[event.sock].open) {
+      // closed since the event was queued
+      return true;
+    }
+    if (event.msg_type == SOCKET_MSG_SEND) {
+      s_sockets[event.sock].in_flight -= 1;
+      s_socket_cb(event.sock, event.msg_type, &event.sent);
+    } else {
+      tstrSocketConnectMsg msg = {.sock = event.sock, .s8Error = event.error};
+      s_socket_cb(event.sock, event.msg_type, &msg);
+    }
+    return true;
+  }
+  if (s_peer >= 0 && s_sockets[s_peer].open && fake_socket_request_done()) {
+    return fake_socket_peer_send(&s_sockets[s_peer]);
+  }
+  return false;
+}
+
+const uint8_t *fake_socket_sent(size_t *len) {
+  *len = s_sent_len;
+  return s_sent;
+}
+
+int fake_socket_max_in_flight(void) { return s_max_in_flight; }
+
+// socket.h
+
+void socketInit(void) {}
+
+SOCKET socket(uint16_t u16Domain, uint8_t u8Type, uint8_t u8Config) {
+  (void)u16Domain;
+  (void)u8Type;
+  (void)u8Config;
+  for (SOCKET i = 0; i < FAKE_SOCKET_MAX; i++) {
+    if (!s_sockets[i].open) {
+      memset(&s_sockets[i], 0, sizeof(s_sockets[i]));
+      s_sockets[i].open = true;
+      return i;
+    }
+  }
+  return SOCK_ERR_MAX_TCP_SOCK;
+}
+
+int8_t connect(SOCKET sock, struct sockaddr *pstrAddr, uint8_t u8AddrLen) {
+  (void)pstrAddr;
+  (void)u8AddrLen;
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || !s_sockets[sock].open) {
+    return SOCK_ERR_INVALID_ARG;
+  }
+  s_peer = sock;
+  s_response_pos = 0;
+  s_peer_closed = false;
+  s_sent_len = 0;
+  fake_socket_queue(&(fake_event_t){.sock = sock,
+                                    .msg_type = SOCKET_MSG_CONNECT,
+                                    .error = s_connect_error});
+  s_connect_error = 0;
+  return SOCK_ERR_NO_ERROR;
+}
+
+int8_t secure(SOCKET sock) {
+  fake_socket_queue(
+      &(fake_event_t){.sock = sock, .msg_type = SOCKET_MSG_SECURE});
+  return SOCK_ERR_NO_ERROR;
+}
+
+int16_t recv(SOCKET sock,
+             void *pvRecvBuf,
+             uint16_t u16BufLen,
+             uint32_t u32Timeoutmsec) {
+  (void)u32Timeoutmsec;
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || !s_sockets[sock].open ||
+      s_sockets[sock].ring != NULL || u16BufLen == 0) {
+    return SOCK_ERR_INVALID_ARG;
+  }
+  s_sockets[sock].recv_buf = pvRecvBuf;
+  s_sockets[sock].recv_size = u16BufLen;
+  return SOCK_ERR_NO_ERROR;
+}
+
+int16_t send(SOCKET sock,
+             void *pvSendBuffer,
+             uint16_t u16SendLength,
+             uint16_t u16Flags) {
+  (void)u16Flags;
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || !s_sockets[sock].open ||
+      u16SendLength > SOCKET_BUFFER_MAX_LENGTH) {
+    return SOCK_ERR_INVALID_ARG;
+  }
+  fake_socket_t *s = &s_sockets[sock];
+  if (s->in_flight >= FAKE_SOCKET_SEND_SLOTS) {
+    return SOCK_ERR_BUFFER_FULL;
+  }
+  if (sock == s_peer) {
+    if (s_sent_len + u16SendLength > s_sent_size) {
+      s_sent_size = 2 * (s_sent_len + u16SendLength);
+      s_sent = realloc(s_sent, s_sent_size);
+    }
+    memcpy(&s_sent[s_sent_len], pvSendBuffer, u16SendLength);
+    s_sent_len += u16SendLength;
+  }
+  s->in_flight += 1;
+  if (s->in_flight > s_max_in_flight) {
+    s_max_in_flight = s->in_flight;
+  }
+  fake_socket_queue(&(fake_event_t){
+      .sock = sock, .msg_type = SOCKET_MSG_SEND, .sent = u16SendLength});
+  return SOCK_ERR_NO_ERROR;
+}
+
+int8_t shutdown(SOCKET sock) {
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || !s_sockets[sock].open) {
+    return SOCK_ERR_INVALID_ARG;
+  }
+  s_sockets[sock].open = false;
+  return SOCK_ERR_NO_ERROR;
+}
+
+int8_t gethostbyname(const char *pcHostName) {
+  snprintf(s_dns_name, sizeof(s_dns_name), "%s", pcHostName);
+  fake_socket_queue(&(fake_event_t){.resolver = true});
+  return SOCK_ERR_NO_ERROR;
+}
+
+int8_t setsockopt(SOCKET socket,
+                  uint8_t u8Level,
+                  uint8_t option_name,
+                  const void *option_value,
+                  uint16_t u16OptionLen) {
+  (void)socket;
+  (void)u8Level;
+  (void)option_name;
+  (void)option_value;
+  (void)u16OptionLen;
+  return SOCK_ERR_NO_ERROR;
+}
+
+int16_t recv_ring_attach(SOCKET sock,
+                         uint8_t *pu8Buf,
+                         uint16_t u16Size,
+                         uint16_t u16Fill,
+                         uint32_t u32Timeoutmsec) {
+  (void)u32Timeoutmsec;
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || !s_sockets[sock].open ||
+      s_sockets[sock].recv_buf != NULL || u16Fill > u16Size) {
+    return SOCK_ERR_INVALID_ARG;
+  }
+  fake_socket_t *s = &s_sockets[sock];
+  s->ring = pu8Buf;
+  s->ring_size = u16Size;
+  s->ring_start = 0;
+  s->ring_fill = u16Fill;
+  s->ring_full = false;
+  memset(&s->ring_stats, 0, sizeof(s->ring_stats));
+  s->ring_stats.u16MaxFill = u16Fill;
+  return SOCK_ERR_NO_ERROR;
+}
+
+uint16_t recv_ring_peek(SOCKET sock, uint8_t **ppu8Data) {
+  fake_socket_t *s = &s_sockets[sock];
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || s->ring == NULL ||
+      s->ring_fill == 0) {
+    return 0;
+  }
+  *ppu8Data = &s->ring[s->ring_start];
+  uint16_t to_end = s->ring_size - s->ring_start;
+  return (s->ring_fill < to_end) ? s->ring_fill : to_end;
+}
+
+int16_t recv_ring_consume(SOCKET sock, uint16_t u16Len) {
+  fake_socket_t *s = &s_sockets[sock];
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || s->ring == NULL ||
+      u16Len > s->ring_fill) {
+    return SOCK_ERR_INVALID_ARG;
+  }
+  s->ring_start = (s->ring_start + u16Len) % s->ring_size;
+  s->ring_fill -= u16Len;
+  s->ring_full = false;
+  return SOCK_ERR_NO_ERROR;
+}
+
+int8_t recv_ring_get_stats(SOCKET sock, tstrSocketRingStats *pstrStats) {
+  if (sock < 0 || sock >= FAKE_SOCKET_MAX || s_sockets[sock].ring == NULL) {
+    return SOCK_ERR_INVALID_ARG;
+  }
+  *pstrStats = s_sockets[sock].ring_stats;
+  return SOCK_ERR_NO_ERROR;
+}
+
+// wdrv_winc_socket.h, wdrv_winc_ssl.h
+
+WDRV_WINC_STATUS WDRV_WINC_SocketRegisterEventCallback(
+    DRV_HANDLE handle, tpfAppSocketCb pfAppSocketCb) {
+  (void)handle;
+  s_socket_cb = pfAppSocketCb;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_SocketRegisterResolverCallback(
+    DRV_HANDLE handle, tpfAppResolveCb pfAppResolveCb) {
+  (void)handle;
+  s_resolver_cb = pfAppResolveCb;
+  return WDRV_WINC_STATUS_OK;
+}
+
+bool WDRV_WINC_IPLinkActive(DRV_HANDLE handle) {
+  (void)handle;
+  return s_link_active;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_SSLCTXCipherSuitesSet(
+    WDRV_WINC_CIPHER_SUITE_CONTEXT *pSSLCipherSuiteCtx,
+    uint16_t *pCipherSuiteList,
+    uint8_t numCipherSuites) {
+  (void)pSSLCipherSuiteCtx;
+  (void)pCipherSuiteList;
+  (void)numCipherSuites;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_SSLActiveCipherSuitesSet(
+    DRV_HANDLE handle,
+    WDRV_WINC_CIPHER_SUITE_CONTEXT *pSSLCipherSuiteCtx,
+    WDRV_WINC_SSL_CIPHERSUITELIST_CALLBACK pfSSLListCallback) {
+  (void)handle;
+  (void)pSSLCipherSuiteCtx;
+  (void)pfSSLListCallback;
+  return WDRV_WINC_STATUS_OK;
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void fake_socket_queue(fake_event_t *event) {
+  CHECK(s_event_count < FAKE_SOCKET_MAX_EVENTS);
+  // Events are delivered in order, so a slow send holds up those after it.
+  event->due = yb_rtc_now();
+  if (event->msg_type == SOCKET_MSG_SEND && !event->resolver) {
+    event->due += s_send_ms;
+  }
+  s_events[(s_event_head + s_event_count) % FAKE_SOCKET_MAX_EVENTS] = *event;
+  s_event_count += 1;
+}
+
+static bool fake_socket_peer_send(fake_socket_t *s) {
+  static tstrSocketRecvMsg msg;
+  uint8_t *dst = NULL;
+  uint16_t space = 0;
+
+  if (s->ring != NULL) {
+    uint16_t end = (s->ring_start + s->ring_fill) % s->ring_size;
+    if (s->ring_fill == s->ring_size) {
+      space = 0;
+    } else if (end >= s->ring_start) {
+      space = s->ring_size - end;
+    } else {
+      space = s->ring_start - end;
+    }
+    dst = &s->ring[end];
+  } else if (s->recv_buf != NULL) {
+    dst = s->recv_buf;
+    space = s->recv_size;
+  }
+  if (space == 0) {
+    if (s->ring != NULL && !s->ring_full && s_response_pos < s_response_len) {
+      // data is waiting and the application has not made room for it
+      s->ring_full = true;
+      s->ring_stats.u32Stalls += 1;
+    }
+    return false;
+  }
+
+  size_t n = s_response_len - s_response_pos;
+  if (n == 0) {
+    if (s_keep_open || s_peer_closed) {
+      return false;
+    }
+    s_peer_closed = true;
+    s->recv_buf = NULL;
+    msg = (tstrSocketRecvMsg){.pu8Buffer = dst,
+                              .s16BufferSize = SOCK_ERR_CONN_ABORTED};
+    s_socket_cb(s_peer, SOCKET_MSG_RECV, &msg);
+    return true;
+  }
+  if (n > s_segment) {
+    n = s_segment;
+  }
+  if (n > space) {
+    n = space;
+  }
+  memcpy(dst, &s_response[s_response_pos], n);
+  s_response_pos += n;
+  if (s->ring != NULL) {
+    s->ring_fill += n;
+    s->ring_stats.u32Bytes += n;
+    s->ring_stats.u32Posts += 1;
+    if (s->ring_fill > s->ring_stats.u16MaxFill) {
+      s->ring_stats.u16MaxFill = s->ring_fill;
+    }
+  } else {
+    // The application reposts from the callback if it wants more.
+    s->recv_buf = NULL;
+  }
+  msg = (tstrSocketRecvMsg){.pu8Buffer = dst, .s16BufferSize = (int16_t)n};
+  s_socket_cb(s_peer, SOCKET_MSG_RECV, &msg);
+  return true;
+}
+
+static bool fake_socket_request_done(void) {
+  if (s_respond_after > 0) {
+    return s_sent_len >= s_respond_after;
+  }
+  for (size_t i = 3; i < s_sent_len; i++) {
+    if (memcmp(&s_sent[i - 3], "\r\n\r\n", 4) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
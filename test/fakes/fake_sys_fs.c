@@ -0,0 +1,213 @@
+/**
+ * @file fake_sys_fs.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief File-backed stand-in for the SYS_FS calls the app makes.
+ *
+ * Paths are taken relative to a directory on the host, so "/yb/config.txt" on
+ * the SD card is <root>/yb/config.txt.  SYS_FS_HANDLE is a FILE pointer.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "definitions.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define FAKE_FS_MAX_PATH 256
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Return the host path of a file system path, in a static buffer.
+ */
+static const char *fake_fs_path(const char *fname);
+
+/**
+ * @brief Record the SYS_FS_ERROR for the last failed call, from errno.
+ */
+static void fake_fs_failed(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static char s_root[FAKE_FS_MAX_PATH] = ".";
+
+static SYS_FS_ERROR s_error;
+
+static long s_write_limit = -1;
+
+// *****************************************************************************
+// Public code
+
+void fake_fs_set_root(const char *dir) {
+  snprintf(s_root, sizeof(s_root), "%s", dir);
+  s_write_limit = -1;
+}
+
+void fake_fs_put(const char *path, const void *data, size_t len) {
+  FILE *f = fopen(fake_fs_path(path), "wb");
+  CHECK(f != NULL);
+  if (f != NULL) {
+    CHECK(fwrite(data, 1, len, f) == len);
+    fclose(f);
+  }
+}
+
+long fake_fs_get(const char *path, void *data, size_t size) {
+  FILE *f = fopen(fake_fs_path(path), "rb");
+  long len;
+  if (f == NULL) {
+    return -1;
+  }
+  fseek(f, 0, SEEK_END);
+  len = ftell(f);
+  rewind(f);
+  (void)!fread(data, 1, size, f);
+  fclose(f);
+  return len;
+}
+
+void fake_fs_set_write_limit(long nbytes) { s_write_limit = nbytes; }
+
+// sys_fs.h
+
+SYS_FS_RESULT SYS_FS_CurrentDriveSet(const char *path) {
+  // Paths are relative to the root whatever the drive.
+  (void)path;
+  return SYS_FS_RES_SUCCESS;
+}
+
+SYS_FS_HANDLE SYS_FS_FileOpen(const char *fname,
+                              SYS_FS_FILE_OPEN_ATTRIBUTES attributes) {
+  static const char *modes[] = {
+      [SYS_FS_FILE_OPEN_READ] = "rb",
+      [SYS_FS_FILE_OPEN_WRITE] = "wb",
+      [SYS_FS_FILE_OPEN_APPEND] = "ab",
+      [SYS_FS_FILE_OPEN_READ_PLUS] = "r+b",
+      [SYS_FS_FILE_OPEN_WRITE_PLUS] = "w+b",
+      [SYS_FS_FILE_OPEN_APPEND_PLUS] = "a+b",
+  };
+  FILE *f = fopen(fake_fs_path(fname), modes[attributes]);
+  if (f == NULL) {
+    fake_fs_failed();
+    return SYS_FS_HANDLE_INVALID;
+  }
+  return (SYS_FS_HANDLE)f;
+}
+
+SYS_FS_RESULT SYS_FS_FileClose(SYS_FS_HANDLE handle) {
+  return fclose((FILE *)handle) == 0 ? SYS_FS_RES_SUCCESS : SYS_FS_RES_FAILURE;
+}
+
+size_t SYS_FS_FileRead(SYS_FS_HANDLE handle, void *buf, size_t nbyte) {
+  size_t n = fread(buf, 1, nbyte, (FILE *)handle);
+  if (n < nbyte && ferror((FILE *)handle)) {
+    fake_fs_failed();
+    return (size_t)-1;
+  }
+  return n;
+}
+
+bool SYS_FS_FileEOF(SYS_FS_HANDLE handle) {
+  // Unlike feof(), true as soon as the last byte has been read.
+  int c = getc((FILE *)handle);
+  if (c == EOF) {
+    return true;
+  }
+  ungetc(c, (FILE *)handle);
+  return false;
+}
+
+size_t SYS_FS_FileWrite(SYS_FS_HANDLE handle, const void *buf, size_t nbyte) {
+  if (s_write_limit >= 0 && nbyte > (size_t)s_write_limit) {
+    // the card is full
+    nbyte = s_write_limit;
+    s_error = SYS_FS_ERROR_DENIED;
+  }
+  if (s_write_limit >= 0) {
+    s_write_limit -= nbyte;
+  }
+  return fwrite(buf, 1, nbyte, (FILE *)handle);
+}
+
+SYS_FS_RESULT SYS_FS_FileStat(const char *fname, SYS_FS_FSTAT *buf) {
+  struct stat st;
+  if (stat(fake_fs_path(fname), &st) != 0) {
+    fake_fs_failed();
+    return SYS_FS_RES_FAILURE;
+  }
+  memset(buf, 0, sizeof(*buf));
+  buf->fsize = st.st_size;
+  return SYS_FS_RES_SUCCESS;
+}
+
+SYS_FS_RESULT SYS_FS_FileDirectoryRemove(const char *path) {
+  if (remove(fake_fs_path(path)) != 0) {
+    fake_fs_failed();
+    return SYS_FS_RES_FAILURE;
+  }
+  return SYS_FS_RES_SUCCESS;
+}
+
+SYS_FS_RESULT SYS_FS_FileDirectoryRenameMove(const char *oldPath,
+                                             const char *newPath) {
+  char from[FAKE_FS_MAX_PATH];
+  snprintf(from, sizeof(from), "%s", fake_fs_path(oldPath));
+  // FAT, unlike POSIX, will not rename over an existing file.
+  struct stat st;
+  if (stat(fake_fs_path(newPath), &st) == 0) {
+    s_error = SYS_FS_ERROR_EXIST;
+    return SYS_FS_RES_FAILURE;
+  }
+  if (rename(from, fake_fs_path(newPath)) != 0) {
+    fake_fs_failed();
+    return SYS_FS_RES_FAILURE;
+  }
+  return SYS_FS_RES_SUCCESS;
+}
+
+SYS_FS_ERROR SYS_FS_Error(void) { return s_error; }
+
+// *****************************************************************************
+// Local (private, static) code
+
+static const char *fake_fs_path(const char *fname) {
+  static char path[FAKE_FS_MAX_PATH];
+  snprintf(path, sizeof(path), "%s/%s", s_root, fname);
+  return path;
+}
+
+static void fake_fs_failed(void) {
+  s_error = (errno == ENOENT) ? SYS_FS_ERROR_NO_FILE : SYS_FS_ERROR_DENIED;
+}
@@ -0,0 +1,263 @@
+/**
+ * @file fake_winc.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Stand-in for the WINC driver's connection, power and statistics
+ * calls.  The SPI transport, wdrv_winc_spi.c, and the CRC module, nmcrc.c,
+ * are real: see fake_drv_spi.c and fake_dmac.c.
+ *
+ * Every request succeeds at once.  The events that the WINC would answer with
+ * later, the BSS connection notifications and the DHCP address, are delivered
+ * by the test through fake_winc_notify() and fake_winc_dhcp().  The IP link
+ * reported by WDRV_WINC_IPLinkActive() follows them.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "definitions.h"
+#include "m2m_hif.h"
+#include "m2m_wifi.h"
+#include "nmdrv.h"
+#include "nmspi.h"
+#include "wdrv_winc_client_api.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+// *****************************************************************************
+// Public storage
+
+// From wdrv_winc.c.  No debug output.
+WDRV_WINC_DEBUG_PRINT_CALLBACK pfWINCDebugPrintCb;
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static WDRV_WINC_BSSCON_NOTIFY_CALLBACK s_notify_cb;
+
+static WDRV_WINC_DHCP_ADDRESS_EVENT_HANDLER s_dhcp_cb;
+
+static int s_connects;
+
+static int s_disconnects;
+
+// *****************************************************************************
+// Public code
+
+void fake_winc_reset(void) {
+  s_notify_cb = NULL;
+  s_dhcp_cb = NULL;
+  s_connects = 0;
+  s_disconnects = 0;
+  fake_socket_set_link(false);
+}
+
+void fake_winc_notify(int state, int error) {
+  if (state != WDRV_WINC_CONN_STATE_CONNECTED) {
+    fake_socket_set_link(false);
+  }
+  if (s_notify_cb != NULL) {
+    s_notify_cb(1, 1, (WDRV_WINC_CONN_STATE)state, (WDRV_WINC_CONN_ERROR)error);
+  }
+}
+
+void fake_winc_dhcp(uint32_t address) {
+  fake_socket_set_link(true);
+  if (s_dhcp_cb != NULL) {
+    s_dhcp_cb(1, address);
+  }
+}
+
+int fake_winc_connects(void) { return s_connects; }
+
+int fake_winc_disconnects(void) { return s_disconnects; }
+
+// wdrv_winc_client_api.h
+
+DRV_HANDLE WDRV_WINC_Open(const SYS_MODULE_INDEX index,
+                          const DRV_IO_INTENT intent) {
+  (void)index;
+  (void)intent;
+  return 1;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_BSSCtxSetDefaults(
+    WDRV_WINC_BSS_CONTEXT *const pBSSCtx) {
+  memset(pBSSCtx, 0, sizeof(*pBSSCtx));
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_BSSCtxSetSSID(WDRV_WINC_BSS_CONTEXT *const pBSSCtx,
+                                         uint8_t *const pSSID,
+                                         uint8_t ssidLength) {
+  (void)pBSSCtx;
+  (void)pSSID;
+  (void)ssidLength;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_AuthCtxSetWPA(WDRV_WINC_AUTH_CONTEXT *const pAuthCtx,
+                                         uint8_t *const pPSK,
+                                         uint8_t size) {
+  (void)pAuthCtx;
+  (void)pPSK;
+  (void)size;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS
+WDRV_WINC_BSSConnect(DRV_HANDLE handle,
+                     const WDRV_WINC_BSS_CONTEXT *const pBSSCtx,
+                     const WDRV_WINC_AUTH_CONTEXT *const pAuthCtx,
+                     const WDRV_WINC_BSSCON_NOTIFY_CALLBACK pfNotifyCallback) {
+  (void)handle;
+  (void)pBSSCtx;
+  (void)pAuthCtx;
+  s_notify_cb = pfNotifyCallback;
+  s_connects += 1;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS
+WDRV_WINC_BSSResume(DRV_HANDLE handle,
+                    uint32_t ipAddress,
+                    uint32_t gatewayAddress,
+                    WDRV_WINC_BSSCON_NOTIFY_CALLBACK pfNotifyCallback) {
+  (void)handle;
+  (void)ipAddress;
+  (void)gatewayAddress;
+  s_notify_cb = pfNotifyCallback;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS
+WDRV_WINC_BSSFindFirst(DRV_HANDLE handle,
+                       WDRV_WINC_CHANNEL_ID channel,
+                       bool active,
+                       const WDRV_WINC_SSID_LIST *const pSSIDList,
+                       const WDRV_WINC_BSSFIND_NOTIFY_CALLBACK
+                           pfNotifyCallback) {
+  // No scan results: profiles are ranked on their past success alone.
+  (void)handle;
+  (void)channel;
+  (void)active;
+  (void)pSSIDList;
+  (void)pfNotifyCallback;
+  return WDRV_WINC_STATUS_REQUEST_ERROR;
+}
+
+WDRV_WINC_STATUS
+WDRV_WINC_AssocSSIDGet(WDRV_WINC_ASSOC_HANDLE assocHandle,
+                       WDRV_WINC_SSID *const pSSID,
+                       WDRV_WINC_ASSOC_CALLBACK const pfAssociationInfoCB) {
+  (void)assocHandle;
+  (void)pfAssociationInfoCB;
+  pSSID->length = 0;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_IPUseDHCPSet(
+    DRV_HANDLE handle,
+    const WDRV_WINC_DHCP_ADDRESS_EVENT_HANDLER pfDHCPAddressEventCallback) {
+  (void)handle;
+  s_dhcp_cb = pfDHCPAddressEventCallback;
+  return WDRV_WINC_STATUS_OK;
+}
+
+uint32_t WDRV_WINC_IPDefaultGatewayGet(DRV_HANDLE handle) {
+  (void)handle;
+  return 0;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_PowerSaveSetMode(DRV_HANDLE handle,
+                                            WDRV_WINC_PS_MODE mode) {
+  (void)handle;
+  (void)mode;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_SystemTimeSNTPClientEnable(DRV_HANDLE handle,
+                                                      const char *pServerName,
+                                                      bool allowDHCPOverride) {
+  (void)handle;
+  (void)pServerName;
+  (void)allowDHCPOverride;
+  return WDRV_WINC_STATUS_OK;
+}
+
+WDRV_WINC_STATUS WDRV_WINC_SystemTimeGetCurrent(
+    DRV_HANDLE handle,
+    const WDRV_WINC_SYSTIME_CURRENT_CALLBACK pfGetCurrentCallback) {
+  // The WINC never answers: the RTC sync times out.
+  (void)handle;
+  (void)pfGetCurrentCallback;
+  return WDRV_WINC_STATUS_OK;
+}
+
+// m2m_wifi.h
+
+int8_t m2m_wifi_deinit(void *arg) {
+  (void)arg;
+  return M2M_SUCCESS;
+}
+
+int8_t m2m_wifi_disconnect(void) {
+  s_disconnects += 1;
+  return M2M_SUCCESS;
+}
+
+int8_t m2m_wifi_get_connection_info(void) { return M2M_SUCCESS; }
+
+int8_t m2m_wifi_get_firmware_version(tstrM2mRev *pstrRev) {
+  memset(pstrRev, 0, sizeof(*pstrRev));
+  return M2M_SUCCESS;
+}
+
+int8_t m2m_wifi_set_power_profile(uint8_t u8PwrMode) {
+  (void)u8PwrMode;
+  return M2M_SUCCESS;
+}
+
+int8_t m2m_wifi_set_tx_power(uint8_t u8TxPwrLevel) {
+  (void)u8TxPwrLevel;
+  return M2M_SUCCESS;
+}
+
+// m2m_hif.h, nmdrv.h and nmspi.h
+
+void hif_get_stats(tstrHifStats *pstrStats) {
+  memset(pstrStats, 0, sizeof(*pstrStats));
+}
+
+uint8_t nm_drv_resumed(void) { return 0; }
+
+void nm_drv_set_resume(uint8_t u8Resume) { (void)u8Resume; }
+
+int8_t nm_spi_set_crc(uint8_t u8Enable) {
+  (void)u8Enable;
+  return M2M_SUCCESS;
+}
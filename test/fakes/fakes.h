@@ -0,0 +1,251 @@
+/**
+ * @file fakes.h
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Host stand-ins for the hardware and WINC driver, with the hooks a test
+ * uses to drive them.
+ *
+ * The modules under test are built unchanged from src/ and linked against
+ * these in place of the RTC, backup RAM, SD card file system and WINC driver.
+ * Time only passes when a test advances it.
+ */
+
+#ifndef _FAKES_H_
+#define _FAKES_H_
+
+// *****************************************************************************
+// Includes
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// *****************************************************************************
+// Public types and definitions
+
+/**
+ * @brief Fail the test, but carry on, if cond is false.
+ */
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      fake_check_failed(__FILE__, __LINE__, #cond);                            \
+    }                                                                          \
+  } while (0)
+
+// *****************************************************************************
+// Public declarations
+
+/**
+ * @brief Record a failed CHECK().
+ */
+void fake_check_failed(const char *file, int line, const char *cond);
+
+/**
+ * @brief Print a summary and return the process exit status: 0 if every
+ * CHECK() passed.
+ */
+int fake_check_summary(const char *test_name);
+
+/**
+ * @brief Clear nv_data, set the clock to zero and set the log level: TRACE if
+ * the environment variable V is set, otherwise FATAL.
+ */
+void fake_reset(void);
+
+/**
+ * @brief Advance the RTC.  One RTC count is one millisecond.
+ */
+void fake_rtc_advance_ms(uint32_t ms);
+
+/**
+ * @brief Make file system paths relative to dir, which must exist.
+ */
+void fake_fs_set_root(const char *dir);
+
+/**
+ * @brief Write len bytes to a file under the file system root.
+ */
+void fake_fs_put(const char *path, const void *data, size_t len);
+
+/**
+ * @brief Read up to size bytes of a file under the file system root.
+ *
+ * @return The length of the file, or -1 if it does not exist.
+ */
+long fake_fs_get(const char *path, void *data, size_t size);
+
+/**
+ * @brief Make the next SYS_FS_FileWrite() calls write at most this many bytes
+ * in total, as a full card would.  -1 removes the limit.
+ */
+void fake_fs_set_write_limit(long nbytes);
+
+/**
+ * @brief Forget every socket and queued event, and restore the defaults: the
+ * IP link is up, DNS answers 10.0.0.1, connects succeed, sends complete at
+ * once and the peer sends no more than SOCKET_BUFFER_MAX_LENGTH bytes per
+ * SOCKET_MSG_RECV.
+ */
+void fake_socket_reset(void);
+
+/**
+ * @brief Set the response the peer sends once the request is complete, after
+ * which it closes the connection.  data must remain valid.
+ */
+void fake_socket_set_response(const void *data, size_t len);
+
+/**
+ * @brief The peer answers once the device has sent this many bytes, rather
+ * than at the end of the request headers.
+ */
+void fake_socket_respond_after(size_t nbytes);
+
+/**
+ * @brief The peer sends at most this many bytes per SOCKET_MSG_RECV.
+ */
+void fake_socket_set_segment(uint16_t nbytes);
+
+/**
+ * @brief The peer keeps the connection open after the response.
+ */
+void fake_socket_set_keep_open(bool keep_open);
+
+/**
+ * @brief Set the s8Error of the next SOCKET_MSG_CONNECT.
+ */
+void fake_socket_set_connect_error(int8_t error);
+
+/**
+ * @brief Set whether WDRV_WINC_IPLinkActive() reports the link up.
+ */
+void fake_socket_set_link(bool active);
+
+/**
+ * @brief Make each send() take this long to complete, as the radio would.
+ */
+void fake_socket_set_send_ms(uint32_t ms);
+
+/**
+ * @brief Deliver the next queued socket or resolver event that is due, or,
+ * failing that, the next segment of the response into a posted recv().
+ *
+ * @return false if there was nothing to deliver.
+ */
+bool fake_socket_poll(void);
+
+/**
+ * @brief Return the bytes the device has sent, and their number in *len.
+ */
+const uint8_t *fake_socket_sent(size_t *len);
+
+/**
+ * @brief Return the most send() calls that were awaiting SOCKET_MSG_SEND at
+ * once.
+ */
+int fake_socket_max_in_flight(void);
+
+/**
+ * @brief Forget the registered WINC callbacks and the counts below, and take
+ * the IP link down.
+ */
+void fake_winc_reset(void);
+
+/**
+ * @brief Deliver a BSS connection event, as a WDRV_WINC_CONN_STATE and
+ * WDRV_WINC_CONN_ERROR, to the callback given to WDRV_WINC_BSSConnect().
+ * Any state but CONNECTED takes the IP link down.
+ */
+void fake_winc_notify(int state, int error);
+
+/**
+ * @brief Deliver a DHCP address to the callback given to
+ * WDRV_WINC_IPUseDHCPSet(), and bring the IP link up.
+ */
+void fake_winc_dhcp(uint32_t address);
+
+/**
+ * @brief Return the number of WDRV_WINC_BSSConnect() calls.
+ */
+int fake_winc_connects(void);
+
+/**
+ * @brief Return the number of m2m_wifi_disconnect() calls.
+ */
+int fake_winc_disconnects(void);
+
+/**
+ * @brief Forget every queued transfer and the bytes on the wire, and restore
+ * the defaults: transfers succeed and reads answer zeros.
+ */
+void fake_spi_reset(void);
+
+/**
+ * @brief Set the bytes the WINC sends back, in order, across the next reads.
+ * data must remain valid.
+ */
+void fake_spi_set_miso(const void *data, size_t len);
+
+/**
+ * @brief Make the next SPI transfer queued complete with
+ * DRV_SPI_TRANSFER_EVENT_ERROR.
+ */
+void fake_spi_fail_next(void);
+
+/**
+ * @brief Complete the oldest queued SPI transfer, as the DMA would.
+ *
+ * @return false if none was queued.
+ */
+bool fake_spi_complete(void);
+
+/**
+ * @brief Return the number of SPI transfers queued and not yet complete.
+ */
+int fake_spi_in_flight(void);
+
+/**
+ * @brief Return the most SPI transfers that were queued at once.
+ */
+int fake_spi_max_in_flight(void);
+
+/**
+ * @brief Return the number of SPI writes whose buffer changed between being
+ * queued and being clocked out.
+ */
+int fake_spi_clobbered(void);
+
+/**
+ * @brief Return the number of SPI transfers DRV_SPI refused.
+ */
+int fake_spi_refused(void);
+
+/**
+ * @brief Return the bytes written to the WINC, in the order they were clocked
+ * out, and their number in *len.
+ */
+const uint8_t *fake_spi_wire(size_t *len);
+
+#endif /* #ifndef _FAKES_H_ */
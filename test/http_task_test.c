@@ -0,0 +1,296 @@
+/**
+ * @file http_task_test.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Host test of http_task's streaming to and from SD card files.
+ *
+ * Drives http_task against a scripted peer (fakes/fake_socket.c) and a
+ * file-backed SYS_FS (fakes/fake_sys_fs.c) in a scratch directory: downloads
+ * must replace the destination only once verified, and uploads must send the
+ * whole file through the send window.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "http_task.h"
+#include "mu_strbuf.h"
+#include "nv_data.h"
+#include "yb_hmac.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define BODY_SIZE 10000
+
+// Steps to allow for one exchange: enough to sit out the idle timeouts.
+#define MAX_STEPS 20000
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Set up http_task for one exchange with the peer.
+ */
+static void start(const char *request);
+
+/**
+ * @brief Step http_task and the peer, a millisecond at a time, until it
+ * finishes.  Returns true if it succeeded.
+ */
+static bool run(void);
+
+/**
+ * @brief Make a response: the status line, a Content-Length header (unless
+ * content_length < 0), then body_len bytes of s_body.
+ */
+static void respond(const char *status, long content_length, size_t body_len);
+
+/**
+ * @brief Return true if path holds exactly len bytes of data.
+ */
+static bool file_is(const char *path, const void *data, size_t len);
+
+static void test_download(void);
+static void test_download_small_segments(void);
+static void test_download_no_length(void);
+static void test_download_bad_hash(void);
+static void test_download_short(void);
+static void test_download_refused(void);
+static void test_download_card_full(void);
+static void test_upload(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static uint8_t s_body[BODY_SIZE];
+
+static uint8_t s_body_hash[YB_SHA256_DIGEST_SIZE];
+
+static uint8_t s_response[BODY_SIZE + 128];
+
+static uint8_t s_response_buf[1460];
+
+static mu_strbuf_t s_request_msg;
+
+static mu_strbuf_t s_response_msg;
+
+static const char s_old[] = "old contents\n";
+
+static const char s_get[] = "GET /yb/file HTTP/1.1\r\nHost: test\r\n\r\n";
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  yb_sha256_t sha;
+
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <scratch directory>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  fake_fs_set_root(argv[1]);
+  for (size_t i = 0; i < sizeof(s_body); i++) {
+    s_body[i] = (uint8_t)(i * 7 + i / 251);
+  }
+  yb_sha256_init(&sha);
+  yb_sha256_update(&sha, s_body, sizeof(s_body));
+  yb_sha256_final(&sha, s_body_hash);
+
+  test_download();
+  test_download_small_segments();
+  test_download_no_length();
+  test_download_bad_hash();
+  test_download_short();
+  test_download_refused();
+  test_download_card_full();
+  test_upload();
+  return fake_check_summary("http_task_test");
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void start(const char *request) {
+  fake_reset();
+  fake_socket_reset();
+  mu_strbuf_init_from_cstr(&s_request_msg, request);
+  mu_strbuf_init_rw(&s_response_msg, s_response_buf, sizeof(s_response_buf));
+  http_task_init(
+      0, "test", "10.0.0.2", 80, false, 0, &s_request_msg, &s_response_msg);
+}
+
+static bool run(void) {
+  for (int i = 0; i < MAX_STEPS; i++) {
+    if (http_task_succeeded() || http_task_failed()) {
+      break;
+    }
+    http_task_step();
+    fake_socket_poll();
+    fake_rtc_advance_ms(1);
+  }
+  http_task_shutdown();
+  return http_task_succeeded();
+}
+
+static void respond(const char *status, long content_length, size_t body_len) {
+  int n = snprintf((char *)s_response, sizeof(s_response), "%s\r\n", status);
+  if (content_length >= 0) {
+    n += snprintf((char *)s_response + n,
+                  sizeof(s_response) - n,
+                  "Content-Length: %ld\r\n",
+                  content_length);
+  }
+  n += snprintf((char *)s_response + n, sizeof(s_response) - n, "\r\n");
+  memcpy(s_response + n, s_body, body_len);
+  fake_socket_set_response(s_response, n + body_len);
+}
+
+static bool file_is(const char *path, const void *data, size_t len) {
+  static uint8_t contents[BODY_SIZE + 1];
+  return fake_fs_get(path, contents, sizeof(contents)) == (long)len &&
+         memcmp(contents, data, len) == 0;
+}
+
+static void test_download(void) {
+  fake_fs_put("dl.bin", s_old, sizeof(s_old));
+  start(s_get);
+  http_task_set_sink("dl.bin", 0, s_body_hash, 8);
+  respond("HTTP/1.1 200 OK", BODY_SIZE, BODY_SIZE);
+  CHECK(run());
+  CHECK(file_is("dl.bin", s_body, BODY_SIZE));
+  CHECK(fake_fs_get("dl.bin.part", NULL, 0) < 0);
+  CHECK(http_task_get_sink()->verified);
+  CHECK(http_task_get_sink()->body_bytes == BODY_SIZE);
+  // two whole blocks from the ring, then the rest
+  CHECK(http_task_get_sink()->block_writes >= 3);
+}
+
+static void test_download_small_segments(void) {
+  // Headers split across many recv()s, and a ring that fills up.
+  fake_fs_put("dl.bin", s_old, sizeof(s_old));
+  start(s_get);
+  http_task_set_sink("dl.bin", BODY_SIZE, NULL, 0);
+  respond("HTTP/1.0 200 OK", BODY_SIZE, BODY_SIZE);
+  fake_socket_set_segment(7);
+  CHECK(run());
+  CHECK(file_is("dl.bin", s_body, BODY_SIZE));
+}
+
+static void test_download_no_length(void) {
+  // No Content-Length and a server that holds the connection open: the body
+  // ends at the idle timeout and the configured length decides.
+  fake_fs_put("dl.bin", s_old, sizeof(s_old));
+  start(s_get);
+  http_task_set_sink("dl.bin", BODY_SIZE, s_body_hash, 16);
+  respond("HTTP/1.1 200 OK", -1, BODY_SIZE);
+  fake_socket_set_keep_open(true);
+  CHECK(run());
+  CHECK(file_is("dl.bin", s_body, BODY_SIZE));
+}
+
+static void test_download_bad_hash(void) {
+  uint8_t hash[8];
+
+  fake_fs_put("dl.bin", s_old, sizeof(s_old));
+  memcpy(hash, s_body_hash, sizeof(hash));
+  hash[7] ^= 1;
+  start(s_get);
+  http_task_set_sink("dl.bin", 0, hash, sizeof(hash));
+  respond("HTTP/1.1 200 OK", BODY_SIZE, BODY_SIZE);
+  CHECK(!run());
+  CHECK(file_is("dl.bin", s_old, sizeof(s_old)));
+  CHECK(fake_fs_get("dl.bin.part", NULL, 0) < 0);
+  CHECK(!http_task_get_sink()->verified);
+}
+
+static void test_download_short(void) {
+  // The server closes the connection part way through the body.
+  fake_fs_put("dl.bin", s_old, sizeof(s_old));
+  start(s_get);
+  http_task_set_sink("dl.bin", 0, NULL, 0);
+  respond("HTTP/1.1 200 OK", BODY_SIZE, BODY_SIZE - 1000);
+  CHECK(!run());
+  CHECK(file_is("dl.bin", s_old, sizeof(s_old)));
+  CHECK(fake_fs_get("dl.bin.part", NULL, 0) < 0);
+}
+
+static void test_download_refused(void) {
+  fake_fs_put("dl.bin", s_old, sizeof(s_old));
+  start(s_get);
+  http_task_set_sink("dl.bin", 0, NULL, 0);
+  respond("HTTP/1.1 404 Not Found", 0, 0);
+  CHECK(!run());
+  CHECK(file_is("dl.bin", s_old, sizeof(s_old)));
+  CHECK(fake_fs_get("dl.bin.part", NULL, 0) < 0);
+}
+
+static void test_download_card_full(void) {
+  fake_fs_put("dl.bin", s_old, sizeof(s_old));
+  start(s_get);
+  http_task_set_sink("dl.bin", 0, NULL, 0);
+  respond("HTTP/1.1 200 OK", BODY_SIZE, BODY_SIZE);
+  fake_fs_set_write_limit(HTTP_TASK_SINK_BLOCK_SIZE + 100);
+  CHECK(!run());
+  fake_fs_set_write_limit(-1);
+  CHECK(file_is("dl.bin", s_old, sizeof(s_old)));
+  CHECK(fake_fs_get("dl.bin.part", NULL, 0) < 0);
+}
+
+static void test_upload(void) {
+  static const char put[] =
+      "PUT /yb/log HTTP/1.1\r\nHost: test\r\nContent-Length: 10000\r\n\r\n";
+  const uint8_t *sent;
+  size_t sent_len;
+
+  fake_fs_put("log.txt", s_body, BODY_SIZE);
+  start(put);
+  http_task_set_source("log.txt");
+  // The server answers once it has the whole body.
+  fake_socket_respond_after(sizeof(put) - 1 + BODY_SIZE);
+  respond("HTTP/1.1 201 Created", 0, 0);
+  // Sending a chunk takes longer than reading one from the card.
+  fake_socket_set_send_ms(5);
+  CHECK(run());
+  sent = fake_socket_sent(&sent_len);
+  CHECK(sent_len == sizeof(put) - 1 + BODY_SIZE);
+  CHECK(memcmp(sent, put, sizeof(put) - 1) == 0);
+  CHECK(memcmp(sent + sizeof(put) - 1, s_body, BODY_SIZE) == 0);
+  CHECK(http_task_get_source()->body_bytes == BODY_SIZE);
+  // The request headers and the first chunks go out together...
+  CHECK(fake_socket_max_in_flight() > 1);
+  // ...but never more than the window.
+  CHECK(fake_socket_max_in_flight() <= HTTP_TASK_SOURCE_WINDOW);
+}
+
+// Not under test.
+
+void winc_task_set_idle(bool idle) { (void)idle; }
@@ -0,0 +1,209 @@
+/**
+ * @file nmcrc_bench.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Host benchmark of the WINC SPI CRCs: nmcrc.c's table-driven CRC7 and
+ * slice-by-4 CRC16 against the bit-at-a-time forms they stand in for.
+ *
+ * Both forms are first checked to agree, over every length up to 64 bytes,
+ * from odd addresses, across chained calls and over the whole buffer; then
+ * each is timed over the same buffer.  Host speeds are not the SAME54's, but
+ * their ratio is a guide.  The DMAC path can only be timed on the target, by
+ * nm_crc_init()'s self test.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "nmcrc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define BENCH_LEN (256 * 1024)
+
+// Passes over the buffer for each timing.
+#define BENCH_ROUNDS 16
+
+typedef uint8_t (*crc7_fn_t)(uint8_t crc, const uint8_t *b, uint32_t len);
+
+typedef uint16_t (*crc16_fn_t)(uint16_t crc, const uint8_t *b, uint32_t len);
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief CRC7 (x^7 + x^3 + 1) a bit at a time, as nm_crc7() continues it.
+ */
+static uint8_t crc7_bitwise(uint8_t crc, const uint8_t *b, uint32_t len);
+
+/**
+ * @brief CRC-16/CCITT (x^16 + x^12 + x^5 + 1) a bit at a time, MSB first.
+ */
+static uint16_t crc16_bitwise(uint16_t crc, const uint8_t *b, uint32_t len);
+
+/**
+ * @brief Return the seconds taken by rounds of CRC7 over the bench buffer.
+ */
+static double time_crc7(crc7_fn_t fn);
+
+/**
+ * @brief Return the seconds taken by rounds of CRC16 over the bench buffer.
+ */
+static double time_crc16(crc16_fn_t fn);
+
+/**
+ * @brief Print one line of results, in MB/s.
+ */
+static void report(const char *name, double bitwise_s, double table_s);
+
+static double now_s(void);
+
+static void check_agreement(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static uint8_t s_buf[BENCH_LEN + 1];
+
+// Results land here so that the timed loops are not optimised away.
+static volatile uint32_t s_sink;
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  tstrNmCrcStats stats;
+
+  (void)argc;
+  (void)argv;
+  for (size_t i = 0; i < sizeof(s_buf); i++) {
+    s_buf[i] = (uint8_t)(i * 37 + i / 253);
+  }
+
+  check_agreement();
+  nm_crc_init();
+  nm_crc_get_stats(&stats);
+  CHECK(stats.u8Tested && stats.u8HwAgrees);
+
+  printf("%d x %d KiB:\n", BENCH_ROUNDS, BENCH_LEN / 1024);
+  report("CRC7 ", time_crc7(crc7_bitwise), time_crc7(nm_crc7));
+  report("CRC16", time_crc16(crc16_bitwise), time_crc16(nm_crc16));
+  return fake_check_summary("nmcrc_bench");
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static uint8_t crc7_bitwise(uint8_t crc, const uint8_t *b, uint32_t len) {
+  while (len--) {
+    uint8_t data = *b++;
+    for (int bit = 7; bit >= 0; bit--) {
+      bool feedback = ((crc >> 6) ^ (data >> bit)) & 1;
+      crc = (crc << 1) & 0x7f;
+      if (feedback) {
+        crc ^= 0x09;
+      }
+    }
+  }
+  return crc;
+}
+
+static uint16_t crc16_bitwise(uint16_t crc, const uint8_t *b, uint32_t len) {
+  while (len--) {
+    crc ^= (uint16_t)(*b++ << 8);
+    for (int bit = 0; bit < 8; bit++) {
+      crc = (uint16_t)((crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1);
+    }
+  }
+  return crc;
+}
+
+static double time_crc7(crc7_fn_t fn) {
+  double start = now_s();
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    s_sink += fn(0x7f, s_buf, BENCH_LEN);
+  }
+  return now_s() - start;
+}
+
+static double time_crc16(crc16_fn_t fn) {
+  double start = now_s();
+  for (int i = 0; i < BENCH_ROUNDS; i++) {
+    s_sink += fn(0xffff, s_buf, BENCH_LEN);
+  }
+  return now_s() - start;
+}
+
+static void report(const char *name, double bitwise_s, double table_s) {
+  double mb = (double)BENCH_ROUNDS * BENCH_LEN / 1e6;
+  printf("  %s  bitwise %7.1f MB/s, table %7.1f MB/s: %.1f times faster\n",
+         name,
+         mb / bitwise_s,
+         mb / table_s,
+         bitwise_s / table_s);
+}
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void check_agreement(void) {
+  static const uint8_t check[] = "123456789";
+
+  // The catalogue check value of CRC-16/CCITT-FALSE.
+  CHECK(nm_crc16(0xffff, check, 9) == 0x29b1);
+  CHECK(crc16_bitwise(0xffff, check, 9) == 0x29b1);
+
+  for (uint32_t len = 0; len <= 64; len++) {
+    for (int offset = 0; offset < 4; offset++) {
+      const uint8_t *b = s_buf + offset;
+      CHECK(nm_crc7(0x7f, b, len) == crc7_bitwise(0x7f, b, len));
+      CHECK(nm_crc16(0xffff, b, len) == crc16_bitwise(0xffff, b, len));
+    }
+  }
+
+  // Long enough to reach every entry of every table.
+  CHECK(nm_crc7(0x7f, s_buf, BENCH_LEN) ==
+        crc7_bitwise(0x7f, s_buf, BENCH_LEN));
+  CHECK(nm_crc16(0xffff, s_buf + 1, BENCH_LEN) ==
+        crc16_bitwise(0xffff, s_buf + 1, BENCH_LEN));
+
+  // nmspi continues a CRC16 across the pieces of a packet.
+  for (uint32_t split = 0; split <= 37; split++) {
+    uint16_t crc = nm_crc16(0xffff, s_buf + 1, split);
+    CHECK(nm_crc16(crc, s_buf + 1 + split, 37 - split) ==
+          crc16_bitwise(0xffff, s_buf + 1, 37));
+  }
+}
@@ -0,0 +1,259 @@
+/**
+ * @file wdrv_winc_spi_test.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Host test of the WINC SPI transport's pipelined transfers.
+ *
+ * Runs wdrv_winc_spi.c against a model of DRV_SPI and the WINC
+ * (fakes/fake_drv_spi.c) that clocks each write out of its buffer only when
+ * the transfer completes.  Short sends must return with their transfer still
+ * in flight, but never have their staging slot reused before it completes;
+ * everything else must be done by the time the call returns; and the WINC
+ * must see the bytes in the order they were sent.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "configuration.h"
+#include "wdrv_winc_spi.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+// The depth of DRV_SPI's queue, and so of the pipeline.
+#define DEPTH DRV_SPI_QUEUE_SIZE_IDX0
+
+// An nmspi register command: the longest that is posted.
+#define CMD_SIZE 7
+
+#define BLOCK_SIZE 3000
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Reset the model and the driver's counters, and open the driver.
+ */
+static void start(void);
+
+/**
+ * @brief Close the driver, and check that the wire carried exactly these
+ * bytes, none of them clobbered.
+ */
+static void finish(const void *expected, size_t len);
+
+/**
+ * @brief Fill a command with bytes that identify it.
+ */
+static void make_cmd(uint8_t *cmd, int n);
+
+static void test_posted_sends(void);
+static void test_slot_reuse(void);
+static void test_receive_waits(void);
+static void test_large_transfers(void);
+static void test_errors(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static uint8_t s_block[BLOCK_SIZE];
+
+static uint8_t s_expected[BLOCK_SIZE + 64 * CMD_SIZE];
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  (void)argc;
+  (void)argv;
+  for (size_t i = 0; i < sizeof(s_block); i++) {
+    s_block[i] = (uint8_t)(i * 13 + i / 241);
+  }
+
+  test_posted_sends();
+  test_slot_reuse();
+  test_receive_waits();
+  test_large_transfers();
+  test_errors();
+  return fake_check_summary("wdrv_winc_spi_test");
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void start(void) {
+  fake_reset();
+  fake_spi_reset();
+  WDRV_WINC_SPIInitialize();
+  WDRV_WINC_SPIStatsReset();
+}
+
+static void finish(const void *expected, size_t len) {
+  const uint8_t *wire;
+  size_t wire_len;
+
+  WDRV_WINC_SPIDeinitialize();
+  CHECK(fake_spi_in_flight() == 0);
+  CHECK(fake_spi_clobbered() == 0);
+  CHECK(fake_spi_refused() == 0);
+  wire = fake_spi_wire(&wire_len);
+  CHECK(wire_len == len);
+  CHECK(memcmp(wire, expected, len) == 0);
+}
+
+static void make_cmd(uint8_t *cmd, int n) {
+  for (int i = 0; i < CMD_SIZE; i++) {
+    cmd[i] = (uint8_t)(0xc0 + n * CMD_SIZE + i);
+  }
+}
+
+static void test_posted_sends(void) {
+  WDRV_WINC_SPI_STATS stats;
+  uint8_t cmd[CMD_SIZE];
+
+  start();
+  make_cmd(cmd, 0);
+  memcpy(s_expected, cmd, CMD_SIZE);
+  CHECK(WDRV_WINC_SPISend(cmd, CMD_SIZE));
+  CHECK(fake_spi_in_flight() == 1);
+  // The caller may reuse its buffer at once.
+  make_cmd(cmd, 1);
+  memcpy(s_expected + CMD_SIZE, cmd, CMD_SIZE);
+  CHECK(WDRV_WINC_SPISend(cmd, CMD_SIZE));
+  CHECK(fake_spi_in_flight() == 2);
+  memset(cmd, 0, sizeof(cmd));
+
+  // The bus runs on while the caller does something else.
+  fake_rtc_advance_ms(3);
+  CHECK(fake_spi_complete());
+  CHECK(fake_spi_complete());
+  WDRV_WINC_SPIStatsGet(&stats);
+  CHECK(stats.transfers == 2);
+  CHECK(stats.posted == 2);
+  CHECK(stats.txBytes == 2 * CMD_SIZE);
+  CHECK(stats.busyTicks == 3);
+  CHECK(stats.waitTicks == 0);
+  CHECK(WDRV_WINC_SPIFlush());
+  finish(s_expected, 2 * CMD_SIZE);
+}
+
+static void test_slot_reuse(void) {
+  // With the bus never finishing on its own, the driver has to wait for a
+  // slot once the pipeline is full, and must not write over one in flight.
+  WDRV_WINC_SPI_STATS stats;
+  uint8_t cmd[CMD_SIZE];
+  int count = 3 * DEPTH + 1;
+
+  start();
+  for (int i = 0; i < count; i++) {
+    make_cmd(cmd, i);
+    memcpy(s_expected + i * CMD_SIZE, cmd, CMD_SIZE);
+    CHECK(WDRV_WINC_SPISend(cmd, CMD_SIZE));
+    CHECK(fake_spi_in_flight() <= DEPTH);
+  }
+  CHECK(fake_spi_max_in_flight() == DEPTH);
+  WDRV_WINC_SPIStatsGet(&stats);
+  CHECK(stats.posted == count);
+  CHECK(stats.pipelineFull == count - DEPTH);
+  CHECK(WDRV_WINC_SPIFlush());
+  finish(s_expected, count * CMD_SIZE);
+}
+
+static void test_receive_waits(void) {
+  // A read returns only once the sends ahead of it, and itself, are done.
+  static const uint8_t reply[] = {0xc1, 0x00, 0xf3, 0x12, 0x34, 0x56, 0x78};
+  uint8_t cmd[CMD_SIZE];
+  uint8_t buf[sizeof(reply)];
+
+  start();
+  fake_spi_set_miso(reply, sizeof(reply));
+  for (int i = 0; i < 2; i++) {
+    make_cmd(cmd, i);
+    memcpy(s_expected + i * CMD_SIZE, cmd, CMD_SIZE);
+    CHECK(WDRV_WINC_SPISend(cmd, CMD_SIZE));
+  }
+  CHECK(fake_spi_in_flight() == 2);
+  CHECK(WDRV_WINC_SPIReceive(buf, sizeof(buf)));
+  CHECK(fake_spi_in_flight() == 0);
+  CHECK(memcmp(buf, reply, sizeof(reply)) == 0);
+  finish(s_expected, 2 * CMD_SIZE);
+}
+
+static void test_large_transfers(void) {
+  // Data blocks go out in DMA-sized chunks, queued back to back, and the
+  // call returns only once the caller's buffer is free again.
+  WDRV_WINC_SPI_STATS stats;
+  uint8_t cmd[CMD_SIZE];
+  static uint8_t buf[BLOCK_SIZE];
+
+  start();
+  make_cmd(cmd, 0);
+  memcpy(s_expected, cmd, CMD_SIZE);
+  memcpy(s_expected + CMD_SIZE, s_block, BLOCK_SIZE);
+  CHECK(WDRV_WINC_SPISend(cmd, CMD_SIZE));
+  CHECK(WDRV_WINC_SPISend(s_block, BLOCK_SIZE));
+  CHECK(fake_spi_in_flight() == 0);
+  CHECK(fake_spi_max_in_flight() == DEPTH);
+  WDRV_WINC_SPIStatsGet(&stats);
+  CHECK(stats.posted == 1);
+  CHECK(stats.transfers == 1 + (BLOCK_SIZE + 1023) / 1024);
+  CHECK(stats.txBytes == CMD_SIZE + BLOCK_SIZE);
+
+  fake_spi_set_miso(s_block, BLOCK_SIZE);
+  CHECK(WDRV_WINC_SPIReceive(buf, BLOCK_SIZE));
+  CHECK(memcmp(buf, s_block, BLOCK_SIZE) == 0);
+  WDRV_WINC_SPIStatsGet(&stats);
+  CHECK(stats.rxBytes == BLOCK_SIZE);
+  finish(s_expected, CMD_SIZE + BLOCK_SIZE);
+}
+
+static void test_errors(void) {
+  // A posted send that fails is reported by the next call that waits.
+  WDRV_WINC_SPI_STATS stats;
+  uint8_t cmd[CMD_SIZE];
+  uint8_t buf[4];
+
+  start();
+  make_cmd(cmd, 0);
+  memcpy(s_expected, cmd, CMD_SIZE);
+  fake_spi_fail_next();
+  CHECK(WDRV_WINC_SPISend(cmd, CMD_SIZE));
+  CHECK(!WDRV_WINC_SPIFlush());
+  CHECK(WDRV_WINC_SPIFlush());
+
+  fake_spi_fail_next();
+  CHECK(!WDRV_WINC_SPIReceive(buf, sizeof(buf)));
+  CHECK(WDRV_WINC_SPIReceive(buf, sizeof(buf)));
+  WDRV_WINC_SPIStatsGet(&stats);
+  CHECK(stats.errors == 2);
+  finish(s_expected, CMD_SIZE);
+}
@@ -0,0 +1,394 @@
+/**
+ * @file winc_task_test.c
+ *
+ * MIT License
+ *
+ * Copyright (c) 2022 Klatu Networks
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ * @brief Host test of winc_task's connect retry policy.
+ *
+ * Drives winc_task through the orders in which the WINC can report a connect
+ * (fakes/fake_winc.c), with the real config_task reading a config.txt from a
+ * scratch directory.  Each failure must be counted once, against its cause,
+ * and end in a backoff and retry, or, once the cause's budget is spent, in the
+ * wake failing.  The stages after the link comes up are stubbed out: reaching
+ * the report is what counts as connected.
+ */
+
+// *****************************************************************************
+// Includes
+
+#include "fakes.h"
+
+#include "app.h"
+#include "config_task.h"
+#include "http_task.h"
+#include "nv_data.h"
+#include "ping_task.h"
+#include "probe_task.h"
+#include "survey_task.h"
+#include "udp_task.h"
+#include "wdrv_winc_client_api.h"
+#include "winc_task.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// *****************************************************************************
+// Local (private) types and definitions
+
+#define DHCP_ADDR 0x0a00000a // 10.0.0.10
+
+// *****************************************************************************
+// Local (private, static) forward declarations
+
+/**
+ * @brief Reset the fakes, load a one-profile config.txt and start a wake.
+ */
+static void start(void);
+
+/**
+ * @brief Step winc_task once per millisecond for this long.
+ */
+static void run_ms(uint32_t ms);
+
+/**
+ * @brief Report the association made, as the WINC would.
+ */
+static void connected(void);
+
+/**
+ * @brief Report the association lost, or ended on request, with no error.
+ */
+static void disconnected(void);
+
+/**
+ * @brief Return the number of failures of a cause recorded in nv_data.
+ */
+static int causes(winc_task_cause_t cause);
+
+/**
+ * @brief Return the total number of failures recorded in nv_data.
+ */
+static int all_causes(void);
+
+static void test_connect(void);
+static void test_disconnect_before_dhcp(void);
+static void test_dhcp_timeout(void);
+
+// *****************************************************************************
+// Local (private, static) storage
+
+static const char s_config[] = "wifi_ssid = test\r\n"
+                               "wifi_pass = secret\r\n";
+
+static int s_reports; // # of http_task_init() calls
+
+static bool s_report_done;
+
+static http_task_timing_t s_timing;
+
+// *****************************************************************************
+// Public code
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <scratch directory>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  fake_fs_set_root(argv[1]);
+
+  test_connect();
+  test_disconnect_before_dhcp();
+  test_dhcp_timeout();
+  return fake_check_summary("winc_task_test");
+}
+
+// *****************************************************************************
+// Local (private, static) code
+
+static void start(void) {
+  fake_reset();
+  fake_winc_reset();
+  s_reports = 0;
+  s_report_done = false;
+  fake_fs_put("config.txt", s_config, sizeof(s_config) - 1);
+  config_task_init("config.txt");
+  for (int i = 0; i < 1000; i++) {
+    if (config_task_succeeded() || config_task_failed()) {
+      break;
+    }
+    config_task_step();
+  }
+  CHECK(config_task_succeeded());
+  CHECK(config_task_get_wifi_profile_count() == 1);
+  winc_task_connect();
+}
+
+static void run_ms(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    winc_task_step();
+    fake_rtc_advance_ms(1);
+  }
+}
+
+static void connected(void) {
+  fake_winc_notify(WDRV_WINC_CONN_STATE_CONNECTED, 0);
+}
+
+static void disconnected(void) {
+  fake_winc_notify(WDRV_WINC_CONN_STATE_DISCONNECTED, 0);
+}
+
+static int causes(winc_task_cause_t cause) {
+  return nv_data()->winc_task_nv_data.causes[cause];
+}
+
+static int all_causes(void) {
+  int n = 0;
+  for (int i = 0; i < WINC_TASK_CAUSE_COUNT; i++) {
+    n += causes(i);
+  }
+  return n;
+}
+
+static void test_connect(void) {
+  winc_task_profile_stats_t *profile =
+      &nv_data()->winc_task_nv_data.profiles[0];
+
+  start();
+  run_ms(10);
+  CHECK(fake_winc_connects() == 1);
+  connected();
+  run_ms(100);
+  CHECK(s_reports == 0);
+  fake_winc_dhcp(DHCP_ADDR);
+  run_ms(10);
+  CHECK(s_reports == 1);
+  CHECK(nv_data()->winc_task_nv_data.ip_address == DHCP_ADDR);
+  CHECK(profile->attempts == 1);
+  CHECK(profile->successes == 1);
+  CHECK(profile->last_ok);
+
+  // The report done, the wake ends with a disconnect.
+  s_report_done = true;
+  run_ms(10);
+  CHECK(fake_winc_disconnects() == 1);
+  CHECK(!winc_task_succeeded());
+  disconnected();
+  run_ms(10);
+  CHECK(winc_task_succeeded());
+  CHECK(all_causes() == 0);
+  CHECK(fake_winc_connects() == 1);
+}
+
+static void test_disconnect_before_dhcp(void) {
+  // The AP drops the station before DHCP: one link loss, then a retry after
+  // the 250 ms backoff that connects.
+  start();
+  run_ms(10);
+  connected();
+  run_ms(10);
+  disconnected();
+  run_ms(1);
+  CHECK(causes(WINC_TASK_CAUSE_LINK_LOSS) == 1);
+  CHECK(all_causes() == 1);
+  run_ms(200);
+  CHECK(fake_winc_connects() == 1);
+  run_ms(100);
+  CHECK(fake_winc_connects() == 2);
+  connected();
+  fake_winc_dhcp(DHCP_ADDR);
+  run_ms(10);
+  CHECK(s_reports == 1);
+  CHECK(all_causes() == 1);
+  CHECK(nv_data()->winc_task_nv_data.profiles[0].last_ok);
+
+  // Twice in one wake spends the budget, and with one profile, the wake.
+  start();
+  for (int i = 0; i < 2; i++) {
+    run_ms(300);
+    CHECK(fake_winc_connects() == i + 1);
+    connected();
+    run_ms(10);
+    disconnected();
+  }
+  run_ms(10);
+  CHECK(winc_task_failed());
+  CHECK(causes(WINC_TASK_CAUSE_LINK_LOSS) == 2);
+  CHECK(all_causes() == 2);
+  CHECK(!nv_data()->winc_task_nv_data.profiles[0].last_ok);
+  CHECK(s_reports == 0);
+}
+
+static void test_dhcp_timeout(void) {
+  start();
+  run_ms(10);
+  connected();
+  run_ms(9900);
+  CHECK(fake_winc_disconnects() == 0);
+  CHECK(all_causes() == 0);
+  run_ms(200);
+  CHECK(fake_winc_disconnects() == 1);
+  CHECK(causes(WINC_TASK_CAUSE_DHCP) == 1);
+
+  // The DISCONNECTED that the timeout asked for arrives only once the retry
+  // has started.  It is no new failure, and the retry still stands.
+  run_ms(500);
+  CHECK(fake_winc_connects() == 2);
+  disconnected();
+  run_ms(1000);
+  CHECK(all_causes() == 1);
+  CHECK(fake_winc_connects() == 2);
+  CHECK(!winc_task_failed());
+
+  // A second timeout spends the budget and fails the wake.  Its own
+  // DISCONNECTED, when it comes, changes nothing.
+  connected();
+  run_ms(10100);
+  CHECK(fake_winc_disconnects() == 2);
+  CHECK(causes(WINC_TASK_CAUSE_DHCP) == 2);
+  CHECK(winc_task_failed());
+  disconnected();
+  run_ms(10);
+  CHECK(winc_task_failed());
+  CHECK(all_causes() == 2);
+  CHECK(s_reports == 0);
+}
+
+// Not under test.  The report never ends until s_report_done is set, and the
+// diagnostic stages, which this config.txt does not enable, never run.
+
+bool app_is_cold_boot(void) { return false; }
+
+mu_strbuf_t *app_request_msg() { return NULL; }
+
+mu_strbuf_t *app_response_msg() { return NULL; }
+
+mu_strbuf_t *app_download_msg(const char *path) {
+  (void)path;
+  return NULL;
+}
+
+mu_strbuf_t *app_upload_msg(const char *path, uint32_t length) {
+  (void)path;
+  (void)length;
+  return NULL;
+}
+
+size_t app_build_report(uint8_t *buf, size_t size) {
+  (void)buf;
+  (void)size;
+  return 0;
+}
+
+void app_report_delivered(bool via_udp) { (void)via_udp; }
+
+void http_task_init(DRV_HANDLE winc_handle,
+                    const char *host_name,
+                    const char *host_ipv4,
+                    uint16_t host_port,
+                    bool use_tls,
+                    yb_rtc_ms_t dns_ttl_ms,
+                    mu_strbuf_t *request_msg,
+                    mu_strbuf_t *response_msg) {
+  s_reports += 1;
+}
+
+void http_task_set_bench(uint32_t up_bytes,
+                         uint32_t down_bytes,
+                         yb_rtc_ms_t budget_ms) {}
+
+void http_task_set_sink(const char *filename,
+                        uint32_t expected_len,
+                        const uint8_t *expected_hash,
+                        size_t hash_len) {}
+
+void http_task_set_source(const char *filename) {}
+
+void http_task_step(void) {}
+
+bool http_task_succeeded(void) { return s_report_done; }
+
+bool http_task_failed(void) { return false; }
+
+void http_task_shutdown(void) {}
+
+void http_task_forget_tls_session(void) {}
+
+const http_task_timing_t *http_task_get_timing(void) { return &s_timing; }
+
+void ping_task_init(DRV_HANDLE winc_handle,
+                    const char *host,
+                    uint8_t count,
+                    yb_rtc_ms_t budget_ms) {}
+
+void ping_task_step(void) {}
+
+bool ping_task_succeeded(void) { return true; }
+
+bool ping_task_failed(void) { return false; }
+
+void ping_task_shutdown(void) {}
+
+void probe_task_init(DRV_HANDLE winc_handle, yb_rtc_ms_t budget_ms) {}
+
+void probe_task_add_endpoint(const char *endpoint) {}
+
+void probe_task_step(void) {}
+
+bool probe_task_succeeded(void) { return true; }
+
+bool probe_task_failed(void) { return false; }
+
+void probe_task_shutdown(void) {}
+
+void survey_task_init(DRV_HANDLE winc_handle,
+                      uint16_t channel_mask,
+                      bool passive,
+                      yb_rtc_ms_t budget_ms) {}
+
+void survey_task_step(void) {}
+
+bool survey_task_succeeded(void) { return true; }
+
+bool survey_task_failed(void) { return false; }
+
+void survey_task_shutdown(void) {}
+
+void udp_task_init(DRV_HANDLE winc_handle,
+                   const char *host,
+                   uint16_t port,
+                   const char *key,
+                   const void *payload,
+                   size_t payload_len,
+                   uint8_t max_attempts,
+                   yb_rtc_ms_t ack_timeout_ms) {}
+
+void udp_task_step(void) {}
+
+bool udp_task_succeeded(void) { return true; }
+
+bool udp_task_failed(void) { return false; }
+
+void udp_task_shutdown(void) {}
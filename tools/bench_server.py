@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""Serve the far end of the throughput benchmark run by http_task.
+
+A stand-in for bench_host: reads the line "YBBENCH <up_bytes> <down_bytes>",
+discards the next up_bytes bytes, sends down_bytes bytes of its own and closes
+the connection.  The goodput it sees in each direction is logged, to compare
+with the device's own "Benchmark up/down" lines.
+
+    python3 tools/bench_server.py [--port 5201] [--pause <ms> --every <n>]
+
+Set bench_host to this machine, bench_port to match, and bench_up_bytes and
+bench_down_bytes to taste.  --pause holds the download for <ms> after every
+<n> bytes sent, so that the device's stall (over 50 ms) and long gap (over
+200 ms) counters can be checked against a known number of gaps.
+"""
+
+import argparse
+import socket
+import threading
+import time
+
+CHUNK = 1460
+FILLER = bytes(range(256)) * (CHUNK // 256 + 1)
+
+
+def rate(nbytes, seconds):
+    return nbytes * 8 / seconds / 1000 if seconds > 0 else 0
+
+
+def read_line(conn):
+    """Return the header line and any bytes read past it."""
+    data = b""
+    while b"\r\n" not in data:
+        chunk = conn.recv(256)
+        if not chunk:
+            raise ConnectionError("closed before the YBBENCH line")
+        data += chunk
+        if len(data) > 256:
+            raise ValueError("no YBBENCH line in %r" % data[:32])
+    line, rest = data.split(b"\r\n", 1)
+    return line.decode(errors="replace"), rest
+
+
+def bench(conn, address, pause_ms, every):
+    line, rest = read_line(conn)
+    words = line.split()
+    if len(words) != 3 or words[0] != "YBBENCH":
+        raise ValueError("bad header %r" % line)
+    up_bytes, down_bytes = int(words[1]), int(words[2])
+    print("%s: %s" % (address[0], line), flush=True)
+
+    start = time.monotonic()
+    got = len(rest)
+    while got < up_bytes:
+        chunk = conn.recv(65536)
+        if not chunk:
+            break
+        got += len(chunk)
+    up_s = time.monotonic() - start
+    print("  up:   %d of %d bytes in %.0f ms = %.0f kbps" %
+          (got, up_bytes, up_s * 1000, rate(got, up_s)), flush=True)
+
+    start = time.monotonic()
+    sent = pauses = 0
+    while sent < down_bytes:
+        n = min(CHUNK, down_bytes - sent)
+        if every:
+            n = min(n, every - sent % every)
+        conn.sendall(FILLER[:n])
+        sent += n
+        if every and sent % every == 0 and sent < down_bytes:
+            time.sleep(pause_ms / 1000)
+            pauses += 1
+    # Wait for the device to close, so the time includes the last bytes
+    # reaching it rather than just leaving this socket's buffer.
+    conn.shutdown(socket.SHUT_WR)
+    conn.settimeout(10)
+    try:
+        while conn.recv(1024):
+            pass
+    except OSError:
+        pass
+    down_s = time.monotonic() - start
+    print("  down: %d bytes in %.0f ms = %.0f kbps%s" %
+          (sent, down_s * 1000, rate(sent, down_s),
+           ", %d pauses of %d ms" % (pauses, pause_ms) if pauses else ""),
+          flush=True)
+
+
+def handle(conn, address, pause_ms, every):
+    with conn:
+        try:
+            bench(conn, address, pause_ms, every)
+        except (OSError, ValueError) as e:
+            print("%s: %s" % (address[0], e), flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=5201)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--pause", type=int, default=0, metavar="MS",
+                        help="pause the download this long [0]")
+    parser.add_argument("--every", type=int, default=0, metavar="BYTES",
+                        help="...after every this many bytes [never]")
+    args = parser.parse_args()
+    if bool(args.pause) != bool(args.every):
+        parser.error("--pause and --every go together")
+
+    listener = socket.create_server((args.bind, args.port))
+    print("listening on %s:%d" % (args.bind, args.port), flush=True)
+    while True:
+        conn, address = listener.accept()
+        threading.Thread(target=handle,
+                         args=(conn, address, args.pause, args.every),
+                         daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
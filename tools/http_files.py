@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Serve downloads to, and take uploads from, the download and upload stages.
+
+A stand-in for APP_HOST_NAME: answers GET with the file at that path under
+--dir, and stores the body of a POST (or PUT) there.  Each transfer is logged
+with its length, time and SHA-256, so the device's "Downloaded" and "Uploaded"
+lines can be checked against it.
+
+    python3 tools/http_files.py [--port 8080] [--dir files] [--tls]
+
+Set download_path and upload_path in config.txt to paths under --dir; for a
+download, the logged download_sha256 value can go in config.txt too.  --tls
+serves HTTPS with the certificate tools/tls_server.py makes, for a build with
+APP_HOST_USE_TLS.  --truncate <n> sends only the first n bytes of each body
+and then closes, which the device must reject without touching its old copy.
+"""
+
+import argparse
+import hashlib
+import http.server
+import os
+import sys
+import time
+
+
+class Handler(http.server.BaseHTTPRequestHandler):
+    # HTTP/1.0: the connection closes after each response, as the device asks.
+    protocol_version = "HTTP/1.0"
+    root = "."
+    truncate = None
+
+    def path_on_disk(self):
+        path = os.path.normpath(self.path.split("?", 1)[0]).lstrip("/")
+        if path.startswith(".."):
+            return None
+        return os.path.join(self.root, path)
+
+    def do_GET(self):
+        path = self.path_on_disk()
+        if path is None or not os.path.isfile(path):
+            self.send_error(404)
+            return
+        with open(path, "rb") as f:
+            body = f.read()
+        sent = body if self.truncate is None else body[:self.truncate]
+        self.send_response(200)
+        self.send_header("Content-Type", "application/octet-stream")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        start = time.monotonic()
+        self.wfile.write(sent)
+        self.wfile.flush()
+        self.log_transfer("sent", len(sent), time.monotonic() - start, body)
+        if len(sent) < len(body):
+            print("  cut short after %d of %d bytes" % (len(sent), len(body)))
+        print("  download_length = %d\n  download_sha256 = %s" %
+              (len(body), hashlib.sha256(body).hexdigest()[:32]), flush=True)
+
+    def do_POST(self):
+        path = self.path_on_disk()
+        length = self.headers.get("Content-Length")
+        if path is None or length is None:
+            self.send_error(400 if path is None else 411)
+            return
+        length = int(length)
+        start = time.monotonic()
+        body = b""
+        while len(body) < length:
+            chunk = self.rfile.read(min(65536, length - len(body)))
+            if not chunk:
+                break
+            body += chunk
+        seconds = time.monotonic() - start
+        if len(body) < length:
+            print("  closed after %d of %d bytes" % (len(body), length))
+            return
+        os.makedirs(os.path.dirname(path) or ".", exist_ok=True)
+        with open(path, "wb") as f:
+            f.write(body)
+        self.log_transfer("received", len(body), seconds, body)
+        self.send_response(201)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    do_PUT = do_POST
+
+    def log_transfer(self, verb, nbytes, seconds, body):
+        rate = nbytes / seconds / 1000 if seconds > 0 else 0
+        print("  %s %d bytes in %.0f ms = %.1f kB/s, sha256 %s" %
+              (verb, nbytes, seconds * 1000, rate,
+               hashlib.sha256(body).hexdigest()), flush=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--dir", default="files",
+                        help="files are served from and stored here [files]")
+    parser.add_argument("--tls", action="store_true",
+                        help="serve HTTPS with tls_server.py's certificate")
+    parser.add_argument("--name", default="yb.local",
+                        help="host name of the certificate [yb.local]")
+    parser.add_argument("--truncate", type=int, default=None, metavar="N",
+                        help="send only the first N bytes of each download")
+    args = parser.parse_args()
+
+    os.makedirs(args.dir, exist_ok=True)
+    Handler.root = args.dir
+    Handler.truncate = args.truncate
+    server = http.server.ThreadingHTTPServer((args.bind, args.port), Handler)
+    if args.tls:
+        sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+        import tls_server
+        ctx = tls_server.context(*tls_server.make_certs("tls", args.name))
+        server.socket = ctx.wrap_socket(server.socket, server_side=True)
+    print("serving %s on %s:%d%s" % (args.dir, args.bind, args.port,
+                                     " with TLS" if args.tls else ""),
+          flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Serve stand-in endpoints for probe_task, each failing in its own way.
+
+Opens one port per behaviour, counting up from --port, and prints the
+probe_endpoint lines to put in the config file.  Each behaviour leads to a
+known entry in the probe's result table:
+
+    ok           answer the HEAD request at once          PROBE_RESULT_OK
+    delay:<ms>   answer after <ms>; first_byte_ms grows   PROBE_RESULT_OK
+    refuse       reset the connect (nothing listening)    CONNECT_FAILED
+    close        accept, then close without a byte        PROBE_RESULT_CLOSED
+    reset        accept, then reset without a byte        PROBE_RESULT_CLOSED
+    silent       accept and never answer                  PROBE_RESULT_TIMED_OUT
+
+    python3 tools/probe_listeners.py [--port 8000] [--host <addr>] \\
+        ok delay:1500 refuse close reset silent
+
+With no behaviours given, one of each is served, with a 1500 ms delay.  Give
+--host the address the device should use for this machine.  At most 7
+endpoints are probed at once, the number of TCP sockets the WINC has.
+"""
+
+import argparse
+import socket
+import struct
+import threading
+import time
+
+DEFAULT = ["ok", "delay:1500", "refuse", "close", "reset", "silent"]
+
+RESPONSE = b"HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n"
+
+
+def log(port, behaviour, address, text):
+    print("%s :%d %-10s %s: %s" % (time.strftime("%H:%M:%S"), port,
+                                   behaviour, address[0], text), flush=True)
+
+
+def handle(conn, address, port, behaviour):
+    with conn:
+        if behaviour == "close":
+            log(port, behaviour, address, "closed")
+            return
+        if behaviour == "reset":
+            # A zero linger time makes close() send a RST rather than a FIN.
+            conn.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER,
+                            struct.pack("ii", 1, 0))
+            log(port, behaviour, address, "reset")
+            return
+        conn.settimeout(30)
+        try:
+            request = conn.recv(1024)
+        except OSError as e:
+            log(port, behaviour, address, e)
+            return
+        line = request.split(b"\r\n", 1)[0].decode(errors="replace")
+        if behaviour == "silent":
+            log(port, behaviour, address, "%s; not answering" % line)
+            # Hold the connection open until the device gives up on it.
+            while conn.recv(1024):
+                pass
+            return
+        if behaviour.startswith("delay:"):
+            time.sleep(int(behaviour[6:]) / 1000)
+        conn.sendall(RESPONSE)
+        log(port, behaviour, address, "%s; answered" % line)
+
+
+def serve(listener, port, behaviour):
+    while True:
+        conn, address = listener.accept()
+        threading.Thread(target=handle, args=(conn, address, port, behaviour),
+                         daemon=True).start()
+
+
+def open_port(bind, port, behaviour):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind((bind, port))
+    if behaviour == "refuse":
+        # Bound but not listening: the port is held, and a SYN gets a RST.
+        return sock
+    sock.listen()
+    threading.Thread(target=serve, args=(sock, port, behaviour),
+                     daemon=True).start()
+    return sock
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8000,
+                        help="port of the first endpoint [8000]")
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--host", default=None,
+                        help="address to print in the config lines")
+    parser.add_argument("behaviours", nargs="*", default=DEFAULT)
+    args = parser.parse_args()
+
+    for b in args.behaviours:
+        if b not in ("ok", "refuse", "close", "reset", "silent") and not (
+                b.startswith("delay:") and b[6:].isdigit()):
+            parser.error("unknown behaviour %r" % b)
+    if len(args.behaviours) > 7:
+        print("note: the probe only takes the first 7 endpoints")
+
+    host = args.host or socket.gethostbyname(socket.gethostname())
+    socks = []
+    for i, behaviour in enumerate(args.behaviours):
+        socks.append(open_port(args.bind, args.port + i, behaviour))
+        print(":%d %s" % (args.port + i, behaviour))
+    print("\nconfig.txt lines, in the same order:")
+    for i in range(len(args.behaviours)):
+        print("probe_endpoint = %s:%d" % (host, args.port + i))
+    print(flush=True)
+    try:
+        while True:
+            time.sleep(3600)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
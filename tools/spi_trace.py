@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+"""Render the SPI trace printed by a firmware built with DRV_SPI_TRACE_ENABLE.
+
+Reads a console log, picks out the "spitrace" lines of the last wake, prints
+the bus time of each source in each application phase, and optionally writes
+a Chrome trace (open with chrome://tracing or https://ui.perfetto.dev) that
+lays the transfers and phases out on a timeline.
+
+    python3 tools/spi_trace.py console.log [-o trace.json]
+"""
+
+import argparse
+import collections
+import json
+import sys
+
+SOURCES = {0: "spi", 1: "winc", 2: "sdspi"}
+DIRS = {1: "write", 2: "read", 3: "write_read"}
+
+
+def parse(lines):
+    """Return (hz, marks, transfers) of the last trace in lines."""
+    hz, marks, transfers = None, [], []
+    for line in lines:
+        fields = line.split()
+        if len(fields) < 2 or fields[0] != "spitrace":
+            continue
+        if fields[1] == "hz":
+            # a new wake: forget the previous one
+            hz, marks, transfers = int(fields[2]), [], []
+        elif fields[1] == "m":
+            marks.append((int(fields[2]), " ".join(fields[3:])))
+        elif fields[1] == "t":
+            source, direction, length, start, end = map(int, fields[2:7])
+            transfers.append((source, direction, length, start, end))
+    if hz is None:
+        sys.exit("no spitrace output found")
+    return hz, marks, transfers
+
+
+def unwrap(cycles, origin):
+    """Cycles since origin, allowing for one wrap of the 32 bit counter."""
+    return (cycles - origin) & 0xFFFFFFFF
+
+
+def phase_of(start, marks):
+    name = "(before first mark)"
+    for cycle, mark in marks:
+        if cycle > start:
+            break
+        name = mark
+    return name
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("log", type=argparse.FileType("r"))
+    parser.add_argument("-o", "--output", help="write a Chrome trace here")
+    args = parser.parse_args()
+
+    hz, marks, transfers = parse(args.log)
+    origin = min([m[0] for m in marks] + [t[3] for t in transfers])
+    us = 1e6 / hz
+    marks = [(unwrap(c, origin), name) for c, name in marks]
+    marks.sort()
+
+    busy = collections.defaultdict(float)
+    count = collections.Counter()
+    nbytes = collections.Counter()
+    events = []
+    for source, direction, length, start, end in transfers:
+        start = unwrap(start, origin)
+        duration = unwrap(end, origin) - start
+        key = (phase_of(start, marks), SOURCES.get(source, str(source)))
+        busy[key] += duration * us
+        count[key] += 1
+        nbytes[key] += length
+        events.append({"name": DIRS.get(direction, str(direction)),
+                       "cat": key[1], "ph": "X", "pid": 0, "tid": source,
+                       "ts": start * us, "dur": duration * us,
+                       "args": {"bytes": length}})
+
+    # Phase lengths, the last running to the end of the trace.
+    ends = [m[0] for m in marks[1:]] + [max(
+        [unwrap(t[4], origin) for t in transfers] + [marks[-1][0] if marks else 0])]
+    span = {name: (end - cycle) * us for (cycle, name), end in zip(marks, ends)}
+
+    print("%-32s %-6s %8s %9s %10s %6s" %
+          ("phase", "source", "count", "bytes", "busy_us", "util"))
+    for (phase, source), total in sorted(busy.items()):
+        length = span.get(phase, 0)
+        util = "%5.1f%%" % (100 * total / length) if length else "     -"
+        print("%-32s %-6s %8d %9d %10.0f %s" %
+              (phase, source, count[(phase, source)],
+               nbytes[(phase, source)], total, util))
+
+    if args.output:
+        for (cycle, name), end in zip(marks, ends):
+            events.append({"name": name, "cat": "phase", "ph": "X", "pid": 0,
+                           "tid": -1, "ts": cycle * us,
+                           "dur": (end - cycle) * us})
+        with open(args.output, "w") as f:
+            json.dump({"traceEvents": events}, f)
+
+
+if __name__ == "__main__":
+    main()
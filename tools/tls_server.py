@@ -0,0 +1,128 @@
+#!/usr/bin/env python3
+"""Serve HTTPS the way http_task expects, to check TLS session resumption.
+
+A stand-in for APP_HOST_NAME: answers each request with a short 200 and logs
+the handshake of every connection, including whether it resumed a cached
+session.  Set APP_HOST_NAME (or APP_HOST_IP_ADDR) and APP_HOST_PORT in app.h
+to this machine.
+
+    python3 tools/tls_server.py [--port 8443] [--name yb.local] [--dir tls]
+
+On first use a self-signed CA and a server certificate for --name, signed by
+it, are made in --dir with the openssl command.  Either load ca.der into the
+WINC with its root certificate tool, or set APP_HOST_TLS_BYPASS_X509.
+
+Only the static-RSA AES-128 suites that http_task offers are enabled, so a
+device that negotiates anything else fails to connect.  The session cache and
+tickets are left on: a wake whose WINC was parked since the last handshake
+should log "resumed"; one whose WINC was reset cannot.
+"""
+
+import argparse
+import os
+import socket
+import ssl
+import subprocess
+import time
+
+# The suites in s_tls_cipher_suites, by their OpenSSL names.
+CIPHERS = "AES128-SHA:AES128-SHA256:AES128-GCM-SHA256"
+
+BODY = b"ok\n"
+
+
+def openssl(*args):
+    subprocess.run(("openssl",) + args, check=True, capture_output=True)
+
+
+def make_certs(directory, name):
+    """Make ca.pem, ca.der, server.pem and server.key unless they exist."""
+    ca, ca_key = os.path.join(directory, "ca.pem"), os.path.join(
+        directory, "ca.key")
+    cert, key = os.path.join(directory, "server.pem"), os.path.join(
+        directory, "server.key")
+    if os.path.exists(cert) and os.path.exists(key):
+        return cert, key
+    os.makedirs(directory, exist_ok=True)
+    openssl("req", "-x509", "-newkey", "rsa:2048", "-nodes", "-days", "3650",
+            "-subj", "/CN=Yellowbird test CA", "-keyout", ca_key, "-out", ca)
+    openssl("x509", "-in", ca, "-outform", "der", "-out",
+            os.path.join(directory, "ca.der"))
+    csr = os.path.join(directory, "server.csr")
+    openssl("req", "-newkey", "rsa:2048", "-nodes", "-subj", "/CN=" + name,
+            "-keyout", key, "-out", csr)
+    ext = os.path.join(directory, "server.ext")
+    with open(ext, "w") as f:
+        f.write("subjectAltName=DNS:%s\n" % name)
+    openssl("x509", "-req", "-in", csr, "-CA", ca, "-CAkey", ca_key,
+            "-CAcreateserial", "-days", "3650", "-extfile", ext, "-out", cert)
+    print("made a CA and a certificate for %s in %s" % (name, directory))
+    return cert, key
+
+
+def context(cert, key):
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+    ctx.minimum_version = ssl.TLSVersion.TLSv1_2
+    # The WINC1500 speaks TLS 1.2 at most; resumption then works by session
+    # ID or ticket, both of which OpenSSL serves by default.
+    ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+    ctx.set_ciphers(CIPHERS + ":@SECLEVEL=1")
+    ctx.load_cert_chain(cert, key)
+    return ctx
+
+
+def serve(conn):
+    """Read one request and answer it."""
+    request = b""
+    while b"\r\n\r\n" not in request:
+        data = conn.recv(1024)
+        if not data:
+            return None
+        request += data
+    conn.sendall(b"HTTP/1.1 200 OK\r\nContent-Length: %d\r\n"
+                 b"Connection: close\r\n\r\n" % len(BODY) + BODY)
+    return request.split(b"\r\n", 1)[0].decode(errors="replace")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", type=int, default=8443)
+    parser.add_argument("--bind", default="0.0.0.0")
+    parser.add_argument("--name", default="yb.local",
+                        help="host name the certificate is for [yb.local]")
+    parser.add_argument("--dir", default="tls",
+                        help="where the CA and certificate are kept [tls]")
+    args = parser.parse_args()
+
+    ctx = context(*make_certs(args.dir, args.name))
+    listener = socket.create_server((args.bind, args.port))
+    print("listening on %s:%d" % (args.bind, args.port))
+    resumed = total = 0
+    while True:
+        raw, address = listener.accept()
+        start = time.monotonic()
+        try:
+            conn = ctx.wrap_socket(raw, server_side=True)
+        except (ssl.SSLError, OSError) as e:
+            print("%s: handshake failed: %s" % (address[0], e))
+            raw.close()
+            continue
+        ms = (time.monotonic() - start) * 1000
+        total += 1
+        resumed += conn.session_reused
+        print("%s: %s handshake, %s, %.0f ms; %d of %d resumed" %
+              (address[0], "resumed" if conn.session_reused else "full",
+               conn.cipher()[0], ms, resumed, total))
+        try:
+            conn.settimeout(10)
+            line = serve(conn)
+            if line:
+                print("  %s" % line)
+        except (ssl.SSLError, OSError) as e:
+            print("  %s" % e)
+        finally:
+            conn.close()
+
+
+if __name__ == "__main__":
+    main()
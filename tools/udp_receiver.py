@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+"""Receive, check and acknowledge the UDP reports sent by udp_task.
+
+A stand-in for the report server: prints each authentic report, decoded as
+app_build_report() lays it out, and returns an ack.  See src/udp_task.h for
+the datagram format.
+
+    python3 tools/udp_receiver.py --key <udp_key> [--port 9000]
+
+Set udp_host to this machine and udp_port and udp_key to match.  A report is
+acked when it is new, or when it repeats the last one seen in its epoch (the
+device is retrying because an ack was lost).  Older sequence numbers in an
+epoch are replays and are dropped unacked.
+"""
+
+import argparse
+import hashlib
+import hmac
+import socket
+import struct
+
+VERSION = 2
+TYPE_REPORT = 1
+TYPE_ACK = 2
+HEADER = struct.Struct(">2sBBIIB")
+MAC_SIZE = 16
+
+CAUSES = ["ap_not_found", "auth", "assoc", "dhcp", "link_loss"]
+PING_TARGETS = ["gateway", "host"]
+PING = struct.Struct(">BBBHHHH")
+TIMING_PHASES = ["dns", "connect", "tls", "send", "ttfb", "transfer", "total"]
+TIMING = struct.Struct(">7HI")
+SURVEY_SIZE = 8
+
+
+def mac(key, data):
+    return hmac.new(key, data, hashlib.sha256).digest()[:MAC_SIZE]
+
+
+def parse(key, datagram):
+    """Return (epoch, seq, payload) of an authentic report, else None."""
+    if len(datagram) < HEADER.size + MAC_SIZE:
+        return None
+    magic, version, kind, epoch, seq, length = HEADER.unpack_from(datagram)
+    end = HEADER.size + length
+    if (magic != b"YB" or version != VERSION or kind != TYPE_REPORT or
+            len(datagram) != end + MAC_SIZE):
+        return None
+    if not hmac.compare_digest(mac(key, datagram[:end]), datagram[end:]):
+        return None
+    return epoch, seq, datagram[HEADER.size:end]
+
+
+def ack(key, epoch, seq):
+    header = HEADER.pack(b"YB", VERSION, TYPE_ACK, epoch, seq, 0)
+    return header + mac(key, header)
+
+
+def decode(payload):
+    """Describe a payload built by app_build_report()."""
+    fields = []
+    if len(payload) >= 12:
+        reboots, successes, uptime = struct.unpack_from(">III", payload)
+        fields.append("reboots=%d successes=%d uptime_ms=%d" %
+                      (reboots, successes, uptime))
+    n = 12
+    if len(payload) >= n + len(CAUSES):
+        fields.append("failures " + " ".join(
+            "%s=%d" % (c, payload[n + i]) for i, c in enumerate(CAUSES)))
+        n += len(CAUSES)
+    if len(payload) >= n + PING.size * len(PING_TARGETS):
+        for target in PING_TARGETS:
+            sent, received, loss, lo, avg, hi, jitter = PING.unpack_from(
+                payload, n)
+            n += PING.size
+            if sent:
+                fields.append("ping %s %d/%d loss=%d%% min/avg/max/jitter="
+                              "%d/%d/%d/%d ms" % (target, received, sent, loss,
+                                                  lo, avg, hi, jitter))
+    if len(payload) >= n + TIMING.size:
+        values = TIMING.unpack_from(payload, n)
+        n += TIMING.size
+        fields.append("last http " + " ".join(
+            "%s=%d" % (p, v) for p, v in zip(TIMING_PHASES, values)) +
+            " ms rx=%d bytes" % values[-1])
+    if len(payload) > n:
+        count = payload[n]
+        n += 1
+        for _ in range(count):
+            if n + SURVEY_SIZE > len(payload):
+                break
+            bssid = ":".join("%02x" % b for b in payload[n:n + 6])
+            auth, channel = payload[n + 6] >> 4, payload[n + 6] & 0x0f
+            rssi = struct.unpack_from("b", payload, n + 7)[0]
+            fields.append("bss %s ch=%d auth=%d rssi=%d" %
+                          (bssid, channel, auth, rssi))
+            n += SURVEY_SIZE
+    return "\n  ".join(fields)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--key", required=True, help="the device's udp_key")
+    parser.add_argument("--port", type=int, default=9000)
+    parser.add_argument("--bind", default="0.0.0.0")
+    args = parser.parse_args()
+    key = args.key.encode()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind((args.bind, args.port))
+    # Epochs are random, so they tell devices apart as well as cold boots.
+    last_seq = {}  # epoch -> highest seq seen
+    while True:
+        datagram, address = sock.recvfrom(2048)
+        report = parse(key, datagram)
+        if report is None:
+            print("%s: dropped %d bytes: not an authentic report" %
+                  (address[0], len(datagram)))
+            continue
+        epoch, seq, payload = report
+        last = last_seq.get(epoch)
+        if last is not None and seq < last:
+            print("%s: dropped replay of epoch %08x seq %d" %
+                  (address[0], epoch, seq))
+            continue
+        sock.sendto(ack(key, epoch, seq), address)
+        if seq == last:
+            print("%s: re-acked epoch %08x seq %d" % (address[0], epoch, seq))
+            continue
+        last_seq[epoch] = seq
+        print("%s: epoch %08x seq %d\n  %s" %
+              (address[0], epoch, seq, decode(payload)))
+
+
+if __name__ == "__main__":
+    main()
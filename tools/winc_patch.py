@@ -0,0 +1,384 @@
+#!/usr/bin/env python3
+"""Make and simulate the binary patches that imager_task applies to the WINC.
+
+A patch rebuilds a WINC flash region (the target image) from what the region
+holds now (the source image), so only the ops and new bytes need to go on the
+SD card.  See src/imager_patch.h for the format.
+
+    python3 tools/winc_patch.py make old.img new.img -o new.patch
+    python3 tools/winc_patch.py apply old.img new.patch -o out.img
+
+"make" applies every patch it writes to a simulated WINC flash holding the
+source, the way imager_task would, and fails unless the result is the target.
+"apply" runs that simulation on its own and writes out the flash it leaves;
+with --interrupt N it cuts the power part way through the Nth erase or program,
+then applies the patch again, resuming from the journal as imager_task would.
+"""
+
+import argparse
+import collections
+import hashlib
+import struct
+import sys
+
+MAGIC = 0x50574259  # "YBWP"
+FORMAT = 1
+HEADER = struct.Struct("<IIIIII32s32s32s")
+OP = struct.Struct("<BII")
+OP_COPY = 1
+OP_INSERT = 2
+
+SECTOR = 4096
+PAGE = 256
+
+# Source offsets are indexed every ALIGN bytes by the BLOCK bytes found there.
+BLOCK = 16
+ALIGN = 4
+MAX_CANDIDATES = 8
+# Shorter matches cost more as ops than as inserted bytes.
+MIN_COPY = 24
+
+# Bytes of the ops hash that tie a journal to its patch.
+JOURNAL_ID = 12
+
+# Where the working firmware version lives in a raw image: the
+# u32OtaCurrentworkingImagFirmwareVer field of the control sector.
+VERSION_OFFSET = 0x1000 + 5 * 4
+
+Op = collections.namedtuple("Op", "kind offset length data")
+
+
+class PatchError(Exception):
+    pass
+
+
+class PowerCut(Exception):
+    pass
+
+
+def match_length(a, ai, b, bi, limit):
+    """Length of the common run of a[ai:] and b[bi:], at most limit."""
+    n = 0
+    step = PAGE
+    while n < limit:
+        m = min(step, limit - n)
+        if a[ai + n:ai + n + m] == b[bi + n:bi + n + m]:
+            n += m
+        elif m == 1:
+            break
+        else:
+            step = max(1, m // 2)
+    return n
+
+
+def diff(source, target):
+    """Return the ops that build target from source in place."""
+    index = collections.defaultdict(list)
+    for i in range(0, len(source) - BLOCK + 1, ALIGN):
+        offsets = index[source[i:i + BLOCK]]
+        if len(offsets) < MAX_CANDIDATES:
+            offsets.append(i)
+
+    ops = []
+    pending = bytearray()
+    resume = None  # source offset following the last copy
+    p = 0
+    while p < len(target):
+        sector_start = p - p % SECTOR
+        limit = sector_start + SECTOR - p
+        limit = min(limit, len(target) - p)
+        # Copies may only read the sector being built or later ones, which
+        # have not been rewritten yet.
+        candidates = [resume, p] + index.get(target[p:p + BLOCK], [])
+        best, best_length = None, 0
+        for src in candidates:
+            if src is None or src < sector_start or src >= len(source):
+                continue
+            n = match_length(source, src, target, p,
+                             min(limit, len(source) - src))
+            if n > best_length:
+                best, best_length = src, n
+        # A run that carries on from the last copy is worth taking at any
+        # length; elsewhere a short match costs more than it saves.
+        if best_length >= MIN_COPY or (best == resume and best_length > 0 and
+                                       not pending):
+            if pending:
+                ops.append(Op(OP_INSERT, 0, len(pending), bytes(pending)))
+                pending = bytearray()
+            ops.append(Op(OP_COPY, best, best_length, b""))
+            p += best_length
+            resume = best + best_length
+        else:
+            pending.append(target[p])
+            p += 1
+            resume = None
+    if pending:
+        ops.append(Op(OP_INSERT, 0, len(pending), bytes(pending)))
+    return merge(ops)
+
+
+def merge(ops):
+    """Join copies of adjacent source runs and adjacent inserts."""
+    merged = []
+    for op in ops:
+        last = merged[-1] if merged else None
+        if (last and op.kind == OP_COPY and last.kind == OP_COPY and
+                last.offset + last.length == op.offset):
+            merged[-1] = last._replace(length=last.length + op.length)
+        elif last and op.kind == OP_INSERT and last.kind == OP_INSERT:
+            merged[-1] = last._replace(length=last.length + op.length,
+                                       data=last.data + op.data)
+        else:
+            merged.append(op)
+    return merged
+
+
+def version_of(image, region):
+    if region != "raw" or len(image) < VERSION_OFFSET + 4:
+        return 0
+    return struct.unpack_from("<I", image, VERSION_OFFSET)[0]
+
+
+def encode(source, target, ops, region):
+    body = bytearray()
+    for op in ops:
+        body += OP.pack(op.kind, op.offset, op.length) + op.data
+    header = HEADER.pack(MAGIC, FORMAT, len(source), len(target),
+                         version_of(source, region), version_of(target, region),
+                         hashlib.sha256(source).digest(),
+                         hashlib.sha256(target).digest(),
+                         hashlib.sha256(body).digest())
+    return header + bytes(body)
+
+
+def decode(patch):
+    if len(patch) < HEADER.size:
+        raise PatchError("too short for a patch header")
+    (magic, fmt, source_size, target_size, source_version, target_version,
+     source_sha, target_sha, ops_sha) = HEADER.unpack_from(patch)
+    if magic != MAGIC or fmt != FORMAT:
+        raise PatchError("not a format %d patch" % FORMAT)
+    body = patch[HEADER.size:]
+    if hashlib.sha256(body).digest() != ops_sha:
+        raise PatchError("ops do not match their hash")
+    return dict(source_size=source_size, target_size=target_size,
+                source_version=source_version, target_version=target_version,
+                source_sha=source_sha, target_sha=target_sha, ops_sha=ops_sha,
+                body=body)
+
+
+class WincNvm:
+    """A WINC flash region with the semantics of its NOR flash: erasing a
+    sector sets it to 0xFF, and programming can only clear bits.
+
+    If cut_after is set, the power fails half way through the erase or program
+    that follows that many others, leaving its sector holding neither the old
+    bytes nor the new."""
+
+    def __init__(self, contents, size, cut_after=None):
+        self.flash = bytearray(contents) + b"\xff" * (size - len(contents))
+        self.sectors_erased = 0
+        self.pages_written = 0
+        self.cut_after = cut_after
+
+    def powered(self):
+        """Count an erase or program; return False if it is cut short."""
+        if self.cut_after is None:
+            return True
+        self.cut_after -= 1
+        return self.cut_after >= 0
+
+    def read(self, offset, length):
+        if offset < 0 or offset + length > len(self.flash):
+            raise PatchError("read of 0x%x+%d outside the region" %
+                             (offset, length))
+        return bytes(self.flash[offset:offset + length])
+
+    def erase_sector(self, sector):
+        start = sector * SECTOR
+        if not self.powered():
+            self.flash[start:start + SECTOR // 2] = b"\xff" * (SECTOR // 2)
+            raise PowerCut()
+        self.flash[start:start + SECTOR] = b"\xff" * SECTOR
+        self.sectors_erased += 1
+
+    def write(self, offset, data):
+        if offset % PAGE or len(data) % PAGE:
+            raise PatchError("write of 0x%x+%d is not whole pages" %
+                             (offset, len(data)))
+        powered = self.powered()
+        for i, byte in enumerate(data[:len(data) if powered else PAGE // 2]):
+            self.flash[offset + i] &= byte
+        if not powered:
+            raise PowerCut()
+        self.pages_written += len(data) // PAGE
+
+
+class Journal:
+    """The journal imager_task keeps in the SAME54's internal flash, which a
+    power cut does not disturb: the patch it is for and, for each sector about
+    to be changed, its new contents and the position in the ops after it."""
+
+    def __init__(self):
+        self.clear()
+
+    def clear(self):
+        self.patch_id = None
+        self.entries = []
+
+    def begin(self, patch_id):
+        self.patch_id = patch_id
+        self.entries = []
+
+    def append(self, sector, op_start, done, data):
+        self.entries.append((sector, op_start, done, bytes(data)))
+
+    def last(self, patch_id):
+        if self.patch_id != patch_id or not self.entries:
+            return None
+        return self.entries[-1]
+
+
+def apply(nvm, patch, journal):
+    """Apply patch to nvm in place, as imager_task does, resuming from the
+    journal if an earlier attempt was cut short."""
+    header = decode(patch)
+    source_size, target_size = header["source_size"], header["target_size"]
+    patch_id = header["ops_sha"][:JOURNAL_ID]
+    if hashlib.sha256(nvm.read(0, target_size)).digest() == header["target_sha"]:
+        journal.clear()
+        return "already patched"
+
+    body = header["body"]
+    position = 0
+    op, op_start, done = None, 0, 0
+    first, resumed = 0, None
+    if hashlib.sha256(nvm.read(0, source_size)).digest() != header["source_sha"]:
+        resumed = journal.last(patch_id)
+        if resumed is None:
+            raise PatchError("flash matches neither source nor target")
+        first, op_start, done, _ = resumed
+        op = OP.unpack_from(body, op_start)
+        position = op_start + OP.size
+        if op[0] == OP_INSERT:
+            position += done
+
+    journaling = resumed is not None
+    patched = 0
+    for sector in range(first, (target_size + SECTOR - 1) // SECTOR):
+        sector_start = sector * SECTOR
+        length = min(SECTOR, target_size - sector_start)
+        have = nvm.read(sector_start, SECTOR)
+        is_resumed = resumed is not None and sector == first
+        want = bytearray(resumed[3]) if is_resumed else bytearray()
+        while len(want) < length:
+            if op is None or done == op[2]:
+                if position + OP.size > len(body):
+                    raise PatchError("ops end in sector %d" % sector)
+                op = OP.unpack_from(body, position)
+                op_start = position
+                position += OP.size
+                done = 0
+                if op[0] not in (OP_COPY, OP_INSERT) or op[2] == 0:
+                    raise PatchError("bad op %r" % (op,))
+            n = min(op[2] - done, length - len(want))
+            if op[0] == OP_INSERT:
+                want += body[position:position + n]
+                position += n
+            else:
+                src = op[1] + done
+                if src < sector_start or src + n > source_size:
+                    raise PatchError("copy from 0x%x into sector %d" %
+                                     (src, sector))
+                want += nvm.read(src, n)
+            done += n
+        # Beyond the end of the target, keep what the flash already has.
+        want += have[len(want):]
+
+        pages = [i for i in range(0, SECTOR, PAGE)
+                 if want[i:i + PAGE] != have[i:i + PAGE]]
+        if not pages:
+            continue
+        if not journaling:
+            journal.begin(patch_id)
+            journaling = True
+        if not is_resumed:
+            journal.append(sector, op_start, done, want)
+        if any(w & ~h for w, h in zip(want, have)):
+            nvm.erase_sector(sector)
+            pages = [i for i in range(0, SECTOR, PAGE)
+                     if want[i:i + PAGE] != b"\xff" * PAGE]
+        else:
+            patched += 1
+        for i in pages:
+            nvm.write(sector_start + i, want[i:i + PAGE])
+        if nvm.read(sector_start, SECTOR) != want:
+            raise PatchError("sector %d failed verification" % sector)
+
+    if hashlib.sha256(nvm.read(0, target_size)).digest() != header["target_sha"]:
+        raise PatchError("result does not match the target")
+    journal.clear()
+    return "%s%d sectors erased, %d patched in place, %d pages written" % (
+        "resumed at sector %d; " % first if resumed else "",
+        nvm.sectors_erased, patched, nvm.pages_written)
+
+
+def region_size(*sizes):
+    return (max(sizes) + SECTOR - 1) // SECTOR * SECTOR
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    commands = parser.add_subparsers(dest="command", required=True)
+    make = commands.add_parser("make", help="make a patch")
+    make.add_argument("source", type=argparse.FileType("rb"))
+    make.add_argument("target", type=argparse.FileType("rb"))
+    make.add_argument("-o", "--output", required=True)
+    make.add_argument("--region", default="raw",
+                      help="winc_image_region the patch is for; firmware "
+                      "versions are checked only for raw [raw]")
+    simulate = commands.add_parser("apply", help="simulate applying a patch")
+    simulate.add_argument("source", type=argparse.FileType("rb"))
+    simulate.add_argument("patch", type=argparse.FileType("rb"))
+    simulate.add_argument("-o", "--output")
+    simulate.add_argument("--interrupt", type=int, metavar="N",
+                          help="cut the power during the Nth erase or "
+                          "program, then resume")
+    args = parser.parse_args()
+
+    source = args.source.read()
+    try:
+        if args.command == "make":
+            target = args.target.read()
+            ops = diff(source, target)
+            patch = encode(source, target, ops, args.region)
+            nvm = WincNvm(source, region_size(len(source), len(target)))
+            result = apply(nvm, patch, Journal())
+            with open(args.output, "wb") as f:
+                f.write(patch)
+            inserted = sum(op.length for op in ops if op.kind == OP_INSERT)
+            print("%s: %d bytes, %d ops, %d bytes inserted; %s" %
+                  (args.output, len(patch), len(ops), inserted, result))
+        else:
+            patch = args.patch.read()
+            header = decode(patch)
+            nvm = WincNvm(source, region_size(len(source),
+                                              header["target_size"]),
+                          args.interrupt)
+            journal = Journal()
+            try:
+                print(apply(nvm, patch, journal))
+            except PowerCut:
+                print("power cut after %d sectors erased and %d pages "
+                      "written" % (nvm.sectors_erased, nvm.pages_written))
+                nvm.cut_after = None
+                print(apply(nvm, patch, journal))
+            if args.output:
+                with open(args.output, "wb") as f:
+                    f.write(nvm.flash[:header["target_size"]])
+    except PatchError as e:
+        sys.exit("winc_patch: %s" % e)
+
+
+if __name__ == "__main__":
+    main()